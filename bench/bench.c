@@ -0,0 +1,275 @@
+/**
+ * @file bench.c
+ * @brief Compiler throughput harness (`make bench`).
+ *
+ * Generates each workload with `gen`, compiles it with `mycc --stats=json`
+ * a few times, and reports the best lines-per-second figure of every
+ * phase. Results can be saved as a baseline and compared against later:
+ *
+ *   bench --mycc build/bin/mycc --gen build/bench/gen --work build/bench
+ *         [--reps N] [--only NAME] [--baseline FILE] [--write-baseline FILE]
+ *
+ * The baseline is plain text, one workload per line:
+ *   <workload> <total> <cache> <parse> <semantic> ... (lines per second)
+ * Absolute numbers only mean something on the machine that produced them,
+ * so regenerate it locally before comparing.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+/* A phase or the total more than this much slower than baseline is flagged */
+#define REGRESSION_PCT 10.0
+
+#define MAX_BASELINE 64
+
+/* Must match stats.c, in the same order */
+static const char *const phases[] = {
+    "cache", "parse", "semantic", "lower", "optimize", "codegen", "peephole", "output"
+};
+#define NPHASES ((int)(sizeof phases / sizeof phases[0]))
+
+typedef struct Workload {
+    const char *name;
+    const char *kind;       /* gen workload */
+    long lines;
+    const char *flags;      /* Extra mycc flags */
+} Workload;
+
+static const Workload workloads[] = {
+    { "lets-10k",     "lets",    10000,   "" },
+    { "lets-100k",    "lets",    100000,  "" },
+    { "lets-1m",      "lets",    1000000, "" },
+    { "lets-10k-O1",  "lets",    10000,   "-O1 --peephole" },
+    { "nested-100k",  "nested",  100000,  "" },
+    { "borrows-100k", "borrows", 100000,  "" },
+    { "strings-100k", "strings", 100000,  "" },
+};
+#define NWORKLOADS ((int)(sizeof workloads / sizeof workloads[0]))
+
+/** Best (smallest) time of each phase over the repetitions, in ns. */
+typedef struct Result {
+    double total;
+    double phase[NPHASES];
+} Result;
+
+typedef struct BaselineRow {
+    char name[64];
+    double total;
+    double phase[NPHASES];  /* Lines per second; 0 = phase too short to time */
+} BaselineRow;
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096, len = 0;
+    char *buf = malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + len, 1, cap - len - 1, f)) > 0) {
+        len += n;
+        if (cap - len < 2) buf = realloc(buf, cap *= 2);
+    }
+    fclose(f);
+    if (buf) buf[len] = '\0';
+    return buf;
+}
+
+/** Value of `"key": {"ns": N` (a phase) in the stats JSON, or -1. */
+static double json_phase_ns(const char *json, const char *key) {
+    char pat[64];
+    snprintf(pat, sizeof pat, "\"%s\": {\"ns\": ", key);
+    const char *p = strstr(json, pat);
+    return p ? strtod(p + strlen(pat), NULL) : -1.0;
+}
+
+/** Compiles `src` once; false if mycc failed or printed no statistics. */
+static bool run_once(const char *mycc, const Workload *w, const char *work, Result *r) {
+    char cmd[2048], src[512], out[512], stats[512];
+    snprintf(src, sizeof src, "%s/%s.my", work, w->name);
+    snprintf(out, sizeof out, "%s/%s", work, w->name);
+    snprintf(stats, sizeof stats, "%s/%s.json", work, w->name);
+    snprintf(cmd, sizeof cmd, "\"%s\" \"%s\" -o \"%s\" --emit=obj %s --stats=json > %s 2> \"%s\"",
+             mycc, src, out, w->flags, NULL_DEVICE, stats);
+    if (system(cmd) != 0) return false;
+
+    char *json = read_file(stats);
+    if (!json) return false;
+    bool ok = true;
+    r->total = 0;
+    for (int p = 0; p < NPHASES; p++) {
+        r->phase[p] = json_phase_ns(json, phases[p]);
+        if (r->phase[p] < 0) ok = false;
+        r->total += r->phase[p];
+    }
+    free(json);
+    return ok;
+}
+
+static double lines_per_sec(long lines, double ns) {
+    return ns > 0 ? (double)lines / (ns / 1e9) : 0.0;
+}
+
+/* Phases below this share of the total are too short to time reliably */
+#define MIN_PHASE_SHARE 0.01
+
+static int load_baseline(const char *path, BaselineRow *rows) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "bench: cannot read baseline '%s'\n", path);
+        return 0;
+    }
+    int n = 0;
+    char line[1024];
+    while (n < MAX_BASELINE && fgets(line, sizeof line, f)) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+        BaselineRow *b = &rows[n];
+        char *p = line;
+        int used;
+        if (sscanf(p, "%63s %lf%n", b->name, &b->total, &used) != 2) continue;
+        p += used;
+        for (int k = 0; k < NPHASES; k++) {
+            b->phase[k] = 0;
+            if (sscanf(p, "%lf%n", &b->phase[k], &used) == 1) p += used;
+        }
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static const BaselineRow *find_baseline(const BaselineRow *rows, int n, const char *name) {
+    for (int i = 0; i < n; i++)
+        if (strcmp(rows[i].name, name) == 0) return &rows[i];
+    return NULL;
+}
+
+/** Prints one throughput cell in k lines/s, or '-' for phases too short to time. */
+static void print_rate(double rate) {
+    if (rate > 0) printf(" %9.1f", rate / 1000.0);
+    else printf(" %9s", "-");
+}
+
+/** Prints the change against the baseline; returns true on a regression. */
+static bool print_delta(double now, double base) {
+    if (now <= 0 || base <= 0) {
+        printf(" %9s", "");
+        return false;
+    }
+    double pct = 100.0 * (now - base) / base;
+    bool slow = pct < -REGRESSION_PCT;
+    printf(" %+7.1f%%%c", pct, slow ? '!' : ' ');
+    return slow;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: bench --mycc <path> --gen <path> --work <dir> [--reps N] [--only NAME]"
+                    " [--baseline FILE] [--write-baseline FILE]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *mycc = NULL, *gen = NULL, *work = NULL;
+    const char *baseline = NULL, *write_baseline = NULL, *only = NULL;
+    int reps = 3;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (i + 1 >= argc) usage();
+        if (strcmp(a, "--mycc") == 0) mycc = argv[++i];
+        else if (strcmp(a, "--gen") == 0) gen = argv[++i];
+        else if (strcmp(a, "--work") == 0) work = argv[++i];
+        else if (strcmp(a, "--baseline") == 0) baseline = argv[++i];
+        else if (strcmp(a, "--write-baseline") == 0) write_baseline = argv[++i];
+        else if (strcmp(a, "--only") == 0) only = argv[++i];
+        else if (strcmp(a, "--reps") == 0) reps = atoi(argv[++i]);
+        else usage();
+    }
+    if (!mycc || !gen || !work || reps < 1) usage();
+
+    BaselineRow base[MAX_BASELINE];
+    int nbase = baseline ? load_baseline(baseline, base) : 0;
+
+    FILE *save = NULL;
+    if (write_baseline) {
+        save = fopen(write_baseline, "w");
+        if (!save) {
+            fprintf(stderr, "bench: cannot write '%s'\n", write_baseline);
+            return 1;
+        }
+        fprintf(save, "# mycc throughput baseline, lines per second (best of %d runs)\n", reps);
+        fprintf(save, "# workload total");
+        for (int p = 0; p < NPHASES; p++) fprintf(save, " %s", phases[p]);
+        fprintf(save, "\n");
+    }
+
+    printf("%-14s %8s %9s", "workload", "lines", "total");
+    for (int p = 0; p < NPHASES; p++) printf(" %9.9s", phases[p]);
+    printf("   (k lines/s, best of %d)\n", reps);
+
+    int failures = 0, regressions = 0;
+    for (int i = 0; i < NWORKLOADS; i++) {
+        const Workload *w = &workloads[i];
+        if (only && strcmp(only, w->name) != 0) continue;
+
+        char cmd[2048];
+        snprintf(cmd, sizeof cmd, "\"%s\" %s %ld \"%s/%s.my\"", gen, w->kind, w->lines, work, w->name);
+        Result best;
+        bool ok = system(cmd) == 0;
+        for (int r = 0; ok && r < reps; r++) {
+            Result cur;
+            ok = run_once(mycc, w, work, &cur);
+            if (!ok) break;
+            if (r == 0 || cur.total < best.total) best.total = cur.total;
+            for (int p = 0; p < NPHASES; p++)
+                if (r == 0 || cur.phase[p] < best.phase[p]) best.phase[p] = cur.phase[p];
+        }
+        if (!ok) {
+            printf("%-14s FAILED\n", w->name);
+            failures++;
+            continue;
+        }
+
+        double total = lines_per_sec(w->lines, best.total);
+        double rate[NPHASES];
+        printf("%-14s %8ld", w->name, w->lines);
+        print_rate(total);
+        for (int p = 0; p < NPHASES; p++) {
+            bool timed = best.phase[p] >= MIN_PHASE_SHARE * best.total;
+            rate[p] = timed ? lines_per_sec(w->lines, best.phase[p]) : 0.0;
+            print_rate(rate[p]);
+        }
+        printf("\n");
+
+        const BaselineRow *b = find_baseline(base, nbase, w->name);
+        if (b) {
+            printf("%-14s %8s", "  vs baseline", "");
+            bool slow = print_delta(total, b->total);
+            for (int p = 0; p < NPHASES; p++) slow |= print_delta(rate[p], b->phase[p]);
+            printf("\n");
+            regressions += slow;
+        }
+
+        if (save) {
+            fprintf(save, "%s %.0f", w->name, total);
+            for (int p = 0; p < NPHASES; p++) fprintf(save, " %.0f", rate[p]);
+            fprintf(save, "\n");
+        }
+    }
+
+    if (save && fclose(save) != 0) {
+        fprintf(stderr, "bench: cannot write '%s'\n", write_baseline);
+        return 1;
+    }
+    if (nbase)
+        printf("%d workload%s more than %.0f%% slower than baseline in some phase (marked '!')\n",
+               regressions, regressions == 1 ? "" : "s", REGRESSION_PCT);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file gen.c
+ * @brief Synthetic MyLang program generator for the throughput benchmarks.
+ *
+ * Usage: gen <workload> <lines> <out.my>
+ *
+ * Every workload produces a program that passes type and borrow checking,
+ * about `lines` lines long, stressing one part of the compiler:
+ *
+ *   lets     straight-line `let` chains reading earlier variables
+ *            (lexer, symbol table, constant folding, emitter)
+ *   nested   blocks, ifs and whiles nested up to 64 deep, with shadowing
+ *            (parser recursion, scopes, control flow)
+ *   borrows  one long chain of copied borrows per string
+ *            (borrow checker dataflow)
+ *   strings  a large table of distinct string literals
+ *            (string scanning, literal emission)
+ *
+ * Output is deterministic: the same arguments always give the same file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEST_DEPTH 64
+
+static void gen_lets(FILE *out, long lines) {
+    long v = 0;
+    fprintf(out, "let v0: int = 1;\n");
+    for (long i = 1; i < lines; i++) {
+        if (i % 1000 == 0) {
+            fprintf(out, "print(v%ld);\n", v);
+        } else {
+            fprintf(out, "let v%ld: int = v%ld + %ld * 3;\n", v + 1, v, i % 97);
+            v++;
+        }
+    }
+}
+
+static void gen_nested(FILE *out, long lines) {
+    long n = 1;
+    fprintf(out, "let depth: int = 0;\n");
+    while (n < lines) {
+        /* One tower: NEST_DEPTH openers, a body, NEST_DEPTH closers */
+        for (int d = 0; d < NEST_DEPTH; d++) {
+            int pad = d * 2;
+            switch (d % 3) {
+            case 0:
+                fprintf(out, "%*s{\n", pad, "");
+                n += 1;
+                break;
+            case 1:
+                fprintf(out, "%*sif depth < %d {\n", pad, "", 1000 + d);
+                n += 1;
+                break;
+            default:
+                /* The shadowing let keeps the loop from ever running */
+                fprintf(out, "%*slet depth: int = %d;\n", pad, "", d);
+                fprintf(out, "%*swhile depth > %d {\n", pad, "", d);
+                n += 2;
+                break;
+            }
+        }
+        fprintf(out, "%*sprint(depth);\n", NEST_DEPTH * 2, "");
+        n++;
+        for (int d = NEST_DEPTH - 1; d >= 0; d--, n++)
+            fprintf(out, "%*s}\n", d * 2, "");
+    }
+}
+
+static void gen_borrows(FILE *out, long lines) {
+    /* Chains of CHAIN copies of one borrow, each checked against its owner */
+    const long chain = 1000;
+    long n = 0;
+    for (long c = 0; n < lines; c++) {
+        fprintf(out, "let s%ld: string = \"owner %ld\";\n", c, c);
+        fprintf(out, "let r%ld_0 = &s%ld;\n", c, c);
+        n += 2;
+        for (long k = 1; k < chain && n < lines; k++, n++)
+            fprintf(out, "let r%ld_%ld = r%ld_%ld;\n", c, k, c, k - 1);
+        fprintf(out, "print(s%ld);\n", c);
+        n++;
+    }
+}
+
+static void gen_strings(FILE *out, long lines) {
+    static const char *const words[] = {
+        "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel"
+    };
+    for (long i = 0; i < lines; i++) {
+        if (i % 4 == 3) {
+            fprintf(out, "print(t%ld);\n", i - 1);
+            continue;
+        }
+        fprintf(out, "let t%ld: string = \"%s %s %ld: \\\"quoted\\\" and plain text\";\n",
+                i, words[i % 8], words[(i / 8) % 8], i);
+    }
+}
+
+typedef struct Workload {
+    const char *name;
+    void (*gen)(FILE *out, long lines);
+} Workload;
+
+static const Workload workloads[] = {
+    { "lets", gen_lets },
+    { "nested", gen_nested },
+    { "borrows", gen_borrows },
+    { "strings", gen_strings },
+};
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: gen <lets|nested|borrows|strings> <lines> <out.my>\n");
+        return 1;
+    }
+
+    char *end;
+    long lines = strtol(argv[2], &end, 10);
+    if (*end != '\0' || lines < 1) {
+        fprintf(stderr, "gen: bad line count '%s'\n", argv[2]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof workloads / sizeof workloads[0]; i++) {
+        if (strcmp(argv[1], workloads[i].name) != 0) continue;
+
+        FILE *out = fopen(argv[3], "w");
+        if (!out) {
+            perror(argv[3]);
+            return 1;
+        }
+        workloads[i].gen(out, lines);
+        if (fclose(out) != 0) {
+            perror(argv[3]);
+            return 1;
+        }
+        return 0;
+    }
+
+    fprintf(stderr, "gen: unknown workload '%s'\n", argv[1]);
+    return 1;
+}
@@ -0,0 +1,94 @@
+#ifndef ASM_H
+#define ASM_H
+
+#include "common.h"
+
+/**
+ * @file asm.h
+ * @brief In-memory buffer of emitted assembly lines.
+ *
+ * The backend formats NASM text into an AsmBuf instead of writing it to the
+ * output file directly. Every line is split into a mnemonic and operands so
+ * that later passes (see peephole.h) can inspect and rewrite instructions
+ * before the buffer is written out.
+ *
+ * Hot paths append structured lines directly (asm_insn, asm_label) and skip
+ * both printf formatting and re-parsing; asm_printf remains for free-form
+ * text. The finished buffer is rendered into memory and written with a
+ * single fwrite.
+ */
+
+#define ASM_MAX_OPS 2
+#define ASM_OP_LEN  64
+
+/**
+ * @enum AsmKind
+ * @brief Classification of a buffered line.
+ */
+typedef enum {
+    ASM_INSN,       /* Indented instruction: mnemonic + operands */
+    ASM_LABEL,      /* "name:" on its own line */
+    ASM_DIRECTIVE   /* Anything else (section, extern, data, blank lines) */
+} AsmKind;
+
+/**
+ * @struct AsmLine
+ * @brief One line of assembly.
+ */
+typedef struct AsmLine {
+    AsmKind kind;
+    char mnemonic[16];                  /* ASM_INSN only */
+    char ops[ASM_MAX_OPS][ASM_OP_LEN];  /* ASM_INSN only */
+    int nops;
+    char *text;                         /* ASM_LABEL / ASM_DIRECTIVE, owned */
+} AsmLine;
+
+/**
+ * @struct AsmBuf
+ * @brief Growable sequence of lines, plus the partially formatted line.
+ */
+typedef struct AsmBuf {
+    AsmLine *lines;
+    int n, cap;
+
+    StrBuf pending;     /* Text after the last newline */
+} AsmBuf;
+
+void asm_init(AsmBuf *buf);
+void asm_free(AsmBuf *buf);
+
+/** Appends formatted text; every completed line is parsed into the buffer. */
+void asm_printf(AsmBuf *buf, const char *fmt, ...);
+
+/** Appends an instruction; `op0`/`op1` may be NULL for fewer operands. */
+void asm_insn(AsmBuf *buf, const char *mnemonic, const char *op0, const char *op1);
+
+/** Appends "name:". */
+void asm_label(AsmBuf *buf, const char *name);
+
+/** Appends a directive/data line taken verbatim (no trailing newline). */
+void asm_directive(AsmBuf *buf, const char *text, size_t len);
+
+/**
+ * @brief Formats a memory operand such as "qword [rbp-8]" into `out`.
+ * `size` may be NULL; `out` must hold ASM_OP_LEN bytes.
+ */
+void asm_fmt_mem(char *out, const char *size, const char *base, long disp);
+
+/** Like asm_fmt_mem with a scaled index: "[base+index*scale+disp]" ("*1" is left out). */
+void asm_fmt_index(char *out, const char *size, const char *base, const char *index,
+                   int scale, long disp);
+
+/** Appends the text of all lines (and any unterminated text) to `out`. */
+void asm_render(const AsmBuf *buf, StrBuf *out);
+
+/** Renders the buffer and writes it to `out` at once; false on I/O error. */
+bool asm_write(const AsmBuf *buf, FILE *out);
+
+/** Number of ASM_INSN lines. */
+int asm_count_insns(const AsmBuf *buf);
+
+/** Builds an instruction line in place (nops operands from `ops`). */
+void asm_set_insn(AsmLine *line, const char *mnemonic, int nops, const char *ops[]);
+
+#endif
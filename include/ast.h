@@ -2,6 +2,7 @@
 #define AST_H
 
 #include "common.h"
+#include "intern.h"
 
 /**
  * @enum StmtKind
@@ -9,6 +10,7 @@
  */
 typedef enum {
     S_DECL,     /* Variable declaration and initialization */
+    S_ASSIGN,   /* Re-assignment of an existing variable (x = expr, a[i] = expr) */
     S_EXPR,     /* Expression-based statement (e.g., assignments, side effects) */
     S_IF,       /* Conditional control flow (if-else) */
     S_WHILE,    /* Pre-condition iteration (while loop) */
@@ -36,6 +38,20 @@ typedef enum {
     E_INDEX     /* Subscript/Element access operation */
 } ExprKind;
 
+/**
+ * @enum AliasFact
+ * @brief What the borrow checker proved about references to a binding.
+ * There is no way to write through a reference that the checker has not
+ * seen, so the binding changes only by its own assignments unless it
+ * has a `&mut` borrow.
+ */
+typedef enum {
+    ALIAS_UNKNOWN,  /* Not checked (--no-borrowck): any borrow may write it */
+    ALIAS_NONE,     /* Never borrowed */
+    ALIAS_SHARED,   /* Only `&` borrows, which freeze it while in force */
+    ALIAS_MUT       /* Has `&mut` borrows, each exclusive while in force */
+} AliasFact;
+
 /**
  * @struct Expr
  * @brief Representation of an expression node.
@@ -48,13 +64,16 @@ typedef struct Expr {
 
     union {
         long int_val;
-        char *str_val;
-        char ident[MAX_IDENT];
+        /* Not NUL-terminated: a view of the source or of the arena */
+        struct { const char *data; int len; } str;
+        Symbol ident;
 
+        /* op is the operator character; two-character comparisons use
+           'l' (<=), 'g' (>=), 'e' (==) and 'n' (!=). */
         struct { char op; struct Expr *l, *r; } bin;
 
         struct {
-            char name[MAX_IDENT];
+            Symbol name;
             struct Expr **args;
             int nargs;
         } call;
@@ -88,12 +107,25 @@ typedef struct Stmt {
     int line, col;
 
     union {
+        /* Ownership facts for owning (string, Rc) bindings are refined by the
+           borrow checker; the constructor defaults are safe without it */
         struct {
-            char name[MAX_IDENT];
+            Symbol name;
             Type type;
             Expr *init;
+            bool clear_on_move; /* Moving out must leave the slot empty */
+            bool drop_at_exit;  /* May still own its value at scope exit */
+            bool rc_alias;      /* `let b = clone(rc)` sharing its source's count */
+            AliasFact alias;    /* References to it, as proved by the borrow checker */
         } decl;
 
+        struct {
+            Symbol name;
+            Expr *index;        /* name[index] = value; NULL for the whole variable */
+            Expr *value;
+            bool drop_old;      /* The target may own a value to drop first */
+        } assign;
+
         Expr *expr;
 
         struct {
@@ -107,10 +139,14 @@ typedef struct Stmt {
             struct Stmt *body;
         } wh;
 
+        /* for var in start..end: the induction variable is an int
+           declaration without initializer, bound anew on every iteration.
+           `par for` runs the iterations on the runtime's thread pool. */
         struct {
-            char var[MAX_IDENT];
+            struct Stmt *var;
             Expr *iter;
             struct Stmt *body;
+            bool par;
         } fors;
 
         struct {
@@ -128,42 +164,55 @@ typedef struct Stmt {
  * Represents a single compilation unit consisting of a signature and a body.
  */
 typedef struct Function {
-    char name[MAX_IDENT];
+    Symbol name;
     Type ret_type;
     Stmt *body;
+    Arena arena;        /* Owns every node, escaped string and list of the tree */
+    SourceBuf source;   /* Mapped input that unescaped string literals point into */
 } Function;
 
 /* ---------------------------------------------------------
    AST Constructors (Factory Methods)
-   Functions for heap allocation and node initialization.
+   Nodes are allocated from the arena `a`, which make_main hands over to
+   the Function (together with the source mapping) so that the whole
+   tree is released in one step.
    --------------------------------------------------------- */
 
-Expr *expr_int(long v, int line, int col);
-Expr *expr_str(const char *s, int line, int col);
-Expr *expr_ident(const char *s, int line, int col);
-Expr *expr_addr(Expr *inner, bool mut, int line, int col);
-Expr *expr_call(const char *name, Expr **args, int nargs, int line, int col);
-Expr *expr_range(Expr *start, Expr *end, int line, int col);
-Expr *expr_array(Expr **items, int count, int line, int col);
-Expr *expr_index(Expr *array, Expr *index, int line, int col);
-
-Stmt *stmt_decl(const char *name, Type t, Expr *init, int line, int col);
-Stmt *stmt_expr(Expr *e, int line, int col);
-Stmt *stmt_block(Stmt **stmts, int n, int line, int col);
-Stmt *stmt_if(Expr *cond, Stmt *then_s, Stmt *else_s, int line, int col);
-Stmt *stmt_while(Expr *cond, Stmt *body, int line, int col);
-Stmt *stmt_for(const char *var, Expr *iter, Stmt *body, int line, int col);
-
-Function *make_main(Stmt *body);
+Expr *expr_int(Arena *a, long v, int line, int col);
+Expr *expr_str(Arena *a, const char *s, int len, int line, int col);
+Expr *expr_ident(Arena *a, Symbol name, int line, int col);
+Expr *expr_addr(Arena *a, Expr *inner, bool mut, int line, int col);
+Expr *expr_binop(Arena *a, char op, Expr *l, Expr *r, int line, int col);
+Expr *expr_call(Arena *a, Symbol name, Expr **args, int nargs, int line, int col);
+Expr *expr_range(Arena *a, Expr *start, Expr *end, int line, int col);
+Expr *expr_array(Arena *a, Expr **items, int count, int line, int col);
+Expr *expr_index(Arena *a, Expr *array, Expr *index, int line, int col);
+
+Stmt *stmt_decl(Arena *a, Symbol name, Type t, Expr *init, int line, int col);
+Stmt *stmt_assign(Arena *a, Symbol name, Expr *value, int line, int col);
+Stmt *stmt_assign_index(Arena *a, Symbol name, Expr *index, Expr *value, int line, int col);
+Stmt *stmt_expr(Arena *a, Expr *e, int line, int col);
+Stmt *stmt_block(Arena *a, Stmt **stmts, int n, int line, int col);
+Stmt *stmt_if(Arena *a, Expr *cond, Stmt *then_s, Stmt *else_s, int line, int col);
+Stmt *stmt_while(Arena *a, Expr *cond, Stmt *body, int line, int col);
+Stmt *stmt_for(Arena *a, Symbol var, Expr *iter, Stmt *body, int line, int col);
+
+Function *make_main(Arena *arena, SourceBuf *source, Stmt *body);
 
 /* ---------------------------------------------------------
    Management and Debug Utilities
    --------------------------------------------------------- */
 
-/** Performs recursive deallocation of the function's AST. */
+/** Releases the function's AST (its arena) and the Function itself. */
 void ast_free_function(Function *f);
 
 /** Outputs a formatted text representation of the AST to stdout. */
 void ast_print_function(Function *f);
 
+/** Number of expression and statement nodes in the tree (for --mem-stats). */
+long ast_count_nodes(const Function *f);
+
+/** Number of nodes in the subtree of `s` (bounds loop unrolling). */
+long ast_count_stmt(const Stmt *s);
+
 #endif
\ No newline at end of file
@@ -1,5 +1,134 @@
 #ifndef BORROW_H
 #define BORROW_H
+
 #include "ast.h"
-void borrow_check(Function *f, const char *filename);
-#endif
\ No newline at end of file
+#include "symtab.h"
+
+/**
+ * @file borrowchecker.h
+ * @brief Ownership and borrowing rules, applied during the semantic pass.
+ *
+ * There is no separate borrow-check traversal: semantic_check walks the
+ * tree once and calls these hooks at uses, declarations, assignments,
+ * scope exits and control-flow constructs. The hooks record borrow events
+ * into the basic blocks of a small control-flow graph; bc_finish then
+ * runs the dataflow analyses over it and reports the first violation.
+ *
+ * The borrow state of a variable is a VarInfo that the semantic pass
+ * embeds in its own symbol table payload at `var_offset`, so both analyses
+ * share one table and one lookup per name.
+ *
+ * With checking disabled every hook returns immediately, and the ownership
+ * annotations keep their conservative AST defaults.
+ */
+
+/**
+ * @struct VarInfo
+ * @brief Per-binding borrow-check handle.
+ */
+typedef struct VarInfo {
+    int id;             /* Variable number in the event graph */
+} VarInfo;
+
+typedef struct BcEvent BcEvent;
+typedef struct BcBlock BcBlock;
+typedef struct BcVar BcVar;
+typedef struct BcLoan BcLoan;
+
+/**
+ * @struct BorrowCheck
+ * @brief Borrow-check context, owned by the driving pass.
+ */
+typedef struct BorrowCheck {
+    bool enabled;
+    const char *file;       /* Source filename for error reporting */
+    const SymTab *vars;     /* Scoped table of the driving pass */
+    size_t var_offset;      /* Offset of the VarInfo in each payload */
+
+    BcEvent *events;        /* All events; each block owns a contiguous run */
+    int nevents, events_cap;
+    BcBlock *blocks;
+    int nblocks, blocks_cap;
+    int cur;                /* Block receiving new events */
+
+    BcVar *var;             /* Indexed by VarInfo.id */
+    int nvars, vars_cap;
+    BcLoan *loans;          /* One per `&x` / `&mut x` bound to a variable */
+    int nloans, loans_cap;
+    BcLoan *copies;         /* Moves between variables, which carry loans along */
+    int ncopies, copies_cap;
+    int pending_loan;       /* Loan of a let initializer awaiting its holder */
+    int par_vars;           /* Variables declared before the par body being checked, or -1 */
+    int par_index;          /* Induction variable of that par loop */
+} BorrowCheck;
+
+/** Block bookkeeping of an if or while; see bc_if_begin/bc_loop_begin. */
+typedef struct BorrowFlow {
+    int cond, then_end;
+} BorrowFlow;
+
+void bc_init(BorrowCheck *bc, const char *file, const SymTab *vars, size_t var_offset, bool enabled);
+
+/** Runs the analyses, reports the first violation and records drop facts. */
+void bc_finish(BorrowCheck *bc);
+
+/** Releases the recorded events; bc_finish does this itself when it returns. */
+void bc_free(BorrowCheck *bc);
+
+/** Reads the variable `v` named by `e`; `what` describes the access in errors. */
+void bc_use(BorrowCheck *bc, VarInfo *v, const Expr *e, const char *what);
+
+/** Reads element `index` of the array `v` named by `e`. */
+void bc_use_element(BorrowCheck *bc, VarInfo *v, const Expr *e, const Expr *index);
+
+/**
+ * @brief Notes that `&v` or `&mut v` is taken, bound or not, for the alias
+ * facts bc_finish leaves in the declaration (Stmt.v.decl.alias).
+ */
+void bc_borrow(BorrowCheck *bc, VarInfo *v, bool mut);
+
+/**
+ * @brief Applies `let x = init`: moves or borrows the source of `init`.
+ * Must run before the new name is bound (it may shadow the source).
+ */
+void bc_bind_source(BorrowCheck *bc, Stmt *decl);
+
+/** Creates the borrow state `v` of the variable declared by `decl`. */
+void bc_declare(BorrowCheck *bc, VarInfo *v, Stmt *decl);
+
+/** Creates and defines the induction variable `decl` of a for loop (on each iteration). */
+void bc_loop_var(BorrowCheck *bc, VarInfo *v, Stmt *decl);
+
+/** Applies `target = value` for the assignment `st`. */
+void bc_assign(BorrowCheck *bc, VarInfo *target, Stmt *st);
+
+/** Applies `target[index] = value`: the array must be valid and not borrowed. */
+void bc_assign_index(BorrowCheck *bc, VarInfo *target, Stmt *st);
+
+/** Ends the bindings declared from `mark` up; call before symtab_pop. */
+void bc_close_scope(BorrowCheck *bc, int mark);
+
+/* if: begin after the condition, else (only with an else arm), end */
+void bc_if_begin(BorrowCheck *bc, BorrowFlow *fl);
+void bc_if_else(BorrowCheck *bc, BorrowFlow *fl);
+void bc_if_end(BorrowCheck *bc, BorrowFlow *fl);
+
+/* while: begin before the condition, body after it, end after the body.
+   A for loop uses the same hooks with an empty condition (its bounds are
+   evaluated once, before bc_loop_begin). */
+void bc_loop_begin(BorrowCheck *bc, BorrowFlow *fl);
+void bc_loop_body(BorrowCheck *bc, BorrowFlow *fl);
+void bc_loop_end(BorrowCheck *bc, BorrowFlow *fl);
+
+/**
+ * @brief Brackets the body of a `par for` with induction variable `index`
+ * (after bc_loop_var). Its iterations run concurrently, so until bc_par_end
+ * the variables declared before the body can only be read: they cannot be
+ * assigned, moved out of or mutably borrowed. An element of an outer array
+ * may be written only at `index` itself, which no two iterations share, and
+ * an array the body writes may only be read there at `index` as well.
+ */
+void bc_par_body(BorrowCheck *bc, VarInfo *index);
+void bc_par_end(BorrowCheck *bc);
+
+#endif
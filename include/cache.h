@@ -0,0 +1,54 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "common.h"
+
+#include <stdint.h>
+
+/**
+ * @file cache.h
+ * @brief On-disk cache of compiled units (--cache-dir).
+ *
+ * An entry is the finished .asm or object file of one unit, stored under
+ * a 128-bit key computed from the source bytes and a configuration string.
+ * The configuration covers everything else the output depends on: the
+ * compiler build, the target ABI and the code generation flags. A hit is
+ * copied to the output path and the unit is not compiled at all.
+ *
+ * Entries are written to a temporary name and renamed into place, so
+ * concurrent compilers sharing a directory never see a partial file.
+ *
+ * A resident compiler (mycc --server) also keeps the entries it fetches
+ * and stores in memory, so its hits do not read the directory at all.
+ */
+
+#define MYCC_VERSION "0.2.0-dev"
+
+typedef struct CacheKey {
+    uint64_t lo, hi;
+} CacheKey;
+
+/**
+ * @brief Appends an identity of the running compiler to `out`: the
+ * version plus a hash of the executable, so any rebuild changes it.
+ * `argv0` is the fallback for locating the executable.
+ */
+void cache_compiler_id(StrBuf *out, const char *argv0);
+
+/** Key of a unit with source `data[0..size)` built under `config`. */
+CacheKey cache_key(const char *config, const char *data, size_t size);
+
+/** Copies the entry for `key` with extension `ext` to `out_path`; false on a miss. */
+bool cache_fetch(const char *dir, const CacheKey *key, const char *ext, const char *out_path);
+
+/** Stores `out_path` as the entry for `key`. Failures only lose the entry. */
+void cache_store(const char *dir, const CacheKey *key, const char *ext, const char *out_path);
+
+/**
+ * @brief From now on, keeps entries in memory as well, up to `budget` bytes
+ * of them in all; later ones are only on disk. Entries do not depend on
+ * the directory they came from, so every directory shares the memory.
+ */
+void cache_keep_in_memory(size_t budget);
+
+#endif
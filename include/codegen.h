@@ -1,5 +1,34 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
-#include "ast.h"
-int codegen_function(Function *f, const char *out_asm, const char *module_name, bool debug_borrow);
+#include "ir.h"
+#include "objfile.h"
+
+/** Output produced by codegen_function. */
+typedef enum {
+    EMIT_ASM,               /* NASM source (assemble with nasm -f elf64/win64) */
+    EMIT_OBJ,               /* Relocatable object from the built-in assembler */
+    EMIT_JIT                /* The same object, kept in memory for --run */
+} EmitKind;
+
+/** Backend settings selected on the command line. */
+typedef struct CodegenOptions {
+    bool debug_borrow;
+    int opt_level;          /* 0 = stack machine, 1 = register temporaries */
+    bool peephole;          /* Run the peephole pass over the emitted code */
+    bool peephole_stats;    /* Print instruction counts for the peephole pass */
+    bool intrinsics;        /* Print integers through an inline routine, not the runtime */
+    bool instrument;        /* Count block and runtime call executions (--instrument) */
+    EmitKind emit;
+    StrBuf *log;            /* Receives the --peephole-stats report */
+    ObjFile *jit_obj;       /* EMIT_JIT: receives the code; out_path is unused */
+} CodegenOptions;
+
+/**
+ * @brief Generates code for `fn` into `out_path`: NASM text or, with
+ * EMIT_OBJ, a native ELF64/COFF object. EMIT_JIT assembles into
+ * opts->jit_obj (initialized and empty) instead.
+ * @return 0 on success, non-zero if the output could not be written.
+ */
+int codegen_function(IrFunc *fn, const char *out_path, const char *module_name,
+                     const CodegenOptions *opts);
 #endif
\ No newline at end of file
@@ -6,7 +6,6 @@
 #include <stdarg.h>
 #include <stdbool.h>
 
-#define MAX_TOK_LEN 256
 #define MAX_IDENT 128
 
 struct Type;
@@ -17,23 +16,215 @@ typedef enum {
     TY_REF,
     TY_MUTREF,
     TY_RC,
+    TY_ARRAY,
     TY_UNKNOWN
 } TypeKind;
 
 // === define Type AFTER forward declaration ===
 typedef struct Type {
     TypeKind kind;
-    struct Type *inner;
+    struct Type *inner;     /* TY_REF/TY_MUTREF: referent; TY_RC: payload; TY_ARRAY: element */
+    long len;               /* TY_ARRAY: number of elements */
 } Type;
 
 static inline Type mktype(TypeKind k) {
-    Type t; t.kind = k; t.inner = NULL; return t;
+    Type t; t.kind = k; t.inner = NULL; t.len = 0; return t;
 }
 static inline Type mkref(TypeKind k, Type *inner) {
-    Type t; t.kind = k; t.inner = inner; return t;
+    Type t; t.kind = k; t.inner = inner; t.len = 0; return t;
 }
+static inline Type mkarray(Type *elem, long len) {
+    Type t; t.kind = TY_ARRAY; t.inner = elem; t.len = len; return t;
+}
+
+/* Arrays are limited to what fits comfortably in a default stack */
+#define MAX_ARRAY_LEN 65536
+
+#ifdef _MSC_VER
+#define NORETURN __declspec(noreturn)
+#else
+#define NORETURN __attribute__((noreturn))
+#endif
+
+/**
+ * Reports a fatal compile error. Outside catch_errors the message goes to
+ * stderr and the process exits; inside it the current unit is abandoned.
+ */
+NORETURN void errorf(const char *fmt, ...);
+
+/**
+ * Reports a fatal error at `line`:`col` of the file this thread is
+ * compiling, as "file:line:col: message".
+ */
+NORETURN void errorf_at(int line, int col, const char *fmt, ...);
 
-void errorf(const char *fmt, ...);
+/** Names the file later errorf_at calls on this thread refer to, or NULL. */
+void error_set_file(const char *path);
 void *xmalloc(size_t s);
+void *xrealloc(void *p, size_t s);
+char *xstrdup(const char *s);
+
+/* ---------------------------------------------------------
+   ARENA ALLOCATOR
+   Bump allocation out of geometrically growing chunks. Everything
+   allocated from an arena is released at once by arena_free/arena_reset;
+   individual allocations are never freed.
+   --------------------------------------------------------- */
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *prev;
+    size_t size;            /* Usable bytes after the header */
+    size_t used;
+} ArenaChunk;
+
+typedef struct Arena {
+    ArenaChunk *chunk;      /* Current (largest) chunk; older ones via prev */
+    size_t total;           /* Bytes handed out since the last reset */
+} Arena;
+
+void arena_init(Arena *a);
+void *arena_alloc(Arena *a, size_t size);
+
+/**
+ * Resizes `p` (allocated with `old_size` bytes). The most recent allocation
+ * grows in place when the chunk has room; anything else is copied.
+ */
+void *arena_realloc(Arena *a, void *p, size_t old_size, size_t new_size);
+char *arena_strdup(Arena *a, const char *s);
+
+/** Forgets all allocations but keeps the current chunk for reuse. */
+void arena_reset(Arena *a);
+
+/** Releases every chunk. */
+void arena_free(Arena *a);
+
+/* ---------------------------------------------------------
+   BYTE BUFFER
+   Growable output buffer with cheap append helpers. Text is built in
+   memory and written with a single fwrite.
+   --------------------------------------------------------- */
+
+typedef struct StrBuf {
+    char *data;             /* Not NUL-terminated */
+    size_t len, cap;
+} StrBuf;
+
+void sb_init(StrBuf *sb);
+void sb_free(StrBuf *sb);
+
+/** Ensures room for `extra` more bytes and returns the write position. */
+char *sb_reserve(StrBuf *sb, size_t extra);
+
+void sb_append(StrBuf *sb, const char *s, size_t len);
+void sb_puts(StrBuf *sb, const char *s);
+void sb_putc(StrBuf *sb, char c);
+
+/** Appends `v` in decimal without going through printf. */
+void sb_put_long(StrBuf *sb, long v);
+
+/** Formatted append; prefer the helpers above on hot paths. */
+void sb_printf(StrBuf *sb, const char *fmt, ...);
+void sb_vprintf(StrBuf *sb, const char *fmt, va_list ap);
+
+/** Writes the whole buffer; false on a short write. */
+bool sb_write(const StrBuf *sb, FILE *out);
+
+/**
+ * Formats `v` in decimal into `out` (at least 21 bytes), NUL-terminated.
+ * @return The number of characters written.
+ */
+size_t fmt_long(char *out, long v);
+
+/* ---------------------------------------------------------
+   SOURCE FILES
+   Read-only, memory-mapped view of an input file. Tokens and string
+   literals point into `data`, so it must stay open as long as the AST.
+   The buffer is NOT NUL-terminated.
+   --------------------------------------------------------- */
+
+typedef struct SourceBuf {
+    const char *data;
+    size_t size;
+    void *map_handle;       /* Windows file mapping object */
+    bool mapped;            /* false for empty files (data points at "") */
+} SourceBuf;
+
+/** Maps `filename` into memory; reports the error and exits on failure. */
+void source_open(SourceBuf *src, const char *filename);
+void source_close(SourceBuf *src);
+
+/** True if `path` names an existing directory. */
+bool is_directory(const char *path);
+
+/* ---------------------------------------------------------
+   ERROR TRAPS
+   Lets the driver run several compilations in one process: an errorf
+   raised while `fn` runs on this thread is appended to `diag` and
+   unwinds straight back to catch_errors. Whatever the abandoned unit
+   still holds is released by the cleanups registered with the trap, which
+   errorf runs (newest first) while their frames are still live.
+   --------------------------------------------------------- */
+
+/** Runs fn(arg); false if it raised an error, whose message is in `diag`. */
+bool catch_errors(void (*fn)(void *arg), void *arg, StrBuf *diag);
+
+/** A release action kept by the innermost trap; lives in its owner's frame. */
+typedef struct ErrorCleanup {
+    void (*fn)(void *arg);
+    void *arg;
+    struct ErrorCleanup *next;
+} ErrorCleanup;
+
+/**
+ * Registers fn(arg) to run if an errorf unwinds past the caller. Outside
+ * catch_errors this does nothing: the error ends the process.
+ */
+void error_cleanup_push(ErrorCleanup *c, void (*fn)(void *arg), void *arg);
+
+/** Unregisters `c`, the newest cleanup, once its owner releases the memory itself. */
+void error_cleanup_pop(ErrorCleanup *c);
+
+/* ---------------------------------------------------------
+   THREADS
+   Just enough portable threading for the parallel driver: a statically
+   initializable mutex, one-time initialization, and a pool that runs
+   indexed jobs.
+   --------------------------------------------------------- */
+
+#ifdef _WIN32
+/* Layout-compatible with SRWLOCK and INIT_ONCE, so <windows.h> stays out */
+typedef struct Mutex { void *impl; } Mutex;
+typedef struct Once { void *impl; } Once;
+#define MUTEX_INIT { NULL }
+#define ONCE_INIT  { NULL }
+#else
+#include <pthread.h>
+typedef struct Mutex { pthread_mutex_t impl; } Mutex;
+typedef struct Once { pthread_once_t impl; } Once;
+#define MUTEX_INIT { PTHREAD_MUTEX_INITIALIZER }
+#define ONCE_INIT  { PTHREAD_ONCE_INIT }
+#endif
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+void mutex_lock(Mutex *m);
+void mutex_unlock(Mutex *m);
+
+/** Calls `fn` exactly once across all threads; later callers wait for it. */
+void run_once(Once *once, void (*fn)(void));
+
+/** Number of online processors (at least 1). */
+int cpu_count(void);
+
+/**
+ * @brief Runs job(ctx, i) for every i in [0, count) on up to `threads`
+ * workers and returns when all are done. Jobs are handed out in index
+ * order; with threads <= 1 they run on the calling thread.
+ */
+void run_parallel(int count, int threads, void (*job)(void *ctx, int i), void *ctx);
 
 #endif
\ No newline at end of file
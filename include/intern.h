@@ -0,0 +1,63 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file intern.h
+ * @brief Global string interner for identifiers and keywords.
+ *
+ * Every distinct name is stored once and identified by a 32-bit Symbol,
+ * so passes compare names with `==` and AST nodes carry 4 bytes instead
+ * of a fixed-size character array. Symbols stay valid for the lifetime
+ * of the process, and all functions here may be called from several
+ * threads at once.
+ */
+
+typedef uint32_t Symbol;
+
+/**
+ * @enum BuiltinSymbol
+ * @brief Names interned at start-up, with fixed ids.
+ * Keywords come first; the lexer recognizes them without a table lookup
+ * and hands out these fixed ids directly.
+ */
+typedef enum {
+    SYM_NONE = 0,       /* "" - never produced by the lexer */
+
+    /* Keywords */
+    SYM_LET,
+    SYM_IF,
+    SYM_ELSE,
+    SYM_WHILE,
+    SYM_FOR,
+    SYM_IN,
+    SYM_PAR,
+    SYM_INT,
+    SYM_STRING,
+    SYM_PRINT,
+    SYM_PRINTLN,
+    SYM_KEYWORD_END,
+
+    /* Built-in functions and entry point */
+    SYM_CLONE = SYM_KEYWORD_END,
+    SYM_RC,
+    SYM_MAIN,
+
+    SYM_BUILTIN_COUNT
+} BuiltinSymbol;
+
+/** Returns the symbol for `s[0..len)`, adding it on first use. */
+Symbol intern(const char *s, size_t len);
+
+/** Convenience wrapper for NUL-terminated names. */
+Symbol intern_cstr(const char *s);
+
+/** The NUL-terminated spelling of `sym`. */
+const char *sym_name(Symbol sym);
+
+/** Number of distinct symbols interned so far (including builtins). */
+uint32_t intern_count(void);
+
+#endif
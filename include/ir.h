@@ -0,0 +1,203 @@
+#ifndef IR_H
+#define IR_H
+
+#include "ast.h"
+
+/**
+ * @file ir.h
+ * @brief Linear three-address intermediate representation.
+ *
+ * The IR sits between the type-annotated AST and the x86_64 emitter.
+ * A function is a list of basic blocks; each block is a straight-line
+ * sequence of instructions ending in exactly one terminator (JMP, BR, RET,
+ * PAR, LEAVE).
+ *
+ * Values live in two kinds of storage:
+ *  - Temporaries: numbered virtual registers, each defined exactly once.
+ *  - Slots: named local variables that are read with LOAD and written
+ *    with STORE (and whose address may be taken with ADDR). An array slot
+ *    holds its elements contiguously; they are accessed by index with
+ *    LOADX/STOREX and the whole array is written with COPY or ZERO.
+ *    A temporary never holds an array, only its address.
+ *
+ * The body of a `par for` is a chunk: a nested function that runs the
+ * iterations [lo, hi) it is given, laid out inline between the IR_PAR that
+ * hands it to the runtime and the block that continues after the loop.
+ * Its blocks are marked `par`; it starts with IR_ENTER, reads its bounds
+ * with IR_ARG and returns with IR_LEAVE. Slots it declares itself are
+ * `par_local` and live in its own frame; all others are the function's,
+ * shared by every thread running the chunk.
+ */
+
+/**
+ * @enum IrOp
+ * @brief Instruction opcodes.
+ */
+typedef enum {
+    IR_CONST,   /* dst = imm */
+    IR_STR,     /* dst = static string object of literal #imm (no allocation) */
+    IR_LOAD,    /* dst = slot */
+    IR_STORE,   /* slot = a */
+    IR_ADDR,    /* dst = &slot */
+    IR_BIN,     /* dst = a <binop> b */
+    IR_CALL,    /* dst = runtime function #imm (a)   (dst and a may be -1) */
+    IR_ARRAY,   /* dst = address of constant array #imm (read-only data) */
+    IR_LOADX,   /* dst = slot[a]; with a = -1 the index is imm */
+    IR_STOREX,  /* slot[a] = b; likewise */
+    IR_BOUNDS,  /* dst = a, after trapping unless 0 <= a < imm */
+    IR_COPY,    /* slot = the whole array at address a */
+    IR_ZERO,    /* slot = all elements 0 */
+    IR_ENTER,   /* Start of a par chunk */
+    IR_ARG,     /* dst = bound #imm of the chunk's range: 0 = lo, 1 = hi */
+
+    /* Terminators */
+    IR_JMP,     /* goto target */
+    IR_BR,      /* if a != 0 goto target else alt */
+    IR_RET,     /* return from function */
+    IR_PAR,     /* run chunk target over [a, b) in parallel, then goto alt */
+    IR_LEAVE    /* return from a par chunk */
+} IrOp;
+
+/**
+ * @enum IrRuntimeFn
+ * @brief Runtime library entry points reachable through IR_CALL.
+ * RT_FLUSH and RT_BOUNDS_FAIL are not IR calls; the backend emits them
+ * in main's epilogue and for failed IR_BOUNDS checks, and the profile
+ * hooks in main's prologue and epilogue with --instrument.
+ */
+typedef enum {
+    RT_CLONE_STRING,
+    RT_DROP_STRING,
+    RT_PRINT_INT,
+    RT_PRINT_STRING,
+    RT_ARENA_ENTER,         /* No argument */
+    RT_ARENA_LEAVE,         /* No argument */
+    RT_ARENA_CLONE_STRING,
+    RT_FLUSH,
+    RT_BOUNDS_FAIL,
+    RT_RC_NEW,
+    RT_RC_RETAIN,
+    RT_RC_RELEASE,
+    RT_PAR_FOR,             /* IR_PAR only */
+    RT_PROFILE_BEGIN,
+    RT_PROFILE_END,
+    RT_COUNT
+} IrRuntimeFn;
+
+/** Symbol names of the runtime functions, indexed by IrRuntimeFn. */
+extern const char *const ir_runtime_names[RT_COUNT];
+
+/**
+ * @struct IrInstr
+ * @brief A single three-address instruction.
+ * Unused operand fields are -1.
+ */
+typedef struct IrInstr {
+    IrOp op;
+    int dst;            /* Defined temporary */
+    int a, b;           /* Source temporaries */
+    int slot;           /* Variable slot (LOAD/STORE/ADDR and the array ops) */
+    long imm;           /* Constant, literal index or IrRuntimeFn */
+    char binop;         /* Operator code for IR_BIN (see Expr.v.bin.op) */
+    int target, alt;    /* Successor block ids for JMP/BR/PAR */
+} IrInstr;
+
+/**
+ * @struct IrBlock
+ * @brief Basic block: straight-line code ending in a terminator.
+ */
+typedef struct IrBlock {
+    int id;             /* Index in IrFunc.blocks (layout order) */
+    const char *hint;   /* Construct that created the block, used for labels */
+    bool par;           /* Part of a par chunk */
+    long count;         /* Times it ran in the --profile-use profile, or -1 */
+    IrInstr *code;
+    int n, cap;
+} IrBlock;
+
+/**
+ * @struct IrSlot
+ * @brief A local variable. Every declaration gets its own slot, so
+ * shadowed names in nested blocks never share storage. Lowering also
+ * creates unnamed (SYM_NONE) slots to hold owned temporaries until
+ * they are dropped, the counter and bound of every for loop, and array
+ * literals that are not stored straight into a declared variable.
+ */
+typedef struct IrSlot {
+    Symbol name;
+    Type type;
+    bool clear_on_move; /* Owning slot that a move must leave empty (NULL) */
+    AliasFact alias;    /* Of its declaration; unnamed slots are never borrowed */
+    bool par_local;     /* Declared by a par chunk, in the chunk's own frame */
+} IrSlot;
+
+/**
+ * True if no reference can write the slot, so that it only changes at its
+ * own stores even where its address is taken (see AliasFact).
+ */
+static inline bool ir_slot_unaliased(const IrSlot *s) {
+    return s->alias == ALIAS_NONE || s->alias == ALIAS_SHARED;
+}
+
+/** 8-byte words of storage the slot occupies. */
+static inline long ir_slot_words(const IrSlot *s) {
+    return s->type.kind == TY_ARRAY ? s->type.len : 1;
+}
+
+/**
+ * @struct IrConstArray
+ * @brief Initial values of an array literal, emitted as read-only data.
+ */
+typedef struct IrConstArray {
+    long *values;
+    long len;
+} IrConstArray;
+
+/**
+ * @struct IrFunc
+ * @brief IR for one function, plus its string literal and constant array tables.
+ */
+typedef struct IrFunc {
+    Symbol name;
+
+    IrBlock **blocks;
+    int nblocks, blocks_cap;
+
+    IrSlot *slots;
+    int nslots, slots_cap;
+
+    int ntemps;
+
+    char **strings;
+    int nstrings, strings_cap;
+
+    IrConstArray *arrays;
+    int narrays, arrays_cap;
+} IrFunc;
+
+/**
+ * @brief Lowers a semantically checked function to IR.
+ * Owned strings are dropped at scope exit. With `string_arena`, clones
+ * outside loops are allocated from a frame arena released at return.
+ * For loops with constant bounds and small bodies are unrolled by up to
+ * `unroll` (4 or 8; 1 disables unrolling). Array indices get an IR_BOUNDS
+ * check unless their range is known to fit, e.g. a constant-bound loop
+ * variable plus or minus a constant.
+ */
+IrFunc *ir_build(Function *f, bool string_arena, int unroll);
+
+/** Releases all memory owned by the IR function. */
+void ir_free(IrFunc *fn);
+
+/** Total number of instructions over all blocks. */
+long ir_count_instrs(const IrFunc *fn);
+
+/** Appends a human-readable listing of the IR to `out`. */
+void ir_print(IrFunc *fn, StrBuf *out);
+
+/** Returns true if the opcode ends a basic block. */
+static inline bool ir_is_terminator(IrOp op) {
+    return op == IR_JMP || op == IR_BR || op == IR_RET || op == IR_PAR || op == IR_LEAVE;
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "objfile.h"
+
+/**
+ * @file jit.h
+ * @brief In-process loader and runner for `--run`.
+ *
+ * Takes the object the built-in assembler produced and, instead of writing
+ * it out, copies its sections into freshly mapped memory, applies the
+ * relocations and calls its `main`. External symbols are bound to the copy
+ * of runtime.c linked into mycc itself, so no assembler, linker or child
+ * process is involved.
+ *
+ * The code only uses rel32 relocations, so the mapping is placed within
+ * 2 GiB of the runtime. Text ends up read/execute, read-only data read-only.
+ */
+
+/**
+ * @brief Loads `obj` and runs its `main`; returns the value main returns.
+ * Runtime errors in the program exit the process, as they would a
+ * standalone binary. Loader failures are reported with errorf.
+ */
+int jit_run(const ObjFile *obj);
+
+#endif
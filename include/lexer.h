@@ -2,13 +2,15 @@
 #define LEXER_H
 
 #include "common.h"
-
-#define MAX_TOK_LEN 256
+#include "intern.h"
 
 typedef struct {
-    const char *src;
+    SourceBuf source;       /* Mapped input; owned by the AST once parsed */
+    const char *src;        /* source.data */
+    size_t size;
     const char *filename;
-    int pos;
+    Arena *strings;         /* Receives string literals that contain escapes */
+    size_t pos;
     int line;
     int col;
 } Lexer;
@@ -26,8 +28,12 @@ typedef enum {
     T_PRINT,
     T_PRINTLN,
     T_LET,
+    T_IF,
+    T_ELSE,
+    T_WHILE,
     T_FOR,
     T_IN,
+    T_PAR,
     T_INT_TYPE,
     T_STRING_TYPE,
 
@@ -38,21 +44,41 @@ typedef enum {
     T_COMMA, T_SEMI,
     T_COLON, T_EQ,
 
+    /* operators */
+    T_PLUS, T_MINUS,
+    T_STAR, T_SLASH, T_PERCENT,
+    T_LT, T_GT, T_LE, T_GE,
+    T_EQEQ, T_NE,
+
     T_AND,
     T_ANDMUT,
 
     T_DOTDOT          /* .. */
 } TokenKind;
 
+/**
+ * A token is a view of `len` bytes at `offset` in the source buffer;
+ * nothing is copied while scanning.
+ */
 typedef struct {
     TokenKind kind;
-    char lexeme[MAX_TOK_LEN];
+    size_t offset;
+    int len;
+    Symbol sym;         /* Interned name of identifiers and keywords */
     long int_val;
+    const char *str;    /* T_STRLIT contents: a source view, or an arena copy */
+    int str_len;        /* with escapes translated */
     int line;
     int col;
 } Token;
 
-void lexer_init(Lexer *l, const char *filename);
+/** Maps `filename`; escaped string literals are materialized in `strings`. */
+void lexer_init(Lexer *l, const char *filename, Arena *strings);
 Token lexer_next(Lexer *l);
 
+/** First byte of the token's source text (not NUL-terminated). */
+static inline const char *tok_text(const Lexer *l, const Token *t) {
+    return l->src + t->offset;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef OBJFILE_H
+#define OBJFILE_H
+
+#include "common.h"
+#include "symtab.h"
+
+#include <stdint.h>
+
+/**
+ * @file objfile.h
+ * @brief Minimal relocatable object model with ELF64 and Win64 COFF writers.
+ *
+ * The model only covers what the backend produces: .text, .data and
+ * read-only data sections, named symbols that are either defined in one
+ * of them or external, and 32-bit PC-relative relocations. Writers lay the sections
+ * out in the native container format of the target.
+ */
+
+/**
+ * @enum ObjFormat
+ * @brief Container format of the written object file.
+ */
+typedef enum {
+    OBJ_ELF64,      /* System V x86_64 (Linux) */
+    OBJ_COFF64      /* Microsoft x64 (Windows) */
+} ObjFormat;
+
+#ifdef _WIN32
+#define OBJ_NATIVE OBJ_COFF64
+#define OBJ_EXT ".obj"
+#else
+#define OBJ_NATIVE OBJ_ELF64
+#define OBJ_EXT ".o"
+#endif
+
+typedef enum {
+    OBJ_SEC_TEXT,
+    OBJ_SEC_DATA,
+    OBJ_SEC_RODATA,     /* .rodata (ELF) or .rdata (COFF) */
+    OBJ_SEC_COUNT
+} ObjSectionId;
+
+/* Alignment of every section in the written object */
+#define OBJ_SECTION_ALIGN 16
+
+#define OBJ_UNDEF (-1)      /* ObjSymbol.section of an external symbol */
+
+/**
+ * @enum ObjRelocKind
+ * @brief Relocations are always 32-bit fields patched relative to the end
+ * of the field (rip-relative addressing).
+ */
+typedef enum {
+    OBJ_REL_PC32,       /* Data reference: rip-relative operand */
+    OBJ_REL_CALL32      /* Call target, may go through the PLT/import stub */
+} ObjRelocKind;
+
+typedef struct ObjSymbol {
+    char *name;
+    int section;        /* ObjSectionId, or OBJ_UNDEF */
+    uint64_t value;     /* Offset within the section */
+    bool global;
+} ObjSymbol;
+
+typedef struct ObjReloc {
+    uint64_t offset;    /* Position of the 32-bit field in the section */
+    int symbol;         /* Index into ObjFile.syms */
+    ObjRelocKind kind;
+} ObjReloc;
+
+typedef struct ObjSection {
+    StrBuf data;
+    ObjReloc *relocs;
+    int nrelocs, cap;
+} ObjSection;
+
+typedef struct ObjFile {
+    ObjSection sections[OBJ_SEC_COUNT];
+    ObjSymbol *syms;
+    int nsyms, cap;
+    SymTab by_name;     /* Interned name -> index into syms */
+} ObjFile;
+
+void obj_init(ObjFile *obj);
+void obj_free(ObjFile *obj);
+
+/** Index of the symbol called `name`, or -1. */
+int obj_find_symbol(const ObjFile *obj, const char *name);
+
+/** Index of the symbol called `name`, added as undefined on first use. */
+int obj_symbol(ObjFile *obj, const char *name);
+
+/** Records a 32-bit relocation in `section` at `offset` against `symbol`. */
+void obj_add_reloc(ObjFile *obj, int section, uint64_t offset, int symbol, ObjRelocKind kind);
+
+/** Writes `obj` as a relocatable object; false on I/O error. */
+bool obj_write(const ObjFile *obj, ObjFormat fmt, FILE *out);
+
+#endif
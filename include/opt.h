@@ -0,0 +1,38 @@
+#ifndef OPT_H
+#define OPT_H
+
+#include "ir.h"
+
+/**
+ * @file opt.h
+ * @brief IR optimization passes, run between ir_build and codegen.
+ */
+
+/**
+ * @brief Folds constant int expressions and propagates constant variables.
+ * Binary operations on known operands become constants, loads of int slots
+ * that are written exactly once with a constant (and that no reference can
+ * write) are replaced by that constant, and branches on known conditions
+ * become jumps.
+ */
+void opt_constant_fold(IrFunc *fn);
+
+/**
+ * @brief Removes unreachable blocks, side-effect-free instructions whose
+ * results are unused, stores to variables that are never read, and the
+ * frame slots no longer referenced by any instruction.
+ */
+void opt_dead_code(IrFunc *fn);
+
+/**
+ * @brief Moves loads out of loops (while bodies, and for loops entered
+ * without a test) when the loop never stores the slot and no reference
+ * can write it, so each is read once before the loop. Loops that call the
+ * runtime are left alone.
+ */
+void opt_hoist_loads(IrFunc *fn);
+
+/** Runs the pass pipeline for the given optimization level (no-op at -O0). */
+void ir_optimize(IrFunc *fn, int opt_level);
+
+#endif
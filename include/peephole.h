@@ -0,0 +1,39 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "asm.h"
+
+/**
+ * @file peephole.h
+ * @brief Windowed peephole optimizer over buffered NASM instructions.
+ */
+
+/**
+ * @enum PeepholeRule
+ * @brief Rewrite patterns, used to index PeepholeStats.hits.
+ */
+typedef enum {
+    PH_PUSH_POP,        /* push x ... pop y         -> mov y, x (or nothing) */
+    PH_PUSH_DISCARD,    /* push x / add rsp, 8      -> nothing */
+    PH_STORE_LOAD,      /* mov [m], r / mov s, [m]  -> mov [m], r / mov s, r */
+    PH_SELF_MOVE,       /* mov r, r                 -> nothing */
+    PH_CONST_BRANCH,    /* mov r, k / cmp r, 0 / jcc -> jmp or nothing */
+    PH_JUMP_NEXT,       /* jmp L / L:               -> L: */
+    PH_UNREACHABLE,     /* code after jmp/ret up to the next label */
+    PH_RULE_COUNT
+} PeepholeRule;
+
+/** Instruction counts before and after the pass, and hits per rule. */
+typedef struct PeepholeStats {
+    int insns_before;
+    int insns_after;
+    int hits[PH_RULE_COUNT];
+} PeepholeStats;
+
+/** Rewrites `buf` in place until no rule applies; `stats` may be NULL. */
+void peephole_run(AsmBuf *buf, PeepholeStats *stats);
+
+/** Appends a one-line-per-rule summary of `stats` to `out`. */
+void peephole_print_stats(const PeepholeStats *stats, StrBuf *out);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "ir.h"
+#include "common.h"
+
+#include <stdint.h>
+
+/**
+ * @file profile.h
+ * @brief Execution profiles: what --instrument counts, and the block
+ * layout --profile-use derives from the counts.
+ *
+ * An instrumented main has one counter per IR block, indexed by block id,
+ * followed by one per runtime call site (IR_CALL and IR_PAR, in layout
+ * order); runtime.h describes the table and the file it ends up in.
+ * A record is matched to a function by a checksum of its IR as the backend
+ * receives it, so the build using a profile must lower the same source
+ * with the same -O level and --string-arena setting as the instrumented one.
+ */
+
+/** A profile file, mapped whole; records are decoded when looked up. */
+typedef struct Profile {
+    const char *path;
+    SourceBuf file;
+} Profile;
+
+/** Maps the profile at `path`; reports the error and exits if it is not one. */
+void profile_load(Profile *p, const char *path);
+void profile_free(Profile *p);
+
+/** Checksum of `fn` the counters of its profile are matched by. */
+uint64_t profile_checksum(const IrFunc *fn);
+
+/** Number of counters of an instrumented `fn`: its blocks, then its call sites. */
+int profile_counters(const IrFunc *fn);
+
+/**
+ * @brief Gives every block of `fn` its count from `p`, then lays the blocks
+ * out hot path first: of the two arms of an if/else, the one that ran more
+ * often follows the branch and is reached by falling through. Only runs of
+ * blocks that are entered at their first block and left to a single join
+ * move, so loops and par chunks stay contiguous. Errors out if `p` has no
+ * record for `fn`.
+ */
+void profile_apply(IrFunc *fn, const Profile *p);
+
+#endif
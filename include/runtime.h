@@ -0,0 +1,106 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stdint.h>
+
+/**
+ * @file runtime.h
+ * @brief Binary interface between generated code and runtime.c.
+ *
+ * A MyLang `string` value is a pointer to an RtString: a 16-byte header
+ * followed by the bytes themselves (plus a NUL for C interop), so every
+ * string is a single block and its length is always known.
+ *
+ * String literals are emitted into .data in exactly this layout with
+ * cap = 0, and code refers to them directly: building a string from a
+ * literal costs no call and no allocation. Strings with cap = 0 are never
+ * written to or freed; clone() always produces a heap copy.
+ *
+ * With --string-arena, clones whose lifetime stays within the function
+ * frame are bump-allocated from a frame arena instead. They also carry
+ * cap = 0, so drops leave them alone, and the whole arena is released by
+ * runtime_arena_leave when the function returns.
+ *
+ * An `Rc<string>` value points at an RtString too, so it prints like one,
+ * but the block starts RT_RC_HEADER bytes earlier with the count of owners.
+ * The count is a plain integer: the only threads are those of par loops,
+ * which cannot clone an Rc from outside the loop. The string
+ * carries cap = 0; the block is freed when its count drops to zero.
+ */
+
+typedef struct RtString {
+    uint64_t len;       /* Bytes in data, excluding the NUL */
+    uint64_t cap;       /* Heap capacity of data, or 0 for a static literal */
+    char data[];
+} RtString;
+
+/* Layout the backend emits for literals (see emit_literals in codegen.c) */
+#define RT_STRING_HEADER 16
+#define RT_STRING_ALIGN  8
+
+RtString *runtime_string_from(const char *bytes, uint64_t len);
+RtString *runtime_clone_string(const RtString *s);
+void runtime_drop_string(RtString *s);
+
+/* Frame arenas nest: leave releases everything since the matching enter */
+void runtime_arena_enter(void);
+void runtime_arena_leave(void);
+RtString *runtime_arena_clone_string(const RtString *s);
+
+/* Rc<string>: the count precedes the RtString in the same block */
+#define RT_RC_HEADER 8
+
+RtString *runtime_rc_new(const RtString *s);
+RtString *runtime_rc_retain(RtString *s);
+void runtime_rc_release(RtString *s);
+
+/* Output is buffered; runtime_flush must run before the program exits */
+#define RT_OUT_BUF_SIZE 65536
+
+/*
+ * The buffer itself, for code that appends to it inline (--intrinsics):
+ * bytes [0, runtime_out_len) are pending. Writers must leave room by
+ * calling runtime_flush once fewer bytes than they need are free.
+ */
+extern char runtime_out_buf[RT_OUT_BUF_SIZE];
+extern uint64_t runtime_out_len;
+
+int runtime_print_int(long v);
+int runtime_print_string(const RtString *s);
+void runtime_flush(void);
+
+/* Target of failed array bounds checks; does not return */
+void runtime_bounds_fail(long index, long len);
+
+/*
+ * par for: calls chunk(a, b, frame) for sub-ranges [a, b) that together
+ * cover [lo, hi) once, spread over a pool of threads, and returns when all
+ * are done. The pool starts on first use with MYLANG_THREADS threads
+ * including the caller (default: one per CPU, at most RT_PAR_MAX_THREADS).
+ */
+typedef void (*RtParChunk)(long lo, long hi, void *frame);
+
+#define RT_PAR_MAX_THREADS 64
+
+void runtime_par_for(RtParChunk chunk, long lo, long hi, void *frame);
+
+/*
+ * --instrument: the program's counters are one table in .data,
+ *   { checksum, n, count[0], ..., count[n - 1] }
+ * (64-bit words; the counts are of IR blocks by id, then of runtime call
+ * sites in code order). main passes it to runtime_profile_begin on entry
+ * and calls runtime_profile_end before returning; fatal runtime errors end
+ * the profile as well. Ending adds the counts to the profile file named by
+ * MYLANG_PROFILE (default RT_PROFILE_FILE):
+ *   RT_PROFILE_MAGIC, a version byte, then one record per program:
+ *   checksum (8 bytes, little-endian), n and the n counts (ULEB128 each)
+ * A record with the same checksum and n is summed into; the others stay.
+ */
+#define RT_PROFILE_MAGIC   "MYPF"
+#define RT_PROFILE_VERSION 1
+#define RT_PROFILE_FILE    "mylang.prof"
+
+void runtime_profile_begin(uint64_t *table);
+void runtime_profile_end(void);
+
+#endif
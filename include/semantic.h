@@ -1,5 +1,12 @@
 #ifndef SEMANTIC_H
 #define SEMANTIC_H
 #include "ast.h"
-void semantic_check(Function *f, const char *filename);
+
+/**
+ * @brief Types and checks `f` in a single traversal.
+ * With `borrowck`, ownership and borrowing rules are enforced in the same
+ * walk (see borrowchecker.h); without it the tree is only type checked.
+ */
+void semantic_check(Function *f, const char *filename, bool borrowck);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+
+/**
+ * @file server.h
+ * @brief Resident compiler (mycc --server=<path>) and its client.
+ *
+ * The server listens on a Unix socket (on Windows, a named pipe) that only
+ * its user can open. A request is the client's working directory and
+ * command line; the reply is the exit status and everything the compile
+ * wrote to stdout and stderr. The process stays up between requests, so
+ * the interner, the memory the allocator got back from earlier units and
+ * the in-memory layer of the unit cache are warm for the next one.
+ *
+ * Requests are served one at a time, each from its client's directory;
+ * one request still compiles its units on -j threads.
+ */
+
+/* Set to the server's path, every mycc forwards its command line there */
+#define SERVER_ENV "MYCC_SERVER"
+
+/* Compiled units the server keeps in memory, in bytes */
+#define SERVER_CACHE_BUDGET ((size_t)256 << 20)
+
+/** Compiles argv[0..argc) like main, writing its reports to `out` and `err`. */
+typedef int (*ServerBuild)(int argc, char **argv, FILE *out, FILE *err);
+
+/**
+ * @brief Serves requests on `path` through `build` until SIGINT or SIGTERM
+ * and returns 0. Raises an error if it cannot listen there.
+ */
+int server_run(const char *path, ServerBuild build);
+
+/**
+ * @brief Has the server on `path` compile argv[0..argc) and prints its
+ * reply, stdout first. Returns the exit status, or -1 without printing
+ * anything if no server answered.
+ */
+int server_forward(const char *path, int argc, char **argv);
+
+#endif
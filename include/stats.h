@@ -0,0 +1,91 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @file stats.h
+ * @brief Compiler self-instrumentation (--time-passes, --mem-stats, --stats=json).
+ *
+ * A Stats record is attached to the current thread with stats_begin. From
+ * then on stats_phase switches the running phase, charging the time since
+ * the previous switch to the phase it ends, and every xmalloc/xrealloc is
+ * counted against the running phase. Units compiled in parallel each have
+ * their own record, merged by the driver afterwards.
+ *
+ * With no record attached every hook is a thread-local load and a branch.
+ */
+
+typedef enum {
+    PHASE_CACHE,        /* Hashing the source, cache lookup and store */
+    PHASE_PARSE,        /* Lexing and parsing */
+    PHASE_SEMANTIC,     /* Type and borrow checking */
+    PHASE_LOWER,        /* AST -> IR */
+    PHASE_OPT,          /* IR optimizations */
+    PHASE_CODEGEN,      /* IR -> buffered assembly */
+    PHASE_PEEPHOLE,
+    PHASE_OUTPUT,       /* Rendering or encoding, and writing the file */
+    PHASE_COUNT
+} Phase;
+
+typedef enum {
+    STAT_TOKENS,
+    STAT_AST_NODES,
+    STAT_IR_INSTRS,     /* As lowered */
+    STAT_IR_INSTRS_OPT, /* After ir_optimize */
+    STAT_ASM_INSNS,     /* Machine instructions written */
+    STAT_OUTPUT_BYTES,
+    STAT_COUNT
+} StatCounter;
+
+typedef struct PhaseStats {
+    uint64_t ns;
+    uint64_t allocs;    /* xmalloc and xrealloc calls */
+    uint64_t bytes;     /* Bytes requested by them */
+} PhaseStats;
+
+typedef struct Stats {
+    PhaseStats phase[PHASE_COUNT];
+    uint64_t counters[STAT_COUNT];
+    int running;        /* Phase being timed, or -1 */
+    uint64_t since;     /* When it started */
+} Stats;
+
+/** Monotonic clock in nanoseconds. */
+uint64_t stats_now_ns(void);
+
+/** Clears `s` and makes it the current thread's record; no phase is running. */
+void stats_begin(Stats *s);
+
+/** Charges the running phase and detaches the record from the thread. */
+void stats_end(void);
+
+/** Ends the running phase (if any) and starts phase `p`. */
+void stats_phase(Phase p);
+
+void stats_count(StatCounter c, uint64_t n);
+
+/** Called by xmalloc/xrealloc for each request. */
+void stats_note_alloc(size_t bytes);
+
+/** Adds the phases and counters of `from` to `into`. */
+void stats_merge(Stats *into, const Stats *from);
+
+/** Report layout: which columns of the table, or everything as JSON. */
+typedef struct StatsFormat {
+    bool time;
+    bool mem;
+    bool json;
+} StatsFormat;
+
+/**
+ * @brief Writes the report for `s`, the sum over `units` units compiled
+ * with `jobs` threads in `wall_ns` of elapsed time.
+ */
+void stats_report(const Stats *s, int units, int jobs, uint64_t wall_ns,
+                  const StatsFormat *fmt, FILE *out);
+
+#endif
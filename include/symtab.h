@@ -0,0 +1,66 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include "common.h"
+#include "intern.h"
+
+/**
+ * @file symtab.h
+ * @brief Scoped symbol table shared by the semantic, borrow-check and IR passes.
+ *
+ * Bindings are kept on a stack in declaration order. An open-addressed hash
+ * table maps every name to its innermost binding, and each binding remembers
+ * the one it shadows, so that popping a scope just walks the bindings above
+ * the scope mark and restores the shadowed entries. Lookup, declaration and
+ * scope exit are all O(1) amortized per binding.
+ *
+ * Every binding carries a caller-defined payload of `value_size` bytes.
+ * Returned payload pointers stay valid only until the next symtab_declare.
+ */
+
+typedef struct SymTabSlot {
+    Symbol name;        /* SYM_NONE = empty */
+    int top;            /* Innermost binding of `name`, or -1 */
+} SymTabSlot;
+
+typedef struct SymTab {
+    unsigned char *bindings;    /* n bindings of entry_size bytes each */
+    size_t value_size, entry_size;
+    int n, cap;
+
+    SymTabSlot *slots;
+    uint32_t nslots, used;
+
+    int *marks;                 /* Binding count at each open scope */
+    int nmarks, marks_cap;
+} SymTab;
+
+/** Creates an empty table whose bindings carry `value_size` bytes each. */
+void symtab_init(SymTab *t, size_t value_size);
+void symtab_free(SymTab *t);
+
+/** Opens a nested scope. */
+void symtab_push(SymTab *t);
+
+/** Closes the innermost scope, dropping every binding declared in it. */
+void symtab_pop(SymTab *t);
+
+/** Number of currently open scopes. */
+int symtab_depth(const SymTab *t);
+
+/**
+ * @brief Binds `name` in the innermost scope, shadowing any outer binding.
+ * @return The zero-initialized payload of the new binding.
+ */
+void *symtab_declare(SymTab *t, Symbol name);
+
+/** Payload of the innermost visible binding of `name`, or NULL. */
+void *symtab_lookup(const SymTab *t, Symbol name);
+
+/** Number of bindings in all open scopes. */
+int symtab_count(const SymTab *t);
+
+/** Payload of binding `i` (0 <= i < symtab_count), in declaration order. */
+void *symtab_at(const SymTab *t, int i);
+
+#endif
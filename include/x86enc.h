@@ -0,0 +1,26 @@
+#ifndef X86ENC_H
+#define X86ENC_H
+
+#include "asm.h"
+#include "objfile.h"
+
+/**
+ * @file x86enc.h
+ * @brief Built-in x86_64 assembler for the backend's buffered output.
+ *
+ * Encodes the structured lines of an AsmBuf straight into machine code and
+ * data in an ObjFile, so `--emit=obj` does not need NASM. Only the subset of
+ * NASM syntax that codegen.c and the peephole pass emit is accepted:
+ * 64/32-bit general purpose registers (plus the low byte registers for
+ * setcc/movzx), immediates, `[reg+disp]` and `[rel symbol]` memory operands,
+ * labels, `global`/`extern`/`section` directives and `db`/`dq` data.
+ *
+ * Jumps start out in their short form and are widened until every
+ * displacement fits, as NASM and GAS do. Unsupported input is reported
+ * with errorf.
+ */
+
+/** Assembles `buf` into the (empty) object `obj`. */
+void x86_assemble(const AsmBuf *buf, ObjFile *obj);
+
+#endif
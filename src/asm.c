@@ -0,0 +1,225 @@
+/**
+ * @file asm.c
+ * @brief Line-structured assembly buffer used by the backend.
+ */
+
+#include "../include/asm.h"
+#include "../include/common.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+void asm_init(AsmBuf *buf) {
+    memset(buf, 0, sizeof(*buf));
+}
+
+void asm_free(AsmBuf *buf) {
+    for (int i = 0; i < buf->n; i++)
+        free(buf->lines[i].text);
+    free(buf->lines);
+    sb_free(&buf->pending);
+    memset(buf, 0, sizeof(*buf));
+}
+
+static AsmLine *push_line(AsmBuf *buf) {
+    if (buf->n == buf->cap) {
+        buf->cap = buf->cap ? buf->cap * 2 : 256;
+        buf->lines = xrealloc(buf->lines, sizeof(AsmLine) * (size_t)buf->cap);
+    }
+    AsmLine *line = &buf->lines[buf->n++];
+    memset(line, 0, sizeof(*line));
+    return line;
+}
+
+static void copy_field(char *dst, size_t cap, const char *src, size_t len) {
+    if (len >= cap) errorf("codegen: assembly operand too long: %.*s\n", (int)len, src);
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+/** Sets `line` to an owned copy of `s[0..len)`. */
+static void set_text(AsmLine *line, AsmKind kind, const char *s, size_t len) {
+    line->kind = kind;
+    line->text = xmalloc(len + 1);
+    memcpy(line->text, s, len);
+    line->text[len] = '\0';
+}
+
+void asm_set_insn(AsmLine *line, const char *mnemonic, int nops, const char *ops[]) {
+    free(line->text);
+    memset(line, 0, sizeof(*line));
+    line->kind = ASM_INSN;
+    copy_field(line->mnemonic, sizeof(line->mnemonic), mnemonic, strlen(mnemonic));
+    line->nops = nops;
+    for (int i = 0; i < nops; i++)
+        copy_field(line->ops[i], ASM_OP_LEN, ops[i], strlen(ops[i]));
+}
+
+/**
+ * @brief Classifies one complete line (without its newline).
+ * Instructions are the indented lines; their operands are separated by
+ * commas outside of memory brackets.
+ */
+static void parse_line(AsmBuf *buf, const char *s, size_t len) {
+    AsmLine *line = push_line(buf);
+
+    if (len > 0 && isspace((unsigned char)s[0])) {
+        size_t i = 0;
+        while (i < len && isspace((unsigned char)s[i])) i++;
+        size_t m = i;
+        while (i < len && !isspace((unsigned char)s[i])) i++;
+        if (i > m) {
+            line->kind = ASM_INSN;
+            copy_field(line->mnemonic, sizeof(line->mnemonic), s + m, i - m);
+
+            while (i < len && line->nops < ASM_MAX_OPS) {
+                while (i < len && isspace((unsigned char)s[i])) i++;
+                if (i >= len) break;
+                size_t start = i;
+                int depth = 0;
+                while (i < len && (depth > 0 || s[i] != ',')) {
+                    if (s[i] == '[') depth++;
+                    if (s[i] == ']') depth--;
+                    i++;
+                }
+                size_t end = i;
+                while (end > start && isspace((unsigned char)s[end - 1])) end--;
+                copy_field(line->ops[line->nops++], ASM_OP_LEN, s + start, end - start);
+                if (i < len) i++;   /* Skip the comma */
+            }
+            if (i < len) errorf("codegen: too many operands: %.*s\n", (int)len, s);
+            return;
+        }
+    }
+
+    bool is_label = len > 1 && s[len - 1] == ':';
+    for (size_t i = 0; is_label && i < len; i++)
+        if (isspace((unsigned char)s[i])) is_label = false;
+
+    set_text(line, is_label ? ASM_LABEL : ASM_DIRECTIVE, s, len);
+}
+
+void asm_printf(AsmBuf *buf, const char *fmt, ...) {
+    StrBuf *p = &buf->pending;
+    size_t old_len = p->len;
+
+    va_list ap;
+    va_start(ap, fmt);
+    sb_vprintf(p, fmt, ap);
+    va_end(ap);
+
+    /* Move every completed line into the buffer; only new text can hold a newline */
+    size_t start = 0;
+    for (size_t i = old_len; i < p->len; i++) {
+        if (p->data[i] != '\n') continue;
+        parse_line(buf, p->data + start, i - start);
+        start = i + 1;
+    }
+    memmove(p->data, p->data + start, p->len - start);
+    p->len -= start;
+}
+
+/** Text appended with asm_printf must not be split by structured lines. */
+static void check_no_pending(const AsmBuf *buf) {
+    if (buf->pending.len > 0)
+        errorf("codegen: unterminated line before structured emission: %.*s\n",
+               (int)buf->pending.len, buf->pending.data);
+}
+
+void asm_insn(AsmBuf *buf, const char *mnemonic, const char *op0, const char *op1) {
+    check_no_pending(buf);
+    AsmLine *line = push_line(buf);
+    line->kind = ASM_INSN;
+    copy_field(line->mnemonic, sizeof(line->mnemonic), mnemonic, strlen(mnemonic));
+    if (op0) {
+        copy_field(line->ops[line->nops++], ASM_OP_LEN, op0, strlen(op0));
+        if (op1) copy_field(line->ops[line->nops++], ASM_OP_LEN, op1, strlen(op1));
+    }
+}
+
+void asm_label(AsmBuf *buf, const char *name) {
+    check_no_pending(buf);
+    size_t len = strlen(name);
+    AsmLine *line = push_line(buf);
+    set_text(line, ASM_LABEL, name, len + 1);
+    line->text[len] = ':';
+}
+
+void asm_directive(AsmBuf *buf, const char *text, size_t len) {
+    check_no_pending(buf);
+    set_text(push_line(buf), ASM_DIRECTIVE, text, len);
+}
+
+void asm_fmt_mem(char *out, const char *size, const char *base, long disp) {
+    asm_fmt_index(out, size, base, NULL, 1, disp);
+}
+
+void asm_fmt_index(char *out, const char *size, const char *base, const char *index,
+                   int scale, long disp) {
+    size_t n = 0;
+    if (size) {
+        size_t len = strlen(size);
+        memcpy(out, size, len);
+        out[len] = ' ';
+        n = len + 1;
+    }
+    size_t blen = strlen(base);
+    size_t ilen = index ? strlen(index) : 0;
+    if (n + blen + ilen + 28 > ASM_OP_LEN) errorf("codegen: memory operand too long\n");
+
+    out[n++] = '[';
+    memcpy(out + n, base, blen);
+    n += blen;
+    if (index) {
+        out[n++] = '+';
+        memcpy(out + n, index, ilen);
+        n += ilen;
+        if (scale != 1) {
+            out[n++] = '*';
+            out[n++] = (char)('0' + scale);
+        }
+    }
+    if (disp != 0) {
+        if (disp > 0) out[n++] = '+';
+        n += fmt_long(out + n, disp);
+    }
+    out[n++] = ']';
+    out[n] = '\0';
+}
+
+void asm_render(const AsmBuf *buf, StrBuf *out) {
+    for (int i = 0; i < buf->n; i++) {
+        const AsmLine *line = &buf->lines[i];
+        if (line->kind != ASM_INSN) {
+            sb_puts(out, line->text);
+            sb_putc(out, '\n');
+            continue;
+        }
+        sb_append(out, "    ", 4);
+        sb_puts(out, line->mnemonic);
+        for (int k = 0; k < line->nops; k++) {
+            sb_append(out, k ? ", " : " ", k ? 2 : 1);
+            sb_puts(out, line->ops[k]);
+        }
+        sb_putc(out, '\n');
+    }
+    sb_append(out, buf->pending.data, buf->pending.len);
+}
+
+bool asm_write(const AsmBuf *buf, FILE *out) {
+    StrBuf text;
+    sb_init(&text);
+    asm_render(buf, &text);
+    bool ok = sb_write(&text, out);
+    sb_free(&text);
+    return ok;
+}
+
+int asm_count_insns(const AsmBuf *buf) {
+    int count = 0;
+    for (int i = 0; i < buf->n; i++)
+        if (buf->lines[i].kind == ASM_INSN) count++;
+    return count;
+}
@@ -7,14 +7,14 @@
 
 /* ---------------------------------------------------------
    EXPRESSION CONSTRUCTORS
-   Memory allocation and initialization for AST expression nodes.
+   Arena allocation and initialization for AST expression nodes.
    --------------------------------------------------------- */
 
 /**
  * @brief Creates an integer literal expression node.
  */
-Expr *expr_int(long v, int line, int col) {
-    Expr *e = xmalloc(sizeof(Expr));
+Expr *expr_int(Arena *a, long v, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
     e->kind = E_INT_LIT;
     e->line = line;
     e->col = col;
@@ -25,38 +25,38 @@ Expr *expr_int(long v, int line, int col) {
 
 /**
  * @brief Creates a string literal expression node.
- * Dynamically allocates the string value.
+ * The value is referenced, not copied: the lexer already placed it in the
+ * source mapping or the arena, both of which live as long as the tree.
  */
-Expr *expr_str(const char *s, int line, int col) {
-    Expr *e = xmalloc(sizeof(Expr));
+Expr *expr_str(Arena *a, const char *s, int len, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
     e->kind = E_STR_LIT;
     e->line = line;
     e->col = col;
     e->type = mktype(TY_STRING);
-    e->v.str_val = strdup(s);
+    e->v.str.data = s;
+    e->v.str.len = len;
     return e;
 }
 
 /**
  * @brief Creates an identifier reference node.
  */
-Expr *expr_ident(const char *s, int line, int col) {
-    Expr *e = xmalloc(sizeof(Expr));
+Expr *expr_ident(Arena *a, Symbol name, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
     e->kind = E_IDENT;
     e->line = line;
     e->col = col;
     e->type = mktype(TY_UNKNOWN);
-
-    /* Use safe buffer copy for fixed-size identifier array */
-    snprintf(e->v.ident, sizeof(e->v.ident), "%s", s);
+    e->v.ident = name;
     return e;
 }
 
 /**
  * @brief Creates a reference expression node (& or &mut).
  */
-Expr *expr_addr(Expr *inner, bool mut, int line, int col) {
-    Expr *e = xmalloc(sizeof(Expr));
+Expr *expr_addr(Arena *a, Expr *inner, bool mut, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
     e->kind = mut ? E_MUTADDR : E_ADDR;
     e->line = line;
     e->col = col;
@@ -65,17 +65,32 @@ Expr *expr_addr(Expr *inner, bool mut, int line, int col) {
     return e;
 }
 
+/**
+ * @brief Creates a binary operation node (l op r).
+ */
+Expr *expr_binop(Arena *a, char op, Expr *l, Expr *r, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
+    e->kind = E_BINOP;
+    e->line = line;
+    e->col = col;
+    e->type = mktype(TY_UNKNOWN);
+    e->v.bin.op = op;
+    e->v.bin.l = l;
+    e->v.bin.r = r;
+    return e;
+}
+
 /**
  * @brief Creates a function or subroutine call node.
  */
-Expr *expr_call(const char *name, Expr **args, int nargs, int line, int col) {
-    Expr *e = xmalloc(sizeof(Expr));
+Expr *expr_call(Arena *a, Symbol name, Expr **args, int nargs, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
     e->kind = E_CALL;
     e->line = line;
     e->col = col;
     e->type = mktype(TY_UNKNOWN);
 
-    snprintf(e->v.call.name, sizeof(e->v.call.name), "%s", name);
+    e->v.call.name = name;
     e->v.call.args = args;
     e->v.call.nargs = nargs;
     return e;
@@ -84,8 +99,8 @@ Expr *expr_call(const char *name, Expr **args, int nargs, int line, int col) {
 /**
  * @brief Creates a range expression node (start..end).
  */
-Expr *expr_range(Expr *start, Expr *end, int line, int col) {
-    Expr *e = xmalloc(sizeof(Expr));
+Expr *expr_range(Arena *a, Expr *start, Expr *end, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
     e->kind = E_RANGE;
     e->line = line;
     e->col = col;
@@ -98,8 +113,8 @@ Expr *expr_range(Expr *start, Expr *end, int line, int col) {
 /**
  * @brief Creates an array literal initialization node.
  */
-Expr *expr_array(Expr **items, int count, int line, int col) {
-    Expr *e = xmalloc(sizeof(Expr));
+Expr *expr_array(Arena *a, Expr **items, int count, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
     e->kind = E_ARRAY_LIT;
     e->line = line;
     e->col = col;
@@ -112,8 +127,8 @@ Expr *expr_array(Expr **items, int count, int line, int col) {
 /**
  * @brief Creates an array indexing/subscript expression node.
  */
-Expr *expr_index(Expr *array, Expr *index, int line, int col) {
-    Expr *e = xmalloc(sizeof(Expr));
+Expr *expr_index(Arena *a, Expr *array, Expr *index, int line, int col) {
+    Expr *e = arena_alloc(a, sizeof(Expr));
     e->kind = E_INDEX;
     e->line = line;
     e->col = col;
@@ -125,29 +140,58 @@ Expr *expr_index(Expr *array, Expr *index, int line, int col) {
 
 /* ---------------------------------------------------------
    STATEMENT CONSTRUCTORS
-   Memory allocation and initialization for AST statement nodes.
+   Arena allocation and initialization for AST statement nodes.
    --------------------------------------------------------- */
 
 /**
  * @brief Creates a variable declaration statement node.
  */
-Stmt *stmt_decl(const char *name, Type t, Expr *init, int line, int col) {
-    Stmt *s = xmalloc(sizeof(Stmt));
+Stmt *stmt_decl(Arena *a, Symbol name, Type t, Expr *init, int line, int col) {
+    Stmt *s = arena_alloc(a, sizeof(Stmt));
     s->kind = S_DECL;
     s->line = line;
     s->col = col;
 
-    snprintf(s->v.decl.name, sizeof(s->v.decl.name), "%s", name);
+    s->v.decl.name = name;
     s->v.decl.type = t;
     s->v.decl.init = init;
+    s->v.decl.clear_on_move = true;
+    s->v.decl.drop_at_exit = true;
+    s->v.decl.rc_alias = false;
+    s->v.decl.alias = ALIAS_UNKNOWN;
+    return s;
+}
+
+/**
+ * @brief Creates an assignment statement node for an existing variable.
+ */
+Stmt *stmt_assign(Arena *a, Symbol name, Expr *value, int line, int col) {
+    Stmt *s = arena_alloc(a, sizeof(Stmt));
+    s->kind = S_ASSIGN;
+    s->line = line;
+    s->col = col;
+
+    s->v.assign.name = name;
+    s->v.assign.index = NULL;
+    s->v.assign.value = value;
+    s->v.assign.drop_old = true;
+    return s;
+}
+
+/**
+ * @brief Creates an assignment to one element of an array variable.
+ */
+Stmt *stmt_assign_index(Arena *a, Symbol name, Expr *index, Expr *value, int line, int col) {
+    Stmt *s = stmt_assign(a, name, value, line, col);
+    s->v.assign.index = index;
     return s;
 }
 
 /**
  * @brief Creates a standalone expression statement node.
  */
-Stmt *stmt_expr(Expr *e, int line, int col) {
-    Stmt *s = xmalloc(sizeof(Stmt));
+Stmt *stmt_expr(Arena *a, Expr *e, int line, int col) {
+    Stmt *s = arena_alloc(a, sizeof(Stmt));
     s->kind = S_EXPR;
     s->line = line;
     s->col = col;
@@ -158,8 +202,8 @@ Stmt *stmt_expr(Expr *e, int line, int col) {
 /**
  * @brief Creates a compound/block statement node.
  */
-Stmt *stmt_block(Stmt **stmts, int n, int line, int col) {
-    Stmt *s = xmalloc(sizeof(Stmt));
+Stmt *stmt_block(Arena *a, Stmt **stmts, int n, int line, int col) {
+    Stmt *s = arena_alloc(a, sizeof(Stmt));
     s->kind = S_BLOCK;
     s->line = line;
     s->col = col;
@@ -171,8 +215,8 @@ Stmt *stmt_block(Stmt **stmts, int n, int line, int col) {
 /**
  * @brief Creates a conditional branching (if-else) statement node.
  */
-Stmt *stmt_if(Expr *cond, Stmt *then_s, Stmt *else_s, int line, int col) {
-    Stmt *s = xmalloc(sizeof(Stmt));
+Stmt *stmt_if(Arena *a, Expr *cond, Stmt *then_s, Stmt *else_s, int line, int col) {
+    Stmt *s = arena_alloc(a, sizeof(Stmt));
     s->kind = S_IF;
     s->line = line;
     s->col = col;
@@ -185,8 +229,8 @@ Stmt *stmt_if(Expr *cond, Stmt *then_s, Stmt *else_s, int line, int col) {
 /**
  * @brief Creates a while-loop iteration statement node.
  */
-Stmt *stmt_while(Expr *cond, Stmt *body, int line, int col) {
-    Stmt *s = xmalloc(sizeof(Stmt));
+Stmt *stmt_while(Arena *a, Expr *cond, Stmt *body, int line, int col) {
+    Stmt *s = arena_alloc(a, sizeof(Stmt));
     s->kind = S_WHILE;
     s->line = line;
     s->col = col;
@@ -197,16 +241,19 @@ Stmt *stmt_while(Expr *cond, Stmt *body, int line, int col) {
 
 /**
  * @brief Creates a for-loop iteration statement node.
+ * The induction variable `var` becomes an int declaration node, so the
+ * later passes can bind it like any other `let`.
  */
-Stmt *stmt_for(const char *var, Expr *iter, Stmt *body, int line, int col) {
-    Stmt *s = xmalloc(sizeof(Stmt));
+Stmt *stmt_for(Arena *a, Symbol var, Expr *iter, Stmt *body, int line, int col) {
+    Stmt *s = arena_alloc(a, sizeof(Stmt));
     s->kind = S_FOR;
     s->line = line;
     s->col = col;
 
-    snprintf(s->v.fors.var, sizeof(s->v.fors.var), "%s", var);
+    s->v.fors.var = stmt_decl(a, var, mktype(TY_INT), NULL, line, col);
     s->v.fors.iter = iter;
     s->v.fors.body = body;
+    s->v.fors.par = false;
     return s;
 }
 
@@ -216,12 +263,18 @@ Stmt *stmt_for(const char *var, Expr *iter, Stmt *body, int line, int col) {
 
 /**
  * @brief Initializes the main entry point function structure.
+ * Takes ownership of the arena the body was allocated from and of the
+ * source mapping its string literals point into.
  */
-Function *make_main(Stmt *body) {
+Function *make_main(Arena *arena, SourceBuf *source, Stmt *body) {
     Function *f = xmalloc(sizeof(Function));
-    snprintf(f->name, sizeof(f->name), "%s", "main");
+    f->name = SYM_MAIN;
     f->ret_type = mktype(TY_INT);
     f->body = body;
+    f->arena = *arena;
+    f->source = *source;
+    arena_init(arena);
+    source->mapped = false;
     return f;
 }
 
@@ -243,11 +296,18 @@ static void print_stmt(Stmt *s, int indent) {
 
     switch (s->kind) {
     case S_DECL:
-        printf("DECL %s\n", s->v.decl.name);
+        printf("DECL %s\n", sym_name(s->v.decl.name));
         if (s->v.decl.init)
             print_expr(s->v.decl.init, indent + 1);
         break;
 
+    case S_ASSIGN:
+        printf("ASSIGN %s%s\n", sym_name(s->v.assign.name), s->v.assign.index ? "[]" : "");
+        if (s->v.assign.index)
+            print_expr(s->v.assign.index, indent + 1);
+        print_expr(s->v.assign.value, indent + 1);
+        break;
+
     case S_EXPR:
         printf("EXPR\n");
         print_expr(s->v.expr, indent + 1);
@@ -274,7 +334,7 @@ static void print_stmt(Stmt *s, int indent) {
         break;
 
     case S_FOR:
-        printf("FOR %s\n", s->v.fors.var);
+        printf("%s %s\n", s->v.fors.par ? "PAR FOR" : "FOR", sym_name(s->v.fors.var->v.decl.name));
         print_expr(s->v.fors.iter, indent + 1);
         print_stmt(s->v.fors.body, indent + 1);
         break;
@@ -293,10 +353,15 @@ static void print_expr(Expr *e, int indent) {
         printf("INT %ld\n", e->v.int_val);
         break;
     case E_STR_LIT:
-        printf("STRING \"%s\"\n", e->v.str_val);
+        printf("STRING \"%.*s\"\n", e->v.str.len, e->v.str.data);
         break;
     case E_IDENT:
-        printf("IDENT %s\n", e->v.ident);
+        printf("IDENT %s\n", sym_name(e->v.ident));
+        break;
+    case E_BINOP:
+        printf("BINOP '%c'\n", e->v.bin.op);
+        print_expr(e->v.bin.l, indent + 1);
+        print_expr(e->v.bin.r, indent + 1);
         break;
     case E_ADDR:
         printf("&\n");
@@ -322,7 +387,7 @@ static void print_expr(Expr *e, int indent) {
         print_expr(e->v.index.index, indent + 1);
         break;
     case E_CALL:
-        printf("CALL %s\n", e->v.call.name);
+        printf("CALL %s\n", sym_name(e->v.call.name));
         for (int i = 0; i < e->v.call.nargs; i++)
             print_expr(e->v.call.args[i], indent + 1);
         break;
@@ -335,7 +400,7 @@ static void print_expr(Expr *e, int indent) {
  * @brief Public interface to print function structure.
  */
 void ast_print_function(Function *f) {
-    printf("Function %s:\n", f->name);
+    printf("Function %s:\n", sym_name(f->name));
     print_stmt(f->body, 1);
 }
 
@@ -343,10 +408,80 @@ void ast_print_function(Function *f) {
    MEMORY MANAGEMENT
    --------------------------------------------------------- */
 
+/* ---------------------------------------------------------
+   NODE COUNT
+   --------------------------------------------------------- */
+
+static long count_expr(const Expr *e) {
+    if (!e) return 0;
+    long n = 1;
+    switch (e->kind) {
+    case E_BINOP:
+        n += count_expr(e->v.bin.l) + count_expr(e->v.bin.r);
+        break;
+    case E_CALL:
+        for (int i = 0; i < e->v.call.nargs; i++) n += count_expr(e->v.call.args[i]);
+        break;
+    case E_ADDR:
+    case E_MUTADDR:
+        n += count_expr(e->v.inner);
+        break;
+    case E_RANGE:
+        n += count_expr(e->v.range.start) + count_expr(e->v.range.end);
+        break;
+    case E_ARRAY_LIT:
+        for (int i = 0; i < e->v.array.count; i++) n += count_expr(e->v.array.items[i]);
+        break;
+    case E_INDEX:
+        n += count_expr(e->v.index.array) + count_expr(e->v.index.index);
+        break;
+    default:
+        break;
+    }
+    return n;
+}
+
+static long count_stmt(const Stmt *s) {
+    if (!s) return 0;
+    long n = 1;
+    switch (s->kind) {
+    case S_DECL:   n += count_expr(s->v.decl.init); break;
+    case S_ASSIGN: n += count_expr(s->v.assign.index) + count_expr(s->v.assign.value); break;
+    case S_EXPR:   n += count_expr(s->v.expr); break;
+    case S_RETURN: n += count_expr(s->v.ret); break;
+    case S_IF:
+        n += count_expr(s->v.ifs.cond) + count_stmt(s->v.ifs.then_s) + count_stmt(s->v.ifs.else_s);
+        break;
+    case S_WHILE:
+        n += count_expr(s->v.wh.cond) + count_stmt(s->v.wh.body);
+        break;
+    case S_FOR:
+        n += count_expr(s->v.fors.iter) + count_stmt(s->v.fors.body);
+        break;
+    case S_BLOCK:
+        for (int i = 0; i < s->v.block.n; i++) n += count_stmt(s->v.block.stmts[i]);
+        break;
+    default:
+        break;
+    }
+    return n;
+}
+
+long ast_count_nodes(const Function *f) {
+    return count_stmt(f->body);
+}
+
+long ast_count_stmt(const Stmt *s) {
+    return count_stmt(s);
+}
+
 /**
- * @brief Recursively deallocates function AST and associated memory.
+ * @brief Deallocates the function AST and associated memory.
+ * Every node lives in the function's arena, so no traversal is needed.
  */
 void ast_free_function(Function *f) {
-    /* Implementation depends on full traversal logic */
-    (void)f;
+    if (!f) return;
+    arena_free(&f->arena);
+    source_close(&f->source);
+    free(f);
 }
\ No newline at end of file
@@ -6,251 +6,989 @@
  * 2. Shared Borrowing: Multiple immutable references (&T) allowed.
  * 3. Exclusive Borrowing: Only one mutable reference (&mut T) allowed.
  * 4. Mutual Exclusion: Cannot mutably borrow if shared borrows exist, and vice versa.
+ *
+ * The rules are checked flow-sensitively. The semantic pass records events
+ * (use, move, borrow, definition, scope exit) into basic blocks, and
+ * bc_finish solves three dataflow problems over the resulting graph:
+ *
+ *  - moved / owned (forward, union): a variable may have been moved out,
+ *    or may still hold a value, on some path to the point;
+ *  - reaching loans (forward, union): a borrow has happened on some path;
+ *  - live holders (backward, union): a variable holding a reference is
+ *    read again later.
+ *
+ * A borrow is in force while its loan reaches the point and a variable
+ * that may hold it is still live, so it ends at its last use rather than
+ * at the end of the scope. An arm of an if only sees its own moves, and
+ * moves in a loop body are seen by the next iteration.
+ *
+ * Every set is a dense bitset over the variables or loans that take part
+ * in it (variables that are ever moved, loans, reference holders), so a
+ * join is a few word-wide ORs and untouched variables cost nothing.
+ *
+ * The moved/owned results also give IR lowering its drop facts (see
+ * Stmt.v.decl): which bindings are ever moved from, and which may still
+ * own a value when they are overwritten or go out of scope. Counting the
+ * borrows of each binding gives the optimizer its alias facts.
+ *
+ * `let b = clone(a)` of an Rc is recorded as a soft shared loan of a held
+ * by b. Soft loans never cause errors; a conflicting event while one is in
+ * force only marks it broken. If it never breaks, a keeps the object alive
+ * for as long as b is used, so b can share a's count: the increment and
+ * the matching decrement at b's scope exit are both left out.
+ *
+ * The body of a `par for` is also checked as it is recorded, without the
+ * dataflow: its iterations run at the same time, so the variables around
+ * the loop must stay unchanged until it ends (see bc_par_body).
  */
 
 #include "../include/borrowchecker.h"
 #include "../include/ast.h"
+#include "../include/symtab.h"
 #include "../include/common.h"
 
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
 
-/**
- * @struct VarInfo
- * @brief Tracks the borrow state and validity of a variable within a scope.
- */
-typedef struct VarInfo {
-    char name[MAX_IDENT];
-    Type type;
+typedef enum {
+    EV_USE,         /* var is read */
+    EV_MOVE,        /* var's value moves elsewhere */
+    EV_BORROW,      /* loan: &var bound to a variable */
+    EV_MUT_BORROW,  /* loan: &mut var bound to a variable */
+    EV_DEF,         /* var is (re)defined: a let or an assignment */
+    EV_STORE,       /* An element of var is overwritten in place */
+    EV_SCOPE_EXIT   /* var goes out of scope */
+} BcEventKind;
+
+struct BcEvent {
+    BcEventKind kind;
+    int var;
+    int loan;           /* EV_BORROW / EV_MUT_BORROW */
+    bool has_value;     /* EV_DEF: a value is stored (not `let x: T;`) */
+    int line, col;
+    const char *what;   /* EV_USE: access described in errors */
+    Stmt *assign;       /* EV_DEF of an assignment: receives drop_old */
+};
+
+struct BcBlock {
+    int first, end;     /* Event range */
+    int succ[2];        /* -1 = none */
+};
+
+struct BcVar {
+    Symbol name;
+    Stmt *decl;
+    bool assigned;      /* Target of a whole-variable assignment */
+    int track;          /* Index in the moved/owned sets, or -1 if never moved */
+    int live;           /* Index in the liveness sets, or -1 if never a holder */
+    int loans;          /* First loan of this variable (BcLoan.next_on_var) */
+    int copies;         /* First copy edge out of this variable, or -1 */
+    bool mut_borrowed;  /* Some `&mut` of it is taken */
+    int imm_count;      /* Number of `&` of it taken */
+
+    /* Outer arrays in the par body being checked */
+    bool par_written;   /* Some element is stored */
+    int par_read_line, par_read_col;    /* First read not at the loop variable, or 0 */
+};
+
+struct BcLoan {
+    int var;            /* Borrowed variable */
+    int holder;         /* Variable the reference was bound to */
+    bool mut;
+    bool soft;          /* Rc share: decides rc_alias instead of raising errors */
+    bool broken;        /* Soft loan met a conflicting event while in force */
+    int next_on_var;
+};
 
-    bool valid;         /* False if the value has been moved */
-    int imm_count;      /* Active count of immutable references */
-    bool mut_borrowed;  /* True if a mutable reference is active */
+/* ---------------------------------------------------------
+   BITSETS
+   --------------------------------------------------------- */
 
-    int scope_depth;
-    struct VarInfo *next;
-} VarInfo;
+typedef uint64_t Word;
 
-/**
- * @struct BCState
- * @brief Context for the Borrow Checker traversal.
- */
-typedef struct {
-    VarInfo *vars;      /* Linked list of variables in the current symbol table */
-    int depth;          /* Current lexical nesting level */
-    const char *file;   /* Source filename for error reporting */
-} BCState;
+#define WORDS(n) (((n) + 63) / 64)
 
-/* ---------------------------------------------------------
-   STATE MANAGEMENT HELPERS
-   --------------------------------------------------------- */
+static bool bit_test(const Word *s, int i) { return (s[i >> 6] >> (i & 63)) & 1; }
+static void bit_set(Word *s, int i)        { s[i >> 6] |= (Word)1 << (i & 63); }
+static void bit_clear(Word *s, int i)      { s[i >> 6] &= ~((Word)1 << (i & 63)); }
 
-/** Retrieves variable metadata from the current context by name. */
-static VarInfo *find_var(BCState *s, const char *name) {
-    for (VarInfo *v = s->vars; v; v = v->next) {
-        if (strcmp(v->name, name) == 0)
-            return v;
+/** dst |= src; returns true if dst changed. */
+static bool bits_or(Word *dst, const Word *src, int n) {
+    Word changed = 0;
+    for (int i = 0; i < n; i++) {
+        Word v = dst[i] | src[i];
+        changed |= v ^ dst[i];
+        dst[i] = v;
     }
-    return NULL;
+    return changed != 0;
 }
 
-/** Registers a new variable into the current scope. */
-static void add_var(BCState *s, const char *name, Type t) {
-    VarInfo *v = xmalloc(sizeof(VarInfo));
+static bool bits_intersect(const Word *a, const Word *b, int n) {
+    for (int i = 0; i < n; i++)
+        if (a[i] & b[i]) return true;
+    return false;
+}
+
+static Word *bits_new(size_t n) {
+    Word *s = xmalloc(sizeof(Word) * (n ? n : 1));
+    memset(s, 0, sizeof(Word) * (n ? n : 1));
+    return s;
+}
 
-    snprintf(v->name, sizeof(v->name), "%s", name);
-    v->type = t;
-    v->valid = true;
-    v->imm_count = 0;
-    v->mut_borrowed = false;
-    v->scope_depth = s->depth;
+/* ---------------------------------------------------------
+   EVENT RECORDING
+   --------------------------------------------------------- */
 
-    /* Prepend to the linked list (shadowing support) */
-    v->next = s->vars;
-    s->vars = v;
+/** Error cleanup for the message bc_error formats. */
+static void free_message(void *arg) {
+    sb_free(arg);
 }
 
 /** Reports a borrow-check violation and terminates compilation. */
-static void bc_error(BCState *s, int line, int col, const char *fmt, ...) {
+static void bc_error(BorrowCheck *bc, int line, int col, const char *fmt, ...) {
+    StrBuf msg;
     va_list ap;
     va_start(ap, fmt);
 
-    fprintf(stderr, "%s:%d:%d: borrow error: ",
-            s->file ? s->file : "<input>", line, col);
+    sb_init(&msg);
+    sb_vprintf(&msg, fmt, ap);
+    va_end(ap);
 
-    vfprintf(stderr, fmt, ap);
-    fprintf(stderr, "\n");
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, free_message, &msg);
+    errorf("%s:%d:%d: borrow error: %.*s\n",
+           bc->file ? bc->file : "<input>", line, col, (int)msg.len, msg.data);
+}
 
-    va_end(ap);
-    exit(1);
+/** Borrow state of the innermost variable called `name`. */
+static VarInfo *find_var(BorrowCheck *bc, Symbol name) {
+    unsigned char *payload = symtab_lookup(bc->vars, name);
+    return payload ? (VarInfo *)(payload + bc->var_offset) : NULL;
 }
 
-/* Forward declarations for recursive traversal */
-static void visit_stmt(BCState *s, Stmt *st);
-static void visit_expr(BCState *s, Expr *e);
+static BcEvent *add_event(BorrowCheck *bc, BcEventKind kind, int var, int line, int col) {
+    if (bc->nevents == bc->events_cap) {
+        bc->events_cap = bc->events_cap ? bc->events_cap * 2 : 256;
+        bc->events = xrealloc(bc->events, sizeof(BcEvent) * (size_t)bc->events_cap);
+    }
+    BcEvent *ev = &bc->events[bc->nevents++];
+    memset(ev, 0, sizeof(*ev));
+    ev->kind = kind;
+    ev->var = var;
+    ev->loan = -1;
+    ev->line = line;
+    ev->col = col;
+    bc->blocks[bc->cur].end = bc->nevents;
+    return ev;
+}
 
-/* ---------------------------------------------------------
-   EXPRESSION ANALYSIS
-   --------------------------------------------------------- */
+/** Starts a new block; events recorded from now on belong to it. */
+static int new_block(BorrowCheck *bc) {
+    if (bc->nblocks == bc->blocks_cap) {
+        bc->blocks_cap = bc->blocks_cap ? bc->blocks_cap * 2 : 16;
+        bc->blocks = xrealloc(bc->blocks, sizeof(BcBlock) * (size_t)bc->blocks_cap);
+    }
+    BcBlock *b = &bc->blocks[bc->nblocks];
+    b->first = b->end = bc->nevents;
+    b->succ[0] = b->succ[1] = -1;
+    bc->cur = bc->nblocks;
+    return bc->nblocks++;
+}
+
+static void add_edge(BorrowCheck *bc, int from, int to) {
+    BcBlock *b = &bc->blocks[from];
+    b->succ[b->succ[0] < 0 ? 0 : 1] = to;
+}
 
 /**
- * @brief Checks for use-after-move and validity of expressions.
+ * Copy edges: when `src` moves into `dst`, every loan `src` may hold can
+ * now be held by `dst` as well. They reuse the BcLoan record, with the
+ * destination as holder, in a per-source list.
  */
-static void visit_expr(BCState *s, Expr *e) {
-    if (!e) return;
-
-    switch (e->kind) {
-
-    case E_IDENT: {
-        VarInfo *v = find_var(s, e->v.ident);
-        if (!v)
-            bc_error(s, e->line, e->col, "use of undeclared variable '%s'", e->v.ident);
-        
-        /* Check Move Semantics */
-        if (!v->valid)
-            bc_error(s, e->line, e->col, "use of moved value '%s'", e->v.ident);
-        break;
+static void add_copy(BorrowCheck *bc, int src, int dst) {
+    if (bc->ncopies == bc->copies_cap) {
+        bc->copies_cap = bc->copies_cap ? bc->copies_cap * 2 : 16;
+        bc->copies = xrealloc(bc->copies, sizeof(BcLoan) * (size_t)bc->copies_cap);
     }
+    BcLoan *c = &bc->copies[bc->ncopies];
+    c->var = src;
+    c->holder = dst;
+    c->mut = c->soft = c->broken = false;
+    c->next_on_var = bc->var[src].copies;
+    bc->var[src].copies = bc->ncopies++;
+}
 
-    case E_CALL:
-        for (int i = 0; i < e->v.call.nargs; i++)
-            visit_expr(s, e->v.call.args[i]);
-        break;
+static int add_loan(BorrowCheck *bc, int var, bool mut) {
+    if (bc->nloans == bc->loans_cap) {
+        bc->loans_cap = bc->loans_cap ? bc->loans_cap * 2 : 16;
+        bc->loans = xrealloc(bc->loans, sizeof(BcLoan) * (size_t)bc->loans_cap);
+    }
+    BcLoan *l = &bc->loans[bc->nloans];
+    l->var = var;
+    l->holder = -1;
+    l->mut = mut;
+    l->soft = l->broken = false;
+    l->next_on_var = bc->var[var].loans;
+    bc->var[var].loans = bc->nloans;
+    return bc->nloans++;
+}
 
-    case E_ADDR:
-    case E_MUTADDR:
-        /* Recursive check of the expression being referenced */
-        visit_expr(s, e->v.inner);
-        break;
+void bc_init(BorrowCheck *bc, const char *file, const SymTab *vars, size_t var_offset, bool enabled) {
+    memset(bc, 0, sizeof(*bc));
+    bc->enabled = enabled;
+    bc->file = file;
+    bc->vars = vars;
+    bc->var_offset = var_offset;
+    bc->pending_loan = -1;
+    bc->par_vars = bc->par_index = -1;
+    if (enabled) new_block(bc);
+}
 
-    default:
-        break;
+/* ---------------------------------------------------------
+   PAR LOOPS
+   --------------------------------------------------------- */
+
+/** True if `var` is declared outside the par body being checked. */
+static bool par_shared(const BorrowCheck *bc, int var) {
+    return var < bc->par_vars;
+}
+
+/** Moving `var` out of a par body would hand one value to every iteration. */
+static void par_check_move(BorrowCheck *bc, int var, int line, int col) {
+    TypeKind k = bc->var[var].decl->v.decl.type.kind;
+    if (par_shared(bc, var) && (k == TY_STRING || k == TY_RC || k == TY_MUTREF))
+        bc_error(bc, line, col, "cannot move out of '%s' inside a par loop (it is shared by every iteration)",
+                 sym_name(bc->var[var].name));
+}
+
+static void par_check_mut_borrow(BorrowCheck *bc, int var, int line, int col) {
+    if (par_shared(bc, var))
+        bc_error(bc, line, col, "cannot mutably borrow '%s' inside a par loop (it is shared by every iteration)",
+                 sym_name(bc->var[var].name));
+}
+
+/** True for `i`, the variable of the par loop being checked. */
+static bool is_par_index(BorrowCheck *bc, const Expr *index) {
+    if (index->kind != E_IDENT) return false;
+    VarInfo *v = find_var(bc, index->v.ident);
+    return v && v->id == bc->par_index;
+}
+
+/**
+ * Notes a read of an outer array other than its element at the loop
+ * variable: another iteration may be writing that element meanwhile.
+ */
+static void par_note_read(BorrowCheck *bc, int var, int line, int col) {
+    BcVar *v = &bc->var[var];
+    if (!par_shared(bc, var) || v->decl->v.decl.type.kind != TY_ARRAY || v->par_read_line) return;
+    v->par_read_line = line;
+    v->par_read_col = col;
+}
+
+void bc_par_body(BorrowCheck *bc, VarInfo *index) {
+    if (!bc->enabled) return;
+    /* Ids are handed out in declaration order */
+    bc->par_vars = bc->par_index = index->id;
+    for (int i = 0; i < bc->par_vars; i++) {
+        bc->var[i].par_written = false;
+        bc->var[i].par_read_line = bc->var[i].par_read_col = 0;
     }
 }
 
+void bc_par_end(BorrowCheck *bc) {
+    if (!bc->enabled) return;
+    /* Reads may come before the write in the body, so this waits for all of it */
+    for (int i = 0; i < bc->par_vars; i++) {
+        const BcVar *v = &bc->var[i];
+        if (v->par_written && v->par_read_line)
+            bc_error(bc, v->par_read_line, v->par_read_col,
+                     "'%s' is written inside a par loop, so it can only be read there at the loop variable '%s'",
+                     sym_name(v->name), sym_name(bc->var[bc->par_index].name));
+    }
+    bc->par_vars = bc->par_index = -1;
+}
+
 /* ---------------------------------------------------------
-   STATEMENT ANALYSIS
+   EXPRESSION AND STATEMENT HOOKS
    --------------------------------------------------------- */
 
+void bc_use(BorrowCheck *bc, VarInfo *v, const Expr *e, const char *what) {
+    if (!bc->enabled) return;
+    par_note_read(bc, v->id, e->line, e->col);
+    add_event(bc, EV_USE, v->id, e->line, e->col)->what = what;
+}
+
+void bc_use_element(BorrowCheck *bc, VarInfo *v, const Expr *e, const Expr *index) {
+    if (!bc->enabled) return;
+    if (!is_par_index(bc, index)) par_note_read(bc, v->id, e->line, e->col);
+    add_event(bc, EV_USE, v->id, e->line, e->col)->what = "use of";
+}
+
+void bc_borrow(BorrowCheck *bc, VarInfo *v, bool mut) {
+    if (!bc->enabled) return;
+    if (mut) bc->var[v->id].mut_borrowed = true;
+    else bc->var[v->id].imm_count++;
+}
+
+/** True for `clone(a)` of an Rc variable `a`. */
+static bool is_rc_clone(const Expr *e) {
+    return e->kind == E_CALL && e->v.call.name == SYM_CLONE && e->v.call.nargs == 1 &&
+           e->v.call.args[0]->kind == E_IDENT && e->type.kind == TY_RC;
+}
+
 /**
- * @brief Analyzes statements to enforce move and borrow boundaries.
+ * @brief Records the move or borrow performed by `let x = init`.
+ * Validity of the source was recorded as a use when the initializer was typed.
  */
-static void visit_stmt(BCState *s, Stmt *st) {
-    if (!st) return;
+void bc_bind_source(BorrowCheck *bc, Stmt *st) {
+    Expr *init = st->v.decl.init;
+    if (!bc->enabled || !init) return;
+
+    /* RULE: MOVE SEMANTICS (let x = y) */
+    if (init->kind == E_IDENT) {
+        int src = find_var(bc, init->v.ident)->id;
+        par_check_move(bc, src, st->line, st->col);
+        add_event(bc, EV_MOVE, src, st->line, st->col);
+    }
 
-    switch (st->kind) {
+    /* RULE: SHARED / MUTABLE BORROW (let r = &x, let r = &mut x) */
+    else if (init->kind == E_ADDR || init->kind == E_MUTADDR) {
+        bool mut = init->kind == E_MUTADDR;
+        Expr *inner = init->v.inner;
+        if (inner->kind != E_IDENT)
+            bc_error(bc, st->line, st->col, mut ? "cannot mutably borrow non-identifier"
+                                                : "cannot borrow from non-identifier");
+
+        int var = find_var(bc, inner->v.ident)->id;
+        if (mut) par_check_mut_borrow(bc, var, st->line, st->col);
+        BcEvent *ev = add_event(bc, mut ? EV_MUT_BORROW : EV_BORROW, var, st->line, st->col);
+        ev->loan = bc->pending_loan = add_loan(bc, var, mut);
+    }
 
-    case S_DECL: {
-        if (st->v.decl.init) {
-            Expr *init = st->v.decl.init;
+    /* Rc SHARING (let b = clone(a)): a soft shared loan of a */
+    else if (is_rc_clone(init)) {
+        int var = find_var(bc, init->v.call.args[0]->v.ident)->id;
+        BcEvent *ev = add_event(bc, EV_BORROW, var, st->line, st->col);
+        ev->loan = bc->pending_loan = add_loan(bc, var, false);
+        bc->loans[ev->loan].soft = true;
+    }
+}
 
-            /* RULE: MOVE SEMANTICS (let x = y) */
-            if (init->kind == E_IDENT) {
-                const char *src = init->v.ident;
-                VarInfo *v = find_var(s, src);
+/** Adds the variable declared by `decl` to the event graph. */
+static BcVar *add_var(BorrowCheck *bc, VarInfo *v, Stmt *decl) {
+    if (bc->nvars == bc->vars_cap) {
+        bc->vars_cap = bc->vars_cap ? bc->vars_cap * 2 : 64;
+        bc->var = xrealloc(bc->var, sizeof(BcVar) * (size_t)bc->vars_cap);
+    }
+    v->id = bc->nvars++;
+    BcVar *bv = &bc->var[v->id];
+    bv->name = decl->v.decl.name;
+    bv->decl = decl;
+    bv->assigned = false;
+    bv->track = bv->live = -1;
+    bv->loans = bv->copies = -1;
+    bv->mut_borrowed = false;
+    bv->imm_count = 0;
+    bv->par_written = false;
+    bv->par_read_line = bv->par_read_col = 0;
+    return bv;
+}
 
-                if (!v) bc_error(s, st->line, st->col, "use of undeclared '%s'", src);
-                if (!v->valid) bc_error(s, st->line, st->col, "use of moved value '%s'", src);
-                
-                /* Check if source is currently borrowed */
-                if (v->imm_count > 0 || v->mut_borrowed)
-                    bc_error(s, st->line, st->col, "cannot move '%s' because it is borrowed", src);
+/** Registers the variable declared by `decl` and records its definition. */
+void bc_declare(BorrowCheck *bc, VarInfo *v, Stmt *decl) {
+    if (!bc->enabled) return;
+    add_var(bc, v, decl);
+
+    Expr *init = decl->v.decl.init;
+    if (init && init->kind == E_IDENT)
+        add_copy(bc, find_var(bc, init->v.ident)->id, v->id);
+    /* A share of a share depends on whatever keeps the first one valid */
+    else if (init && is_rc_clone(init))
+        add_copy(bc, find_var(bc, init->v.call.args[0]->v.ident)->id, v->id);
+    if (bc->pending_loan >= 0) {
+        bc->loans[bc->pending_loan].holder = v->id;
+        bc->pending_loan = -1;
+    }
 
-                v->valid = false; /* Invalidate source after move */
-            }
+    add_event(bc, EV_DEF, v->id, decl->line, decl->col)->has_value = init != NULL;
+}
 
-            /* RULE: SHARED BORROW (let r = &x) */
-            else if (init->kind == E_ADDR) {
-                Expr *inner = init->v.inner;
-                if (inner->kind != E_IDENT)
-                    bc_error(s, st->line, st->col, "cannot borrow from non-identifier");
+void bc_loop_var(BorrowCheck *bc, VarInfo *v, Stmt *decl) {
+    if (!bc->enabled) return;
+    add_var(bc, v, decl);
+    add_event(bc, EV_DEF, v->id, decl->line, decl->col)->has_value = true;
+}
 
-                VarInfo *v = find_var(s, inner->v.ident);
-                if (!v) bc_error(s, st->line, st->col, "borrow of undeclared '%s'", inner->v.ident);
-                if (!v->valid) bc_error(s, st->line, st->col, "borrow of moved value '%s'", inner->v.ident);
-                
-                /* Conflict: Existing mutable borrow */
-                if (v->mut_borrowed)
-                    bc_error(s, st->line, st->col, "cannot shared-borrow '%s' while mutably borrowed", inner->v.ident);
+void bc_assign(BorrowCheck *bc, VarInfo *target, Stmt *st) {
+    if (!bc->enabled) return;
+    if (par_shared(bc, target->id))
+        bc_error(bc, st->line, st->col, "cannot assign to '%s' inside a par loop (it is shared by every iteration)",
+                 sym_name(st->v.assign.name));
+    if (target->id == bc->par_index)
+        bc_error(bc, st->line, st->col, "cannot assign to the par loop variable '%s'",
+                 sym_name(st->v.assign.name));
+    bc->var[target->id].assigned = true;
+
+    Expr *value = st->v.assign.value;
+    if (value->kind == E_IDENT) {
+        /* RULE: MOVE SEMANTICS (x = y) */
+        int src = find_var(bc, value->v.ident)->id;
+        if (src == target->id) {
+            /* Self-assignment keeps the value in place */
+            st->v.assign.drop_old = false;
+            return;
+        }
+        par_check_move(bc, src, st->line, st->col);
+        add_event(bc, EV_MOVE, src, st->line, st->col);
+        add_copy(bc, src, target->id);
+    } else if ((value->kind == E_ADDR || value->kind == E_MUTADDR) &&
+               value->v.inner->kind == E_IDENT) {
+        /* Re-pointing a reference: r = &x */
+        bool mut = value->kind == E_MUTADDR;
+        int var = find_var(bc, value->v.inner->v.ident)->id;
+        if (mut) par_check_mut_borrow(bc, var, st->line, st->col);
+        BcEvent *ev = add_event(bc, mut ? EV_MUT_BORROW : EV_BORROW, var, st->line, st->col);
+        ev->loan = add_loan(bc, var, mut);
+        bc->loans[ev->loan].holder = target->id;
+    }
 
-                v->imm_count++;
-            }
+    BcEvent *def = add_event(bc, EV_DEF, target->id, st->line, st->col);
+    def->has_value = true;
+    def->assign = st;
+}
 
-            /* RULE: MUTABLE BORROW (let r = &mut x) */
-            else if (init->kind == E_MUTADDR) {
-                Expr *inner = init->v.inner;
-                if (inner->kind != E_IDENT)
-                    bc_error(s, st->line, st->col, "cannot mutably borrow non-identifier");
+/* ---------------------------------------------------------
+   SCOPES AND CONTROL FLOW
+   --------------------------------------------------------- */
 
-                VarInfo *v = find_var(s, inner->v.ident);
-                if (!v) bc_error(s, st->line, st->col, "mut borrow of undeclared '%s'", inner->v.ident);
-                if (!v->valid) bc_error(s, st->line, st->col, "mut borrow of moved value '%s'", inner->v.ident);
-                
-                /* Conflict: Any existing borrow (shared or mutable) */
-                if (v->imm_count > 0 || v->mut_borrowed)
-                    bc_error(s, st->line, st->col, "cannot mutably borrow '%s' (already borrowed)", inner->v.ident);
+void bc_assign_index(BorrowCheck *bc, VarInfo *target, Stmt *st) {
+    if (!bc->enabled) return;
+    /* Iterations then write disjoint elements */
+    if (par_shared(bc, target->id)) {
+        if (!is_par_index(bc, st->v.assign.index))
+            bc_error(bc, st->line, st->col,
+                     "element of '%s' written inside a par loop must be indexed by the loop variable '%s'",
+                     sym_name(st->v.assign.name), sym_name(bc->var[bc->par_index].name));
+        bc->var[target->id].par_written = true;
+    }
+    add_event(bc, EV_USE, target->id, st->line, st->col)->what = "assignment to element of";
+    add_event(bc, EV_STORE, target->id, st->line, st->col);
+}
+
+void bc_close_scope(BorrowCheck *bc, int mark) {
+    if (!bc->enabled) return;
+    for (int i = mark; i < symtab_count(bc->vars); i++) {
+        VarInfo *v = (VarInfo *)((unsigned char *)symtab_at(bc->vars, i) + bc->var_offset);
+        add_event(bc, EV_SCOPE_EXIT, v->id, 0, 0);
+    }
+}
 
-                v->mut_borrowed = true;
+void bc_if_begin(BorrowCheck *bc, BorrowFlow *fl) {
+    if (!bc->enabled) return;
+    fl->cond = bc->cur;
+    fl->then_end = -1;
+    add_edge(bc, fl->cond, new_block(bc));
+}
+
+void bc_if_else(BorrowCheck *bc, BorrowFlow *fl) {
+    if (!bc->enabled) return;
+    fl->then_end = bc->cur;
+    add_edge(bc, fl->cond, new_block(bc));
+}
+
+void bc_if_end(BorrowCheck *bc, BorrowFlow *fl) {
+    if (!bc->enabled) return;
+    int last = bc->cur;
+    int join = new_block(bc);
+    add_edge(bc, last, join);
+    add_edge(bc, fl->then_end >= 0 ? fl->then_end : fl->cond, join);
+}
+
+void bc_loop_begin(BorrowCheck *bc, BorrowFlow *fl) {
+    if (!bc->enabled) return;
+    int prev = bc->cur;
+    fl->cond = new_block(bc);
+    add_edge(bc, prev, fl->cond);
+}
+
+void bc_loop_body(BorrowCheck *bc, BorrowFlow *fl) {
+    if (!bc->enabled) return;
+    fl->then_end = bc->cur;     /* End of the condition */
+    add_edge(bc, fl->then_end, new_block(bc));
+}
+
+void bc_loop_end(BorrowCheck *bc, BorrowFlow *fl) {
+    if (!bc->enabled) return;
+    add_edge(bc, bc->cur, fl->cond);
+    add_edge(bc, fl->then_end, new_block(bc));
+}
+
+/* ---------------------------------------------------------
+   DATAFLOW
+   --------------------------------------------------------- */
+
+/** Problem sizes and per-block results. */
+typedef struct Flow {
+    int ntrack, nlive;
+    int wt, wl, wh;     /* Words: tracked vars, loans, live holders */
+    int wf;             /* Forward state: moved | owned | reaching loans */
+
+    int *pred_start, *preds;
+    Word *out;          /* Forward state at block exit */
+    Word *live_in;      /* Live holders at block entry */
+    Word *holders;      /* Per loan: variables that may hold it */
+} Flow;
+
+/* Offsets of the three parts of a forward state */
+#define MOVED(f, s) (s)
+#define OWNED(f, s) ((s) + (f)->wt)
+#define REACH(f, s) ((s) + 2 * (f)->wt)
+
+static void forward_event(const BorrowCheck *bc, const Flow *f, const BcEvent *ev, Word *s) {
+    int t = ev->var >= 0 ? bc->var[ev->var].track : -1;
+
+    switch (ev->kind) {
+    case EV_MOVE:
+        if (t >= 0) {
+            bit_set(MOVED(f, s), t);
+            bit_clear(OWNED(f, s), t);
+        }
+        break;
+    case EV_DEF:
+        if (t >= 0) {
+            bit_clear(MOVED(f, s), t);
+            if (ev->has_value) bit_set(OWNED(f, s), t);
+            else bit_clear(OWNED(f, s), t);
+        }
+        break;
+    case EV_BORROW:
+    case EV_MUT_BORROW:
+        bit_set(REACH(f, s), ev->loan);
+        break;
+    default:
+        break;
+    }
+}
+
+static void backward_event(const BorrowCheck *bc, const BcEvent *ev, Word *live) {
+    int h = bc->var[ev->var].live;
+    if (h < 0) return;
+
+    if (ev->kind == EV_DEF)
+        bit_clear(live, h);
+    else if (ev->kind == EV_USE || ev->kind == EV_MOVE)
+        bit_set(live, h);
+}
+
+/** Forward state at the entry of block `b`. */
+static void block_in(const Flow *f, int b, Word *s) {
+    memset(s, 0, sizeof(Word) * (size_t)(f->wf ? f->wf : 1));
+    for (int p = f->pred_start[b]; p < f->pred_start[b + 1]; p++)
+        bits_or(s, &f->out[(size_t)f->preds[p] * f->wf], f->wf);
+}
+
+static void solve_forward(const BorrowCheck *bc, Flow *f) {
+    int n = bc->nblocks;
+    int *work = xmalloc(sizeof(int) * (size_t)n);
+    bool *queued = xmalloc(sizeof(bool) * (size_t)n);
+    Word *s = bits_new((size_t)f->wf);
+
+    /* Seed in creation order, which follows the source */
+    int head = 0, count = n;
+    for (int i = 0; i < n; i++) {
+        work[i] = i;
+        queued[i] = true;
+    }
+
+    while (count > 0) {
+        int b = work[head];
+        head = (head + 1) % n;
+        count--;
+        queued[b] = false;
+
+        block_in(f, b, s);
+        for (int e = bc->blocks[b].first; e < bc->blocks[b].end; e++)
+            forward_event(bc, f, &bc->events[e], s);
+
+        Word *out = &f->out[(size_t)b * f->wf];
+        if (memcmp(out, s, sizeof(Word) * (size_t)f->wf) != 0) {
+            memcpy(out, s, sizeof(Word) * (size_t)f->wf);
+            for (int k = 0; k < 2; k++) {
+                int succ = bc->blocks[b].succ[k];
+                if (succ >= 0 && !queued[succ]) {
+                    queued[succ] = true;
+                    work[(head + count++) % n] = succ;
+                }
             }
-            else {
-                visit_expr(s, init);
+        }
+    }
+
+    free(work);
+    free(queued);
+    free(s);
+}
+
+/** Live holders at the exit of block `b`. */
+static void block_live_out(const BorrowCheck *bc, const Flow *f, int b, Word *live) {
+    memset(live, 0, sizeof(Word) * (size_t)(f->wh ? f->wh : 1));
+    for (int k = 0; k < 2; k++) {
+        int succ = bc->blocks[b].succ[k];
+        if (succ >= 0) bits_or(live, &f->live_in[(size_t)succ * f->wh], f->wh);
+    }
+}
+
+static void solve_backward(const BorrowCheck *bc, Flow *f) {
+    int n = bc->nblocks;
+    int *work = xmalloc(sizeof(int) * (size_t)n);
+    bool *queued = xmalloc(sizeof(bool) * (size_t)n);
+    Word *live = bits_new((size_t)f->wh);
+
+    /* Seed in reverse creation order */
+    int head = 0, count = n;
+    for (int i = 0; i < n; i++) {
+        work[i] = n - 1 - i;
+        queued[i] = true;
+    }
+
+    while (count > 0) {
+        int b = work[head];
+        head = (head + 1) % n;
+        count--;
+        queued[b] = false;
+
+        block_live_out(bc, f, b, live);
+        for (int e = bc->blocks[b].end - 1; e >= bc->blocks[b].first; e--)
+            backward_event(bc, &bc->events[e], live);
+
+        Word *in = &f->live_in[(size_t)b * f->wh];
+        if (memcmp(in, live, sizeof(Word) * (size_t)f->wh) != 0) {
+            memcpy(in, live, sizeof(Word) * (size_t)f->wh);
+            for (int p = f->pred_start[b]; p < f->pred_start[b + 1]; p++) {
+                int pred = f->preds[p];
+                if (!queued[pred]) {
+                    queued[pred] = true;
+                    work[(head + count++) % n] = pred;
+                }
             }
         }
+    }
 
-        add_var(s, st->v.decl.name, st->v.decl.type);
-        break;
+    free(work);
+    free(queued);
+    free(live);
+}
+
+/** Builds the predecessor lists of the block graph. */
+static void build_preds(const BorrowCheck *bc, Flow *f) {
+    int n = bc->nblocks;
+    f->pred_start = xmalloc(sizeof(int) * (size_t)(n + 1));
+    memset(f->pred_start, 0, sizeof(int) * (size_t)(n + 1));
+
+    for (int b = 0; b < n; b++)
+        for (int k = 0; k < 2; k++)
+            if (bc->blocks[b].succ[k] >= 0) f->pred_start[bc->blocks[b].succ[k] + 1]++;
+    for (int b = 0; b < n; b++)
+        f->pred_start[b + 1] += f->pred_start[b];
+
+    int *fill = xmalloc(sizeof(int) * (size_t)(n ? n : 1));
+    memcpy(fill, f->pred_start, sizeof(int) * (size_t)n);
+    f->preds = xmalloc(sizeof(int) * (size_t)(f->pred_start[n] ? f->pred_start[n] : 1));
+    for (int b = 0; b < n; b++)
+        for (int k = 0; k < 2; k++)
+            if (bc->blocks[b].succ[k] >= 0) f->preds[fill[bc->blocks[b].succ[k]]++] = b;
+    free(fill);
+}
+
+/**
+ * @brief Numbers the variables that take part in each problem.
+ * Only moved-from variables can be moved or need drop flags, and only
+ * variables that a loan can reach (its holder and whatever it is copied
+ * into) need liveness. Also fills in the holder set of every loan.
+ */
+static void number_vars(BorrowCheck *bc, Flow *f) {
+    f->ntrack = f->nlive = 0;
+    for (int e = 0; e < bc->nevents; e++) {
+        BcEvent *ev = &bc->events[e];
+        if (ev->kind == EV_MOVE && bc->var[ev->var].track < 0)
+            bc->var[ev->var].track = f->ntrack++;
     }
 
-    case S_BLOCK: {
-        s->depth++;
-        for (int i = 0; i < st->v.block.n; i++)
-            visit_stmt(s, st->v.block.stmts[i]);
-
-        /* Scope Exit: Cleanup variables defined at this depth */
-        VarInfo **pp = &s->vars;
-        while (*pp) {
-            if ((*pp)->scope_depth == s->depth) {
-                VarInfo *to_free = *pp;
-                *pp = (*pp)->next;
-                free(to_free);
-                continue;
+    /* Holder closure of every loan over the copy edges */
+    int nvars = bc->nvars;
+    int *stack = xmalloc(sizeof(int) * (size_t)(nvars ? nvars : 1));
+    int *seen = xmalloc(sizeof(int) * (size_t)(nvars ? nvars : 1));
+    for (int i = 0; i < nvars; i++) seen[i] = -1;
+
+    for (int l = 0; l < bc->nloans; l++) {
+        if (bc->loans[l].holder < 0) continue;
+        int top = 0;
+        stack[top++] = bc->loans[l].holder;
+        seen[bc->loans[l].holder] = l;
+        while (top > 0) {
+            int v = stack[--top];
+            if (bc->var[v].live < 0) bc->var[v].live = f->nlive++;
+            for (int c = bc->var[v].copies; c >= 0; c = bc->copies[c].next_on_var) {
+                int dst = bc->copies[c].holder;
+                if (seen[dst] != l) {
+                    seen[dst] = l;
+                    stack[top++] = dst;
+                }
             }
-            pp = &(*pp)->next;
         }
-        s->depth--;
-        break;
     }
 
-    case S_IF:
-        visit_expr(s, st->v.ifs.cond);
-        visit_stmt(s, st->v.ifs.then_s);
-        if (st->v.ifs.else_s) visit_stmt(s, st->v.ifs.else_s);
-        break;
+    f->wt = WORDS(f->ntrack);
+    f->wl = WORDS(bc->nloans);
+    f->wh = WORDS(f->nlive);
+    f->wf = 2 * f->wt + f->wl;
+
+    f->holders = bits_new((size_t)bc->nloans * (size_t)f->wh);
+    for (int i = 0; i < nvars; i++) seen[i] = -1;
+    for (int l = 0; l < bc->nloans; l++) {
+        if (bc->loans[l].holder < 0) continue;
+        Word *hs = &f->holders[(size_t)l * f->wh];
+        int top = 0;
+        stack[top++] = bc->loans[l].holder;
+        seen[bc->loans[l].holder] = l;
+        while (top > 0) {
+            int v = stack[--top];
+            bit_set(hs, bc->var[v].live);
+            for (int c = bc->var[v].copies; c >= 0; c = bc->copies[c].next_on_var) {
+                int dst = bc->copies[c].holder;
+                if (seen[dst] != l) {
+                    seen[dst] = l;
+                    stack[top++] = dst;
+                }
+            }
+        }
+    }
 
-    case S_WHILE:
-        visit_expr(s, st->v.wh.cond);
-        visit_stmt(s, st->v.wh.body);
-        break;
+    free(stack);
+    free(seen);
+}
 
-    default:
-        break;
+/** Events that conflict with loans in force on their variable. */
+static bool checks_loans(const BcEvent *ev) {
+    return ev->kind == EV_MOVE || ev->kind == EV_BORROW || ev->kind == EV_MUT_BORROW ||
+           ev->kind == EV_STORE || (ev->kind == EV_DEF && ev->assign);
+}
+
+/**
+ * @brief True if one of the `n` loans in `live_loans` other than `except`
+ * reaches state `s`. With `mut_only`, only mutable loans count.
+ */
+static bool is_borrowed(const BorrowCheck *bc, const Flow *f, const int *live_loans, int n,
+                        int except, bool mut_only, const Word *s) {
+    for (int i = 0; i < n; i++) {
+        int l = live_loans[i];
+        if (l == except || bc->loans[l].soft || (mut_only && !bc->loans[l].mut)) continue;
+        if (bit_test(REACH(f, s), l)) return true;
     }
+    return false;
+}
+
+/** Breaks the soft loans among the `n` in `live_loans` that `ev` conflicts with at `s`. */
+static void break_shares(BorrowCheck *bc, const Flow *f, const int *live_loans, int n,
+                         const BcEvent *ev, const Word *s) {
+    if (ev->kind == EV_BORROW) return;      /* Shared borrows coexist */
+    for (int i = 0; i < n; i++) {
+        BcLoan *l = &bc->loans[live_loans[i]];
+        if (live_loans[i] != ev->loan && l->soft && bit_test(REACH(f, s), live_loans[i]))
+            l->broken = true;
+    }
+}
+
+/** Scratch arrays of check_blocks; an error releases them as well. */
+typedef struct CheckScratch {
+    Word *s, *live;
+    int *hit_at, *hits;
+} CheckScratch;
+
+static void scratch_free(void *arg) {
+    CheckScratch *k = arg;
+    free(k->s);
+    free(k->live);
+    free(k->hit_at);
+    free(k->hits);
+}
+
+/** Walks every block with the solved states, reporting violations and drop facts. */
+static void check_blocks(BorrowCheck *bc, Flow *f) {
+    CheckScratch k = { bits_new((size_t)f->wf), bits_new((size_t)f->wh), NULL, NULL };
+    Word *s = k.s, *live = k.live;
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, scratch_free, &k);
+
+    /*
+     * Loans with a live holder right after each event of the current block
+     * that checks them. The block is walked backwards, so event i of the
+     * block owns hits[hit_at[i + 1] .. hit_at[i]). Keeping these short lists
+     * instead of a live set per event keeps memory linear in the block
+     * length when there are many holders.
+     */
+    size_t hit_at_cap = 0, hits_len, hits_cap = 0;
+
+    for (int b = 0; b < bc->nblocks; b++) {
+        BcBlock *blk = &bc->blocks[b];
+        size_t n = (size_t)(blk->end - blk->first);
+
+        if (n + 1 > hit_at_cap) {
+            hit_at_cap = n + 1;
+            k.hit_at = xrealloc(k.hit_at, sizeof(int) * hit_at_cap);
+        }
+        hits_len = 0;
+        k.hit_at[n] = 0;
+        if (bc->nloans > 0) block_live_out(bc, f, b, live);
+        for (int e = blk->end - 1; e >= blk->first; e--) {
+            const BcEvent *ev = &bc->events[e];
+            if (bc->nloans > 0 && checks_loans(ev)) {
+                for (int l = bc->var[ev->var].loans; l >= 0; l = bc->loans[l].next_on_var) {
+                    if (bc->loans[l].holder < 0 ||
+                        !bits_intersect(&f->holders[(size_t)l * f->wh], live, f->wh))
+                        continue;
+                    if (hits_len == hits_cap) {
+                        hits_cap = hits_cap ? hits_cap * 2 : 64;
+                        k.hits = xrealloc(k.hits, sizeof(int) * hits_cap);
+                    }
+                    k.hits[hits_len++] = l;
+                }
+            }
+            if (bc->nloans > 0) backward_event(bc, ev, live);
+            k.hit_at[e - blk->first] = (int)hits_len;
+        }
+
+        block_in(f, b, s);
+        for (int e = blk->first; e < blk->end; e++) {
+            BcEvent *ev = &bc->events[e];
+            BcVar *v = &bc->var[ev->var];
+            int i = e - blk->first;
+            bool borrowed = checks_loans(ev) &&
+                            is_borrowed(bc, f, k.hits + k.hit_at[i + 1], k.hit_at[i] - k.hit_at[i + 1],
+                                        ev->loan, ev->kind == EV_BORROW, s);
+            bool owned = v->track < 0 || bit_test(OWNED(f, s), v->track);
+            if (checks_loans(ev))
+                break_shares(bc, f, k.hits + k.hit_at[i + 1], k.hit_at[i] - k.hit_at[i + 1], ev, s);
+
+            switch (ev->kind) {
+            case EV_USE:
+                /* Check Move Semantics */
+                if (v->track >= 0 && bit_test(MOVED(f, s), v->track))
+                    bc_error(bc, ev->line, ev->col, "%s moved value '%s'", ev->what, sym_name(v->name));
+                break;
+            case EV_MOVE:
+                if (borrowed)
+                    bc_error(bc, ev->line, ev->col, "cannot move '%s' because it is borrowed", sym_name(v->name));
+                break;
+            case EV_BORROW:
+                /* Conflict: Existing mutable borrow */
+                if (borrowed && bc->loans[ev->loan].soft)
+                    bc->loans[ev->loan].broken = true;
+                else if (borrowed)
+                    bc_error(bc, ev->line, ev->col, "cannot shared-borrow '%s' while mutably borrowed", sym_name(v->name));
+                break;
+            case EV_MUT_BORROW:
+                /* Conflict: Any existing borrow (shared or mutable) */
+                if (borrowed)
+                    bc_error(bc, ev->line, ev->col, "cannot mutably borrow '%s' (already borrowed)", sym_name(v->name));
+                break;
+            case EV_DEF:
+                if (ev->assign) {
+                    /* Overwriting a borrowed value would invalidate live references */
+                    if (borrowed)
+                        bc_error(bc, ev->line, ev->col, "cannot assign to '%s' because it is borrowed", sym_name(v->name));
+                    ev->assign->v.assign.drop_old = owned;
+                }
+                break;
+            case EV_STORE:
+                if (borrowed)
+                    bc_error(bc, ev->line, ev->col, "cannot assign to element of '%s' because it is borrowed", sym_name(v->name));
+                break;
+            case EV_SCOPE_EXIT:
+                v->decl->v.decl.drop_at_exit = owned;
+                break;
+            }
+            forward_event(bc, f, ev, s);
+        }
+    }
+
+    error_cleanup_pop(&cleanup);
+    scratch_free(&k);
 }
 
 /* ---------------------------------------------------------
    ENTRY POINT
    --------------------------------------------------------- */
 
-/**
- * @brief Public interface to trigger the borrow check analysis.
- */
-void borrow_check(Function *f, const char *filename) {
-    BCState s = {
-        .vars = NULL,
-        .depth = 0,
-        .file = filename
-    };
-
-    visit_stmt(&s, f->body);
-}
\ No newline at end of file
+/** Error cleanup for the solver state of bc_finish. */
+static void flow_free(void *arg) {
+    Flow *f = arg;
+    free(f->pred_start);
+    free(f->preds);
+    free(f->out);
+    free(f->live_in);
+    free(f->holders);
+}
+
+void bc_finish(BorrowCheck *bc) {
+    if (!bc->enabled) return;
+
+    Flow f;
+    memset(&f, 0, sizeof(f));
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, flow_free, &f);
+    number_vars(bc, &f);
+    build_preds(bc, &f);
+
+    f.out = bits_new((size_t)bc->nblocks * (size_t)f.wf);
+    f.live_in = bits_new((size_t)bc->nblocks * (size_t)f.wh);
+    if (f.wf > 0) solve_forward(bc, &f);
+    if (f.wh > 0) solve_backward(bc, &f);
+    check_blocks(bc, &f);
+
+    /* Moves out of a variable must leave it empty for its later drop */
+    for (int i = 0; i < bc->nvars; i++)
+        bc->var[i].decl->v.decl.clear_on_move = bc->var[i].track >= 0;
+
+    /* A for loop's variable is one declaration bound anew on every iteration */
+    for (int i = 0; i < bc->nvars; i++)
+        bc->var[i].decl->v.decl.alias = ALIAS_NONE;
+    for (int i = 0; i < bc->nvars; i++) {
+        const BcVar *v = &bc->var[i];
+        AliasFact *fact = &v->decl->v.decl.alias;
+        if (v->mut_borrowed) *fact = ALIAS_MUT;
+        else if (v->imm_count > 0 && *fact == ALIAS_NONE) *fact = ALIAS_SHARED;
+    }
+
+    /*
+     * An unbroken share may skip its count unless it is moved, reassigned
+     * or borrowed itself: a reference to it can be used after its own last
+     * use, and the other two would release a count it never took.
+     */
+    for (int l = 0; l < bc->nloans; l++) {
+        const BcLoan *share = &bc->loans[l];
+        if (!share->soft) continue;
+        const BcVar *h = &bc->var[share->holder];
+        bool borrowed = false;
+        for (int k = h->loans; k >= 0; k = bc->loans[k].next_on_var)
+            borrowed |= !bc->loans[k].soft;
+        h->decl->v.decl.rc_alias = !share->broken && h->track < 0 && !h->assigned && !borrowed;
+    }
+
+    error_cleanup_pop(&cleanup);
+    flow_free(&f);
+    bc_free(bc);
+}
+
+void bc_free(BorrowCheck *bc) {
+    free(bc->events);
+    free(bc->blocks);
+    free(bc->var);
+    free(bc->loans);
+    free(bc->copies);
+    bc->events = NULL;
+    bc->blocks = NULL;
+    bc->var = NULL;
+    bc->loans = NULL;
+    bc->copies = NULL;
+}
@@ -0,0 +1,304 @@
+/**
+ * @file cache.c
+ * @brief Content-addressed store of compiled units.
+ *
+ * Keys come from a two-lane multiply/rotate hash over 8-byte words,
+ * finished with the MurmurHash3 avalanche. It is not cryptographic, but
+ * 128 bits make an accidental collision between two builds negligible,
+ * and hashing runs at memory speed, so a hit costs little more than
+ * reading the file.
+ */
+/* getpid/mkdir are POSIX, hidden by -std=c99 without this */
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/cache.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* ---------------------------------------------------------
+   HASHING
+   --------------------------------------------------------- */
+
+typedef struct Hasher {
+    uint64_t a, b;
+} Hasher;
+
+#define HASHER_INIT { 0x243F6A8885A308D3ull, 0x13198A2E03707344ull }
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDull;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+static void hash_word(Hasher *h, uint64_t w) {
+    h->a = rotl64(h->a ^ (w * 0x9E3779B97F4A7C15ull), 31) * 0xC2B2AE3D27D4EB4Full;
+    h->b = rotl64(h->b ^ (w * 0x165667B19E3779F9ull), 27) * 0xD6E8FEB86659FD93ull + h->a;
+}
+
+/** Hashes `len` and then the bytes, so consecutive fields cannot run together. */
+static void hash_bytes(Hasher *h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    hash_word(h, (uint64_t)len);
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        hash_word(h, w);
+    }
+    if (len) {
+        uint64_t w = 0;
+        memcpy(&w, p, len);
+        hash_word(h, w);
+    }
+}
+
+static CacheKey hash_finish(const Hasher *h) {
+    CacheKey k;
+    k.lo = fmix64(h->a ^ rotl64(h->b, 32));
+    k.hi = fmix64(h->b ^ k.lo);
+    return k;
+}
+
+CacheKey cache_key(const char *config, const char *data, size_t size) {
+    Hasher h = HASHER_INIT;
+    hash_bytes(&h, config, strlen(config));
+    hash_bytes(&h, data, size);
+    return hash_finish(&h);
+}
+
+/** Appends the contents of `path` to `data`; false if it cannot be read. */
+static bool read_file(StrBuf *data, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    size_t n;
+    do {
+        char *dst = sb_reserve(data, 65536);
+        n = fread(dst, 1, 65536, f);
+        data->len += n;
+    } while (n > 0);
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+/** Hashes the contents of `path` as one field; false if it cannot be read. */
+static bool hash_file(Hasher *h, const char *path) {
+    StrBuf data;
+    sb_init(&data);
+    bool ok = read_file(&data, path);
+    if (ok) hash_bytes(h, data.data, data.len);
+    sb_free(&data);
+    return ok;
+}
+
+/* Computed once: the code that runs cannot change under the process, and
+   a resident compiler would otherwise rehash itself on every request */
+static Mutex id_lock = MUTEX_INIT;
+static StrBuf compiler_id;
+
+static void compute_compiler_id(StrBuf *out, const char *argv0) {
+    Hasher h = HASHER_INIT;
+    bool found = false;
+#ifdef _WIN32
+    char path[MAX_PATH];
+    DWORD n = GetModuleFileNameA(NULL, path, sizeof path);
+    if (n > 0 && n < sizeof path) found = hash_file(&h, path);
+#else
+    found = hash_file(&h, "/proc/self/exe");
+#endif
+    if (!found && argv0) found = hash_file(&h, argv0);
+
+    sb_printf(out, "mycc %s", MYCC_VERSION);
+    if (found) {
+        CacheKey k = hash_finish(&h);
+        sb_printf(out, " exe %016llx%016llx", (unsigned long long)k.hi, (unsigned long long)k.lo);
+    } else {
+        /* Cannot see our own binary: fall back to when this file was built */
+        sb_printf(out, " built %s %s", __DATE__, __TIME__);
+    }
+}
+
+void cache_compiler_id(StrBuf *out, const char *argv0) {
+    mutex_lock(&id_lock);
+    if (compiler_id.len == 0) compute_compiler_id(&compiler_id, argv0);
+    mutex_unlock(&id_lock);
+    sb_append(out, compiler_id.data, compiler_id.len);
+}
+
+/* ---------------------------------------------------------
+   MEMORY
+   --------------------------------------------------------- */
+
+#define MEMORY_BUCKETS 4096
+
+/* Never changed or freed once in the table, so it is read without the lock */
+typedef struct MemEntry {
+    CacheKey key;
+    char *ext;
+    StrBuf data;
+    struct MemEntry *next;
+} MemEntry;
+
+/* Guards the table; NULL until cache_keep_in_memory */
+static Mutex memory_lock = MUTEX_INIT;
+static MemEntry **memory;
+static size_t memory_used, memory_budget;
+
+void cache_keep_in_memory(size_t budget) {
+    mutex_lock(&memory_lock);
+    if (!memory) {
+        memory = xmalloc(sizeof(MemEntry *) * MEMORY_BUCKETS);
+        memset(memory, 0, sizeof(MemEntry *) * MEMORY_BUCKETS);
+    }
+    memory_budget = budget;
+    mutex_unlock(&memory_lock);
+}
+
+/** Entry in a non-NULL table; the caller holds memory_lock. */
+static MemEntry *memory_find(const CacheKey *key, const char *ext) {
+    for (MemEntry *e = memory[key->lo % MEMORY_BUCKETS]; e; e = e->next)
+        if (e->key.lo == key->lo && e->key.hi == key->hi && strcmp(e->ext, ext) == 0) return e;
+    return NULL;
+}
+
+static const MemEntry *memory_lookup(const CacheKey *key, const char *ext) {
+    mutex_lock(&memory_lock);
+    const MemEntry *e = memory ? memory_find(key, ext) : NULL;
+    mutex_unlock(&memory_lock);
+    return e;
+}
+
+/** Keeps a copy of `path` as the entry for `key`, if the budget allows. */
+static void memory_keep(const CacheKey *key, const char *ext, const char *path) {
+    mutex_lock(&memory_lock);
+    bool wanted = memory && memory_used < memory_budget && !memory_find(key, ext);
+    mutex_unlock(&memory_lock);
+    if (!wanted) return;
+
+    MemEntry *e = xmalloc(sizeof *e);
+    e->key = *key;
+    e->ext = xstrdup(ext);
+    sb_init(&e->data);
+    bool ok = read_file(&e->data, path);
+
+    /* Another unit may have kept the same entry meanwhile */
+    mutex_lock(&memory_lock);
+    if (ok && memory_used + e->data.len <= memory_budget && !memory_find(key, ext)) {
+        MemEntry **bucket = &memory[key->lo % MEMORY_BUCKETS];
+        e->next = *bucket;
+        *bucket = e;
+        memory_used += e->data.len;
+        e = NULL;
+    }
+    mutex_unlock(&memory_lock);
+    if (e) {
+        sb_free(&e->data);
+        free(e->ext);
+        free(e);
+    }
+}
+
+/** Writes `data` to `path`; on failure `path` may be left incomplete. */
+static bool write_file(const char *path, const StrBuf *data) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(data->data, 1, data->len, f) == data->len;
+    if (fclose(f) != 0) ok = false;
+    return ok;
+}
+
+/* ---------------------------------------------------------
+   ENTRIES
+   --------------------------------------------------------- */
+
+/** `dir`/<32 hex digits><ext>, NUL-terminated in `out`. */
+static void entry_path(StrBuf *out, const char *dir, const CacheKey *key, const char *ext) {
+    size_t dlen = strlen(dir);
+    sb_puts(out, dir);
+    if (dlen > 0 && dir[dlen - 1] != '/' && dir[dlen - 1] != '\\') sb_putc(out, '/');
+    sb_printf(out, "%016llx%016llx%s", (unsigned long long)key->hi, (unsigned long long)key->lo, ext);
+    sb_putc(out, '\0');
+}
+
+/** Copies file `from` to `to`; on failure `to` may be left incomplete. */
+static bool copy_file(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb");
+    if (!in) return false;
+    FILE *out = fopen(to, "wb");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    char buf[65536];
+    bool ok = true;
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, in)) > 0) {
+        if (fwrite(buf, 1, n, out) != n) {
+            ok = false;
+            break;
+        }
+    }
+    if (ferror(in)) ok = false;
+    fclose(in);
+    if (fclose(out) != 0) ok = false;
+    return ok;
+}
+
+bool cache_fetch(const char *dir, const CacheKey *key, const char *ext, const char *out_path) {
+    const MemEntry *kept = memory_lookup(key, ext);
+    if (kept) return write_file(out_path, &kept->data);
+
+    StrBuf path;
+    sb_init(&path);
+    entry_path(&path, dir, key, ext);
+    bool hit = copy_file(path.data, out_path);
+    sb_free(&path);
+    if (hit) memory_keep(key, ext, out_path);
+    return hit;
+}
+
+/* Distinguishes the temporary files of the units of one process */
+static Mutex store_lock = MUTEX_INIT;
+static unsigned store_serial;
+
+void cache_store(const char *dir, const CacheKey *key, const char *ext, const char *out_path) {
+#ifdef _WIN32
+    CreateDirectoryA(dir, NULL);
+    unsigned long pid = GetCurrentProcessId();
+#else
+    mkdir(dir, 0777);
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    mutex_lock(&store_lock);
+    unsigned serial = store_serial++;
+    mutex_unlock(&store_lock);
+
+    StrBuf path, tmp;
+    sb_init(&path);
+    sb_init(&tmp);
+    entry_path(&path, dir, key, ext);
+    sb_printf(&tmp, "%s.tmp%lu-%u", path.data, pid, serial);
+    sb_putc(&tmp, '\0');
+
+    /* rename fails on Windows if another compiler stored the entry first */
+    if (!copy_file(out_path, tmp.data) || rename(tmp.data, path.data) != 0)
+        remove(tmp.data);
+
+    sb_free(&path);
+    sb_free(&tmp);
+    memory_keep(key, ext, out_path);
+}
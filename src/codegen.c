@@ -1,305 +1,1574 @@
 /**
  * @file codegen.c
  * @brief x86_64 NASM backend supporting System V (Linux) and MS ABI (Windows).
- * * This generator implements a stack-based virtual machine approach where 
- * expression results are pushed onto the hardware stack and popped into 
- * registers for operations or function calls.
+ * * The backend consumes the linear IR built by ir.c. How IR temporaries are
+ * materialized depends on the optimization level:
+ *  - -O0: a stack-based virtual machine. Every temporary is pushed onto the
+ *    hardware stack and popped into registers for operations or calls
+ *    (unoptimized IR uses each temporary once, in LIFO order).
+ *  - -O1: temporaries are assigned caller-saved registers of the target ABI
+ *    by a linear-scan allocator over their live intervals, and only spill to
+ *    frame slots when the register pool runs out. Scalar variables that no
+ *    reference can write (for-loop counters and bounds among them) get
+ *    callee-saved registers the same way, so they survive the runtime calls
+ *    in loop bodies; a comparison that only feeds the branch after it
+ *    becomes a single cmp/jcc.
+ *
+ * Arrays live in the frame, element k at the slot's offset + 8k. Whole
+ * arrays are copied and cleared 16 bytes at a time through xmm0, and a
+ * failed bounds check jumps to a stub after the epilogue that reports
+ * the index and exits.
+ *
+ * A par chunk is emitted as a function of its own (par_chunk<block>) where
+ * its blocks are laid out. The runtime's thread pool calls it as
+ * chunk(lo, hi, frame). It gets a frame the size of main's, with the same
+ * offsets: its own slots live there, and main's are reached through
+ * `frame` (main's RBP), which the chunk keeps in r15. Functions with par
+ * loops therefore leave r15 out of the slot registers.
+ *
+ * With --instrument, main hands a table of counters (profile_counters,
+ * in .data) to the runtime on entry and tells it to write them out before
+ * returning. Each block and each runtime call site adds one to its counter
+ * through rax, which is never live at those points.
+ *
+ * With --intrinsics, print(int) calls a routine emitted into the object
+ * itself (.Lprint_int) that formats the number and appends it to the
+ * runtime's output buffer directly. It preserves every register but rax
+ * and rdx, so call sites need no saves, padding or shadow space.
+ *
+ * Instructions are appended to the AsmBuf as structured lines (asm_insn);
+ * operands are assembled with fmt_long/asm_fmt_mem rather than printf.
  */
 
 #include "../include/codegen.h"
-#include "../include/ast.h"
+#include "../include/ir.h"
+#include "../include/asm.h"
+#include "../include/peephole.h"
+#include "../include/objfile.h"
+#include "../include/x86enc.h"
+#include "../include/stats.h"
+#include "../include/profile.h"
+#include "../include/runtime.h"
 #include "../include/common.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
-/** Tracks string literals to be emitted in the .data section. */
-typedef struct Literal {
-    char *s;
-    int id;
-    struct Literal *next;
-} Literal;
+/* ---------------------------------------------------------
+   TARGET REGISTER CONVENTIONS
+   The temporary pool only holds caller-saved registers that are not
+   needed for argument passing or by idiv (rax/rdx), so operations
+   never have to shuffle temporaries out of the way.
+   --------------------------------------------------------- */
 
-/** Tracks local variable offsets relative to the Base Pointer (RBP). */
-typedef struct VSlot {
-    char name[MAX_IDENT];
-    int offset;
-    Type type;
-    struct VSlot *next;
-} VSlot;
+#ifdef _WIN32
+static const char *const temp_regs[] = { "r8", "r9", "r10", "r11" };
+#define ARG0 "rcx"
+#define ARG1 "rdx"
+#define ARG2 "r8"
+#define ARG3 "r9"
+#define RODATA_SECTION ".rdata"
+#else
+static const char *const temp_regs[] = { "rcx", "rsi", "r8", "r9", "r10", "r11" };
+#define ARG0 "rdi"
+#define ARG1 "rsi"
+#define ARG2 "rdx"
+#define ARG3 "rcx"
+#define RODATA_SECTION ".rodata"
+#endif
+
+#define NUM_TEMP_REGS ((int)(sizeof(temp_regs) / sizeof(temp_regs[0])))
+
+/* Callee-saved registers for slots; the prologue preserves those used */
+#ifdef _WIN32
+static const char *const saved_regs[] = { "rbx", "rsi", "rdi", "r12", "r13", "r14", "r15" };
+#else
+static const char *const saved_regs[] = { "rbx", "r12", "r13", "r14", "r15" };
+#endif
+
+#define NUM_SAVED_REGS ((int)(sizeof(saved_regs) / sizeof(saved_regs[0])))
+
+/* Main's frame inside par chunks; the last of saved_regs */
+#define PARENT_FRAME "r15"
+
+/* The first argument register doubles as a scratch operand register,
+   since it is only live between argument setup and the call itself. */
+#define SCRATCH ARG0
+
+/** Where an IR temporary lives at -O1. */
+typedef struct TempLoc {
+    int start, end;     /* Live interval in linear instruction positions */
+    int nuses;
+    int reg;            /* Index into temp_regs, or -1 */
+    int offset;         /* RBP-relative spill slot when reg < 0 */
+    bool is_const;      /* -O1: defined by IR_CONST; rematerialized at each use */
+    long imm;
+    int saved;          /* -O1: load of a register slot, read straight from
+                           saved_regs[saved]; or -1 */
+} TempLoc;
+
+/** A loop in layout order: a back edge from `latch` to `head` (positions). */
+typedef struct LoopSpan {
+    int head, latch;
+} LoopSpan;
+
+/** Shared target of the failing bounds checks on one register and length. */
+typedef struct BoundsStub {
+    const char *reg;    /* Register holding the index */
+    long len;
+} BoundsStub;
 
 /** Code Generator State Context. */
 typedef struct CG {
-    FILE *out;
-    int stack_size;
-    VSlot *slots;
-    int label_counter;
-    bool debug_borrow;
-    Literal *lits;
-    int lit_count;
+    AsmBuf text;        /* Emitted lines, written out once the function is done */
+    IrFunc *fn;
+    const CodegenOptions *opts;
+    int opt_level;      /* 0 = pure stack machine, 1 = register temporaries */
+
+    int frame_size;     /* Bytes reserved below RBP by the prologue */
+    int *slot_offset;   /* RBP-relative offset of every IR slot */
+    int *slot_reg;      /* -O1: index into saved_regs holding the slot, or -1 */
+    int save_offset[NUM_SAVED_REGS];   /* Frame slot saving each used one, or 0 */
+    bool has_par;       /* The function has par chunks */
+    bool in_chunk;      /* Emitting a block of one */
+    int parent_save;    /* Frame slot where chunks save the caller's PARENT_FRAME */
+    TempLoc *temps;
+    LoopSpan *loops;    /* By head; the outermost latch of each head */
+    int nloops;
+
+    /* -O1: temporaries of each register in interval order, and the first
+       one whose interval has not ended yet at the current position */
+    int *reg_temps[NUM_TEMP_REGS];
+    int nreg_temps[NUM_TEMP_REGS], reg_cursor[NUM_TEMP_REGS];
+
+    int *vstack;        /* -O0: temporaries currently on the hardware stack */
+    int depth;
+
+    BoundsStub *stubs;  /* .Lbounds<i>, emitted after the epilogue */
+    int nstubs, stubs_cap;
+    int ncopy_loops;    /* .Lcopy<i> labels used so far */
+    bool print_routine; /* --intrinsics: .Lprint_int is called */
+    int ncall_sites;    /* --instrument: call site counters used so far */
+
+    char imm_buf[32];   /* Formatted immediate operand (imm_operand) */
+    FILE *out;          /* Output file while it is open, or NULL */
 } CG;
 
+/** Shorthand for appending one instruction. */
+static void emit(CG *g, const char *mnemonic, const char *a, const char *b) {
+    asm_insn(&g->text, mnemonic, a, b);
+}
+
+/** "[rbp-N]" (optionally size-prefixed) for a frame offset. */
+static const char *frame_operand(char *out, const char *size, int offset) {
+    asm_fmt_mem(out, size, "rbp", offset);
+    return out;
+}
+
+/** Base register of `slot`: in a chunk, main's slots are in main's frame. */
+static const char *slot_base(const CG *g, int slot) {
+    return g->in_chunk && !g->fn->slots[slot].par_local ? PARENT_FRAME : "rbp";
+}
+
+/** Memory operand of the frame-resident `slot`. */
+static const char *slot_operand(CG *g, char *out, const char *size, int slot) {
+    asm_fmt_mem(out, size, slot_base(g, slot), g->slot_offset[slot]);
+    return out;
+}
+
 /* ---------------------------------------------------------
-   SYMBOL & LITERAL MANAGEMENT
+   FRAME LAYOUT & REGISTER ALLOCATION
    --------------------------------------------------------- */
 
-static VSlot *cg_find(CG *g, const char *name) {
-    for (VSlot *v = g->slots; v; v = v->next)
-        if (strcmp(v->name, name) == 0)
-            return v;
-    return NULL;
+/* Keeps frame offsets well inside the disp32 range */
+#define MAX_FRAME_SIZE (1 << 30)
+
+/* Windows commits the stack one guard page at a time */
+#define STACK_PAGE 4096
+
+/** Collects the back edges of the layout as loops, sorted by head. */
+static void find_loops(CG *g) {
+    IrFunc *fn = g->fn;
+    int *block_start = xmalloc(sizeof(int) * (size_t)fn->nblocks);
+    int *latch = xmalloc(sizeof(int) * (size_t)fn->nblocks);
+
+    int pos = 0;
+    for (int i = 0; i < fn->nblocks; i++) {
+        block_start[i] = pos;
+        latch[i] = -1;
+        pos += fn->blocks[i]->n;
+
+        IrInstr *term = &fn->blocks[i]->code[fn->blocks[i]->n - 1];
+        int targets[2] = { term->target, term->alt };
+        for (int k = 0; k < 2; k++) {
+            if (targets[k] >= 0 && targets[k] <= i && latch[targets[k]] < pos - 1)
+                latch[targets[k]] = pos - 1;
+        }
+    }
+
+    g->loops = xmalloc(sizeof(LoopSpan) * (size_t)fn->nblocks);
+    g->nloops = 0;
+    for (int i = 0; i < fn->nblocks; i++) {
+        if (latch[i] < 0) continue;
+        g->loops[g->nloops].head = block_start[i];
+        g->loops[g->nloops++].latch = latch[i];
+    }
+    free(block_start);
+    free(latch);
 }
 
-/** Allocates a new slot on the stack for a local variable. */
-static void cg_add(CG *g, const char *name, Type t) {
-    VSlot *v = xmalloc(sizeof(VSlot));
-    snprintf(v->name, sizeof(v->name), "%s", name);
+/**
+ * @brief Stretches the range start..*end over every loop it is live into.
+ * A value defined before a loop header and used inside the loop must
+ * survive to the latch; heads are sorted, so one scan from the first head
+ * after `start` also catches loops the range grows into.
+ */
+static void extend_over_loops(const CG *g, int start, int *end) {
+    int lo = 0, hi = g->nloops;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g->loops[mid].head <= start) lo = mid + 1;
+        else hi = mid;
+    }
+    for (int k = lo; k < g->nloops && g->loops[k].head <= *end; k++) {
+        if (g->loops[k].latch > *end) *end = g->loops[k].latch;
+    }
+}
+
+/** Computes live intervals and use counts for every temporary. */
+static void compute_intervals(CG *g) {
+    IrFunc *fn = g->fn;
+
+    for (int t = 0; t < fn->ntemps; t++) {
+        g->temps[t].start = g->temps[t].end = -1;
+        g->temps[t].nuses = 0;
+        g->temps[t].reg = -1;
+        g->temps[t].offset = 0;
+        g->temps[t].is_const = false;
+        g->temps[t].saved = -1;
+    }
 
-    /* x86_64 uses 8-byte alignment for standard types in this compiler */
-    g->stack_size += 8;
-    v->offset = -g->stack_size;
-    v->type = t;
-    v->next = g->slots;
-    g->slots = v;
+    int pos = 0;
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++, pos++) {
+            IrInstr *in = &blk->code[j];
+            int uses[2] = { in->a, in->b };
+            for (int k = 0; k < 2; k++) {
+                if (uses[k] < 0) continue;
+                g->temps[uses[k]].end = pos;
+                g->temps[uses[k]].nuses++;
+            }
+            if (in->dst >= 0) {
+                g->temps[in->dst].start = pos;
+                if (g->temps[in->dst].end < pos) g->temps[in->dst].end = pos;
+                if (in->op == IR_CONST && g->opt_level >= 1) {
+                    g->temps[in->dst].is_const = true;
+                    g->temps[in->dst].imm = in->imm;
+                }
+            }
+        }
+    }
+
+    for (int t = 0; t < fn->ntemps; t++) {
+        if (g->temps[t].start >= 0) extend_over_loops(g, g->temps[t].start, &g->temps[t].end);
+    }
 }
 
-static int cg_new_label(CG *g) {
-    return ++g->label_counter;
+/** Allocates `words` 64-bit frame words and returns the RBP-relative offset of the first. */
+static int frame_alloc(CG *g, long words) {
+    if (words > (MAX_FRAME_SIZE - g->frame_size) / 8)
+        errorf("codegen: stack frame larger than %d bytes\n", MAX_FRAME_SIZE);
+    g->frame_size += (int)(8 * words);
+    return -g->frame_size;
 }
 
-static int cg_register_literal(CG *g, const char *s) {
-    Literal *L = xmalloc(sizeof(Literal));
-    L->s = strdup(s);
-    L->id = ++g->lit_count;
-    L->next = g->lits;
-    g->lits = L;
-    return L->id;
+/**
+ * @brief Linear-scan register allocation over temporary live intervals.
+ * Temporaries are visited in order of definition. Registers whose intervals
+ * end at (or before) a definition are free for it, the emitter handles an
+ * operand sharing its register with the result. When the pool is exhausted,
+ * the interval that ends last is spilled to a frame slot.
+ */
+static void allocate_registers(CG *g) {
+    IrFunc *fn = g->fn;
+    int active[NUM_TEMP_REGS];      /* Temporary occupying each register, or -1 */
+    for (int r = 0; r < NUM_TEMP_REGS; r++) active[r] = -1;
+
+    /* Temporaries are numbered in definition order, which is interval start order */
+    for (int t = 0; t < fn->ntemps; t++) {
+        TempLoc *cur = &g->temps[t];
+        if (cur->start < 0 || cur->nuses == 0 || cur->is_const || cur->saved >= 0) continue;
+
+        int free_reg = -1;
+        for (int r = 0; r < NUM_TEMP_REGS; r++) {
+            if (active[r] >= 0 && g->temps[active[r]].end <= cur->start)
+                active[r] = -1;
+            if (active[r] < 0 && free_reg < 0)
+                free_reg = r;
+        }
+
+        if (free_reg >= 0) {
+            cur->reg = free_reg;
+            active[free_reg] = t;
+            continue;
+        }
+
+        /* Spill whichever of the active intervals or the current one ends last */
+        int victim = -1;
+        for (int r = 0; r < NUM_TEMP_REGS; r++) {
+            if (victim < 0 || g->temps[active[r]].end > g->temps[active[victim]].end)
+                victim = r;
+        }
+        if (g->temps[active[victim]].end > cur->end) {
+            TempLoc *spilled = &g->temps[active[victim]];
+            cur->reg = victim;
+            spilled->reg = -1;
+            spilled->offset = frame_alloc(g, 1);
+            active[victim] = t;
+        } else {
+            cur->offset = frame_alloc(g, 1);
+        }
+    }
+}
+
+typedef struct SlotRange {
+    int slot;
+    int first, last;    /* Linear positions of the first and last access */
+} SlotRange;
+
+static int by_first(const void *a, const void *b) {
+    const SlotRange *x = a, *y = b;
+    return x->first != y->first ? (x->first < y->first ? -1 : 1) : x->slot - y->slot;
+}
+
+static int by_last(const void *a, const void *b) {
+    const SlotRange *x = a, *y = b;
+    return x->last != y->last ? (x->last < y->last ? -1 : 1) : x->slot - y->slot;
+}
+
+/**
+ * @brief Keeps scalar slots in callee-saved registers (-O1).
+ * Candidates only change at their own stores: no reference can write them
+ * (their address is never taken, or the alias facts rule it out), and no
+ * par chunk reads them from main's frame. A slot is live from its first to
+ * its last access, stretched over the loops it is live into and over the
+ * temporaries loaded from it. Ranges are scanned in order of first access;
+ * when the registers run out, the range that ends last goes back to the
+ * frame.
+ */
+static void allocate_slot_registers(CG *g) {
+    IrFunc *fn = g->fn;
+    int ns = fn->nslots;
+    SlotRange *ranges = xmalloc(sizeof(SlotRange) * (size_t)(ns ? ns : 1));
+    bool *eligible = xmalloc(sizeof(bool) * (size_t)(ns ? ns : 1));
+    for (int i = 0; i < ns; i++) {
+        ranges[i].slot = i;
+        ranges[i].first = ranges[i].last = -1;
+        eligible[i] = fn->slots[i].type.kind != TY_ARRAY;
+        g->slot_reg[i] = -1;
+    }
+
+    int pos = 0;
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++, pos++) {
+            IrInstr *in = &blk->code[j];
+            int s = in->slot;
+            if (s < 0) continue;
+            if (blk->par && !fn->slots[s].par_local) eligible[s] = false;
+            if (in->op == IR_ADDR && !ir_slot_unaliased(&fn->slots[s])) eligible[s] = false;
+
+            SlotRange *r = &ranges[s];
+            if (r->first < 0) r->first = pos;
+            if (r->last < pos) r->last = pos;
+            if (in->op == IR_LOAD && r->last < g->temps[in->dst].end) r->last = g->temps[in->dst].end;
+        }
+    }
+
+    int n = 0;
+    for (int s = 0; s < ns; s++) {
+        if (!eligible[s] || ranges[s].first < 0) continue;
+        extend_over_loops(g, ranges[s].first, &ranges[s].last);
+        ranges[n++] = ranges[s];
+    }
+    qsort(ranges, (size_t)n, sizeof(SlotRange), by_first);
+
+    /* PARENT_FRAME is reserved in functions with par chunks */
+    int nregs = g->has_par ? NUM_SAVED_REGS - 1 : NUM_SAVED_REGS;
+    int active[NUM_SAVED_REGS];     /* Range occupying each register, or -1 */
+    for (int r = 0; r < nregs; r++) active[r] = -1;
+
+    for (int k = 0; k < n; k++) {
+        const SlotRange *cur = &ranges[k];
+        int free_reg = -1;
+        for (int r = 0; r < nregs; r++) {
+            if (active[r] >= 0 && ranges[active[r]].last < cur->first)
+                active[r] = -1;
+            if (active[r] < 0 && free_reg < 0)
+                free_reg = r;
+        }
+        if (free_reg < 0) {
+            int victim = 0;
+            for (int r = 1; r < nregs; r++) {
+                if (ranges[active[r]].last > ranges[active[victim]].last)
+                    victim = r;
+            }
+            if (ranges[active[victim]].last <= cur->last) continue;
+            g->slot_reg[ranges[active[victim]].slot] = -1;
+            free_reg = victim;
+        }
+        g->slot_reg[cur->slot] = free_reg;
+        active[free_reg] = k;
+    }
+
+    for (int s = 0; s < ns; s++) {
+        int r = g->slot_reg[s];
+        if (r >= 0 && g->save_offset[r] == 0)
+            g->save_offset[r] = frame_alloc(g, 1);
+    }
+    free(ranges);
+    free(eligible);
+}
+
+/**
+ * @brief Lets loads of register slots read the register itself.
+ * Allowed when the slot is not stored again while the loaded temporary is
+ * live, so the register still holds the loaded value; the slot's range
+ * covers the temporary, so no other slot takes the register meanwhile.
+ */
+static void alias_slot_loads(CG *g) {
+    IrFunc *fn = g->fn;
+    long total = ir_count_instrs(fn);
+    IrInstr **at = xmalloc(sizeof(IrInstr *) * (size_t)(total ? total : 1));
+    int pos = 0;
+    for (int i = 0; i < fn->nblocks; i++)
+        for (int j = 0; j < fn->blocks[i]->n; j++) at[pos++] = &fn->blocks[i]->code[j];
+
+    for (int p = 0; p < pos; p++) {
+        IrInstr *in = at[p];
+        if (in->op != IR_LOAD || g->slot_reg[in->slot] < 0) continue;
+
+        TempLoc *l = &g->temps[in->dst];
+        bool ok = true;
+        for (int k = p + 1; ok && k < l->end; k++) {
+            if (at[k]->op == IR_STORE && at[k]->slot == in->slot)
+                ok = false;
+        }
+        if (ok) l->saved = g->slot_reg[in->slot];
+    }
+    free(at);
+}
+
+/**
+ * @brief Lists the temporaries of each register in interval order, for
+ * emit_call to find the ones live across a call without a full scan.
+ * Intervals sharing a register do not overlap, and temporaries are
+ * numbered in start order.
+ */
+static void index_register_temps(CG *g) {
+    for (int r = 0; r < NUM_TEMP_REGS; r++) {
+        g->reg_temps[r] = NULL;
+        g->nreg_temps[r] = g->reg_cursor[r] = 0;
+    }
+    int cap[NUM_TEMP_REGS] = { 0 };
+    for (int t = 0; t < g->fn->ntemps; t++) {
+        int r = g->temps[t].reg;
+        if (r < 0 || g->temps[t].nuses == 0) continue;
+        if (g->nreg_temps[r] == cap[r]) {
+            cap[r] = cap[r] ? cap[r] * 2 : 64;
+            g->reg_temps[r] = xrealloc(g->reg_temps[r], sizeof(int) * (size_t)cap[r]);
+        }
+        g->reg_temps[r][g->nreg_temps[r]++] = t;
+    }
+}
+
+/** A frame slot waiting in the free lists of assign_slot_offsets. */
+typedef struct FreeSlot {
+    long words;
+    int offset;
+} FreeSlot;
+
+/**
+ * @brief Gives each frame-resident slot an offset, sharing space between
+ * slots whose accesses do not overlap.
+ * Every slot is written before it is read on all paths, so the range
+ * from its first to its last access (stretched over the loops it is
+ * live into) covers its value. A slot whose address is kept, by a
+ * borrow rather than a copy, stays reserved to the end of the function.
+ * Slots are placed in order of first access; one whose range has ended
+ * hands its space to the next slot of the same size.
+ */
+static void assign_slot_offsets(CG *g) {
+    IrFunc *fn = g->fn;
+    int ns = fn->nslots, nt = fn->ntemps ? fn->ntemps : 1;
+    SlotRange *ranges = xmalloc(sizeof(SlotRange) * (size_t)(ns ? ns : 1));
+    bool *copied = xmalloc(sizeof(bool) * (size_t)nt);
+    memset(copied, 0, sizeof(bool) * (size_t)nt);
+    for (int i = 0; i < ns; i++) {
+        ranges[i].slot = i;
+        ranges[i].first = ranges[i].last = -1;
+        g->slot_offset[i] = 0;
+    }
+
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++) {
+            if (blk->code[j].op == IR_COPY) copied[blk->code[j].a] = true;
+        }
+    }
+
+    int pos = 0;
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++, pos++) {
+            IrInstr *in = &blk->code[j];
+            if (in->slot < 0) continue;
+            SlotRange *r = &ranges[in->slot];
+            if (g->slot_reg[in->slot] >= 0) {
+                /* A register slot only has a home for the references taken to it */
+                if (in->op != IR_ADDR) continue;
+                if (r->first < 0) r->first = pos;
+                r->last = INT_MAX;
+                continue;
+            }
+            if (r->first < 0) r->first = pos;
+            if (r->last != INT_MAX) r->last = pos;
+            if (in->op == IR_ADDR && !copied[in->dst]) r->last = INT_MAX;
+        }
+    }
+    free(copied);
+
+    int n = 0;
+    for (int i = 0; i < ns; i++) {
+        if (ranges[i].first < 0) continue;
+        if (ranges[i].last != INT_MAX) extend_over_loops(g, ranges[i].first, &ranges[i].last);
+        ranges[n++] = ranges[i];
+    }
+    SlotRange *ends = xmalloc(sizeof(SlotRange) * (size_t)(n ? n : 1));
+    memcpy(ends, ranges, sizeof(SlotRange) * (size_t)n);
+    qsort(ranges, (size_t)n, sizeof(SlotRange), by_first);
+    qsort(ends, (size_t)n, sizeof(SlotRange), by_last);
+
+    FreeSlot *free_slots = NULL;
+    int nfree = 0, free_cap = 0;
+    for (int k = 0, e = 0; k < n; k++) {
+        const SlotRange *r = &ranges[k];
+        for (; e < n && ends[e].last < r->first; e++) {
+            if (nfree == free_cap) {
+                free_cap = free_cap ? free_cap * 2 : 16;
+                free_slots = xrealloc(free_slots, sizeof(FreeSlot) * (size_t)free_cap);
+            }
+            free_slots[nfree].words = ir_slot_words(&fn->slots[ends[e].slot]);
+            free_slots[nfree++].offset = g->slot_offset[ends[e].slot];
+        }
+
+        /* Most recently freed first */
+        long words = ir_slot_words(&fn->slots[r->slot]);
+        int f = nfree - 1;
+        while (f >= 0 && free_slots[f].words != words) f--;
+        if (f >= 0) {
+            g->slot_offset[r->slot] = free_slots[f].offset;
+            free_slots[f] = free_slots[--nfree];
+        } else {
+            g->slot_offset[r->slot] = frame_alloc(g, words);
+        }
+    }
+    free(free_slots);
+    free(ranges);
+    free(ends);
+}
+
+/** Assigns every IR slot a frame offset and, at -O1, allocates temporaries. */
+static void layout_frame(CG *g) {
+    IrFunc *fn = g->fn;
+
+    g->slot_offset = xmalloc(sizeof(int) * (size_t)(fn->nslots ? fn->nslots : 1));
+    g->slot_reg = xmalloc(sizeof(int) * (size_t)(fn->nslots ? fn->nslots : 1));
+    for (int i = 0; i < fn->nslots; i++)
+        g->slot_reg[i] = -1;
+    for (int i = 0; i < fn->nblocks; i++)
+        if (fn->blocks[i]->par) g->has_par = true;
+    find_loops(g);
+    g->temps = xmalloc(sizeof(TempLoc) * (size_t)(fn->ntemps ? fn->ntemps : 1));
+    compute_intervals(g);
+
+    if (g->opt_level >= 1) allocate_slot_registers(g);
+    if (g->has_par) g->parent_save = frame_alloc(g, 1);
+    assign_slot_offsets(g);
+
+    if (g->opt_level >= 1) {
+        alias_slot_loads(g);
+        allocate_registers(g);
+        index_register_temps(g);
+    } else {
+        g->vstack = xmalloc(sizeof(int) * (size_t)(fn->ntemps ? fn->ntemps : 1));
+        g->depth = 0;
+    }
+
+    /* Keep RSP 16-byte aligned after the prologue */
+    g->frame_size = (g->frame_size + 15) & ~15;
 }
 
 /* ---------------------------------------------------------
    ABI-SPECIFIC EMISSION HELPERS
    --------------------------------------------------------- */
 
-/** Emits the function prologue and establishes the stack frame. */
+/**
+ * @brief Establishes the stack frame and saves the callee-saved registers
+ * in use. `probe` labels the page probe loop of large Windows frames.
+ */
+static void emit_frame(CG *g, const char *probe) {
+    emit(g, "push", "rbp", NULL);
+    emit(g, "mov", "rbp", "rsp");
+    char size[24];
+    int rest = g->frame_size;
+#ifdef _WIN32
+    /* A frame larger than a page must touch every page, top down */
+    if (rest > STACK_PAGE) {
+        fmt_long(size, rest / STACK_PAGE);
+        emit(g, "mov", "rax", size);
+        asm_label(&g->text, probe);
+        fmt_long(size, STACK_PAGE);
+        emit(g, "sub", "rsp", size);
+        emit(g, "mov", "qword [rsp]", "0");
+        emit(g, "sub", "rax", "1");
+        emit(g, "jne", probe, NULL);
+        rest %= STACK_PAGE;
+    }
+#else
+    (void)probe;
+#endif
+    if (rest > 0) {
+        fmt_long(size, rest);
+        emit(g, "sub", "rsp", size);
+    }
+
+    char mem[ASM_OP_LEN];
+    for (int r = 0; r < NUM_SAVED_REGS; r++) {
+        if (g->save_offset[r])
+            emit(g, "mov", frame_operand(mem, NULL, g->save_offset[r]), saved_regs[r]);
+    }
+}
+
+/** Restores the registers emit_frame saved and returns to the caller. */
+static void emit_frame_exit(CG *g) {
+    char mem[ASM_OP_LEN];
+    for (int r = 0; r < NUM_SAVED_REGS; r++) {
+        if (g->save_offset[r])
+            emit(g, "mov", saved_regs[r], frame_operand(mem, NULL, g->save_offset[r]));
+    }
+    emit(g, "mov", "rsp", "rbp");
+    emit(g, "pop", "rbp", NULL);
+    emit(g, "ret", NULL, NULL);
+}
+
+/** Emits the declarations and main's prologue. */
 static void emit_prologue(CG *g) {
-    fprintf(g->out,
-        "global main\n"
-        "extern runtime_new_string\n"
-        "extern runtime_print_int\n"
-        "extern runtime_print_string\n"
-        "extern runtime_clone_string\n\n"
-        "section .text\n"
-        "main:\n"
-        "    push rbp\n"
-        "    mov rbp, rsp\n"
-    );
-}
-
-/** Restores the stack frame and returns. */
-static void emit_epilogue(CG *g) {
-    fprintf(g->out,
-        "    mov eax, 0\n"
-        "    mov rsp, rbp\n"
-        "    pop rbp\n"
-        "    ret\n"
-    );
+    asm_printf(&g->text, "global main\n");
+    for (int i = 0; i < RT_COUNT; i++)
+        asm_printf(&g->text, "extern %s\n", ir_runtime_names[i]);
+    if (g->opts->intrinsics)
+        asm_printf(&g->text, "extern runtime_out_buf\nextern runtime_out_len\n");
+
+    asm_printf(&g->text, "\nsection .text\n");
+    asm_label(&g->text, "main");
+    emit_frame(g, ".Lprobe");
 }
 
-static void cg_emit_expr(CG *g, Expr *e);
+/* ---------------------------------------------------------
+   TEMPORARY ACCESS
+   --------------------------------------------------------- */
+
+/** True if the temporary's value is never read. */
+static bool is_dead(CG *g, int t) {
+    return g->temps[t].nuses == 0;
+}
 
 /**
- * @brief Handles string object creation.
- * Windows requires 32-byte "Shadow Space" (SPO) above the return address.
+ * @brief Returns a register holding temporary `t`.
+ * At -O0 the temporary is popped into `scratch`; at -O1 its own register is
+ * returned, or `scratch` after reloading a spilled value.
  */
-static void cg_emit_string_literal(CG *g, int litid) {
-#ifdef _WIN32
-    fprintf(g->out,
-        "    ; Windows x64 ABI: RCX for 1st arg + Shadow Space\n"
-        "    lea rcx, [rel literal_%d]\n"
-        "    sub rsp, 32\n"
-        "    call runtime_new_string\n"
-        "    add rsp, 32\n"
-        "    push rax\n", litid, litid);
-#else
-    fprintf(g->out,
-        "    ; System V ABI: RDI for 1st arg\n"
-        "    lea rdi, [rel literal_%d]\n"
-        "    call runtime_new_string\n"
-        "    push rax\n", litid, litid);
-#endif
+static const char *use_temp(CG *g, int t, const char *scratch) {
+    if (g->opt_level == 0) {
+        assert(g->depth > 0 && g->vstack[g->depth - 1] == t);
+        g->depth--;
+        emit(g, "pop", scratch, NULL);
+        return scratch;
+    }
+
+    /* Formatted locally: imm_buf may already hold the other operand */
+    char op[ASM_OP_LEN];
+    TempLoc *l = &g->temps[t];
+    if (l->is_const) {
+        fmt_long(op, l->imm);
+        emit(g, "mov", scratch, op);
+        return scratch;
+    }
+    if (l->saved >= 0) return saved_regs[l->saved];
+    if (l->reg >= 0) return temp_regs[l->reg];
+    emit(g, "mov", scratch, frame_operand(op, NULL, l->offset));
+    return scratch;
+}
+
+/**
+ * @brief Returns temporary `t` as an immediate operand, or NULL.
+ * Only constants that fit the sign-extended imm32 encoding qualify.
+ */
+static const char *imm_operand(CG *g, int t) {
+    TempLoc *l = &g->temps[t];
+    if (g->opt_level == 0 || !l->is_const) return NULL;
+    if (l->imm < -2147483647L - 1 || l->imm > 2147483647L) return NULL;
+    fmt_long(g->imm_buf, l->imm);
+    return g->imm_buf;
+}
+
+/** Preferred register to compute temporary `t` into: its own, or rax. */
+static const char *def_reg(CG *g, int t) {
+    if (g->opt_level >= 1 && g->temps[t].reg >= 0)
+        return temp_regs[g->temps[t].reg];
+    return "rax";
+}
+
+/** Stores a freshly computed value held in `reg` into temporary `t`. */
+static void def_temp(CG *g, int t, const char *reg) {
+    if (is_dead(g, t)) return;
+
+    if (g->opt_level == 0) {
+        g->vstack[g->depth++] = t;
+        emit(g, "push", reg, NULL);
+        return;
+    }
+
+    char mem[ASM_OP_LEN];
+    TempLoc *l = &g->temps[t];
+    if (l->reg < 0)
+        emit(g, "mov", frame_operand(mem, NULL, l->offset), reg);
+    else if (strcmp(temp_regs[l->reg], reg) != 0)
+        emit(g, "mov", temp_regs[l->reg], reg);
 }
 
-/** Dispatches the appropriate runtime print function based on expression type. */
-static void emit_print_call_for_expr(CG *g, Expr *arg) {
-    fprintf(g->out, "    pop rax\n");
+/**
+ * @brief Calls a runtime function with its argument already in ARG0.
+ * Register temporaries live across the call are caller-saved, so they
+ * are preserved around it. RSP is 16-byte aligned after the prologue;
+ * an odd number of words pushed since (saved registers, or the -O0
+ * expression stack) is padded to keep it aligned at the call. Windows
+ * additionally requires 32 bytes of shadow space.
+ * Calls are emitted in position order, which lets each register's
+ * cursor into reg_temps only move forward.
+ */
+static void emit_call(CG *g, const char *fn, int pos) {
+    int saved[NUM_TEMP_REGS];
+    int nsaved = 0;
 
+    if (g->opt_level >= 1) {
+        for (int r = 0; r < NUM_TEMP_REGS; r++) {
+            int *c = &g->reg_cursor[r];
+            while (*c < g->nreg_temps[r] && g->temps[g->reg_temps[r][*c]].end <= pos) (*c)++;
+            if (*c < g->nreg_temps[r] && g->temps[g->reg_temps[r][*c]].start < pos)
+                saved[nsaved++] = r;
+        }
+    }
+
+    for (int i = 0; i < nsaved; i++)
+        emit(g, "push", temp_regs[saved[i]], NULL);
+
+    int pad = (g->depth + nsaved) % 2 ? 8 : 0;
 #ifdef _WIN32
-    fprintf(g->out, "    mov rcx, rax\n    sub rsp, 32\n");
-    if (arg && arg->type.kind == TY_STRING)
-        fprintf(g->out, "    call runtime_print_string\n");
-    else
-        fprintf(g->out, "    call runtime_print_int\n");
-    fprintf(g->out, "    add rsp, 32\n");
-#else
-    fprintf(g->out, "    mov rdi, rax\n");
-    if (arg && arg->type.kind == TY_STRING)
-        fprintf(g->out, "    call runtime_print_string\n");
-    else
-        fprintf(g->out, "    call runtime_print_int\n");
+    pad += 32;
 #endif
-    fprintf(g->out, "    push 0\n"); /* Dummy return for statement-expressions */
+    char size[24];
+    fmt_long(size, pad);
+    if (pad) emit(g, "sub", "rsp", size);
+    emit(g, "call", fn, NULL);
+    if (pad) emit(g, "add", "rsp", size);
+
+    for (int i = nsaved - 1; i >= 0; i--)
+        emit(g, "pop", temp_regs[saved[i]], NULL);
+}
+
+/**
+ * @brief Flushes buffered program output, restores the stack frame and returns.
+ * The runtime buffers stdout, so main must flush before handing back to libc.
+ */
+static void emit_epilogue(CG *g, int pos) {
+    emit_call(g, ir_runtime_names[RT_FLUSH], pos);
+    if (g->opts->instrument) emit_call(g, ir_runtime_names[RT_PROFILE_END], pos);
+    emit(g, "mov", "eax", "0");
+    emit_frame_exit(g);
+}
+
+/**
+ * @brief Applies a binary operator in place: dst = dst op src.
+ * Neither operand may be rdx, and src may not be rax: idiv and setcc
+ * use them as scratch.
+ */
+static void emit_binop(CG *g, char op, const char *dst, const char *src) {
+    const char *cc = NULL;
+
+    switch (op) {
+    case '+': emit(g, "add", dst, src); return;
+    case '-': emit(g, "sub", dst, src); return;
+    case '*': emit(g, "imul", dst, src); return;
+    case '/':
+    case '%':
+        if (strcmp(dst, "rax") != 0)
+            emit(g, "mov", "rax", dst);
+        emit(g, "cqo", NULL, NULL);
+        emit(g, "idiv", src, NULL);
+        emit(g, "mov", dst, op == '/' ? "rax" : "rdx");
+        return;
+    case '<': cc = "setl";  break;
+    case '>': cc = "setg";  break;
+    case 'l': cc = "setle"; break;
+    case 'g': cc = "setge"; break;
+    case 'e': cc = "sete";  break;
+    case 'n': cc = "setne"; break;
+    default:
+        errorf("codegen: unsupported operator '%c'\n", op);
+    }
+
+    emit(g, "cmp", dst, src);
+    emit(g, cc, "al", NULL);
+    emit(g, "movzx", dst, "al");
 }
 
 /* ---------------------------------------------------------
-   RECURSIVE CODE GENERATION (EXPRESSIONS & STATEMENTS)
+   INSTRUCTION SELECTION
    --------------------------------------------------------- */
 
-static void cg_emit_expr(CG *g, Expr *e) {
-    if (!e) return;
-    switch (e->kind) {
-    case E_INT_LIT:
-        fprintf(g->out, "    mov rax, %ld\n    push rax\n", e->v.int_val);
-        break;
+/** ".L<hint><id>" */
+static const char *block_label(char *out, const IrBlock *blk) {
+    size_t n = strlen(blk->hint);
+    out[0] = '.';
+    out[1] = 'L';
+    memcpy(out + 2, blk->hint, n);
+    fmt_long(out + 2 + n, blk->id);
+    return out;
+}
 
-    case E_STR_LIT:
-        cg_emit_string_literal(g, cg_register_literal(g, e->v.str_val));
-        break;
+/** "par_chunk<id>", the function of the par chunk starting at block `id`. */
+static const char *chunk_label(char *out, int id) {
+    memcpy(out, "par_chunk", 9);
+    fmt_long(out + 9, id);
+    return out;
+}
 
-    case E_IDENT: {
-        VSlot *v = cg_find(g, e->v.ident);
-        if (!v) {
-            errorf("codegen: unknown identifier '%s' at %d:%d\n",
-                e->v.ident, e->line, e->col);
-            exit(1);
-        }
-        fprintf(g->out,
-            "    mov rax, [rbp%+d]\n"
-            "    push rax\n",
-            v->offset);
-        break;
+/** --instrument: adds one to profile counter `k`, clobbering rax and the flags. */
+static void emit_counter(CG *g, int k) {
+    char mem[ASM_OP_LEN];
+    emit(g, "lea", "rax", "[rel profile_counters]");
+    asm_fmt_mem(mem, "qword", "rax", 8 * (2 + (long)k));
+    emit(g, "add", mem, "1");
+}
+
+/** --instrument: registers the counters with the runtime, first thing in main. */
+static void emit_profile_begin(CG *g) {
+    emit(g, "lea", ARG0, "[rel profile_counters]");
+    emit_call(g, ir_runtime_names[RT_PROFILE_BEGIN], 0);
+}
+
+static void emit_label(CG *g, IrBlock *blk) {
+    char label[ASM_OP_LEN];
+    asm_label(&g->text, block_label(label, blk));
+}
+
+static void emit_jump(CG *g, const char *jcc, int target) {
+    char label[ASM_OP_LEN];
+    emit(g, jcc, block_label(label, g->fn->blocks[target]), NULL);
+}
+
+/**
+ * @brief Emits the jumps of IR_BR `br` in block `bi` after the flags are set:
+ * `jcc` is taken when the condition holds, `jncc` when it does not.
+ */
+static void emit_branch(CG *g, const IrInstr *br, int bi, const char *jcc, const char *jncc) {
+    if (br->target == bi + 1) {
+        emit_jump(g, jncc, br->alt);
+    } else {
+        emit_jump(g, jcc, br->target);
+        if (br->alt != bi + 1)
+            emit_jump(g, "jmp", br->alt);
     }
+}
 
-    case E_CALL: {
-        /* Push arguments in reverse order (standard C calling convention) */
-        for (int i = e->v.call.nargs - 1; i >= 0; i--)
-            cg_emit_expr(g, e->v.call.args[i]);
+/** Jump mnemonics taken when comparison `op` holds ([0]) or fails ([1]), or NULL. */
+static const char *const *compare_jumps(char op) {
+    static const char *const jumps[][2] = {
+        { "jl", "jge" }, { "jg", "jle" }, { "jle", "jg" },
+        { "jge", "jl" }, { "je", "jne" }, { "jne", "je" }
+    };
+    switch (op) {
+    case '<': return jumps[0];
+    case '>': return jumps[1];
+    case 'l': return jumps[2];
+    case 'g': return jumps[3];
+    case 'e': return jumps[4];
+    case 'n': return jumps[5];
+    default:  return NULL;
+    }
+}
 
-        const char *fn = e->v.call.name;
-        if (strcmp(fn, "print") == 0) {
-            emit_print_call_for_expr(g, (e->v.call.nargs > 0) ? e->v.call.args[0] : NULL);
-        } else if (strcmp(fn, "clone") == 0) {
-            fprintf(g->out, "    pop rax\n");
+/**
+ * @brief At -O1, emits a comparison whose only use is the IR_BR right after
+ * it as one cmp and a conditional jump, instead of materializing the 0/1
+ * result and testing it. Returns false if the pair does not qualify.
+ */
+static bool emit_compare_branch(CG *g, const IrInstr *cmp, const IrInstr *br, int bi) {
+    const char *const *jumps = compare_jumps(cmp->binop);
+    if (g->opt_level == 0 || cmp->op != IR_BIN || !jumps || br->op != IR_BR ||
+        br->a != cmp->dst || g->temps[cmp->dst].nuses != 1)
+        return false;
+
+    const char *rb = imm_operand(g, cmp->b);
+    if (!rb) rb = use_temp(g, cmp->b, SCRATCH);
+    emit(g, "cmp", use_temp(g, cmp->a, "rax"), rb);
+    emit_branch(g, br, bi, jumps[0], jumps[1]);
+    return true;
+}
+
+/* ---------------------------------------------------------
+   ARRAYS
+   --------------------------------------------------------- */
+
+/* Block moves of up to this many 16-byte chunks are unrolled */
+#define COPY_UNROLL 8
+
+/**
+ * @brief Formats the element operand of IR_LOADX/IR_STOREX `in`.
+ * Constant indices fold into the displacement; any other is read with
+ * use_temp into `scratch` if needed.
+ */
+static const char *element_operand(CG *g, char *out, const char *size, const IrInstr *in,
+                                   const char *scratch) {
+    long offset = g->slot_offset[in->slot];
+    const char *base = slot_base(g, in->slot);
+    if (in->a < 0)
+        asm_fmt_mem(out, size, base, offset + 8 * in->imm);
+    else if (g->opt_level >= 1 && g->temps[in->a].is_const)
+        asm_fmt_mem(out, size, base, offset + 8 * g->temps[in->a].imm);
+    else
+        asm_fmt_index(out, size, base, use_temp(g, in->a, scratch), 8, offset);
+    return out;
+}
+
+/** ".Lbounds<i>" for the stub reporting index `reg` against `len`, shared where possible. */
+static const char *bounds_stub(CG *g, char *out, const char *reg, long len) {
+    int i = 0;
+    while (i < g->nstubs && !(g->stubs[i].len == len && strcmp(g->stubs[i].reg, reg) == 0)) i++;
+    if (i == g->nstubs) {
+        if (g->nstubs == g->stubs_cap) {
+            g->stubs_cap = g->stubs_cap ? g->stubs_cap * 2 : 8;
+            g->stubs = xrealloc(g->stubs, sizeof(BoundsStub) * (size_t)g->stubs_cap);
+        }
+        g->stubs[g->nstubs].reg = reg;
+        g->stubs[g->nstubs++].len = len;
+    }
+    memcpy(out, ".Lbounds", 8);
+    fmt_long(out + 8, i);
+    return out;
+}
+
+/**
+ * @brief Stubs for the failed bounds checks. The runtime reports the
+ * error and exits, so the stack only needs realigning for the call.
+ */
+static void emit_bounds_stubs(CG *g) {
+    char op[ASM_OP_LEN];
+    for (int i = 0; i < g->nstubs; i++) {
+        const BoundsStub *s = &g->stubs[i];
+        memcpy(op, ".Lbounds", 8);
+        fmt_long(op + 8, i);
+        asm_label(&g->text, op);
+        if (strcmp(s->reg, ARG0) != 0) emit(g, "mov", ARG0, s->reg);
+        fmt_long(op, s->len);
+        emit(g, "mov", ARG1, op);
+        emit(g, "and", "rsp", "-16");
 #ifdef _WIN32
-            fprintf(g->out, "    mov rcx, rax\n    sub rsp, 32\n    call runtime_clone_string\n    add rsp, 32\n    push rax\n");
-#else
-            fprintf(g->out, "    mov rdi, rax\n    call runtime_clone_string\n    push rax\n");
+        emit(g, "sub", "rsp", "32");
 #endif
-        } else {
-            errorf("codegen: unknown function '%s'\n", fn);
+        emit(g, "call", ir_runtime_names[RT_BOUNDS_FAIL], NULL);
+    }
+}
+
+/**
+ * @brief Fills array `slot` from the array at address `src` (IR_COPY), or
+ * with zeros when `src` is NULL (IR_ZERO). Moves 16 bytes at a time
+ * through xmm0, counting rdx up to 0 when the block is too long to unroll.
+ */
+static void emit_block_move(CG *g, int slot, const char *src) {
+    char from[ASM_OP_LEN], to[ASM_OP_LEN];
+    long words = ir_slot_words(&g->fn->slots[slot]);
+    long chunks = words / 2, tail = 16 * chunks;
+    long offset = g->slot_offset[slot];
+    const char *base = slot_base(g, slot);
+
+    if (!src && chunks > 0) emit(g, "pxor", "xmm0", "xmm0");
+    if (chunks <= COPY_UNROLL) {
+        for (long k = 0; k < chunks; k++) {
+            if (src) {
+                asm_fmt_mem(from, NULL, src, 16 * k);
+                emit(g, "movdqu", "xmm0", from);
+            }
+            asm_fmt_mem(to, NULL, base, offset + 16 * k);
+            emit(g, "movdqu", to, "xmm0");
         }
-        break;
+    } else {
+        char label[ASM_OP_LEN];
+        memcpy(label, ".Lcopy", 6);
+        fmt_long(label + 6, g->ncopy_loops++);
+        fmt_long(from, -tail);
+        emit(g, "mov", "rdx", from);
+        asm_label(&g->text, label);
+        if (src) {
+            asm_fmt_index(from, NULL, src, "rdx", 1, tail);
+            emit(g, "movdqu", "xmm0", from);
+        }
+        asm_fmt_index(to, NULL, base, "rdx", 1, offset + tail);
+        emit(g, "movdqu", to, "xmm0");
+        emit(g, "add", "rdx", "16");
+        emit(g, "jne", label, NULL);
     }
 
-    case E_ADDR:
-    case E_MUTADDR: {
-        if (!e->v.inner || e->v.inner->kind != E_IDENT) {
-            errorf("codegen: & expects identifier at %d:%d\n",
-                e->line, e->col);
-            exit(1);
+    if (words % 2) {
+        if (src) {
+            asm_fmt_mem(from, NULL, src, tail);
+            emit(g, "mov", "rdx", from);
+            asm_fmt_mem(to, NULL, base, offset + tail);
+            emit(g, "mov", to, "rdx");
+        } else {
+            asm_fmt_mem(to, "qword", base, offset + tail);
+            emit(g, "mov", to, "0");
         }
+    }
+}
+
+/** Emits a single IR instruction at linear position `pos` within block `bi`. */
+static void emit_instr(CG *g, IrInstr *in, int bi, int pos) {
+    char op[ASM_OP_LEN];
+
+    switch (in->op) {
+    case IR_CONST:
+        /* -O1 constants are rematerialized at their uses instead */
+        if (is_dead(g, in->dst) || g->temps[in->dst].is_const) break;
+        fmt_long(op, in->imm);
+        emit(g, "mov", def_reg(g, in->dst), op);
+        def_temp(g, in->dst, def_reg(g, in->dst));
+        break;
 
-        VSlot *v = cg_find(g, e->v.inner->v.ident);
-        if (!v) {
-            errorf("codegen: unknown identifier '%s' in & at %d:%d\n",
-                e->v.inner->v.ident, e->line, e->col);
-            exit(1);
+    case IR_STR:
+        /* Literals are ready-made string objects in .data (see runtime.h) */
+        if (is_dead(g, in->dst)) break;
+        memcpy(op, "[rel literal_", 13);
+        fmt_long(op + 13, in->imm);
+        strcat(op, "]");
+        emit(g, "lea", def_reg(g, in->dst), op);
+        def_temp(g, in->dst, def_reg(g, in->dst));
+        break;
+
+    case IR_LOAD:
+        if (is_dead(g, in->dst)) break;
+        if (g->slot_reg[in->slot] >= 0) {
+            if (g->temps[in->dst].saved < 0)
+                def_temp(g, in->dst, saved_regs[g->slot_reg[in->slot]]);
+            break;
         }
+        emit(g, "mov", def_reg(g, in->dst), slot_operand(g, op, NULL, in->slot));
+        def_temp(g, in->dst, def_reg(g, in->dst));
+        break;
 
-        fprintf(g->out,
-            "    lea rax, [rbp%+d]\n"
-            "    push rax\n",
-            v->offset);
+    case IR_STORE: {
+        const char *imm = imm_operand(g, in->a);
+        if (g->slot_reg[in->slot] >= 0) {
+            const char *reg = saved_regs[g->slot_reg[in->slot]];
+            const char *src = imm ? imm : use_temp(g, in->a, reg);
+            if (strcmp(src, reg) != 0) emit(g, "mov", reg, src);
+        } else if (imm) {
+            emit(g, "mov", slot_operand(g, op, "qword", in->slot), imm);
+        } else {
+            emit(g, "mov", slot_operand(g, op, NULL, in->slot), use_temp(g, in->a, "rax"));
+        }
         break;
     }
-    default: errorf("codegen: unsupported expr kind %d\n", e->kind);
+
+    case IR_ADDR:
+        if (is_dead(g, in->dst)) break;
+        /* The home of a register slot is only written for its references */
+        if (g->slot_reg[in->slot] >= 0)
+            emit(g, "mov", slot_operand(g, op, NULL, in->slot), saved_regs[g->slot_reg[in->slot]]);
+        emit(g, "lea", def_reg(g, in->dst), slot_operand(g, op, NULL, in->slot));
+        def_temp(g, in->dst, def_reg(g, in->dst));
+        break;
+
+    case IR_BIN: {
+        /* Right operand first: at -O0 it is on top of the stack.
+           idiv has no immediate form, so divisors always need a register. */
+        bool is_div = in->binop == '/' || in->binop == '%';
+        const char *rb = is_div ? NULL : imm_operand(g, in->b);
+        if (!rb) rb = use_temp(g, in->b, SCRATCH);
+        const char *ra = use_temp(g, in->a, "rax");
+        const char *dst = def_reg(g, in->dst);
+
+        /* Work in rax unless the result can be computed in place */
+        const char *work = (strcmp(dst, ra) == 0 || strcmp(dst, rb) != 0) ? dst : "rax";
+        if (strcmp(work, ra) != 0)
+            emit(g, "mov", work, ra);
+        emit_binop(g, in->binop, work, rb);
+        def_temp(g, in->dst, work);
+        break;
     }
-}
 
-static void cg_emit_stmt(CG *g, Stmt *s) {
-    if (!s) return;
-    switch (s->kind) {
-    case S_DECL:
-        cg_add(g, s->v.decl.name, s->v.decl.type);
-        VSlot *v = cg_find(g, s->v.decl.name);
-        if (s->v.decl.init) {
-            cg_emit_expr(g, s->v.decl.init);
-            fprintf(g->out, "    pop rax\n    mov [rbp%+d], rax\n", v->offset);
+    case IR_CALL: {
+        if (g->opts->instrument) emit_counter(g, g->fn->nblocks + g->ncall_sites++);
+        /* A constant argument is a single immediate move into ARG0 */
+        if (in->a >= 0) {
+            const char *arg = use_temp(g, in->a, ARG0);
+            if (strcmp(arg, ARG0) != 0)
+                emit(g, "mov", ARG0, arg);
+        }
+        if (g->opts->intrinsics && in->imm == RT_PRINT_INT) {
+            emit(g, "call", ".Lprint_int", NULL);
+            g->print_routine = true;
         } else {
-            fprintf(g->out, "    mov qword [rbp%+d], 0\n", v->offset);
+            emit_call(g, ir_runtime_names[in->imm], pos);
         }
+        if (in->dst >= 0)
+            def_temp(g, in->dst, "rax");
         break;
+    }
 
-    case S_EXPR:
-        cg_emit_expr(g, s->v.expr);
-        fprintf(g->out, "    add rsp, 8\n"); /* Cleanup stack after expression */
+    case IR_ARRAY:
+        if (is_dead(g, in->dst)) break;
+        memcpy(op, "[rel array_", 11);
+        fmt_long(op + 11, in->imm);
+        strcat(op, "]");
+        emit(g, "lea", def_reg(g, in->dst), op);
+        def_temp(g, in->dst, def_reg(g, in->dst));
         break;
 
-    case S_BLOCK:
-        for (int i = 0; i < s->v.block.n; i++)
-            cg_emit_stmt(g, s->v.block.stmts[i]);
+    case IR_LOADX:
+        /* The index is consumed even when the element is not needed */
+        element_operand(g, op, NULL, in, "rax");
+        if (is_dead(g, in->dst)) break;
+        emit(g, "mov", def_reg(g, in->dst), op);
+        def_temp(g, in->dst, def_reg(g, in->dst));
         break;
 
-    case S_IF: {
-        int lbl = cg_new_label(g);
-        cg_emit_expr(g, s->v.ifs.cond);
-        fprintf(g->out, "    pop rax\n    cmp rax, 0\n    je .Lelse%d\n", lbl);
-        cg_emit_stmt(g, s->v.ifs.then_s);
-        fprintf(g->out, "    jmp .Lend%d\n.Lelse%d:\n", lbl, lbl);
-        if (s->v.ifs.else_s) cg_emit_stmt(g, s->v.ifs.else_s);
-        fprintf(g->out, ".Lend%d:\n", lbl);
+    case IR_STOREX: {
+        /* The value first: at -O0 it is above the index on the stack */
+        const char *imm = imm_operand(g, in->b);
+        const char *src = imm ? imm : use_temp(g, in->b, SCRATCH);
+        emit(g, "mov", element_operand(g, op, imm ? "qword" : NULL, in, "rax"), src);
         break;
     }
 
-    case S_WHILE: {
-        int lbl = cg_new_label(g);
-        fprintf(g->out, ".Lwhile%d:\n", lbl);
-        cg_emit_expr(g, s->v.wh.cond);
-        fprintf(g->out, "    pop rax\n    cmp rax, 0\n    je .Lendwhile%d\n", lbl);
-        cg_emit_stmt(g, s->v.wh.body);
-        fprintf(g->out, "    jmp .Lwhile%d\n.Lendwhile%d:\n", lbl, lbl);
+    case IR_BOUNDS: {
+        /* Unsigned compare: a negative index is above every length */
+        char len[24], stub[ASM_OP_LEN];
+        const char *reg = use_temp(g, in->a, "rax");
+        fmt_long(len, in->imm);
+        emit(g, "cmp", reg, len);
+        emit(g, "jae", bounds_stub(g, stub, reg, in->imm), NULL);
+        def_temp(g, in->dst, reg);
         break;
     }
-    default: errorf("codegen: unsupported stmt\n");
+
+    case IR_COPY:
+        emit_block_move(g, in->slot, use_temp(g, in->a, "rax"));
+        break;
+
+    case IR_ZERO:
+        emit_block_move(g, in->slot, NULL);
+        break;
+
+    case IR_JMP:
+        if (in->target != bi + 1)
+            emit_jump(g, "jmp", in->target);
+        break;
+
+    case IR_BR:
+        emit(g, "cmp", use_temp(g, in->a, "rax"), "0");
+        emit_branch(g, in, bi, "jne", "je");
+        break;
+
+    case IR_RET:
+        emit_epilogue(g, pos);
+        break;
+
+    case IR_PAR: {
+        /* runtime_par_for(chunk, lo, hi, frame). Nothing else is live across a
+           statement; the bounds go through rax and rdx since the argument
+           registers may hold either one. */
+        if (g->opts->instrument) emit_counter(g, g->fn->nblocks + g->ncall_sites++);
+        const char *hi = use_temp(g, in->b, "rdx");
+        if (strcmp(hi, "rdx") != 0) emit(g, "mov", "rdx", hi);
+        const char *lo = use_temp(g, in->a, "rax");
+        if (strcmp(lo, "rax") != 0) emit(g, "mov", "rax", lo);
+        if (strcmp(ARG2, "rdx") != 0) emit(g, "mov", ARG2, "rdx");
+        emit(g, "mov", ARG1, "rax");
+        emit(g, "mov", ARG3, "rbp");
+        memcpy(op, "[rel ", 5);
+        chunk_label(op + 5, in->target);
+        strcat(op, "]");
+        emit(g, "lea", ARG0, op);
+        emit_call(g, ir_runtime_names[RT_PAR_FOR], pos);
+        if (in->alt != bi + 1)
+            emit_jump(g, "jmp", in->alt);
+        break;
     }
+
+    case IR_ENTER: {
+        /* The chunk's frame mirrors main's; main's own is kept in PARENT_FRAME */
+        char probe[ASM_OP_LEN];
+        asm_label(&g->text, chunk_label(op, bi));
+        memcpy(probe, ".Lprobe", 7);
+        fmt_long(probe + 7, bi);
+        emit_frame(g, probe);
+        emit(g, "mov", frame_operand(op, NULL, g->parent_save), PARENT_FRAME);
+        emit(g, "mov", PARENT_FRAME, ARG2);
+        break;
+    }
+
+    case IR_ARG:
+        if (!is_dead(g, in->dst))
+            def_temp(g, in->dst, in->imm ? ARG1 : ARG0);
+        break;
+
+    case IR_LEAVE:
+        emit(g, "mov", PARENT_FRAME, frame_operand(op, NULL, g->parent_save));
+        emit_frame_exit(g);
+        break;
+    }
+}
+
+/* Source bytes per `db` line of a string literal */
+#define LITERAL_LINE_BYTES 64
+
+/**
+ * @brief Appends `s[0..len)` as `db` operands.
+ * Printable characters are grouped into quoted runs; quotes and control
+ * characters are written as decimal bytes (NASM "..." strings have no
+ * escapes).
+ */
+static void append_db_bytes(StrBuf *line, const unsigned char *s, size_t len) {
+    bool quoted = false;
+    for (size_t i = 0; i < len; i++) {
+        bool printable = s[i] >= 0x20 && s[i] < 0x7F && s[i] != '"';
+        if (printable != quoted) {
+            if (quoted) sb_putc(line, '"');
+            if (i > 0) sb_putc(line, ',');
+            if (printable) sb_putc(line, '"');
+            quoted = printable;
+        } else if (!printable && i > 0) {
+            sb_putc(line, ',');
+        }
+        if (printable) sb_putc(line, (char)s[i]);
+        else sb_put_long(line, s[i]);
+    }
+    if (quoted) sb_putc(line, '"');
 }
 
-/** Finalizes the assembly file by emitting the .data section for strings. */
+/**
+ * @brief Finalizes the assembly file by emitting the .data section for strings.
+ * Every literal is a static RtString: length, cap = 0, then the bytes and a
+ * NUL, padded so that the next header stays aligned.
+ */
 static void emit_literals(CG *g) {
-    if (g->lit_count == 0) return;
-    fprintf(g->out, "\nsection .data\n");
-    for (Literal *L = g->lits; L; L = L->next) {
-        fprintf(g->out, "literal_%d: db ", L->id);
-        for (size_t i = 0; L->s[i]; i++)
-            fprintf(g->out, "%u,", (unsigned int)(unsigned char)L->s[i]);
-        fprintf(g->out, "0\n");
+    IrFunc *fn = g->fn;
+    if (fn->nstrings == 0) return;
+    asm_printf(&g->text, "\nsection .data align=%d\n", RT_STRING_ALIGN);
+
+    StrBuf line;
+    sb_init(&line);
+    for (int id = 0; id < fn->nstrings; id++) {
+        const unsigned char *s = (const unsigned char *)fn->strings[id];
+        size_t len = strlen(fn->strings[id]);
+
+        line.len = 0;
+        sb_puts(&line, "literal_");
+        sb_put_long(&line, id);
+        sb_puts(&line, ": dq ");
+        sb_put_long(&line, (long)len);
+        sb_puts(&line, ", 0");
+        asm_directive(&g->text, line.data, line.len);
+
+        /* The bytes follow on `db` lines of bounded length */
+        line.len = 0;
+        sb_puts(&line, "    db ");
+        for (size_t i = 0; i < len; i += LITERAL_LINE_BYTES) {
+            if (i > 0) {
+                asm_directive(&g->text, line.data, line.len);
+                line.len = 0;
+                sb_puts(&line, "    db ");
+            }
+            size_t n = len - i < LITERAL_LINE_BYTES ? len - i : LITERAL_LINE_BYTES;
+            append_db_bytes(&line, s + i, n);
+        }
+        if (len > 0) sb_putc(&line, ',');
+
+        /* NUL, then zero padding up to the next header */
+        size_t pad = (RT_STRING_ALIGN - (len + 1) % RT_STRING_ALIGN) % RT_STRING_ALIGN;
+        sb_putc(&line, '0');
+        for (size_t i = 0; i < pad; i++)
+            sb_puts(&line, ",0");
+        asm_directive(&g->text, line.data, line.len);
+    }
+    sb_free(&line);
+}
+
+/* Elements per `dq` line of a constant array */
+#define ARRAY_LINE_WORDS 16
+
+/** Emits the initial values of long array literals as read-only data. */
+static void emit_const_arrays(CG *g) {
+    IrFunc *fn = g->fn;
+    if (fn->narrays == 0) return;
+    asm_printf(&g->text, "\nsection %s align=16\n", RODATA_SECTION);
+
+    StrBuf line;
+    sb_init(&line);
+    for (int id = 0; id < fn->narrays; id++) {
+        const IrConstArray *a = &fn->arrays[id];
+        for (long i = 0; i < a->len; i += ARRAY_LINE_WORDS) {
+            line.len = 0;
+            if (i == 0) {
+                sb_puts(&line, "array_");
+                sb_put_long(&line, id);
+                sb_puts(&line, ": dq ");
+            } else {
+                sb_puts(&line, "    dq ");
+            }
+            for (long k = i; k < a->len && k < i + ARRAY_LINE_WORDS; k++) {
+                if (k > i) sb_puts(&line, ", ");
+                sb_put_long(&line, a->values[k]);
+            }
+            asm_directive(&g->text, line.data, line.len);
+        }
+    }
+    sb_free(&line);
+}
+
+/** --instrument: the counter table runtime.h describes, all counts zero. */
+static void emit_profile_table(CG *g) {
+    int n = profile_counters(g->fn);
+    asm_printf(&g->text, "\nsection .data align=8\n");
+
+    StrBuf line;
+    sb_init(&line);
+    /* Signed, as the assemblers read data operands; long is 32 bits on Win64 */
+    sb_printf(&line, "profile_counters: dq %lld, %d", (long long)profile_checksum(g->fn), n);
+    asm_directive(&g->text, line.data, line.len);
+    for (int i = 0; i < n; i += ARRAY_LINE_WORDS) {
+        line.len = 0;
+        sb_puts(&line, "    dq 0");
+        for (int k = i + 1; k < n && k < i + ARRAY_LINE_WORDS; k++)
+            sb_puts(&line, ", 0");
+        asm_directive(&g->text, line.data, line.len);
     }
+    sb_free(&line);
+}
+
+/* ---------------------------------------------------------
+   INTRINSICS
+   --------------------------------------------------------- */
+
+/* Room .Lprint_int needs in the output buffer: it always stores 32 bytes,
+   of which the longest number ("-9223372036854775808\n") uses 21 */
+#define PRINT_INT_ROOM 32
+
+/* ceil(2^67 / 10) as a signed immediate: the high half of u * this,
+   shifted right by 3, is u / 10 for every unsigned 64-bit u */
+#define DIV10_MAGIC "-3689348814741910323"
+
+/**
+ * @brief Emits .Lprint_int, the --intrinsics version of runtime_print_int:
+ * ARG0 is formatted back to front into 32 bytes of stack, which are then
+ * stored into the runtime's output buffer with two 16-byte moves.
+ * Returns the length in rax like the runtime function, and clobbers only
+ * rax, rdx, xmm0 and the flags. When the buffer lacks room it is flushed
+ * first, saving every register a temporary or the argument may be in.
+ */
+static void emit_print_routine(CG *g) {
+    if (!g->print_routine) return;
+
+    char op[24];
+    fmt_long(op, RT_OUT_BUF_SIZE - PRINT_INT_ROOM);
+    asm_printf(&g->text,
+        ".Lprint_int:\n"
+        "    mov rax, [rel runtime_out_len]\n"
+        "    cmp rax, %s\n"
+        "    ja .Lprint_flush\n"
+        ".Lprint_fast:\n"
+        "    push r8\n"
+        "    push r9\n"
+        "    push r10\n"
+        "    sub rsp, 32\n"
+        "    lea r8, [rsp+31]\n"
+        "    mov byte [r8], 10\n"
+        /* |v|, read as unsigned, so LONG_MIN needs no special case */
+        "    mov rax, %s\n"
+        "    cqo\n"
+        "    xor rax, rdx\n"
+        "    sub rax, rdx\n"
+        "    mov r10, rax\n"
+        "    mov r9, %s\n"
+        ".Lprint_digit:\n"
+        "    mov rax, r10\n"
+        "    mul r9\n"
+        "    shr rdx, 3\n"
+        "    lea rax, [rdx+rdx*4]\n"
+        "    add rax, rax\n"
+        "    sub r10, rax\n"
+        "    add r10, 48\n"
+        "    sub r8, 1\n"
+        "    mov [r8], r10b\n"
+        "    mov r10, rdx\n"
+        "    test r10, r10\n"
+        "    jne .Lprint_digit\n"
+        "    test %s, %s\n"
+        "    jns .Lprint_copy\n"
+        "    sub r8, 1\n"
+        "    mov byte [r8], 45\n"
+        ".Lprint_copy:\n"
+        "    mov rax, [rel runtime_out_len]\n"
+        "    lea rdx, [rel runtime_out_buf]\n"
+        "    add rdx, rax\n"
+        "    movdqu xmm0, [r8]\n"
+        "    movdqu [rdx], xmm0\n"
+        "    movdqu xmm0, [r8+16]\n"
+        "    movdqu [rdx+16], xmm0\n"
+        "    lea r9, [rsp+32]\n"
+        "    sub r9, r8\n"
+        "    add rax, r9\n"
+        "    mov [rel runtime_out_len], rax\n"
+        "    mov rax, r9\n"
+        "    add rsp, 32\n"
+        "    pop r10\n"
+        "    pop r9\n"
+        "    pop r8\n"
+        "    ret\n"
+        ".Lprint_flush:\n",
+        op, ARG0, DIV10_MAGIC, ARG0, ARG0);
+
+    /* The caller's stack alignment is unknown; rbx keeps the old rsp */
+    emit(g, "push", ARG0, NULL);
+    for (int r = 0; r < NUM_TEMP_REGS; r++)
+        emit(g, "push", temp_regs[r], NULL);
+    emit(g, "push", "rbx", NULL);
+    emit(g, "mov", "rbx", "rsp");
+    emit(g, "and", "rsp", "-16");
+#ifdef _WIN32
+    emit(g, "sub", "rsp", "32");
+#endif
+    emit(g, "call", ir_runtime_names[RT_FLUSH], NULL);
+    emit(g, "mov", "rsp", "rbx");
+    emit(g, "pop", "rbx", NULL);
+    for (int r = NUM_TEMP_REGS - 1; r >= 0; r--)
+        emit(g, "pop", temp_regs[r], NULL);
+    emit(g, "pop", ARG0, NULL);
+    emit(g, "jmp", ".Lprint_fast", NULL);
 }
 
 /* ---------------------------------------------------------
    ENTRY POINT
    --------------------------------------------------------- */
 
-int codegen_function(Function *f, const char *out_asm, const char *module_name, bool debug_borrow) {
-    CG g = { .out = fopen(out_asm, "w"), .debug_borrow = debug_borrow };
-    if (!g.out) return 1;
+/** Assembles the buffered code with the built-in encoder and writes the object. */
+static bool write_object(const AsmBuf *text, FILE *out) {
+    ObjFile obj;
+    obj_init(&obj);
+    x86_assemble(text, &obj);
+    bool ok = obj_write(&obj, OBJ_NATIVE, out);
+    obj_free(&obj);
+    return ok;
+}
+
+/** Releases the code generator's state; also the error cleanup. */
+static void cg_free(void *arg) {
+    CG *g = arg;
+    if (g->out) fclose(g->out);
+    asm_free(&g->text);
+    free(g->slot_offset);
+    free(g->slot_reg);
+    free(g->temps);
+    free(g->vstack);
+    free(g->stubs);
+    free(g->loops);
+    for (int r = 0; r < NUM_TEMP_REGS; r++) free(g->reg_temps[r]);
+}
+
+int codegen_function(IrFunc *fn, const char *out_path, const char *module_name,
+                     const CodegenOptions *opts) {
+    (void)module_name;
 
+    CG g = {
+        .fn = fn,
+        .opts = opts,
+        .opt_level = opts->opt_level
+    };
+    FILE *out = NULL;
+    if (opts->emit != EMIT_JIT) {
+        out = fopen(out_path, opts->emit == EMIT_OBJ ? "wb" : "w");
+        if (!out) return 1;
+    }
+    asm_init(&g.text);
+    g.out = out;
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, cg_free, &g);
+
+    layout_frame(&g);
     emit_prologue(&g);
-    cg_emit_stmt(&g, f->body);
-    emit_epilogue(&g);
+    if (opts->instrument) emit_profile_begin(&g);
+
+    int pos = 0;
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        g.in_chunk = blk->par;
+        if (i > 0) emit_label(&g, blk);
+        for (int j = 0; j < blk->n; j++, pos++) {
+            /* A chunk's counter goes after the entry code that the runtime calls */
+            if (opts->instrument && j == (blk->code[0].op == IR_ENTER))
+                emit_counter(&g, i);
+            if (j + 1 < blk->n && emit_compare_branch(&g, &blk->code[j], &blk->code[j + 1], i)) {
+                j++;
+                pos++;
+                continue;
+            }
+            emit_instr(&g, &blk->code[j], i, pos);
+        }
+    }
+
+    emit_bounds_stubs(&g);
+    emit_print_routine(&g);
     emit_literals(&g);
+    emit_const_arrays(&g);
+    if (opts->instrument) emit_profile_table(&g);
+
+    if (opts->peephole) {
+        stats_phase(PHASE_PEEPHOLE);
+        PeepholeStats stats;
+        peephole_run(&g.text, &stats);
+        if (opts->peephole_stats) peephole_print_stats(&stats, opts->log);
+    }
 
-    fclose(g.out);
-    return 0;
-}
\ No newline at end of file
+    stats_phase(PHASE_OUTPUT);
+    stats_count(STAT_ASM_INSNS, (uint64_t)asm_count_insns(&g.text));
+    bool ok = true;
+    if (opts->emit == EMIT_JIT) {
+        x86_assemble(&g.text, opts->jit_obj);
+    } else {
+        ok = opts->emit == EMIT_OBJ ? write_object(&g.text, out) : asm_write(&g.text, out);
+        long size = ftell(out);
+        if (size > 0) stats_count(STAT_OUTPUT_BYTES, (uint64_t)size);
+        g.out = NULL;
+        if (fclose(out) != 0) ok = false;
+    }
+    error_cleanup_pop(&cleanup);
+    cg_free(&g);
+    return ok ? 0 : 1;
+}
@@ -1,7 +1,25 @@
 // src/common.c
+/* mmap/open/fstat are POSIX, hidden by -std=c99 without this */
+#define _POSIX_C_SOURCE 200809L
+
 #include "../include/common.h"
+#include "../include/stats.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <setjmp.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 void *xmalloc(size_t s) {
+    stats_note_alloc(s);
     void *p = malloc(s);
     if (!p) {
         fprintf(stderr, "FATAL: out of memory allocating %zu bytes\n", s);
@@ -10,10 +28,507 @@ void *xmalloc(size_t s) {
     return p;
 }
 
+void *xrealloc(void *p, size_t s) {
+    stats_note_alloc(s);
+    void *q = realloc(p, s);
+    if (!q) {
+        fprintf(stderr, "FATAL: out of memory allocating %zu bytes\n", s);
+        exit(1);
+    }
+    return q;
+}
+
+char *xstrdup(const char *s) {
+    size_t n = strlen(s) + 1;
+    char *p = xmalloc(n);
+    memcpy(p, s, n);
+    return p;
+}
+
+typedef struct ErrorTrap {
+    jmp_buf env;
+    StrBuf *diag;
+    ErrorCleanup *cleanups; /* Newest first */
+} ErrorTrap;
+
+/* Innermost catch_errors on this thread, or NULL */
+static THREAD_LOCAL ErrorTrap *error_trap;
+
+/* Source file errorf_at names, or NULL */
+static THREAD_LOCAL const char *error_file;
+
+/** Writes an error message to the trap's diag, or to stderr without one. */
+static void report_error(const char *prefix, const char *fmt, va_list ap) {
+    if (error_trap) {
+        sb_puts(error_trap->diag, prefix);
+        sb_vprintf(error_trap->diag, fmt, ap);
+    } else {
+        fputs(prefix, stderr);
+        vfprintf(stderr, fmt, ap);
+    }
+}
+
+/** Abandons the unit after its error was reported. */
+static NORETURN void raise_error(void) {
+    if (error_trap) {
+        for (ErrorCleanup *c = error_trap->cleanups; c; c = c->next)
+            c->fn(c->arg);
+        longjmp(error_trap->env, 1);
+    }
+    exit(1);
+}
+
 void errorf(const char *fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
-    vfprintf(stderr, fmt, ap);
+    report_error("", fmt, ap);
     va_end(ap);
-    exit(1);
-}
\ No newline at end of file
+    raise_error();
+}
+
+void errorf_at(int line, int col, const char *fmt, ...) {
+    char prefix[512];
+    snprintf(prefix, sizeof prefix, "%s:%d:%d: ", error_file ? error_file : "<input>", line, col);
+    va_list ap;
+    va_start(ap, fmt);
+    report_error(prefix, fmt, ap);
+    va_end(ap);
+    raise_error();
+}
+
+void error_set_file(const char *path) {
+    error_file = path;
+}
+
+/* ---------------------------------------------------------
+   ARENA ALLOCATOR
+   --------------------------------------------------------- */
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_CHUNK (64 * 1024)
+#define ARENA_HEADER ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static size_t arena_round(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static unsigned char *chunk_data(ArenaChunk *c) {
+    return (unsigned char *)c + ARENA_HEADER;
+}
+
+void arena_init(Arena *a) {
+    a->chunk = NULL;
+    a->total = 0;
+}
+
+void *arena_alloc(Arena *a, size_t size) {
+    size = arena_round(size ? size : 1);
+
+    ArenaChunk *c = a->chunk;
+    if (!c || c->size - c->used < size) {
+        /* Each chunk is at least twice the previous one */
+        size_t cap = c ? c->size * 2 : ARENA_MIN_CHUNK;
+        while (cap < size) cap *= 2;
+        ArenaChunk *fresh = xmalloc(ARENA_HEADER + cap);
+        fresh->prev = c;
+        fresh->size = cap;
+        fresh->used = 0;
+        a->chunk = c = fresh;
+    }
+
+    void *p = chunk_data(c) + c->used;
+    c->used += size;
+    a->total += size;
+    return p;
+}
+
+void *arena_realloc(Arena *a, void *p, size_t old_size, size_t new_size) {
+    if (!p) return arena_alloc(a, new_size);
+
+    ArenaChunk *c = a->chunk;
+    size_t old_r = arena_round(old_size ? old_size : 1);
+    size_t new_r = arena_round(new_size ? new_size : 1);
+
+    /* Last allocation of the current chunk: extend it in place */
+    if ((unsigned char *)p + old_r == chunk_data(c) + c->used &&
+        new_r >= old_r && new_r - old_r <= c->size - c->used) {
+        c->used += new_r - old_r;
+        a->total += new_r - old_r;
+        return p;
+    }
+
+    void *q = arena_alloc(a, new_size);
+    memcpy(q, p, old_size < new_size ? old_size : new_size);
+    return q;
+}
+
+char *arena_strdup(Arena *a, const char *s) {
+    size_t n = strlen(s) + 1;
+    char *p = arena_alloc(a, n);
+    memcpy(p, s, n);
+    return p;
+}
+
+void arena_reset(Arena *a) {
+    ArenaChunk *c = a->chunk;
+    if (!c) return;
+
+    /* Keep only the newest chunk: it is the largest */
+    ArenaChunk *old = c->prev;
+    while (old) {
+        ArenaChunk *prev = old->prev;
+        free(old);
+        old = prev;
+    }
+    c->prev = NULL;
+    c->used = 0;
+    a->total = 0;
+}
+
+void arena_free(Arena *a) {
+    ArenaChunk *c = a->chunk;
+    while (c) {
+        ArenaChunk *prev = c->prev;
+        free(c);
+        c = prev;
+    }
+    arena_init(a);
+}
+
+/* ---------------------------------------------------------
+   BYTE BUFFER
+   --------------------------------------------------------- */
+
+void sb_init(StrBuf *sb) {
+    sb->data = NULL;
+    sb->len = sb->cap = 0;
+}
+
+void sb_free(StrBuf *sb) {
+    free(sb->data);
+    sb_init(sb);
+}
+
+char *sb_reserve(StrBuf *sb, size_t extra) {
+    if (sb->cap - sb->len < extra) {
+        size_t cap = sb->cap ? sb->cap : 4096;
+        while (cap - sb->len < extra) cap *= 2;
+        sb->data = xrealloc(sb->data, cap);
+        sb->cap = cap;
+    }
+    return sb->data + sb->len;
+}
+
+void sb_append(StrBuf *sb, const char *s, size_t len) {
+    if (len == 0) return;
+    memcpy(sb_reserve(sb, len), s, len);
+    sb->len += len;
+}
+
+void sb_puts(StrBuf *sb, const char *s) {
+    sb_append(sb, s, strlen(s));
+}
+
+void sb_putc(StrBuf *sb, char c) {
+    *sb_reserve(sb, 1) = c;
+    sb->len++;
+}
+
+size_t fmt_long(char *out, long v) {
+    char tmp[24];
+    int n = 0;
+    /* Work on the unsigned magnitude so LONG_MIN does not overflow */
+    unsigned long u = v < 0 ? 0UL - (unsigned long)v : (unsigned long)v;
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+
+    size_t len = 0;
+    if (v < 0) out[len++] = '-';
+    while (n > 0) out[len++] = tmp[--n];
+    out[len] = '\0';
+    return len;
+}
+
+void sb_put_long(StrBuf *sb, long v) {
+    sb->len += fmt_long(sb_reserve(sb, 24), v);
+}
+
+void sb_vprintf(StrBuf *sb, const char *fmt, va_list ap) {
+    va_list again;
+    va_copy(again, ap);
+
+    /* Try the space already available first; retry once with the exact size */
+    size_t room = sb->cap - sb->len;
+    int need = vsnprintf(room ? sb->data + sb->len : NULL, room, fmt, ap);
+    if (need < 0) errorf("formatting failed\n");
+
+    if ((size_t)need >= room) {
+        sb_reserve(sb, (size_t)need + 1);
+        vsnprintf(sb->data + sb->len, (size_t)need + 1, fmt, again);
+    }
+    va_end(again);
+    sb->len += (size_t)need;
+}
+
+void sb_printf(StrBuf *sb, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    sb_vprintf(sb, fmt, ap);
+    va_end(ap);
+}
+
+bool sb_write(const StrBuf *sb, FILE *out) {
+    return sb->len == 0 || fwrite(sb->data, 1, sb->len, out) == sb->len;
+}
+
+/* ---------------------------------------------------------
+   SOURCE FILES
+   --------------------------------------------------------- */
+
+void source_open(SourceBuf *src, const char *filename) {
+    src->data = "";
+    src->size = 0;
+    src->map_handle = NULL;
+    src->mapped = false;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        errorf("%s: cannot open file (error %lu)\n", filename, GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+        errorf("%s: cannot read file size (error %lu)\n", filename, GetLastError());
+
+    if (size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const char *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (!view)
+            errorf("%s: cannot map file (error %lu)\n", filename, GetLastError());
+        src->data = view;
+        src->size = (size_t)size.QuadPart;
+        src->map_handle = mapping;
+        src->mapped = true;
+    }
+    /* The mapping keeps its own reference to the file */
+    CloseHandle(file);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        errorf("%s: %s\n", filename, strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        errorf("%s: %s\n", filename, strerror(err));
+    }
+
+    if (st.st_size > 0) {
+        void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            errorf("%s: %s\n", filename, strerror(err));
+        }
+        src->data = view;
+        src->size = (size_t)st.st_size;
+        src->mapped = true;
+    }
+    close(fd);
+#endif
+}
+
+void source_close(SourceBuf *src) {
+    if (src->mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile((void *)src->data);
+        CloseHandle((HANDLE)src->map_handle);
+#else
+        munmap((void *)src->data, src->size);
+#endif
+    }
+    src->data = "";
+    src->size = 0;
+    src->map_handle = NULL;
+    src->mapped = false;
+}
+
+bool is_directory(const char *path) {
+#ifdef _WIN32
+    DWORD attr = GetFileAttributesA(path);
+    return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+/* ---------------------------------------------------------
+   ERROR TRAPS
+   --------------------------------------------------------- */
+
+bool catch_errors(void (*fn)(void *arg), void *arg, StrBuf *diag) {
+    ErrorTrap trap;
+    ErrorTrap *outer = error_trap;
+
+    trap.diag = diag;
+    trap.cleanups = NULL;
+    error_trap = &trap;
+    if (setjmp(trap.env)) {
+        error_trap = outer;
+        return false;
+    }
+    fn(arg);
+    error_trap = outer;
+    return true;
+}
+
+void error_cleanup_push(ErrorCleanup *c, void (*fn)(void *arg), void *arg) {
+    c->fn = fn;
+    c->arg = arg;
+    c->next = NULL;
+    if (!error_trap) return;
+    c->next = error_trap->cleanups;
+    error_trap->cleanups = c;
+}
+
+void error_cleanup_pop(ErrorCleanup *c) {
+    if (!error_trap) return;
+    assert(error_trap->cleanups == c);
+    error_trap->cleanups = c->next;
+}
+
+/* ---------------------------------------------------------
+   THREADS
+   --------------------------------------------------------- */
+
+/* Workers recurse as deeply as the main thread, so give them its stack size */
+#define WORKER_STACK_SIZE (8 * 1024 * 1024)
+
+typedef struct Pool {
+    int next, count;
+    void (*job)(void *ctx, int i);
+    void *ctx;
+} Pool;
+
+/* Guards Pool.next; held only to hand out one index */
+static Mutex pool_lock = MUTEX_INIT;
+
+static void pool_work(Pool *p) {
+    for (;;) {
+        mutex_lock(&pool_lock);
+        int i = p->next < p->count ? p->next++ : -1;
+        mutex_unlock(&pool_lock);
+        if (i < 0) return;
+        p->job(p->ctx, i);
+    }
+}
+
+#ifdef _WIN32
+
+void mutex_lock(Mutex *m) {
+    AcquireSRWLockExclusive((PSRWLOCK)&m->impl);
+}
+
+void mutex_unlock(Mutex *m) {
+    ReleaseSRWLockExclusive((PSRWLOCK)&m->impl);
+}
+
+typedef struct OnceFn {
+    void (*fn)(void);
+} OnceFn;
+
+static BOOL CALLBACK once_thunk(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+    (void)once;
+    (void)ctx;
+    ((OnceFn *)param)->fn();
+    return TRUE;
+}
+
+void run_once(Once *once, void (*fn)(void)) {
+    OnceFn box = { fn };
+    InitOnceExecuteOnce((PINIT_ONCE)&once->impl, once_thunk, &box, NULL);
+}
+
+int cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+static DWORD WINAPI pool_thread(LPVOID p) {
+    pool_work(p);
+    return 0;
+}
+
+void run_parallel(int count, int threads, void (*job)(void *ctx, int i), void *ctx) {
+    Pool pool = { 0, count, job, ctx };
+    if (threads > count) threads = count;
+
+    /* The calling thread is one of the workers */
+    HANDLE *h = threads > 1 ? xmalloc(sizeof(HANDLE) * (size_t)(threads - 1)) : NULL;
+    int started = 0;
+    for (; started < threads - 1; started++) {
+        h[started] = CreateThread(NULL, WORKER_STACK_SIZE, pool_thread, &pool,
+                                  STACK_SIZE_PARAM_IS_A_RESERVATION, NULL);
+        if (!h[started]) break;
+    }
+    pool_work(&pool);
+    for (int t = 0; t < started; t++) {
+        WaitForSingleObject(h[t], INFINITE);
+        CloseHandle(h[t]);
+    }
+    free(h);
+}
+
+#else
+
+void mutex_lock(Mutex *m) {
+    pthread_mutex_lock(&m->impl);
+}
+
+void mutex_unlock(Mutex *m) {
+    pthread_mutex_unlock(&m->impl);
+}
+
+void run_once(Once *once, void (*fn)(void)) {
+    pthread_once(&once->impl, fn);
+}
+
+int cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void *pool_thread(void *p) {
+    pool_work(p);
+    return NULL;
+}
+
+void run_parallel(int count, int threads, void (*job)(void *ctx, int i), void *ctx) {
+    Pool pool = { 0, count, job, ctx };
+    if (threads > count) threads = count;
+
+    /* The calling thread is one of the workers */
+    pthread_t *th = threads > 1 ? xmalloc(sizeof(pthread_t) * (size_t)(threads - 1)) : NULL;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, WORKER_STACK_SIZE);
+
+    /* If a thread cannot be created, the ones already running take its share */
+    int started = 0;
+    for (; started < threads - 1; started++)
+        if (pthread_create(&th[started], &attr, pool_thread, &pool) != 0) break;
+    pthread_attr_destroy(&attr);
+
+    pool_work(&pool);
+    for (int t = 0; t < started; t++)
+        pthread_join(th[t], NULL);
+    free(th);
+}
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file intern.c
+ * @brief Open-addressed hash table of unique names.
+ *
+ * Spellings live in an arena; the table stores symbol ids (0 = empty slot,
+ * which is safe because SYM_NONE is never looked up) and is kept at most
+ * half full, so probe sequences stay short.
+ *
+ * Units compiled in parallel share the interner. Lookups and insertions
+ * take a lock; sym_name does not, because entries live in fixed-size
+ * pages that never move once published, and a thread only ever asks for
+ * symbols it has already been handed by intern().
+ */
+
+#include "../include/intern.h"
+#include "../include/common.h"
+
+#include <assert.h>
+#include <string.h>
+
+typedef struct NameEntry {
+    const char *name;
+    uint32_t len;
+    uint32_t hash;
+} NameEntry;
+
+#define NAME_PAGE_BITS 12
+#define NAME_PAGE_SIZE (1u << NAME_PAGE_BITS)
+#define NAME_PAGES     (1u << 16)
+
+typedef struct Interner {
+    NameEntry *pages[NAME_PAGES];   /* Entry of Symbol s: pages[s >> BITS][s & mask] */
+    uint32_t count;
+
+    Symbol *table;          /* Open-addressed, power-of-two size */
+    uint32_t table_size;
+
+    Arena strings;
+} Interner;
+
+static Interner I;
+static Mutex intern_lock = MUTEX_INIT;
+static Once intern_ready = ONCE_INIT;
+
+static const char *const builtin_names[SYM_BUILTIN_COUNT] = {
+    [SYM_NONE]    = "",
+    [SYM_LET]     = "let",
+    [SYM_IF]      = "if",
+    [SYM_ELSE]    = "else",
+    [SYM_WHILE]   = "while",
+    [SYM_FOR]     = "for",
+    [SYM_IN]      = "in",
+    [SYM_PAR]     = "par",
+    [SYM_INT]     = "int",
+    [SYM_STRING]  = "string",
+    [SYM_PRINT]   = "print",
+    [SYM_PRINTLN] = "println",
+    [SYM_CLONE]   = "clone",
+    [SYM_RC]      = "Rc",
+    [SYM_MAIN]    = "main",
+};
+
+/** FNV-1a */
+static uint32_t hash_name(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static NameEntry *entry(Symbol sym) {
+    return &I.pages[sym >> NAME_PAGE_BITS][sym & (NAME_PAGE_SIZE - 1)];
+}
+
+static void rehash(uint32_t size) {
+    free(I.table);
+    I.table = xmalloc(sizeof(Symbol) * size);
+    memset(I.table, 0, sizeof(Symbol) * size);
+    I.table_size = size;
+
+    for (Symbol sym = 1; sym < I.count; sym++) {
+        uint32_t i = entry(sym)->hash & (size - 1);
+        while (I.table[i]) i = (i + 1) & (size - 1);
+        I.table[i] = sym;
+    }
+}
+
+static Symbol add_name(const char *s, size_t len, uint32_t hash) {
+    if ((I.count & (NAME_PAGE_SIZE - 1)) == 0) {
+        /* Not errorf: that could unwind with intern_lock held */
+        if ((I.count >> NAME_PAGE_BITS) == NAME_PAGES) {
+            fprintf(stderr, "FATAL: too many distinct names\n");
+            exit(1);
+        }
+        I.pages[I.count >> NAME_PAGE_BITS] = xmalloc(sizeof(NameEntry) * NAME_PAGE_SIZE);
+    }
+
+    char *copy = arena_alloc(&I.strings, len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+
+    Symbol sym = I.count++;
+    NameEntry *e = entry(sym);
+    e->name = copy;
+    e->len = (uint32_t)len;
+    e->hash = hash;
+
+    if (sym != SYM_NONE) {
+        if (I.count * 2 > I.table_size) {
+            rehash(I.table_size * 2);
+        } else {
+            uint32_t i = hash & (I.table_size - 1);
+            while (I.table[i]) i = (i + 1) & (I.table_size - 1);
+            I.table[i] = sym;
+        }
+    }
+    return sym;
+}
+
+static void intern_init(void) {
+    arena_init(&I.strings);
+    rehash(512);
+    for (int k = 0; k < SYM_BUILTIN_COUNT; k++) {
+        const char *s = builtin_names[k];
+        Symbol sym = add_name(s, strlen(s), hash_name(s, strlen(s)));
+        assert(sym == (Symbol)k);
+        (void)sym;
+    }
+}
+
+Symbol intern(const char *s, size_t len) {
+    run_once(&intern_ready, intern_init);
+
+    uint32_t h = hash_name(s, len);
+    Symbol sym = SYM_NONE;
+    mutex_lock(&intern_lock);
+    uint32_t mask = I.table_size - 1;
+    for (uint32_t i = h & mask; I.table[i]; i = (i + 1) & mask) {
+        NameEntry *e = entry(I.table[i]);
+        if (e->hash == h && e->len == len && memcmp(e->name, s, len) == 0) {
+            sym = I.table[i];
+            break;
+        }
+    }
+    if (sym == SYM_NONE) sym = add_name(s, len, h);
+    mutex_unlock(&intern_lock);
+    return sym;
+}
+
+Symbol intern_cstr(const char *s) {
+    return intern(s, strlen(s));
+}
+
+const char *sym_name(Symbol sym) {
+    run_once(&intern_ready, intern_init);
+    return entry(sym)->name;
+}
+
+uint32_t intern_count(void) {
+    run_once(&intern_ready, intern_init);
+    mutex_lock(&intern_lock);
+    uint32_t n = I.count;
+    mutex_unlock(&intern_lock);
+    return n;
+}
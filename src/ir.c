@@ -0,0 +1,1111 @@
+/**
+ * @file ir.c
+ * @brief Lowering from the type-annotated AST to the linear IR.
+ *
+ * Expressions are flattened in post-order, so every temporary is used
+ * exactly once and in LIFO order before any optimization runs. The -O0
+ * backend relies on this to emit temporaries as plain push/pop pairs.
+ */
+
+#include "../include/ir.h"
+#include "../include/ast.h"
+#include "../include/symtab.h"
+#include "../include/common.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *const ir_runtime_names[RT_COUNT] = {
+    [RT_CLONE_STRING]       = "runtime_clone_string",
+    [RT_DROP_STRING]        = "runtime_drop_string",
+    [RT_PRINT_INT]          = "runtime_print_int",
+    [RT_PRINT_STRING]       = "runtime_print_string",
+    [RT_ARENA_ENTER]        = "runtime_arena_enter",
+    [RT_ARENA_LEAVE]        = "runtime_arena_leave",
+    [RT_ARENA_CLONE_STRING] = "runtime_arena_clone_string",
+    [RT_FLUSH]              = "runtime_flush",
+    [RT_BOUNDS_FAIL]        = "runtime_bounds_fail",
+    [RT_RC_NEW]             = "runtime_rc_new",
+    [RT_RC_RETAIN]          = "runtime_rc_retain",
+    [RT_RC_RELEASE]         = "runtime_rc_release",
+    [RT_PAR_FOR]            = "runtime_par_for",
+    [RT_PROFILE_BEGIN]      = "runtime_profile_begin",
+    [RT_PROFILE_END]        = "runtime_profile_end",
+};
+
+/** Values a for-loop variable takes while its body runs. */
+typedef struct LoopRange {
+    int slot;
+    long lo, hi;        /* Inclusive */
+} LoopRange;
+
+/** Lowering context. */
+typedef struct IrBuilder {
+    IrFunc *fn;
+    IrBlock *cur;           /* Block receiving new instructions */
+
+    IrBlock **created;      /* Blocks in creation order (provisional ids) */
+    int ncreated, created_cap;
+
+    SymTab names;           /* Slot (int) of every visible declaration */
+
+    int *owned;             /* Slots to drop at exit, innermost scope last */
+    int nowned, owned_cap;
+
+    LoopRange *ranges;      /* Enclosing loops whose variable has a known range */
+    int nranges, ranges_cap;
+
+    int loop_depth;
+    bool in_par;            /* Lowering a par chunk: new blocks and slots are its own */
+    bool string_arena;      /* Frame-local clones come from the arena */
+    int unroll;             /* Largest unroll factor for counted loops */
+} IrBuilder;
+
+/* ---------------------------------------------------------
+   CONSTRUCTION HELPERS
+   --------------------------------------------------------- */
+
+/** Grows a dynamic array to hold at least `need` elements of `elem` bytes. */
+static void *grow(void *p, int *cap, int need, size_t elem) {
+    if (need <= *cap) return p;
+    int n = *cap ? *cap * 2 : 8;
+    while (n < need) n *= 2;
+    *cap = n;
+    return xrealloc(p, elem * (size_t)n);
+}
+
+/**
+ * @brief Creates a detached block.
+ * Blocks receive a provisional id at creation so that forward branches can
+ * name them; they are laid out in the order emission first reaches them.
+ */
+static IrBlock *new_block(IrBuilder *b, const char *hint) {
+    b->created = grow(b->created, &b->created_cap, b->ncreated + 1, sizeof(IrBlock *));
+
+    IrBlock *blk = xmalloc(sizeof(IrBlock));
+    blk->id = b->ncreated;
+    blk->hint = hint;
+    blk->par = b->in_par;
+    blk->count = -1;
+    blk->code = NULL;
+    blk->n = blk->cap = 0;
+    b->created[b->ncreated++] = blk;
+    return blk;
+}
+
+static int new_temp(IrBuilder *b) {
+    return b->fn->ntemps++;
+}
+
+/** Returns an instruction template with every operand unset. */
+static IrInstr ins_make(IrOp op) {
+    IrInstr in;
+    in.op = op;
+    in.dst = in.a = in.b = in.slot = -1;
+    in.imm = 0;
+    in.binop = 0;
+    in.target = in.alt = -1;
+    return in;
+}
+
+/** Appends an instruction to the current block. */
+static void emit(IrBuilder *b, IrInstr in) {
+    IrBlock *blk = b->cur;
+    blk->code = grow(blk->code, &blk->cap, blk->n + 1, sizeof(IrInstr));
+    blk->code[blk->n++] = in;
+}
+
+/** Continues emission in `blk`, placing it after the blocks emitted so far. */
+static void switch_to(IrBuilder *b, IrBlock *blk) {
+    IrFunc *fn = b->fn;
+    fn->blocks = grow(fn->blocks, &fn->blocks_cap, fn->nblocks + 1, sizeof(IrBlock *));
+    fn->blocks[fn->nblocks++] = blk;
+    b->cur = blk;
+}
+
+/** Renumbers blocks to their layout position and rewrites branch targets. */
+static void finalize_layout(IrBuilder *b) {
+    IrFunc *fn = b->fn;
+    int *remap = xmalloc(sizeof(int) * (size_t)(b->ncreated ? b->ncreated : 1));
+
+    for (int i = 0; i < fn->nblocks; i++)
+        remap[fn->blocks[i]->id] = i;
+
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        blk->id = i;
+        for (int j = 0; j < blk->n; j++) {
+            IrInstr *in = &blk->code[j];
+            if (in->target >= 0) in->target = remap[in->target];
+            if (in->alt >= 0) in->alt = remap[in->alt];
+        }
+    }
+    free(remap);
+}
+
+static void emit_jmp(IrBuilder *b, IrBlock *target) {
+    IrInstr in = ins_make(IR_JMP);
+    in.target = target->id;
+    emit(b, in);
+}
+
+static void emit_br(IrBuilder *b, int cond, IrBlock *then_b, IrBlock *else_b) {
+    IrInstr in = ins_make(IR_BR);
+    in.a = cond;
+    in.target = then_b->id;
+    in.alt = else_b->id;
+    emit(b, in);
+}
+
+static int add_string(IrFunc *fn, const char *s, int len) {
+    fn->strings = grow(fn->strings, &fn->strings_cap, fn->nstrings + 1, sizeof(char *));
+    char *copy = xmalloc((size_t)len + 1);
+    memcpy(copy, s, (size_t)len);
+    copy[len] = '\0';
+    fn->strings[fn->nstrings] = copy;
+    return fn->nstrings++;
+}
+
+/** Adds a constant array (taking ownership of `values`) and returns its id. */
+static int add_array(IrFunc *fn, long *values, long len) {
+    fn->arrays = grow(fn->arrays, &fn->arrays_cap, fn->narrays + 1, sizeof(IrConstArray));
+    fn->arrays[fn->narrays].values = values;
+    fn->arrays[fn->narrays].len = len;
+    return fn->narrays++;
+}
+
+/* ---------------------------------------------------------
+   NAME RESOLUTION
+   --------------------------------------------------------- */
+
+/** Adds a slot that no name refers to. */
+static int new_slot(IrBuilder *b, Symbol name, Type t) {
+    IrFunc *fn = b->fn;
+    fn->slots = grow(fn->slots, &fn->slots_cap, fn->nslots + 1, sizeof(IrSlot));
+    IrSlot *s = &fn->slots[fn->nslots];
+    s->name = name;
+    s->type = t;
+    s->clear_on_move = false;
+    s->alias = name == SYM_NONE ? ALIAS_NONE : ALIAS_UNKNOWN;
+    s->par_local = b->in_par;
+    return fn->nslots++;
+}
+
+/** Makes `name` refer to `slot` from here to the end of the scope. */
+static void bind(IrBuilder *b, Symbol name, int slot) {
+    *(int *)symtab_declare(&b->names, name) = slot;
+}
+
+/** Declares a new variable and returns its (fresh) slot. */
+static int declare(IrBuilder *b, const Stmt *decl) {
+    int slot = new_slot(b, decl->v.decl.name, decl->v.decl.type);
+    b->fn->slots[slot].alias = decl->v.decl.alias;
+    bind(b, decl->v.decl.name, slot);
+    return slot;
+}
+
+/** Resolves a name to the slot of its innermost visible declaration. */
+static int lookup(IrBuilder *b, Symbol name, int line, int col) {
+    int *slot = symtab_lookup(&b->names, name);
+    if (slot) return *slot;
+    errorf_at(line, col, "IR error: unknown identifier '%s'\n", sym_name(name));
+    return -1;
+}
+
+/* ---------------------------------------------------------
+   OWNERSHIP
+   Strings own their heap block and an Rc owns one count of its shared
+   block. Each owning variable is dropped when its scope ends unless the
+   borrow checker proved it moved out on every path; variables that may be
+   moved from are cleared by the move, so a drop of the moved-out value is
+   a no-op.
+   --------------------------------------------------------- */
+
+static bool is_owning(Type t) {
+    return t.kind == TY_STRING || t.kind == TY_RC;
+}
+
+static IrRuntimeFn drop_fn(Type t) {
+    return t.kind == TY_RC ? RT_RC_RELEASE : RT_DROP_STRING;
+}
+
+/** Emits a call to a runtime function that returns nothing useful. */
+static void emit_call_void(IrBuilder *b, IrRuntimeFn f, int arg) {
+    IrInstr in = ins_make(IR_CALL);
+    in.imm = f;
+    in.a = arg;
+    emit(b, in);
+}
+
+/** Drops whatever `slot` currently holds. */
+static void emit_drop(IrBuilder *b, int slot) {
+    IrInstr in = ins_make(IR_LOAD);
+    in.dst = new_temp(b);
+    in.slot = slot;
+    emit(b, in);
+    emit_call_void(b, drop_fn(b->fn->slots[slot].type), in.dst);
+}
+
+/** Leaves `slot` empty (NULL) after its value was moved elsewhere. */
+static void emit_clear(IrBuilder *b, int slot) {
+    IrInstr zero = ins_make(IR_CONST);
+    zero.dst = new_temp(b);
+    emit(b, zero);
+
+    IrInstr in = ins_make(IR_STORE);
+    in.slot = slot;
+    in.a = zero.dst;
+    emit(b, in);
+}
+
+/** Clears the source of a move out of a named variable, where needed. */
+static void lower_move(IrBuilder *b, Expr *value) {
+    if (value->kind != E_IDENT || !is_owning(value->type)) return;
+    int slot = lookup(b, value->v.ident, value->line, value->col);
+    if (b->fn->slots[slot].clear_on_move)
+        emit_clear(b, slot);
+}
+
+/**
+ * With --string-arena every string stays inside the frame (there are no
+ * returns or globals to escape through), but only clones outside loops
+ * are bounded in number, so only those are placed in the arena.
+ */
+static bool clone_in_arena(IrBuilder *b) {
+    return b->string_arena && b->loop_depth == 0;
+}
+
+/** True if `e` yields a heap string or an Rc count that nothing else owns yet. */
+static bool is_owned_temp(IrBuilder *b, Expr *e) {
+    if (e->kind != E_CALL) return false;
+    if (e->v.call.name == SYM_RC) return true;
+    return e->v.call.name == SYM_CLONE && (e->type.kind == TY_RC || !clone_in_arena(b));
+}
+
+/**
+ * True for clone() of an Rc. Where the clone is only borrowed and then
+ * dropped, the increment and decrement cancel and the source is used as is.
+ */
+static bool is_rc_share(Expr *e) {
+    return e->kind == E_CALL && e->v.call.name == SYM_CLONE && e->type.kind == TY_RC;
+}
+
+/* ---------------------------------------------------------
+   EXPRESSION LOWERING
+   --------------------------------------------------------- */
+
+static void lower_array_init(IrBuilder *b, int slot, Expr *lit);
+static void lower_index(IrBuilder *b, IrInstr *access, Expr *index);
+
+/** Lowers an expression and returns the temporary holding its value. */
+static int lower_expr(IrBuilder *b, Expr *e) {
+    IrInstr in;
+
+    switch (e->kind) {
+    case E_INT_LIT:
+        in = ins_make(IR_CONST);
+        in.dst = new_temp(b);
+        in.imm = e->v.int_val;
+        emit(b, in);
+        return in.dst;
+
+    case E_STR_LIT:
+        in = ins_make(IR_STR);
+        in.dst = new_temp(b);
+        in.imm = add_string(b->fn, e->v.str.data, e->v.str.len);
+        emit(b, in);
+        return in.dst;
+
+    case E_IDENT:
+        /* An array is passed around by address, for IR_COPY to read */
+        in = ins_make(IR_LOAD);
+        in.dst = new_temp(b);
+        in.slot = lookup(b, e->v.ident, e->line, e->col);
+        if (b->fn->slots[in.slot].type.kind == TY_ARRAY) in.op = IR_ADDR;
+        emit(b, in);
+        return in.dst;
+
+    case E_ARRAY_LIT:
+        /* Built in a slot of its own: the destination may be read by the items */
+        in = ins_make(IR_ADDR);
+        in.slot = new_slot(b, SYM_NONE, e->type);
+        lower_array_init(b, in.slot, e);
+        in.dst = new_temp(b);
+        emit(b, in);
+        return in.dst;
+
+    case E_INDEX:
+        in = ins_make(IR_LOADX);
+        in.slot = lookup(b, e->v.index.array->v.ident, e->line, e->col);
+        lower_index(b, &in, e->v.index.index);
+        in.dst = new_temp(b);
+        emit(b, in);
+        return in.dst;
+
+    case E_BINOP: {
+        int l = lower_expr(b, e->v.bin.l);
+        int r = lower_expr(b, e->v.bin.r);
+        in = ins_make(IR_BIN);
+        in.dst = new_temp(b);
+        in.a = l;
+        in.b = r;
+        in.binop = e->v.bin.op;
+        emit(b, in);
+        return in.dst;
+    }
+
+    case E_ADDR:
+    case E_MUTADDR:
+        if (!e->v.inner || e->v.inner->kind != E_IDENT)
+            errorf_at(e->line, e->col, "IR error: & expects identifier\n");
+        in = ins_make(IR_ADDR);
+        in.dst = new_temp(b);
+        in.slot = lookup(b, e->v.inner->v.ident, e->line, e->col);
+        emit(b, in);
+        return in.dst;
+
+    case E_CALL: {
+        Symbol fn = e->v.call.name;
+        if (e->v.call.nargs != 1)
+            errorf_at(e->line, e->col, "IR error: %s() expects 1 argument\n", sym_name(fn));
+
+        Expr *arg = e->v.call.args[0];
+        while (is_rc_share(arg)) arg = arg->v.call.args[0];
+        int a = lower_expr(b, arg);
+
+        /* The builtins only borrow their argument: an owned temporary is
+           parked in a slot and dropped after the call */
+        int hold = -1;
+        if (is_owned_temp(b, arg)) {
+            hold = new_slot(b, SYM_NONE, arg->type);
+            IrInstr st = ins_make(IR_STORE);
+            st.slot = hold;
+            st.a = a;
+            emit(b, st);
+
+            IrInstr ld = ins_make(IR_LOAD);
+            a = ld.dst = new_temp(b);
+            ld.slot = hold;
+            emit(b, ld);
+        }
+
+        in = ins_make(IR_CALL);
+        in.a = a;
+
+        if (fn == SYM_PRINT) {
+            bool text = arg->type.kind == TY_STRING || arg->type.kind == TY_RC;
+            in.imm = text ? RT_PRINT_STRING : RT_PRINT_INT;
+            emit(b, in);
+            if (hold >= 0) emit_drop(b, hold);
+
+            /* print() evaluates to 0 when used as a value */
+            IrInstr zero = ins_make(IR_CONST);
+            zero.dst = new_temp(b);
+            zero.imm = 0;
+            emit(b, zero);
+            return zero.dst;
+        }
+        if (fn == SYM_CLONE || fn == SYM_RC) {
+            if (fn == SYM_RC) in.imm = RT_RC_NEW;
+            else if (arg->type.kind == TY_RC) in.imm = RT_RC_RETAIN;
+            else in.imm = clone_in_arena(b) ? RT_ARENA_CLONE_STRING : RT_CLONE_STRING;
+            in.dst = new_temp(b);
+            emit(b, in);
+            if (hold >= 0) emit_drop(b, hold);
+            return in.dst;
+        }
+        errorf_at(e->line, e->col, "IR error: unknown function '%s'\n", sym_name(fn));
+        return -1;
+    }
+
+    default:
+        errorf_at(e->line, e->col, "IR error: unsupported expr kind %d\n", e->kind);
+        return -1;
+    }
+}
+
+/* ---------------------------------------------------------
+   STATEMENT LOWERING
+   --------------------------------------------------------- */
+
+/** Lowers `name = value`, dropping the value it replaces. */
+static void lower_assign(IrBuilder *b, Stmt *s) {
+    int slot = lookup(b, s->v.assign.name, s->line, s->col);
+    Expr *value = s->v.assign.value;
+
+    if (s->v.assign.index) {
+        IrInstr in = ins_make(IR_STOREX);
+        in.slot = slot;
+        lower_index(b, &in, s->v.assign.index);
+        in.b = lower_expr(b, value);
+        emit(b, in);
+        return;
+    }
+    if (b->fn->slots[slot].type.kind == TY_ARRAY) {
+        IrInstr in = ins_make(IR_COPY);
+        in.slot = slot;
+        in.a = lower_expr(b, value);
+        emit(b, in);
+        return;
+    }
+
+    IrInstr in = ins_make(IR_STORE);
+    in.slot = slot;
+    in.a = lower_expr(b, value);
+
+    /* The new value is computed first: it may be a clone of the old one */
+    if (is_owning(b->fn->slots[slot].type)) {
+        bool self_move = value->kind == E_IDENT &&
+                         lookup(b, value->v.ident, value->line, value->col) == slot;
+        if (!self_move) {
+            lower_move(b, value);
+            if (s->v.assign.drop_old) emit_drop(b, slot);
+        }
+    }
+    emit(b, in);
+}
+
+/* ---------------------------------------------------------
+   COUNTED LOOPS
+   `for x in start..end` runs a hidden counter from start up to (not
+   including) end, both evaluated once. The loop is rotated: one guard
+   before it and a single increment, compare and branch at the bottom.
+   When both bounds are constant the trip count is known, so the guard
+   disappears and short loop bodies are unrolled by 4 or 8, the
+   remaining iterations following the loop as straight-line copies.
+   --------------------------------------------------------- */
+
+/* Bodies larger than this many AST nodes are never unrolled */
+#define UNROLL_MAX_NODES 32
+
+static void lower_stmt(IrBuilder *b, Stmt *s);
+
+static int emit_const(IrBuilder *b, long v) {
+    IrInstr in = ins_make(IR_CONST);
+    in.dst = new_temp(b);
+    in.imm = v;
+    emit(b, in);
+    return in.dst;
+}
+
+static int emit_load(IrBuilder *b, int slot) {
+    IrInstr in = ins_make(IR_LOAD);
+    in.dst = new_temp(b);
+    in.slot = slot;
+    emit(b, in);
+    return in.dst;
+}
+
+static void emit_store(IrBuilder *b, int slot, int t) {
+    IrInstr in = ins_make(IR_STORE);
+    in.slot = slot;
+    in.a = t;
+    emit(b, in);
+}
+
+static int emit_bin(IrBuilder *b, char op, int l, int r) {
+    IrInstr in = ins_make(IR_BIN);
+    in.dst = new_temp(b);
+    in.a = l;
+    in.b = r;
+    in.binop = op;
+    emit(b, in);
+    return in.dst;
+}
+
+/** Value of a bound built from int literals with + - * (including -k). */
+static bool const_bound(const Expr *e, long *out) {
+    long l, r;
+    if (e->kind == E_INT_LIT) {
+        *out = e->v.int_val;
+        return true;
+    }
+    if (e->kind != E_BINOP || !const_bound(e->v.bin.l, &l) || !const_bound(e->v.bin.r, &r))
+        return false;
+
+    /* Two's-complement wraparound, as in the emitted code */
+    unsigned long ul = (unsigned long)l, ur = (unsigned long)r;
+    switch (e->v.bin.op) {
+    case '+': *out = (long)(ul + ur); return true;
+    case '-': *out = (long)(ul - ur); return true;
+    case '*': *out = (long)(ul * ur); return true;
+    default:  return false;
+    }
+}
+
+/** True if `s` may assign to the variable `name` (by that name, in any scope). */
+static bool assigns_to(const Stmt *s, Symbol name) {
+    if (!s) return false;
+    switch (s->kind) {
+    case S_ASSIGN:
+        return s->v.assign.name == name && !s->v.assign.index;
+    case S_BLOCK:
+        for (int i = 0; i < s->v.block.n; i++)
+            if (assigns_to(s->v.block.stmts[i], name)) return true;
+        return false;
+    case S_IF:
+        return assigns_to(s->v.ifs.then_s, name) || assigns_to(s->v.ifs.else_s, name);
+    case S_WHILE:
+        return assigns_to(s->v.wh.body, name);
+    case S_FOR:
+        return assigns_to(s->v.fors.body, name);
+    default:
+        return false;
+    }
+}
+
+/** Binds the induction variable `var_slot` to `value` and lowers one copy of the body. */
+static void lower_iteration(IrBuilder *b, Stmt *s, int var_slot, int value) {
+    emit_store(b, var_slot, value);
+    lower_stmt(b, s->v.fors.body);
+}
+
+static void lower_for(IrBuilder *b, Stmt *s) {
+    Expr *range = s->v.fors.iter;
+    Stmt *var = s->v.fors.var;
+
+    /* Trip count, or -1 when a bound is only known at run time */
+    long lo, hi, trips = -1;
+    if (const_bound(range->v.range.start, &lo) && const_bound(range->v.range.end, &hi)) {
+        if (hi <= lo) return;  /* Never runs, and constant bounds have no effects */
+        if (lo >= 0 || hi <= LONG_MAX + lo) trips = hi - lo;
+    }
+
+    int unroll = 1;
+    if (trips > 0 && ast_count_stmt(s->v.fors.body) <= UNROLL_MAX_NODES) {
+        if (b->unroll >= 8 && trips >= 16) unroll = 8;
+        else if (b->unroll >= 4 && trips >= 4) unroll = 4;
+    }
+
+    int counter = new_slot(b, SYM_NONE, mktype(TY_INT));
+    int bound = -1;     /* Slot of a run-time end bound */
+    emit_store(b, counter, lower_expr(b, range->v.range.start));
+    if (trips < 0) {
+        bound = new_slot(b, SYM_NONE, mktype(TY_INT));
+        emit_store(b, bound, lower_expr(b, range->v.range.end));
+    }
+
+    IrBlock *body = new_block(b, "for");
+    IrBlock *exit_b = new_block(b, "endfor");
+    long main_end = trips < 0 ? 0 : lo + trips / unroll * unroll;
+
+    if (trips < 0) {
+        int c = emit_load(b, counter);
+        emit_br(b, emit_bin(b, '<', c, emit_load(b, bound)), body, exit_b);
+    } else {
+        emit_jmp(b, body);
+    }
+
+    b->loop_depth++;
+    symtab_push(&b->names);
+    int var_slot = declare(b, var);
+
+    /* With constant bounds the variable stays in range unless the body assigns it */
+    int mark = b->nranges;
+    if (trips > 0 && !assigns_to(s->v.fors.body, var->v.decl.name)) {
+        b->ranges = grow(b->ranges, &b->ranges_cap, b->nranges + 1, sizeof(LoopRange));
+        b->ranges[b->nranges++] = (LoopRange){ var_slot, lo, hi - 1 };
+    }
+
+    switch_to(b, body);
+    for (int k = 0; k < unroll; k++) {
+        int c = emit_load(b, counter);
+        lower_iteration(b, s, var_slot, k ? emit_bin(b, '+', c, emit_const(b, k)) : c);
+    }
+
+    /* Latch: step the counter and test it against the end bound */
+    int c = emit_load(b, counter);
+    emit_store(b, counter, emit_bin(b, '+', c, emit_const(b, unroll)));
+    c = emit_load(b, counter);
+    int end = bound >= 0 ? emit_load(b, bound) : emit_const(b, main_end);
+    emit_br(b, emit_bin(b, '<', c, end), body, exit_b);
+
+    switch_to(b, exit_b);
+    for (long k = main_end; trips > 0 && k < hi; k++)
+        lower_iteration(b, s, var_slot, emit_const(b, k));
+
+    b->nranges = mark;
+    symtab_pop(&b->names);
+    b->loop_depth--;
+}
+
+/** Emits `dst = arg #k` of the current par chunk. */
+static int emit_arg(IrBuilder *b, long k) {
+    IrInstr in = ins_make(IR_ARG);
+    in.dst = new_temp(b);
+    in.imm = k;
+    emit(b, in);
+    return in.dst;
+}
+
+/**
+ * @brief Lowers `par for`: the body becomes a chunk looping over the
+ * sub-range its caller hands it, and IR_PAR splits the full range
+ * between the runtime's threads. Chunks are never empty, so the loop
+ * is entered without a test. Nothing is unrolled; each chunk already
+ * runs many iterations.
+ */
+static void lower_par_for(IrBuilder *b, Stmt *s) {
+    Expr *range = s->v.fors.iter;
+    Stmt *var = s->v.fors.var;
+
+    long lo, hi;
+    bool known = const_bound(range->v.range.start, &lo) && const_bound(range->v.range.end, &hi);
+    if (known && hi <= lo) return;  /* Never runs, and constant bounds have no effects */
+
+    IrInstr par = ins_make(IR_PAR);
+    par.a = lower_expr(b, range->v.range.start);
+    par.b = lower_expr(b, range->v.range.end);
+
+    IrBlock *exit_b = new_block(b, "endpar");
+    b->in_par = true;
+    IrBlock *entry = new_block(b, "par");
+    IrBlock *body = new_block(b, "parbody");
+    IrBlock *done = new_block(b, "parend");
+    par.target = entry->id;
+    par.alt = exit_b->id;
+    emit(b, par);
+
+    /* hi first: the backend reads both from argument registers */
+    switch_to(b, entry);
+    emit(b, ins_make(IR_ENTER));
+    int counter = new_slot(b, SYM_NONE, mktype(TY_INT));
+    int bound = new_slot(b, SYM_NONE, mktype(TY_INT));
+    emit_store(b, bound, emit_arg(b, 1));
+    emit_store(b, counter, emit_arg(b, 0));
+    emit_jmp(b, body);
+
+    b->loop_depth++;
+    symtab_push(&b->names);
+    int var_slot = declare(b, var);
+
+    /* Every chunk stays within the full range */
+    int mark = b->nranges;
+    if (known && (lo >= 0 || hi <= LONG_MAX + lo) && !assigns_to(s->v.fors.body, var->v.decl.name)) {
+        b->ranges = grow(b->ranges, &b->ranges_cap, b->nranges + 1, sizeof(LoopRange));
+        b->ranges[b->nranges++] = (LoopRange){ var_slot, lo, hi - 1 };
+    }
+
+    switch_to(b, body);
+    lower_iteration(b, s, var_slot, emit_load(b, counter));
+    int c = emit_load(b, counter);
+    emit_store(b, counter, emit_bin(b, '+', c, emit_const(b, 1)));
+    c = emit_load(b, counter);
+    emit_br(b, emit_bin(b, '<', c, emit_load(b, bound)), body, done);
+
+    switch_to(b, done);
+    emit(b, ins_make(IR_LEAVE));
+
+    b->nranges = mark;
+    symtab_pop(&b->names);
+    b->loop_depth--;
+    b->in_par = false;
+    switch_to(b, exit_b);
+}
+
+/* ---------------------------------------------------------
+   ARRAYS
+   An array slot holds its elements in place. Indices are checked
+   against the length at run time unless their range is known to fit:
+   constants, the variable of an enclosing loop with constant bounds,
+   and sums and differences of those.
+   --------------------------------------------------------- */
+
+/* Literals with at least this many elements start as a copy of read-only data */
+#define ARRAY_COPY_MIN 8
+
+/* Range analysis gives up beyond this magnitude, well clear of overflow */
+#define RANGE_LIMIT (LONG_MAX / 4)
+
+/** Inclusive range of values `e` may take, if it is known. */
+static bool index_range(IrBuilder *b, const Expr *e, long *lo, long *hi) {
+    long l1, h1, l2, h2;
+    switch (e->kind) {
+    case E_INT_LIT:
+        *lo = *hi = e->v.int_val;
+        break;
+    case E_IDENT: {
+        int *slot = symtab_lookup(&b->names, e->v.ident);
+        int k = b->nranges - 1;
+        while (k >= 0 && (!slot || b->ranges[k].slot != *slot)) k--;
+        if (k < 0) return false;
+        *lo = b->ranges[k].lo;
+        *hi = b->ranges[k].hi;
+        break;
+    }
+    case E_BINOP:
+        if ((e->v.bin.op != '+' && e->v.bin.op != '-') ||
+            !index_range(b, e->v.bin.l, &l1, &h1) || !index_range(b, e->v.bin.r, &l2, &h2))
+            return false;
+        *lo = e->v.bin.op == '+' ? l1 + l2 : l1 - h2;
+        *hi = e->v.bin.op == '+' ? h1 + h2 : h1 - l2;
+        break;
+    default:
+        return false;
+    }
+    return *lo >= -RANGE_LIMIT && *hi <= RANGE_LIMIT;
+}
+
+/**
+ * @brief Sets the index operand of the IR_LOADX/IR_STOREX `access`.
+ * A literal index was checked by the semantic pass and becomes an
+ * immediate; any other is computed and checked unless it is known
+ * to be in range.
+ */
+static void lower_index(IrBuilder *b, IrInstr *access, Expr *index) {
+    if (index->kind == E_INT_LIT) {
+        access->imm = index->v.int_val;
+        return;
+    }
+
+    long len = b->fn->slots[access->slot].type.len, lo, hi;
+    access->a = lower_expr(b, index);
+    if (index_range(b, index, &lo, &hi) && lo >= 0 && hi < len) return;
+
+    IrInstr in = ins_make(IR_BOUNDS);
+    in.dst = new_temp(b);
+    in.a = access->a;
+    in.imm = len;
+    emit(b, in);
+    access->a = in.dst;
+}
+
+/** Stores `value` into element `k` of `slot`. */
+static void emit_store_elem(IrBuilder *b, int slot, long k, int value) {
+    IrInstr in = ins_make(IR_STOREX);
+    in.slot = slot;
+    in.imm = k;
+    in.b = value;
+    emit(b, in);
+}
+
+/**
+ * @brief Fills `slot` from the array literal `lit`, left to right.
+ * Long literals copy their constant elements from read-only data in one
+ * block (zeros stand in for the rest) and then store the others.
+ */
+static void lower_array_init(IrBuilder *b, int slot, Expr *lit) {
+    int n = lit->v.array.count;
+    Expr **items = lit->v.array.items;
+
+    if (n < ARRAY_COPY_MIN) {
+        for (int k = 0; k < n; k++)
+            emit_store_elem(b, slot, k, lower_expr(b, items[k]));
+        return;
+    }
+
+    long *values = xmalloc(sizeof(long) * (size_t)n);
+    bool *known = xmalloc(sizeof(bool) * (size_t)n);
+    for (int k = 0; k < n; k++) {
+        known[k] = const_bound(items[k], &values[k]);
+        if (!known[k]) values[k] = 0;
+    }
+
+    IrInstr data = ins_make(IR_ARRAY);
+    data.dst = new_temp(b);
+    data.imm = add_array(b->fn, values, n);
+    emit(b, data);
+
+    IrInstr copy = ins_make(IR_COPY);
+    copy.slot = slot;
+    copy.a = data.dst;
+    emit(b, copy);
+
+    /* Constant items have no effects, so this keeps the evaluation order */
+    for (int k = 0; k < n; k++)
+        if (!known[k]) emit_store_elem(b, slot, k, lower_expr(b, items[k]));
+    free(known);
+}
+
+/** Lowers the declaration of an array variable. */
+static void lower_array_decl(IrBuilder *b, Stmt *s) {
+    Expr *init = s->v.decl.init;
+    int slot = new_slot(b, s->v.decl.name, s->v.decl.type);
+    b->fn->slots[slot].alias = s->v.decl.alias;
+
+    /* The initializer is evaluated before the new name becomes visible */
+    if (!init) {
+        IrInstr in = ins_make(IR_ZERO);
+        in.slot = slot;
+        emit(b, in);
+    } else if (init->kind == E_ARRAY_LIT) {
+        lower_array_init(b, slot, init);
+    } else {
+        IrInstr in = ins_make(IR_COPY);
+        in.slot = slot;
+        in.a = lower_expr(b, init);
+        emit(b, in);
+    }
+    bind(b, s->v.decl.name, slot);
+}
+
+/** Registers a declared owning variable for its scope-exit drop. */
+static void own_slot(IrBuilder *b, Stmt *s, int slot) {
+    if (!is_owning(s->v.decl.type)) return;
+    b->fn->slots[slot].clear_on_move = s->v.decl.clear_on_move;
+    if (!s->v.decl.drop_at_exit || s->v.decl.rc_alias) return;
+
+    b->owned = grow(b->owned, &b->owned_cap, b->nowned + 1, sizeof(int));
+    b->owned[b->nowned++] = slot;
+}
+
+static void lower_stmt(IrBuilder *b, Stmt *s) {
+    if (!s) return;
+
+    switch (s->kind) {
+    case S_DECL: {
+        if (s->v.decl.type.kind == TY_ARRAY) {
+            lower_array_decl(b, s);
+            break;
+        }
+
+        /* The initializer is evaluated before the new name becomes visible */
+        if (s->v.decl.init) {
+            /* A share the borrow checker proved redundant takes no count */
+            Expr *init = s->v.decl.init;
+            if (s->v.decl.rc_alias) init = init->v.call.args[0];
+            int v = lower_expr(b, init);
+            lower_move(b, s->v.decl.init);
+            IrInstr in = ins_make(IR_STORE);
+            in.slot = declare(b, s);
+            in.a = v;
+            emit(b, in);
+            own_slot(b, s, in.slot);
+        } else {
+            IrInstr zero = ins_make(IR_CONST);
+            zero.dst = new_temp(b);
+            emit(b, zero);
+
+            IrInstr in = ins_make(IR_STORE);
+            in.slot = declare(b, s);
+            in.a = zero.dst;
+            emit(b, in);
+            own_slot(b, s, in.slot);
+        }
+        break;
+    }
+
+    case S_ASSIGN:
+        lower_assign(b, s);
+        break;
+
+    case S_EXPR: {
+        /* The value is discarded; the temporary simply has no use */
+        Expr *e = s->v.expr;
+        while (is_rc_share(e)) e = e->v.call.args[0];
+        int t = lower_expr(b, e);
+        if (is_owned_temp(b, e))
+            emit_call_void(b, drop_fn(e->type), t);
+        break;
+    }
+
+    case S_BLOCK: {
+        symtab_push(&b->names);
+        int mark = b->nowned;
+        for (int i = 0; i < s->v.block.n; i++)
+            lower_stmt(b, s->v.block.stmts[i]);
+
+        /* Scope exit: drop in reverse declaration order */
+        while (b->nowned > mark)
+            emit_drop(b, b->owned[--b->nowned]);
+        symtab_pop(&b->names);
+        break;
+    }
+
+    case S_IF: {
+        IrBlock *then_b = new_block(b, "then");
+        IrBlock *else_b = s->v.ifs.else_s ? new_block(b, "else") : NULL;
+        IrBlock *end_b = new_block(b, "end");
+
+        emit_br(b, lower_expr(b, s->v.ifs.cond), then_b, else_b ? else_b : end_b);
+
+        switch_to(b, then_b);
+        lower_stmt(b, s->v.ifs.then_s);
+        emit_jmp(b, end_b);
+
+        if (else_b) {
+            switch_to(b, else_b);
+            lower_stmt(b, s->v.ifs.else_s);
+            emit_jmp(b, end_b);
+        }
+
+        switch_to(b, end_b);
+        break;
+    }
+
+    case S_WHILE: {
+        IrBlock *head = new_block(b, "while");
+        IrBlock *body = new_block(b, "body");
+        IrBlock *exit_b = new_block(b, "endwhile");
+
+        emit_jmp(b, head);
+
+        b->loop_depth++;
+        switch_to(b, head);
+        emit_br(b, lower_expr(b, s->v.wh.cond), body, exit_b);
+
+        switch_to(b, body);
+        lower_stmt(b, s->v.wh.body);
+        emit_jmp(b, head);
+        b->loop_depth--;
+
+        switch_to(b, exit_b);
+        break;
+    }
+
+    case S_FOR:
+        if (s->v.fors.par) lower_par_for(b, s);
+        else lower_for(b, s);
+        break;
+
+    default:
+        errorf_at(s->line, s->col, "IR error: unsupported stmt kind %d\n", s->kind);
+    }
+}
+
+/* ---------------------------------------------------------
+   PUBLIC INTERFACE
+   --------------------------------------------------------- */
+
+/** Error cleanup: the builder's state and the function built so far. */
+static void builder_free(void *arg) {
+    IrBuilder *b = arg;
+    /* Every block is freed through the creation list, placed or not */
+    for (int i = 0; i < b->ncreated; i++) {
+        free(b->created[i]->code);
+        free(b->created[i]);
+    }
+    b->fn->nblocks = 0;
+    ir_free(b->fn);
+    free(b->created);
+    free(b->owned);
+    free(b->ranges);
+    symtab_free(&b->names);
+}
+
+IrFunc *ir_build(Function *f, bool string_arena, int unroll) {
+    IrFunc *fn = xmalloc(sizeof(IrFunc));
+    memset(fn, 0, sizeof(IrFunc));
+    fn->name = f->name;
+
+    IrBuilder b = { .fn = fn, .string_arena = string_arena, .unroll = unroll };
+    symtab_init(&b.names, sizeof(int));
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, builder_free, &b);
+    switch_to(&b, new_block(&b, "entry"));
+
+    if (string_arena) emit_call_void(&b, RT_ARENA_ENTER, -1);
+    lower_stmt(&b, f->body);
+    if (string_arena) emit_call_void(&b, RT_ARENA_LEAVE, -1);
+    emit(&b, ins_make(IR_RET));
+
+    finalize_layout(&b);
+    error_cleanup_pop(&cleanup);
+    free(b.created);
+    free(b.owned);
+    free(b.ranges);
+    symtab_free(&b.names);
+    return fn;
+}
+
+void ir_free(IrFunc *fn) {
+    if (!fn) return;
+    for (int i = 0; i < fn->nblocks; i++) {
+        free(fn->blocks[i]->code);
+        free(fn->blocks[i]);
+    }
+    for (int i = 0; i < fn->nstrings; i++)
+        free(fn->strings[i]);
+    for (int i = 0; i < fn->narrays; i++)
+        free(fn->arrays[i].values);
+    free(fn->blocks);
+    free(fn->slots);
+    free(fn->strings);
+    free(fn->arrays);
+    free(fn);
+}
+
+/* ---------------------------------------------------------
+   DEBUG LISTING
+   --------------------------------------------------------- */
+
+long ir_count_instrs(const IrFunc *fn) {
+    long n = 0;
+    for (int i = 0; i < fn->nblocks; i++) n += fn->blocks[i]->n;
+    return n;
+}
+
+static void print_binop(char op, StrBuf *out) {
+    switch (op) {
+    case 'l': sb_puts(out, "<="); break;
+    case 'g': sb_puts(out, ">="); break;
+    case 'e': sb_puts(out, "=="); break;
+    case 'n': sb_puts(out, "!="); break;
+    default:  sb_putc(out, op); break;
+    }
+}
+
+void ir_print(IrFunc *fn, StrBuf *out) {
+    sb_printf(out, "function %s (%d slots, %d temps)\n", sym_name(fn->name), fn->nslots, fn->ntemps);
+
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        sb_printf(out, "b%d (%s", blk->id, blk->hint);
+        if (blk->par) sb_puts(out, ", par");
+        if (blk->count >= 0) sb_printf(out, ", ran %ld", blk->count);
+        sb_puts(out, "):\n");
+
+        for (int j = 0; j < blk->n; j++) {
+            IrInstr *in = &blk->code[j];
+            sb_puts(out, "    ");
+            if (in->dst >= 0) sb_printf(out, "t%d = ", in->dst);
+
+            switch (in->op) {
+            case IR_CONST: sb_printf(out, "const %ld", in->imm); break;
+            case IR_STR:   sb_printf(out, "str #%ld", in->imm); break;
+            case IR_LOAD:  sb_printf(out, "load %s.%d", sym_name(fn->slots[in->slot].name), in->slot); break;
+            case IR_STORE:
+                sb_printf(out, "store %s.%d, t%d", sym_name(fn->slots[in->slot].name), in->slot, in->a);
+                break;
+            case IR_ADDR:  sb_printf(out, "addr %s.%d", sym_name(fn->slots[in->slot].name), in->slot); break;
+            case IR_BIN:
+                sb_printf(out, "t%d ", in->a);
+                print_binop(in->binop, out);
+                sb_printf(out, " t%d", in->b);
+                break;
+            case IR_CALL:
+                if (in->a >= 0)
+                    sb_printf(out, "call %s(t%d)", ir_runtime_names[in->imm], in->a);
+                else
+                    sb_printf(out, "call %s()", ir_runtime_names[in->imm]);
+                break;
+            case IR_ARRAY: sb_printf(out, "array #%ld", in->imm); break;
+            case IR_LOADX:
+            case IR_STOREX:
+                sb_printf(out, "%s %s.%d[", in->op == IR_LOADX ? "loadx" : "storex",
+                          sym_name(fn->slots[in->slot].name), in->slot);
+                if (in->a >= 0) sb_printf(out, "t%d]", in->a);
+                else sb_printf(out, "%ld]", in->imm);
+                if (in->op == IR_STOREX) sb_printf(out, ", t%d", in->b);
+                break;
+            case IR_BOUNDS: sb_printf(out, "bounds t%d, %ld", in->a, in->imm); break;
+            case IR_COPY:
+                sb_printf(out, "copy %s.%d, t%d", sym_name(fn->slots[in->slot].name), in->slot, in->a);
+                break;
+            case IR_ZERO:  sb_printf(out, "zero %s.%d", sym_name(fn->slots[in->slot].name), in->slot); break;
+            case IR_ENTER: sb_puts(out, "enter"); break;
+            case IR_ARG:   sb_printf(out, "arg %ld", in->imm); break;
+            case IR_JMP:   sb_printf(out, "jmp b%d", in->target); break;
+            case IR_BR:    sb_printf(out, "br t%d, b%d, b%d", in->a, in->target, in->alt); break;
+            case IR_RET:   sb_puts(out, "ret"); break;
+            case IR_PAR:
+                sb_printf(out, "par t%d, t%d, b%d, b%d", in->a, in->b, in->target, in->alt);
+                break;
+            case IR_LEAVE: sb_puts(out, "leave"); break;
+            }
+            sb_putc(out, '\n');
+        }
+    }
+}
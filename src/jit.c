@@ -0,0 +1,185 @@
+/**
+ * @file jit.c
+ * @brief Runs an assembled object inside the compiler process (--run).
+ *
+ * Sections are laid out page-aligned in one anonymous mapping, text first.
+ * It is filled while writable, relocated against itself and the runtime
+ * linked into mycc, and only then made executable, so no page is ever
+ * writable and executable at the same time.
+ */
+/* mmap's MAP_ANONYMOUS is hidden by -std=c99 without this */
+#define _DEFAULT_SOURCE
+
+#include "../include/jit.h"
+#include "../include/ir.h"
+#include "../include/runtime.h"
+#include "../include/common.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/* Placements are tried this far apart on either side of the runtime,
+   which keeps hints aligned for VirtualAlloc as well */
+#define PLACEMENT_STEP ((uintptr_t)64 << 20)
+#define PLACEMENT_TRIES 16
+
+/* rel32 reaches 2 GiB; everything must be well within that of the runtime */
+#define PLACEMENT_RANGE ((uintptr_t)1 << 30)
+
+/** Address of the runtime symbol `name` in this process, or 0. */
+static uintptr_t runtime_address(const char *name) {
+    const uintptr_t functions[RT_COUNT] = {
+        [RT_CLONE_STRING]       = (uintptr_t)runtime_clone_string,
+        [RT_DROP_STRING]        = (uintptr_t)runtime_drop_string,
+        [RT_PRINT_INT]          = (uintptr_t)runtime_print_int,
+        [RT_PRINT_STRING]       = (uintptr_t)runtime_print_string,
+        [RT_ARENA_ENTER]        = (uintptr_t)runtime_arena_enter,
+        [RT_ARENA_LEAVE]        = (uintptr_t)runtime_arena_leave,
+        [RT_ARENA_CLONE_STRING] = (uintptr_t)runtime_arena_clone_string,
+        [RT_FLUSH]              = (uintptr_t)runtime_flush,
+        [RT_BOUNDS_FAIL]        = (uintptr_t)runtime_bounds_fail,
+        [RT_RC_NEW]             = (uintptr_t)runtime_rc_new,
+        [RT_RC_RETAIN]          = (uintptr_t)runtime_rc_retain,
+        [RT_RC_RELEASE]         = (uintptr_t)runtime_rc_release,
+        [RT_PAR_FOR]            = (uintptr_t)runtime_par_for,
+        [RT_PROFILE_BEGIN]      = (uintptr_t)runtime_profile_begin,
+        [RT_PROFILE_END]        = (uintptr_t)runtime_profile_end,
+    };
+    for (int i = 0; i < RT_COUNT; i++)
+        if (strcmp(ir_runtime_names[i], name) == 0) return functions[i];
+
+    /* Referenced by the --intrinsics print routine */
+    if (strcmp(name, "runtime_out_buf") == 0) return (uintptr_t)runtime_out_buf;
+    if (strcmp(name, "runtime_out_len") == 0) return (uintptr_t)&runtime_out_len;
+    return 0;
+}
+
+/* ---------------------------------------------------------
+   MEMORY
+   --------------------------------------------------------- */
+
+static size_t page_size(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static void unmap(uint8_t *p, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, size);
+#endif
+}
+
+/** `size` writable bytes, preferably at `hint`; NULL if nothing could be mapped. */
+static uint8_t *map_at(uintptr_t hint, size_t size) {
+#ifdef _WIN32
+    return VirtualAlloc((void *)hint, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void *p = mmap((void *)hint, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+#endif
+}
+
+/**
+ * @brief Maps `size` bytes close enough to `anchor` for rel32 references
+ * in both directions, trying free ranges below it first (the heap grows
+ * upwards from the executable). NULL if none is available.
+ */
+static uint8_t *map_near(uintptr_t anchor, size_t size) {
+    uintptr_t base = anchor & ~(PLACEMENT_STEP - 1);
+    for (uintptr_t k = 1; k <= PLACEMENT_TRIES; k++) {
+        for (int above = 0; above < 2; above++) {
+            if (!above && base < k * PLACEMENT_STEP) continue;
+            uint8_t *p = map_at(above ? base + k * PLACEMENT_STEP : base - k * PLACEMENT_STEP, size);
+            if (!p) continue;
+
+            uintptr_t lo = (uintptr_t)p, hi = lo + size;
+            uintptr_t far = anchor > lo ? anchor - lo : hi - anchor;
+            if (far < PLACEMENT_RANGE) return p;
+            unmap(p, size);
+        }
+    }
+    return NULL;
+}
+
+/** Makes `p[0..size)` read-only, and executable if `exec`. */
+static void protect(uint8_t *p, size_t size, bool exec) {
+    if (size == 0) return;
+#ifdef _WIN32
+    DWORD old;
+    if (!VirtualProtect(p, size, exec ? PAGE_EXECUTE_READ : PAGE_READONLY, &old))
+        errorf("jit: cannot protect code (error %lu)\n", GetLastError());
+    if (exec) FlushInstructionCache(GetCurrentProcess(), p, size);
+#else
+    if (mprotect(p, size, exec ? PROT_READ | PROT_EXEC : PROT_READ) != 0)
+        errorf("jit: cannot protect code\n");
+#endif
+}
+
+/* ---------------------------------------------------------
+   LOADING
+   --------------------------------------------------------- */
+
+int jit_run(const ObjFile *obj) {
+    size_t page = page_size();
+    size_t start[OBJ_SEC_COUNT], len[OBJ_SEC_COUNT], size = 0;
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) {
+        start[s] = size;
+        len[s] = obj->sections[s].data.len;
+        size += (len[s] + page - 1) & ~(page - 1);
+    }
+
+    uintptr_t anchor = runtime_address(ir_runtime_names[RT_FLUSH]);
+    uint8_t *image = map_near(anchor, size);
+    if (!image) errorf("jit: cannot map memory within reach of the runtime\n");
+    for (int s = 0; s < OBJ_SEC_COUNT; s++)
+        if (len[s]) memcpy(image + start[s], obj->sections[s].data.data, len[s]);
+
+    /* Every field is rel32 from its own end (nothing follows a relocated operand) */
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) {
+        const ObjSection *sec = &obj->sections[s];
+        for (int i = 0; i < sec->nrelocs; i++) {
+            const ObjReloc *r = &sec->relocs[i];
+            const ObjSymbol *sym = &obj->syms[r->symbol];
+            uintptr_t target = sym->section == OBJ_UNDEF
+                ? runtime_address(sym->name)
+                : (uintptr_t)(image + start[sym->section] + sym->value);
+            if (!target) errorf("jit: undefined symbol '%s'\n", sym->name);
+
+            uint8_t *field = image + start[s] + r->offset;
+            int64_t disp = (int64_t)(target - ((uintptr_t)field + 4));
+            if (disp < INT32_MIN || disp > INT32_MAX)
+                errorf("jit: '%s' is out of reach of rel32\n", sym->name);
+            int32_t v = (int32_t)disp;
+            memcpy(field, &v, sizeof v);
+        }
+    }
+
+    protect(image + start[OBJ_SEC_TEXT], len[OBJ_SEC_TEXT], true);
+    protect(image + start[OBJ_SEC_RODATA], len[OBJ_SEC_RODATA], false);
+
+    int m = obj_find_symbol(obj, "main");
+    if (m < 0 || obj->syms[m].section != OBJ_SEC_TEXT) errorf("jit: no main in the program\n");
+    int (*entry)(void) = (int (*)(void))(uintptr_t)(image + start[OBJ_SEC_TEXT] + obj->syms[m].value);
+
+    /* The program writes to the stdout handle directly, behind stdio's back */
+    fflush(stdout);
+    int rc = entry();
+    unmap(image, size);
+    return rc;
+}
@@ -1,63 +1,300 @@
 #include "../include/lexer.h"
 #include "../include/common.h"
 
-#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define LEXER_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 /** ---------------------------------------------------------
  * SCANNING PREDICATES
- * Character classification for identifier resolution.
+ * Character classification through a 256-entry table (ASCII only, so
+ * the result never depends on the C locale).
  * --------------------------------------------------------- */
 
-static int is_ident_start(char c) {
-    return isalpha((unsigned char)c) || c == '_';
-}
+enum {
+    S = 1,      /* Whitespace: space, \t \n \v \f \r */
+    D = 2,      /* Decimal digit */
+    A = 4       /* Letter or underscore */
+};
+
+static const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+    /* 0x80-0xFF: never part of a token */
+};
+
+static int is_space(char c)       { return char_class[(unsigned char)c] & S; }
+static int is_digit(char c)       { return char_class[(unsigned char)c] & D; }
+static int is_ident_start(char c) { return char_class[(unsigned char)c] & A; }
+static int is_ident_char(char c)  { return char_class[(unsigned char)c] & (A | D); }
 
-static int is_ident_char(char c) {
-    return isalnum((unsigned char)c) || c == '_';
+/**
+ * @brief Recognizes keywords by length and first character.
+ * Keywords never reach the interner; their symbols are the fixed builtin ids.
+ * @return The keyword's token kind and symbol, or T_IDENT.
+ */
+static TokenKind keyword(const char *s, size_t len, Symbol *sym) {
+#define KW(word, kind, id) \
+    if (memcmp(s, word, len) == 0) { *sym = id; return kind; } break
+
+    switch (len) {
+    case 2:
+        if (s[0] == 'i') {
+            switch (s[1]) {
+            case 'f': KW("if", T_IF, SYM_IF);
+            case 'n': KW("in", T_IN, SYM_IN);
+            }
+        }
+        break;
+    case 3:
+        switch (s[0]) {
+        case 'l': KW("let", T_LET, SYM_LET);
+        case 'i': KW("int", T_INT_TYPE, SYM_INT);
+        case 'f': KW("for", T_FOR, SYM_FOR);
+        case 'p': KW("par", T_PAR, SYM_PAR);
+        }
+        break;
+    case 4:
+        if (s[0] == 'e') { KW("else", T_ELSE, SYM_ELSE); }
+        break;
+    case 5:
+        switch (s[0]) {
+        case 'w': KW("while", T_WHILE, SYM_WHILE);
+        case 'p': KW("print", T_PRINT, SYM_PRINT);
+        }
+        break;
+    case 6:
+        if (s[0] == 's') { KW("string", T_STRING_TYPE, SYM_STRING); }
+        break;
+    case 7:
+        if (s[0] == 'p') { KW("println", T_PRINTLN, SYM_PRINTLN); }
+        break;
+    }
+    return T_IDENT;
+#undef KW
 }
 
 /** ---------------------------------------------------------
- * LEXER LIFECYCLE
- * Buffer management and stream initialization.
+ * BULK SCANNERS
+ * Each returns the first position >= pos (and <= size) whose byte ends
+ * the run. The SIMD variants handle whole 16/32-byte blocks and finish
+ * the tail with the scalar versions; the best one supported by the CPU
+ * is selected once, on the first lexer_init.
  * --------------------------------------------------------- */
 
-/**
- * @brief Initializes the lexer by reading the source file into a buffer.
- * Performs a full file read to memory for fast non-sequential access.
- */
-void lexer_init(Lexer *l, const char *filename) {
-    FILE *f = fopen(filename, "rb");
-    if (!f) {
-        perror(filename);
-        exit(1);
+/** Whitespace run; also counts the newlines in it and the last one's position. */
+typedef size_t (*SpaceScanner)(const char *s, size_t pos, size_t size,
+                               int *newlines, size_t *last_nl);
+/** Identifier characters. */
+typedef size_t (*IdentScanner)(const char *s, size_t pos, size_t size);
+/** String literal body: stops at '"', '\\' or '\n'. */
+typedef size_t (*StringScanner)(const char *s, size_t pos, size_t size);
+
+typedef struct Scanners {
+    SpaceScanner space;
+    IdentScanner ident;
+    StringScanner string;
+} Scanners;
+
+static size_t scan_space_scalar(const char *s, size_t pos, size_t size,
+                                int *newlines, size_t *last_nl) {
+    while (pos < size && is_space(s[pos])) {
+        if (s[pos] == '\n') {
+            (*newlines)++;
+            *last_nl = pos;
+        }
+        pos++;
     }
+    return pos;
+}
+
+static size_t scan_ident_scalar(const char *s, size_t pos, size_t size) {
+    while (pos < size && is_ident_char(s[pos])) pos++;
+    return pos;
+}
 
-    /* Determine file size for buffer allocation */
-    fseek(f, 0, SEEK_END);
-    long sz = ftell(f);
-    fseek(f, 0, SEEK_SET);
+static size_t scan_string_scalar(const char *s, size_t pos, size_t size) {
+    while (pos < size && s[pos] != '"' && s[pos] != '\\' && s[pos] != '\n') pos++;
+    return pos;
+}
 
-    char *buf = malloc(sz + 1);
-    if (!buf) {
-        perror("malloc");
-        exit(1);
+#ifdef LEXER_X86_SIMD
+
+/* Byte-wise unsigned range test lo <= x <= hi, as a 0x00/0xFF mask */
+#define IN_RANGE128(x, lo, hi) \
+    _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8((x), _mm_set1_epi8(lo)), \
+                                _mm_set1_epi8((char)((hi) - (lo)))), \
+                   _mm_sub_epi8((x), _mm_set1_epi8(lo)))
+#define IN_RANGE256(x, lo, hi) \
+    _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8((x), _mm256_set1_epi8(lo)), \
+                                      _mm256_set1_epi8((char)((hi) - (lo)))), \
+                      _mm256_sub_epi8((x), _mm256_set1_epi8(lo)))
+
+/** Adds the newlines among the first `n` bytes flagged in `nl_mask`. */
+static void count_newlines(uint32_t nl_mask, int n, size_t base,
+                           int *newlines, size_t *last_nl) {
+    if (n < 32) nl_mask &= (1u << n) - 1;
+    if (!nl_mask) return;
+    *newlines += __builtin_popcount(nl_mask);
+    *last_nl = base + 31 - (size_t)__builtin_clz(nl_mask);
+}
+
+static size_t scan_space_sse2(const char *s, size_t pos, size_t size,
+                              int *newlines, size_t *last_nl) {
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + pos));
+        __m128i sp = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), IN_RANGE128(x, 9, 13));
+        uint32_t nl = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')));
+        uint32_t stop = ~(uint32_t)_mm_movemask_epi8(sp) & 0xFFFF;
+        if (stop) {
+            int n = __builtin_ctz(stop);
+            count_newlines(nl, n, pos, newlines, last_nl);
+            return pos + (size_t)n;
+        }
+        count_newlines(nl, 16, pos, newlines, last_nl);
     }
+    return scan_space_scalar(s, pos, size, newlines, last_nl);
+}
 
-    /* Populate buffer and ensure null-termination */
-    size_t rd = fread(buf, 1, sz, f);
-    if (rd != (size_t)sz) {
-        perror("fread");
-        exit(1);
+static size_t scan_ident_sse2(const char *s, size_t pos, size_t size) {
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + pos));
+        __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+        __m128i ok = _mm_or_si128(
+            _mm_or_si128(IN_RANGE128(lower, 'a', 'z'), IN_RANGE128(x, '0', '9')),
+            _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+        uint32_t stop = ~(uint32_t)_mm_movemask_epi8(ok) & 0xFFFF;
+        if (stop) return pos + (size_t)__builtin_ctz(stop);
     }
+    return scan_ident_scalar(s, pos, size);
+}
 
-    buf[sz] = '\0';
-    fclose(f);
+static size_t scan_string_sse2(const char *s, size_t pos, size_t size) {
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + pos));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'))),
+            _mm_cmpeq_epi8(x, _mm_set1_epi8('\n')));
+        uint32_t stop = (uint32_t)_mm_movemask_epi8(hit);
+        if (stop) return pos + (size_t)__builtin_ctz(stop);
+    }
+    return scan_string_scalar(s, pos, size);
+}
 
-    l->src = buf;
+__attribute__((target("avx2")))
+static size_t scan_space_avx2(const char *s, size_t pos, size_t size,
+                              int *newlines, size_t *last_nl) {
+    for (; pos + 32 <= size; pos += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(s + pos));
+        __m256i sp = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), IN_RANGE256(x, 9, 13));
+        uint32_t nl = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')));
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(sp);
+        if (stop) {
+            int n = __builtin_ctz(stop);
+            count_newlines(nl, n, pos, newlines, last_nl);
+            return pos + (size_t)n;
+        }
+        count_newlines(nl, 32, pos, newlines, last_nl);
+    }
+    return scan_space_sse2(s, pos, size, newlines, last_nl);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_ident_avx2(const char *s, size_t pos, size_t size) {
+    for (; pos + 32 <= size; pos += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(s + pos));
+        __m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+        __m256i ok = _mm256_or_si256(
+            _mm256_or_si256(IN_RANGE256(lower, 'a', 'z'), IN_RANGE256(x, '0', '9')),
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(ok);
+        if (stop) return pos + (size_t)__builtin_ctz(stop);
+    }
+    return scan_ident_sse2(s, pos, size);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_string_avx2(const char *s, size_t pos, size_t size) {
+    for (; pos + 32 <= size; pos += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(s + pos));
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\'))),
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')));
+        uint32_t stop = (uint32_t)_mm256_movemask_epi8(hit);
+        if (stop) return pos + (size_t)__builtin_ctz(stop);
+    }
+    return scan_string_sse2(s, pos, size);
+}
+
+#endif /* LEXER_X86_SIMD */
+
+static const Scanners scalar_scanners = {
+    scan_space_scalar, scan_ident_scalar, scan_string_scalar
+};
+#ifdef LEXER_X86_SIMD
+static const Scanners sse2_scanners = {
+    scan_space_sse2, scan_ident_sse2, scan_string_sse2
+};
+static const Scanners avx2_scanners = {
+    scan_space_avx2, scan_ident_avx2, scan_string_avx2
+};
+#endif
+
+/* Chosen once per process; every Lexer afterwards only reads it */
+static const Scanners *scanners;
+static Once scanners_ready = ONCE_INIT;
+
+/**
+ * @brief Picks the widest scanner set the CPU supports.
+ * MYLANG_LEXER=scalar|sse2|avx2 forces a narrower one (used to test the
+ * fallbacks against each other).
+ */
+static void select_scanners(void) {
+    const char *force = getenv("MYLANG_LEXER");
+    scanners = &scalar_scanners;
+#ifdef LEXER_X86_SIMD
+    /* SSE2 is part of the x86_64 baseline */
+    scanners = &sse2_scanners;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        scanners = &avx2_scanners;
+    if (force && strcmp(force, "sse2") == 0)
+        scanners = &sse2_scanners;
+#endif
+    if (force && strcmp(force, "scalar") == 0)
+        scanners = &scalar_scanners;
+}
+
+/** ---------------------------------------------------------
+ * LEXER LIFECYCLE
+ * Buffer management and stream initialization.
+ * --------------------------------------------------------- */
+
+/**
+ * @brief Initializes the lexer over a memory-mapped view of the source file.
+ * Tokens are slices of the mapping, so no per-token copies are made.
+ */
+void lexer_init(Lexer *l, const char *filename, Arena *strings) {
+    run_once(&scanners_ready, select_scanners);
+    source_open(&l->source, filename);
+
+    l->src = l->source.data;
+    l->size = l->source.size;
     l->filename = filename;
+    l->strings = strings;
     l->pos = 0;
     l->line = 1;
     l->col = 1;
@@ -68,15 +305,20 @@ void lexer_init(Lexer *l, const char *filename) {
  * Lookahead and consumption primitives.
  * --------------------------------------------------------- */
 
+/** Lookahead `k` characters past the current one. Returns NUL past EOF. */
+static char peek_at(Lexer *l, size_t k) {
+    return (l->pos + k < l->size) ? l->src[l->pos + k] : '\0';
+}
+
 /** Non-consuming lookahead of the current character. Returns NUL at EOF. */
 static char peek(Lexer *l) {
-    return l->src[l->pos];
+    return peek_at(l, 0);
 }
 
 /** Consumes the current character and updates stream coordinates. */
 static char getc_lex(Lexer *l) {
+    if (l->pos >= l->size) return '\0';
     char c = l->src[l->pos];
-    if (c == '\0') return '\0';
 
     l->pos++;
     if (c == '\n') {
@@ -88,28 +330,71 @@ static char getc_lex(Lexer *l) {
     return c;
 }
 
+/** Advances over a run known to contain no newline. */
+static void skip_to(Lexer *l, size_t end) {
+    l->col += (int)(end - l->pos);
+    l->pos = end;
+}
+
 /** ---------------------------------------------------------
  * TOKEN GENERATION
  * --------------------------------------------------------- */
 
-/** Factory function for creating Token structures with coordinate metadata. */
-static Token make_token(TokenKind k, const char *lex, long val, int line, int col) {
-    Token t;
-    memset(&t, 0, sizeof(Token));
-
+/** Finishes a token that started at `t->offset` and ends at the current position. */
+static Token finish(Lexer *l, Token t, TokenKind k) {
     t.kind = k;
-    t.int_val = val;
-    t.line = line;
-    t.col = col;
+    t.len = (int)(l->pos - t.offset);
+    return t;
+}
 
-    if (lex) {
-        /* Safe lexeme copying with guaranteed termination */
-        snprintf(t.lexeme, sizeof(t.lexeme), "%s", lex);
-    } else {
-        t.lexeme[0] = '\0';
+/**
+ * @brief Scans the body of a string literal after the opening quote.
+ * Literals without escapes are returned as views of the source; the rest
+ * are translated into a copy in the lexer's arena.
+ */
+static void scan_string(Lexer *l, Token *t) {
+    size_t start = l->pos;
+    bool escaped = false;
+
+    while (1) {
+        skip_to(l, scanners->string(l->src, l->pos, l->size));
+        char c = peek(l);
+        if (c == '\0' || c == '"') break;
+        if (getc_lex(l) == '\\' && peek(l)) {
+            getc_lex(l);
+            escaped = true;
+        }
+    }
+    if (peek(l) != '"') {
+        errorf_at(t->line, t->col, "syntax error: unterminated string literal\n");
     }
 
-    return t;
+    const char *raw = l->src + start;
+    size_t raw_len = l->pos - start;
+    getc_lex(l); /* Consume closing delimiter */
+
+    if (!escaped) {
+        t->str = raw;
+        t->str_len = (int)raw_len;
+        return;
+    }
+
+    /* Escape sequence translation: the result is never longer than the source */
+    char *out = arena_alloc(l->strings, raw_len);
+    int n = 0;
+    for (size_t i = 0; i < raw_len; i++) {
+        char pc = raw[i];
+        if (pc == '\\' && i + 1 < raw_len) {
+            char esc = raw[++i];
+            if (esc == 'n') out[n++] = '\n';
+            else if (esc == 't') out[n++] = '\t';
+            else out[n++] = esc;
+        } else {
+            out[n++] = pc;
+        }
+    }
+    t->str = out;
+    t->str_len = n;
 }
 
 /** ---------------------------------------------------------
@@ -122,131 +407,137 @@ static Token make_token(TokenKind k, const char *lex, long val, int line, int co
  * Handles whitespace, comments, literals, identifiers, and symbols.
  */
 Token lexer_next(Lexer *l) {
-    Token t = make_token(T_EOF, NULL, 0, l->line, l->col);
-
-    /* Skip trivia (whitespace), reporting EOL where necessary */
+    /* Skip trivia (whitespace) and line comments */
     while (1) {
-        char c = peek(l);
-        if (!c) {
-            t.kind = T_EOF;
-            return t;
+        int newlines = 0;
+        size_t last_nl = 0;
+        size_t end = scanners->space(l->src, l->pos, l->size, &newlines, &last_nl);
+        if (newlines) {
+            l->line += newlines;
+            l->col = (int)(end - last_nl);
+        } else {
+            l->col += (int)(end - l->pos);
         }
-        if (c == '\n') {
-            getc_lex(l);
-            continue;
-        }
-        if (isspace((unsigned char)c)) {
-            getc_lex(l);
+        l->pos = end;
+
+        /* Line comments: // ... */
+        if (peek(l) == '/' && peek_at(l, 1) == '/') {
+            const char *nl = memchr(l->src + l->pos, '\n', l->size - l->pos);
+            skip_to(l, nl ? (size_t)(nl - l->src) : l->size);
             continue;
         }
         break;
     }
 
+    Token t;
+    memset(&t, 0, sizeof(Token));
+    t.offset = l->pos;
+    t.line = l->line;
+    t.col = l->col;
+
     char c = peek(l);
     if (!c) {
-        t.kind = T_EOF;
-        return t;
+        return finish(l, t, T_EOF);
     }
 
     /* String Literal Scanning (handles escape sequences) */
     if (c == '"') {
         getc_lex(l); /* Consume opening delimiter */
-        int i = 0;
-
-        while (peek(l) && peek(l) != '"') {
-            char pc = getc_lex(l);
-            if (pc == '\\' && peek(l)) {
-                /* Escape sequence translation */
-                char esc = getc_lex(l);
-                if (esc == 'n') t.lexeme[i++] = '\n';
-                else if (esc == 't') t.lexeme[i++] = '\t';
-                else t.lexeme[i++] = esc;
-            } else {
-                t.lexeme[i++] = pc;
-            }
-
-            if (i >= MAX_TOK_LEN - 1) break;
-        }
-
-        t.lexeme[i] = '\0';
-
-        if (peek(l) != '"') {
-            errorf("Unterminated string literal at %d:%d\n", t.line, t.col);
-            exit(1);
-        }
-
-        getc_lex(l); /* Consume closing delimiter */
-        t.kind = T_STRLIT;
-        return t;
+        scan_string(l, &t);
+        return finish(l, t, T_STRLIT);
     }
 
     /* Integer Literal Scanning */
-    if (isdigit((unsigned char)c)) {
-        long val = 0;
-        while (isdigit((unsigned char)peek(l))) {
-            val = val * 10 + (getc_lex(l) - '0');
+    if (is_digit(c)) {
+        /* Checked before each step, so the value never overflows */
+        uint64_t val = 0;
+        while (is_digit(peek(l))) {
+            unsigned digit = (unsigned)(getc_lex(l) - '0');
+            if (val > ((uint64_t)LONG_MAX - digit) / 10)
+                errorf_at(t.line, t.col, "syntax error: integer literal too large (the largest is %ld)\n", LONG_MAX);
+            val = val * 10 + digit;
         }
-
-        char buf[64];
-        snprintf(buf, sizeof(buf), "%ld", val);
-        return make_token(T_INTLIT, buf, val, l->line, l->col);
+        t.int_val = (long)val;
+        return finish(l, t, T_INTLIT);
     }
 
     /* Identifier and Keyword Scanning */
     if (is_ident_start(c)) {
-        int i = 0;
-        while (is_ident_char(peek(l))) {
-            if (i < MAX_TOK_LEN - 1)
-                t.lexeme[i++] = getc_lex(l);
-            else
-                getc_lex(l);
-        }
-        t.lexeme[i] = '\0';
-
-        /* Keyword Triage */
-        if (strcmp(t.lexeme, "let") == 0) t.kind = T_LET;
-        else if (strcmp(t.lexeme, "int") == 0) t.kind = T_INT_TYPE;
-        else if (strcmp(t.lexeme, "string") == 0) t.kind = T_STRING_TYPE;
-        else if (strcmp(t.lexeme, "print") == 0) t.kind = T_PRINT;
-        else if (strcmp(t.lexeme, "println") == 0) t.kind = T_PRINTLN;
-        else t.kind = T_IDENT;
-
-        return t;
+        skip_to(l, scanners->ident(l->src, l->pos + 1, l->size));
+
+        const char *name = l->src + t.offset;
+        size_t len = l->pos - t.offset;
+        TokenKind kind = keyword(name, len, &t.sym);
+        if (kind == T_IDENT)
+            t.sym = intern(name, len);
+        return finish(l, t, kind);
     }
 
     /* Symbol and Operator Scanning */
     c = getc_lex(l);
     switch (c) {
-        case '{': return make_token(T_LBRACE, "{", 0, l->line, l->col - 1);
-        case '}': return make_token(T_RBRACE, "}", 0, l->line, l->col - 1);
-        case '(': return make_token(T_LPAREN, "(", 0, l->line, l->col - 1);
-        case ')': return make_token(T_RPAREN, ")", 0, l->line, l->col - 1);
-        case ';': return make_token(T_SEMI, ";", 0, l->line, l->col - 1);
-        case ':': return make_token(T_COLON, ":", 0, l->line, l->col - 1);
-        case '=': return make_token(T_EQ, "=", 0, l->line, l->col - 1);
-        case ',': return make_token(T_COMMA, ",", 0, l->line, l->col - 1);
-
-        case '&': {
-            /* Multi-character operator lookahead for '&mut' */
-            if (peek(l) == 'm') {
-                int saved = l->pos;
-                int ok = 1;
-
-                if (peek(l) == 'm') getc_lex(l); else ok = 0;
-                if (peek(l) == 'u') getc_lex(l); else ok = 0;
-                if (peek(l) == 't') getc_lex(l); else ok = 0;
+        case '{': return finish(l, t, T_LBRACE);
+        case '}': return finish(l, t, T_RBRACE);
+        case '(': return finish(l, t, T_LPAREN);
+        case ')': return finish(l, t, T_RPAREN);
+        case '[': return finish(l, t, T_LBRACKET);
+        case ']': return finish(l, t, T_RBRACKET);
+        case ';': return finish(l, t, T_SEMI);
+        case ':': return finish(l, t, T_COLON);
+        case ',': return finish(l, t, T_COMMA);
+        case '+': return finish(l, t, T_PLUS);
+        case '-': return finish(l, t, T_MINUS);
+        case '*': return finish(l, t, T_STAR);
+        case '/': return finish(l, t, T_SLASH);
+        case '%': return finish(l, t, T_PERCENT);
+
+        /* Range operator: start..end */
+        case '.':
+            if (peek(l) == '.') {
+                getc_lex(l);
+                return finish(l, t, T_DOTDOT);
+            }
+            break;
 
-                if (ok)
-                    return make_token(T_ANDMUT, "&mut", 0, l->line, l->col - 1);
+        /* One- or two-character comparison operators */
+        case '=':
+            if (peek(l) == '=') {
+                getc_lex(l);
+                return finish(l, t, T_EQEQ);
+            }
+            return finish(l, t, T_EQ);
+        case '!':
+            if (peek(l) == '=') {
+                getc_lex(l);
+                return finish(l, t, T_NE);
+            }
+            break;
+        case '<':
+            if (peek(l) == '=') {
+                getc_lex(l);
+                return finish(l, t, T_LE);
+            }
+            return finish(l, t, T_LT);
+        case '>':
+            if (peek(l) == '=') {
+                getc_lex(l);
+                return finish(l, t, T_GE);
+            }
+            return finish(l, t, T_GT);
 
-                /* Backtrack on failed multi-char match */
-                l->pos = saved;
+        case '&':
+            /* Multi-character operator lookahead for '&mut' */
+            if (peek(l) == 'm' && peek_at(l, 1) == 'u' && peek_at(l, 2) == 't') {
+                getc_lex(l);
+                getc_lex(l);
+                getc_lex(l);
+                return finish(l, t, T_ANDMUT);
             }
-            return make_token(T_AND, "&", 0, l->line, l->col - 1);
-        }
+            return finish(l, t, T_AND);
 
         default:
-            errorf("Unknown character '%c' at %d:%d\n", c, l->line, l->col - 1);
-            exit(1);
+            break;
     }
-}
\ No newline at end of file
+
+    errorf_at(t.line, t.col, "syntax error: unknown character '%c'\n", c);
+}
@@ -2,7 +2,11 @@
  * @file main.c
  * @brief Entry point for the mycc compiler frontend.
  * * This module orchestrates the compilation pipeline: Lexing/Parsing, 
- * Semantic Analysis (including borrow checking), and x86_64 Code Generation.
+ * Semantic Analysis (including borrow checking), IR lowering, and x86_64
+ * Code Generation.
+ *
+ * The same driver serves requests in a resident compiler (--server), and
+ * with MYCC_SERVER set the command line is handed to that server instead.
  */
 
 #include <stdio.h>
@@ -14,85 +18,497 @@
 #include "../include/lexer.h"
 #include "../include/parser.h"
 #include "../include/semantic.h"
+#include "../include/ir.h"
+#include "../include/opt.h"
+#include "../include/profile.h"
 #include "../include/codegen.h"
+#include "../include/objfile.h"
+#include "../include/cache.h"
+#include "../include/jit.h"
+#include "../include/server.h"
+#include "../include/stats.h"
 #include "../include/common.h"
 
 /**
- * @brief Prints CLI usage instructions and terminates the process.
+ * @brief Raises the CLI usage instructions as an error: they end the
+ * process, or only the request when the server is compiling.
  */
-static void usage() {
-    fprintf(stderr, "Usage: mycc <input.my> -o <output> [--debug-borrow]\n");
-    exit(1);
+static void usage(void) {
+    errorf("Usage: mycc <input.my>... [-o <output>] [-j N] [-O0|-O1] [--emit=asm|obj] [--run] [--peephole] [--peephole-stats] [--string-arena] [--intrinsics] [--instrument] [--profile-use=<file>] [--no-borrowck] [--debug-borrow] [--dump-ir] [--cache-dir <dir>] [--cache-stats] [--time-passes] [--mem-stats] [--stats=json]\n"
+           "       With several inputs, -o names an existing directory for the outputs.\n"
+           "       mycc --server=<socket> stays resident; mycc with " SERVER_ENV "=<socket> compiles there.\n");
 }
 
+/** Settings shared by every unit of one invocation. */
+typedef struct BuildOptions {
+    bool dump_ir;
+    bool string_arena;
+    bool borrowck;
+    bool several;           /* More than one input: shorter reports */
+    bool run;               /* --run: execute the program instead of writing it */
+    CodegenOptions cg;      /* cg.log is set per unit */
+    const Profile *profile; /* --profile-use, or NULL */
+    const char *cache_dir;  /* --cache-dir, or NULL when not caching */
+    char *cache_config;     /* Everything besides the source the output depends on */
+    StatsFormat stats;      /* --time-passes / --mem-stats / --stats=json */
+    bool collect_stats;     /* Any of them */
+} BuildOptions;
+
+/** How a unit's output was obtained. */
+typedef enum {
+    CACHE_UNUSED,
+    CACHE_HIT,              /* Copied from the cache; nothing was compiled */
+    CACHE_MISS              /* Compiled, then stored if it succeeded */
+} CacheUse;
+
 /**
- * @brief Main execution loop for the compiler.
+ * @brief One input file and everything it produces. Units are compiled
+ * independently (possibly on different threads); their reports are
+ * buffered and printed in command-line order once all are done.
+ */
+typedef struct Unit {
+    const char *input;
+    char *out_base;         /* Output name without extension */
+    char *out_file;         /* out_base plus .asm or the object extension */
+    const BuildOptions *opts;
+    StrBuf log;             /* What the unit prints to stdout */
+    StrBuf diag;            /* The error that stopped it, if any */
+    bool ok;
+    CacheUse cache;
+    Stats stats;            /* Filled when collect_stats is set */
+    ObjFile obj;            /* --run: the assembled program */
+} Unit;
+
+/** Concatenates `a` and `b` into a new heap string. */
+static char *str_concat(const char *a, const char *b) {
+    size_t la = strlen(a), lb = strlen(b);
+    char *s = xmalloc(la + lb + 1);
+    memcpy(s, a, la);
+    memcpy(s + la, b, lb + 1);
+    return s;
+}
+
+/**
+ * @brief Output name for `input`: its path without a ".my" extension or,
+ * when `dir` is given, that file name inside `dir`.
+ */
+static char *output_base(const char *input, const char *dir) {
+    const char *name = input;
+    if (dir) {
+        for (const char *c = input; *c; c++)
+            if (*c == '/' || *c == '\\') name = c + 1;
+    }
+
+    size_t len = strlen(name);
+    if (len > 3 && strcmp(name + len - 3, ".my") == 0) len -= 3;
+
+    size_t dlen = dir ? strlen(dir) : 0;
+    bool sep = dlen > 0 && dir[dlen - 1] != '/' && dir[dlen - 1] != '\\';
+    char *s = xmalloc(dlen + sep + len + 1);
+    if (dlen) memcpy(s, dir, dlen);
+    if (sep) s[dlen] = '/';
+    memcpy(s + dlen + sep, name, len);
+    s[dlen + sep + len] = '\0';
+    return s;
+}
+
+/** Appends the success message (and, for a lone input, how to link it). */
+static void report_output(const Unit *u) {
+    StrBuf *log = (StrBuf *)&u->log;
+    const char *outfile = u->out_base;
+    const char *asmfile = u->out_file;
+
+    if (u->opts->cg.emit == EMIT_OBJ) {
+        sb_printf(log, "Successfully generated object: %s\n", asmfile);
+        if (u->opts->several) return;
+        sb_printf(log, "To link and run:\n");
+#ifdef _WIN32
+        sb_printf(log, ">> gcc %s runtime.o -o %s.exe\n", asmfile, outfile);
+        sb_printf(log, ">> .\\\\%s.exe\n", outfile);
+#else
+        sb_printf(log, ">> gcc %s runtime.o -o %s\n", asmfile, outfile);
+        sb_printf(log, ">> ./%s\n", outfile);
+#endif
+        return;
+    }
+
+    sb_printf(log, "Successfully generated assembly: %s\n", asmfile);
+    if (u->opts->several) return;
+
+#ifdef _WIN32
+    /* Windows (Win64) build steps using NASM and GCC */
+    sb_printf(log, "To link and run:\n");
+    sb_printf(log, ">> nasm -f win64 %s -o %s.obj\n", asmfile, outfile);
+    sb_printf(log, ">> gcc %s.obj runtime.o -o %s.exe\n", outfile, outfile);
+    sb_printf(log, ">> .\\\\%s.exe\n", outfile);
+#else
+    /* Unix/Linux (ELF64) build steps using NASM and GCC */
+    sb_printf(log, "To link and run:\n");
+    sb_printf(log, ">> nasm -f elf64 %s -o %s.o\n", asmfile, outfile);
+    sb_printf(log, ">> gcc %s.o runtime.o -o %s\n", outfile, outfile);
+    sb_printf(log, ">> ./%s\n", outfile);
+#endif
+}
+
+/* Error cleanups for the AST and the IR of an abandoned unit */
+static void free_ast(void *f) {
+    ast_free_function(f);
+}
+
+static void free_ir(void *ir) {
+    ir_free(ir);
+}
+
+/**
+ * @brief Runs the whole pipeline for one unit. Errors raised by any phase
+ * unwind to compile_job through catch_errors, releasing what the unit has
+ * built on the way.
  * * Implements a linear compilation pass:
- * 1. CLI Argument Parsing
- * 2. Abstract Syntax Tree (AST) Generation (via parse_program)
- * 3. Static Analysis & Type Checking (via semantic_check)
- * 4. Assembly Generation (via codegen_function)
+ * 1. Abstract Syntax Tree (AST) Generation (via parse_program)
+ * 2. Type Checking & Borrow Checking in one traversal (via semantic_check)
+ * 3. Lowering to the linear IR (via ir_build)
+ * 4. Assembly or object code generation (via codegen_function)
  */
-int main(int argc, char **argv) {
-    /* Minimum required: <bin> <input> -o <output> */
-    if (argc < 4) usage();
+static void compile_unit(void *arg) {
+    Unit *u = arg;
+    const BuildOptions *o = u->opts;
+    const char *ext = o->cg.emit == EMIT_OBJ ? OBJ_EXT : ".asm";
+
+    // Phase 0: Cache lookup
+    // The key covers the exact bytes the lexer would read; a hit is the
+    // finished output of an earlier compile with the same configuration
+    CacheKey key;
+    if (o->cache_dir) {
+        stats_phase(PHASE_CACHE);
+        SourceBuf src;
+        source_open(&src, u->input);
+        key = cache_key(o->cache_config, src.data, src.size);
+        source_close(&src);
+
+        u->cache = CACHE_MISS;
+        if (cache_fetch(o->cache_dir, &key, ext, u->out_file)) {
+            u->cache = CACHE_HIT;
+            report_output(u);
+            return;
+        }
+    }
+
+    // Phase 1: Parsing (Lexing is handled internally by the parser)
+    // Returns the root of the AST (Function node)
+    stats_phase(PHASE_PARSE);
+    Function *f = parse_program(u->input);
+    ErrorCleanup ast_cleanup;
+    error_cleanup_push(&ast_cleanup, free_ast, f);
+    if (o->collect_stats) stats_count(STAT_AST_NODES, (uint64_t)ast_count_nodes(f));
+
+    // Phase 2: Semantic Analysis
+    // Performs type checking and validates ownership/borrow rules in the
+    // same walk (--no-borrowck skips the latter)
+    stats_phase(PHASE_SEMANTIC);
+    semantic_check(f, u->input, o->borrowck);
+
+    // Phase 3: IR Lowering
+    // Flattens the annotated AST into basic blocks of three-address code,
+    // inserting scope-exit drops of owned strings
+    // (-O1 also folds constants and removes dead code and unused slots;
+    //  and unrolls counted loops with constant bounds;
+    //  --string-arena allocates frame-local clones from a bump arena;
+    //  --profile-use lays the hotter arm of each if/else out first)
+    stats_phase(PHASE_LOWER);
+    IrFunc *ir = ir_build(f, o->string_arena, o->cg.opt_level >= 1 ? 8 : 1);
+    error_cleanup_pop(&ast_cleanup);
+    ast_free_function(f);   // The IR holds its own copies of names and strings
+    ErrorCleanup ir_cleanup;
+    error_cleanup_push(&ir_cleanup, free_ir, ir);
+    if (o->collect_stats) stats_count(STAT_IR_INSTRS, (uint64_t)ir_count_instrs(ir));
+    stats_phase(PHASE_OPT);
+    ir_optimize(ir, o->cg.opt_level);
+    if (o->profile) profile_apply(ir, o->profile);
+    if (o->collect_stats) stats_count(STAT_IR_INSTRS_OPT, (uint64_t)ir_count_instrs(ir));
+    if (o->dump_ir) ir_print(ir, &u->log);
 
-    const char *input = NULL;
+    // Phase 4: Code Generation
+    // Emits x86_64 assembly to the .asm file, or with --emit=obj encodes it
+    // directly into an ELF64/COFF object (--run keeps that object in memory)
+    // (-O1 keeps expression temporaries in registers instead of on the stack;
+    //  --peephole rewrites the buffered instructions before they are written)
+    CodegenOptions cg_opts = o->cg;
+    cg_opts.log = &u->log;
+    cg_opts.jit_obj = &u->obj;
+    stats_phase(PHASE_CODEGEN);
+    int rc = codegen_function(ir, u->out_file, u->out_base, &cg_opts);
+    error_cleanup_pop(&ir_cleanup);
+    ir_free(ir);
+    if (rc != 0) errorf("Error: Codegen failed for input '%s'\n", u->input);
+    if (o->run) return;
+
+    if (o->cache_dir) {
+        stats_phase(PHASE_CACHE);
+        cache_store(o->cache_dir, &key, ext, u->out_file);
+    }
+    report_output(u);
+}
+
+/** run_parallel job: compiles unit `i`, keeping its error to itself. */
+static void compile_job(void *ctx, int i) {
+    Unit *u = &((Unit *)ctx)[i];
+    if (u->opts->collect_stats) stats_begin(&u->stats);
+    error_set_file(u->input);
+    u->ok = catch_errors(compile_unit, u, &u->diag);
+    error_set_file(NULL);
+    stats_end();
+}
+
+/** What build has allocated so far; released on return and by errors. */
+typedef struct BuildState {
+    const char **inputs;
+    BuildOptions *opts;
+    Profile *profile;       /* Loaded by --profile-use, or NULL */
+    Unit *units;
+    int nunits;             /* Initialized entries of units */
+} BuildState;
+
+static void build_free(void *arg) {
+    BuildState *st = arg;
+    for (int i = 0; i < st->nunits; i++) {
+        Unit *u = &st->units[i];
+        sb_free(&u->log);
+        sb_free(&u->diag);
+        free(u->out_base);
+        free(u->out_file);
+        obj_free(&u->obj);
+    }
+    free(st->units);
+    free(st->inputs);
+    free(st->opts->cache_config);
+    if (st->profile) profile_free(st->profile);
+}
+
+/**
+ * @brief Main execution loop for the compiler.
+ * * Parses the command line, compiles every input as its own unit on a
+ * pool of `-j` worker threads (one per core by default), then prints the
+ * units' reports and errors to `out` and `err` in input order, so the
+ * output does not depend on scheduling.
+ */
+static int build(int argc, char **argv, FILE *out, FILE *err) {
     const char *outfile = NULL;
-    bool debug_borrow = false;
+    int ninputs = 0;
+    int jobs = 0;
+    bool cache_stats = false;
+    const char *profile_path = NULL;
+    Profile profile;
+    BuildOptions o = {
+        .borrowck = true,
+        .cg = { .opt_level = 0, .emit = EMIT_ASM }
+    };
+    BuildState st = { .opts = &o };
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, build_free, &st);
 
     /* --- Command Line Interface (CLI) Parsing --- */
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--debug-borrow") == 0) {
-            debug_borrow = true;
+            o.cg.debug_borrow = true;
+        } else if (strcmp(argv[i], "--dump-ir") == 0) {
+            o.dump_ir = true;
+        } else if (strcmp(argv[i], "--peephole") == 0) {
+            o.cg.peephole = true;
+        } else if (strcmp(argv[i], "--peephole-stats") == 0) {
+            o.cg.peephole = o.cg.peephole_stats = true;
+        } else if (strcmp(argv[i], "--no-borrowck") == 0) {
+            o.borrowck = false;
+        } else if (strcmp(argv[i], "--string-arena") == 0) {
+            o.string_arena = true;
+        } else if (strcmp(argv[i], "--intrinsics") == 0) {
+            o.cg.intrinsics = true;
+        } else if (strcmp(argv[i], "--instrument") == 0) {
+            o.cg.instrument = true;
+        } else if (strncmp(argv[i], "--profile-use=", 14) == 0) {
+            profile_path = argv[i] + 14;
+            if (*profile_path == '\0') usage();
+        } else if (strcmp(argv[i], "--emit=asm") == 0) {
+            o.cg.emit = EMIT_ASM;
+        } else if (strcmp(argv[i], "--emit=obj") == 0) {
+            o.cg.emit = EMIT_OBJ;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            o.run = true;
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            o.cg.opt_level = 0;
+        } else if (strcmp(argv[i], "-O1") == 0) {
+            o.cg.opt_level = 1;
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 >= argc) usage();
+            o.cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            cache_stats = true;
+        } else if (strcmp(argv[i], "--time-passes") == 0) {
+            o.stats.time = true;
+        } else if (strcmp(argv[i], "--mem-stats") == 0) {
+            o.stats.mem = true;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            o.stats.json = true;
         } else if (strcmp(argv[i], "-o") == 0) {
             if (i + 1 >= argc) usage();
             outfile = argv[++i];
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            /* -j N or -jN */
+            const char *n = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+            char *end;
+            long v = strtol(n, &end, 10);
+            if (*n == '\0' || *end != '\0' || v < 1 || v > 1024) usage();
+            jobs = (int)v;
+        } else if (strcmp(argv[i], "--help") == 0) {
+            usage();
         } else if (argv[i][0] != '-') {
-            input = argv[i];
+            st.inputs = xrealloc(st.inputs, sizeof(*st.inputs) * (size_t)(ninputs + 1));
+            st.inputs[ninputs++] = argv[i];
+        } else {
+            errorf("mycc: unknown option '%s'\n", argv[i]);
         }
     }
 
     /* Validate mandatory arguments */
-    if (!input || !outfile) usage();
+    if (ninputs == 0) usage();
+    o.several = ninputs > 1;
+    if (o.several && outfile && !is_directory(outfile))
+        errorf("mycc: -o '%s' must be an existing directory when compiling several inputs\n", outfile);
+    if (jobs == 0) jobs = cpu_count();
+    o.collect_stats = o.stats.time || o.stats.mem || o.stats.json;
+    if (o.run) {
+        if (o.several) errorf("mycc: --run takes a single input\n");
+        o.cg.emit = EMIT_JIT;
+        o.cache_dir = NULL;     /* Nothing is written that could be cached */
+    }
+
+    /* Counters are numbered by the layout a profile would change */
+    if (o.cg.instrument && profile_path)
+        errorf("mycc: --instrument and --profile-use cannot be combined\n");
+    if (profile_path) {
+        profile_load(&profile, profile_path);
+        st.profile = &profile;
+        o.profile = &profile;
+    }
 
-    /* Prepare intermediate assembly filename buffer */
-    char asmfile[256];
-    snprintf(asmfile, sizeof(asmfile), "%s.asm", outfile);
+    /* Reports that need the pipeline to run cannot come from the cache */
+    if (o.dump_ir || o.cg.peephole_stats) o.cache_dir = NULL;
+    if (o.cache_dir) {
+        StrBuf cfg;
+        sb_init(&cfg);
+        cache_compiler_id(&cfg, argv[0]);
+#ifdef _WIN32
+        sb_puts(&cfg, "; abi=win64");
+#else
+        sb_puts(&cfg, "; abi=sysv");
+#endif
+        sb_printf(&cfg, "; emit=%s; O%d; debug-borrow=%d; peephole=%d; string-arena=%d; borrowck=%d"
+                  "; intrinsics=%d; instrument=%d",
+                  o.cg.emit == EMIT_OBJ ? "obj" : "asm", o.cg.opt_level, o.cg.debug_borrow,
+                  o.cg.peephole, o.string_arena, o.borrowck, o.cg.intrinsics, o.cg.instrument);
+        if (o.profile) {
+            CacheKey pk = cache_key("profile", profile.file.data, profile.file.size);
+            sb_printf(&cfg, "; profile=%016llx%016llx", (unsigned long long)pk.hi, (unsigned long long)pk.lo);
+        }
+        sb_putc(&cfg, '\0');
+        o.cache_config = cfg.data;
+    }
+
+    /* Each unit writes <base>.asm or <base>.o/.obj */
+    Unit *units = st.units = xmalloc(sizeof(Unit) * (size_t)ninputs);
+    const char *ext = o.cg.emit == EMIT_OBJ ? OBJ_EXT : ".asm";
+    for (int i = 0; i < ninputs; i++) {
+        Unit *u = &units[i];
+        u->input = st.inputs[i];
+        u->out_base = o.several ? output_base(st.inputs[i], outfile)
+                                : (outfile ? xstrdup(outfile) : output_base(st.inputs[i], NULL));
+        u->out_file = str_concat(u->out_base, ext);
+        u->opts = &o;
+        sb_init(&u->log);
+        sb_init(&u->diag);
+        u->ok = false;
+        u->cache = CACHE_UNUSED;
+        obj_init(&u->obj);
+        st.nunits++;
+    }
+    for (int i = 0; i < ninputs; i++)
+        for (int j = 0; j < i; j++)
+            if (strcmp(units[i].out_file, units[j].out_file) == 0)
+                errorf("mycc: '%s' and '%s' would both be written to '%s'\n",
+                       units[j].input, units[i].input, units[i].out_file);
 
     /* --- Compilation Pipeline --- */
+    uint64_t started = stats_now_ns();
+    run_parallel(ninputs, jobs, compile_job, units);
+    uint64_t wall_ns = stats_now_ns() - started;
 
-    // Phase 1: Parsing (Lexing is handled internally by the parser)
-    // Returns the root of the AST (Function node)
-    Function *f = parse_program(input);
+    /* --- Reports, in input order --- */
+    int failed = 0, hits = 0, misses = 0;
+    Stats total;
+    stats_begin(&total);
+    stats_end();
+    for (int i = 0; i < ninputs; i++) {
+        Unit *u = &units[i];
+        if (o.collect_stats) stats_merge(&total, &u->stats);
+        hits += u->cache == CACHE_HIT;
+        misses += u->cache == CACHE_MISS;
+        sb_write(&u->log, out);
+        if (!u->ok) {
+            failed++;
+            fflush(out);
+            /* Errors that do not name their file get it prepended */
+            size_t in_len = strlen(u->input);
+            bool named = u->diag.len > in_len && memcmp(u->diag.data, u->input, in_len) == 0
+                         && u->diag.data[in_len] == ':';
+            if (o.several && !named) fprintf(err, "%s: ", u->input);
+            sb_write(&u->diag, err);
+            fflush(err);
+        }
+    }
 
-    // Phase 2: Semantic Analysis
-    // Performs type checking and validates ownership/borrow rules
-    semantic_check(f, input);
-
-    // Phase 3: Code Generation
-    // Emits x86_64 assembly to the .asm file and handles final binary output
-    if (codegen_function(f, asmfile, outfile, debug_borrow) != 0) {
-        fprintf(stderr, "Error: Codegen failed for input '%s'\n", input);
-        return 1;
+    /* Like the errors, statistics go to stderr and leave stdout to the reports */
+    fflush(out);
+    if (o.collect_stats)
+        stats_report(&total, ninputs, jobs < ninputs ? jobs : ninputs, wall_ns, &o.stats, err);
+    if (cache_stats) {
+        if (o.cache_dir)
+            fprintf(out, "cache: %d hits, %d misses (%s)\n", hits, misses, o.cache_dir);
+        else
+            fprintf(out, "cache: not used\n");
     }
 
-    /* --- Post-Compilation Build Instructions --- */
-    printf("Successfully generated assembly: %s\n", asmfile);
-    
-#ifdef _WIN32
-    /* Windows (Win64) build steps using NASM and GCC */
-    printf("To link and run:\n");
-    printf(">> nasm -f win64 %s -o %s.obj\n", asmfile, outfile);
-    printf(">> gcc %s.obj runtime.o -o %s.exe\n", outfile, outfile);
-    printf(">> .\\\\%s.exe\n", outfile);
-#else
-    /* Unix/Linux (ELF64) build steps using NASM and GCC */
-    printf("To link and run:\n");
-    printf(">> nasm -f elf64 %s -o %s.o\n", asmfile, outfile);
-    printf(">> gcc %s.o runtime.o -o %s\n", outfile, outfile);
-    printf(">> ./%s\n", outfile);
-#endif
+    if (failed && o.several)
+        fprintf(err, "mycc: %d of %d units failed\n", failed, ninputs);
+
+    /* Only now, so the program's output follows every report */
+    int status = failed ? 1 : 0;
+    if (o.run && !failed) status = jit_run(&units[0].obj);
+    error_cleanup_pop(&cleanup);
+    build_free(&st);
+    return status;
+}
+
+/** ServerBuild for --server: like build, but a program cannot run there. */
+static int serve_build(int argc, char **argv, FILE *out, FILE *err) {
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--run") == 0) errorf("mycc: --run is not available through the server\n");
+    return build(argc, argv, out, err);
+}
 
-    return 0;
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--server=", 9) != 0) continue;
+        if (argc != 2 || argv[i][9] == '\0') usage();
+        return server_run(argv[i] + 9, serve_build);
+    }
+
+    /* --run stays here: the program's output and exit status are ours.
+       Without a server answering, the compile happens here as before */
+    const char *server = getenv(SERVER_ENV);
+    bool run = false;
+    for (int i = 1; i < argc; i++) run |= strcmp(argv[i], "--run") == 0;
+    if (server && *server && !run) {
+        int status = server_forward(server, argc, argv);
+        if (status >= 0) return status;
+    }
+    return build(argc, argv, stdout, stderr);
 }
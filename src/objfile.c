@@ -0,0 +1,457 @@
+/**
+ * @file objfile.c
+ * @brief Relocatable object container and its ELF64 / COFF serializers.
+ *
+ * Both writers emit the file into one in-memory buffer and write it with
+ * a single fwrite. All multi-byte fields are little-endian regardless of
+ * the host.
+ */
+
+#include "../include/objfile.h"
+#include "../include/intern.h"
+#include "../include/common.h"
+
+#include <string.h>
+
+static const char *const section_names[OBJ_SEC_COUNT] = { ".text", ".data", ".rdata" };
+
+void obj_init(ObjFile *obj) {
+    memset(obj, 0, sizeof(*obj));
+    for (int i = 0; i < OBJ_SEC_COUNT; i++)
+        sb_init(&obj->sections[i].data);
+    symtab_init(&obj->by_name, sizeof(int));
+}
+
+void obj_free(ObjFile *obj) {
+    for (int i = 0; i < OBJ_SEC_COUNT; i++) {
+        sb_free(&obj->sections[i].data);
+        free(obj->sections[i].relocs);
+    }
+    for (int i = 0; i < obj->nsyms; i++)
+        free(obj->syms[i].name);
+    free(obj->syms);
+    symtab_free(&obj->by_name);
+    memset(obj, 0, sizeof(*obj));
+}
+
+int obj_find_symbol(const ObjFile *obj, const char *name) {
+    int *index = symtab_lookup(&obj->by_name, intern_cstr(name));
+    return index ? *index : -1;
+}
+
+int obj_symbol(ObjFile *obj, const char *name) {
+    int found = obj_find_symbol(obj, name);
+    if (found >= 0) return found;
+
+    if (obj->nsyms == obj->cap) {
+        obj->cap = obj->cap ? obj->cap * 2 : 32;
+        obj->syms = xrealloc(obj->syms, sizeof(ObjSymbol) * (size_t)obj->cap);
+    }
+    ObjSymbol *sym = &obj->syms[obj->nsyms];
+    sym->name = xstrdup(name);
+    sym->section = OBJ_UNDEF;
+    sym->value = 0;
+    sym->global = false;
+
+    *(int *)symtab_declare(&obj->by_name, intern_cstr(name)) = obj->nsyms;
+    return obj->nsyms++;
+}
+
+void obj_add_reloc(ObjFile *obj, int section, uint64_t offset, int symbol, ObjRelocKind kind) {
+    ObjSection *sec = &obj->sections[section];
+    if (sec->nrelocs == sec->cap) {
+        sec->cap = sec->cap ? sec->cap * 2 : 64;
+        sec->relocs = xrealloc(sec->relocs, sizeof(ObjReloc) * (size_t)sec->cap);
+    }
+    sec->relocs[sec->nrelocs].offset = offset;
+    sec->relocs[sec->nrelocs].symbol = symbol;
+    sec->relocs[sec->nrelocs].kind = kind;
+    sec->nrelocs++;
+}
+
+/* ---------------------------------------------------------
+   BYTE HELPERS
+   --------------------------------------------------------- */
+
+static void put_le(StrBuf *out, uint64_t v, int bytes) {
+    char *p = sb_reserve(out, (size_t)bytes);
+    for (int i = 0; i < bytes; i++)
+        p[i] = (char)((v >> (8 * i)) & 0xFF);
+    out->len += (size_t)bytes;
+}
+
+static void put_u8(StrBuf *out, uint8_t v)   { put_le(out, v, 1); }
+static void put_u16(StrBuf *out, uint16_t v) { put_le(out, v, 2); }
+static void put_u32(StrBuf *out, uint32_t v) { put_le(out, v, 4); }
+static void put_u64(StrBuf *out, uint64_t v) { put_le(out, v, 8); }
+
+/** Overwrites 8 bytes at `pos` (for fields whose value is known late). */
+static void patch_u64(StrBuf *out, size_t pos, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        out->data[pos + (size_t)i] = (char)((v >> (8 * i)) & 0xFF);
+}
+
+static void pad_to(StrBuf *out, size_t align) {
+    while (out->len % align) sb_putc(out, '\0');
+}
+
+/** Appends a NUL-terminated string to a string table; returns its offset. */
+static uint32_t add_string(StrBuf *table, const char *s) {
+    uint32_t offset = (uint32_t)table->len;
+    sb_append(table, s, strlen(s) + 1);
+    return offset;
+}
+
+static bool write_buffer(StrBuf *file, FILE *out) {
+    bool ok = sb_write(file, out);
+    sb_free(file);
+    return ok;
+}
+
+/* ---------------------------------------------------------
+   ELF64
+   Layout: header, .text, .data, .rodata, their .rela sections, .symtab,
+   .strtab, .shstrtab, then the section header table.
+   --------------------------------------------------------- */
+
+enum {
+    SHT_PROGBITS = 1, SHT_SYMTAB = 2, SHT_STRTAB = 3, SHT_RELA = 4,
+    SHF_WRITE = 1, SHF_ALLOC = 2, SHF_EXECINSTR = 4, SHF_INFO_LINK = 0x40,
+    STB_LOCAL = 0, STB_GLOBAL = 1,
+    STT_NOTYPE = 0, STT_SECTION = 3,
+    R_X86_64_PC32 = 2, R_X86_64_PLT32 = 4
+};
+
+/* Section header indices */
+enum {
+    ELF_NULL, ELF_TEXT, ELF_DATA, ELF_RODATA, ELF_RELA_TEXT, ELF_RELA_DATA, ELF_RELA_RODATA,
+    ELF_SYMTAB, ELF_STRTAB, ELF_SHSTRTAB, ELF_NOTE_STACK, ELF_NSECTIONS
+};
+
+typedef struct ElfShdr {
+    uint32_t name, type;
+    uint64_t flags, offset, size;
+    uint32_t link, info;
+    uint64_t align, entsize;
+} ElfShdr;
+
+static void elf_symbol(StrBuf *symtab, uint32_t name, int bind, int type,
+                       uint16_t shndx, uint64_t value) {
+    put_u32(symtab, name);
+    put_u8(symtab, (uint8_t)((bind << 4) | type));
+    put_u8(symtab, 0);
+    put_u16(symtab, shndx);
+    put_u64(symtab, value);
+    put_u64(symtab, 0);
+}
+
+static bool write_elf64(const ObjFile *obj, FILE *out) {
+    StrBuf symtab, strtab, shstrtab, rela[OBJ_SEC_COUNT];
+    sb_init(&symtab);
+    sb_init(&strtab);
+    sb_init(&shstrtab);
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) sb_init(&rela[s]);
+
+    /* Symbols: null, one per section, then locals before globals */
+    int *elf_index = xmalloc(sizeof(int) * (size_t)(obj->nsyms ? obj->nsyms : 1));
+    add_string(&strtab, "");
+    elf_symbol(&symtab, 0, STB_LOCAL, STT_NOTYPE, 0, 0);
+    elf_symbol(&symtab, 0, STB_LOCAL, STT_SECTION, ELF_TEXT, 0);
+    elf_symbol(&symtab, 0, STB_LOCAL, STT_SECTION, ELF_DATA, 0);
+    elf_symbol(&symtab, 0, STB_LOCAL, STT_SECTION, ELF_RODATA, 0);
+    int nelf = 1 + OBJ_SEC_COUNT;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < obj->nsyms; i++) {
+            const ObjSymbol *sym = &obj->syms[i];
+            bool global = sym->global || sym->section == OBJ_UNDEF;
+            if (global != (pass == 1)) continue;
+            uint16_t shndx = sym->section == OBJ_UNDEF ? 0 : (uint16_t)(ELF_TEXT + sym->section);
+            elf_symbol(&symtab, add_string(&strtab, sym->name),
+                       global ? STB_GLOBAL : STB_LOCAL, STT_NOTYPE, shndx, sym->value);
+            elf_index[i] = nelf++;
+        }
+    }
+    int first_global = 1 + OBJ_SEC_COUNT;
+    for (int i = 0; i < obj->nsyms; i++)
+        if (!obj->syms[i].global && obj->syms[i].section != OBJ_UNDEF) first_global++;
+
+    /* The field holds 0; the addend accounts for rip pointing past it */
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) {
+        const ObjSection *sec = &obj->sections[s];
+        for (int r = 0; r < sec->nrelocs; r++) {
+            const ObjReloc *rel = &sec->relocs[r];
+            uint32_t type = rel->kind == OBJ_REL_CALL32 ? R_X86_64_PLT32 : R_X86_64_PC32;
+            put_u64(&rela[s], rel->offset);
+            put_u64(&rela[s], ((uint64_t)elf_index[rel->symbol] << 32) | type);
+            put_u64(&rela[s], (uint64_t)(int64_t)-4);
+        }
+    }
+    free(elf_index);
+
+    ElfShdr sh[ELF_NSECTIONS];
+    memset(sh, 0, sizeof(sh));
+    add_string(&shstrtab, "");
+    sh[ELF_TEXT].name = add_string(&shstrtab, ".text");
+    sh[ELF_DATA].name = add_string(&shstrtab, ".data");
+    sh[ELF_RODATA].name = add_string(&shstrtab, ".rodata");
+    sh[ELF_RELA_TEXT].name = add_string(&shstrtab, ".rela.text");
+    sh[ELF_RELA_DATA].name = add_string(&shstrtab, ".rela.data");
+    sh[ELF_RELA_RODATA].name = add_string(&shstrtab, ".rela.rodata");
+    sh[ELF_SYMTAB].name = add_string(&shstrtab, ".symtab");
+    sh[ELF_STRTAB].name = add_string(&shstrtab, ".strtab");
+    sh[ELF_SHSTRTAB].name = add_string(&shstrtab, ".shstrtab");
+    sh[ELF_NOTE_STACK].name = add_string(&shstrtab, ".note.GNU-stack");
+
+    sh[ELF_TEXT].type = SHT_PROGBITS;
+    sh[ELF_TEXT].flags = SHF_ALLOC | SHF_EXECINSTR;
+    sh[ELF_TEXT].align = OBJ_SECTION_ALIGN;
+    sh[ELF_DATA].type = SHT_PROGBITS;
+    sh[ELF_DATA].flags = SHF_ALLOC | SHF_WRITE;
+    sh[ELF_DATA].align = OBJ_SECTION_ALIGN;
+    sh[ELF_RODATA].type = SHT_PROGBITS;
+    sh[ELF_RODATA].flags = SHF_ALLOC;
+    sh[ELF_RODATA].align = OBJ_SECTION_ALIGN;
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) {
+        ElfShdr *r = &sh[ELF_RELA_TEXT + s];
+        r->type = SHT_RELA;
+        r->flags = SHF_INFO_LINK;
+        r->link = ELF_SYMTAB;
+        r->info = (uint32_t)(ELF_TEXT + s);
+        r->align = 8;
+        r->entsize = 24;
+    }
+    sh[ELF_SYMTAB].type = SHT_SYMTAB;
+    sh[ELF_SYMTAB].link = ELF_STRTAB;
+    sh[ELF_SYMTAB].info = (uint32_t)first_global;
+    sh[ELF_SYMTAB].align = 8;
+    sh[ELF_SYMTAB].entsize = 24;
+    sh[ELF_STRTAB].type = SHT_STRTAB;
+    sh[ELF_STRTAB].align = 1;
+    sh[ELF_SHSTRTAB].type = SHT_STRTAB;
+    sh[ELF_SHSTRTAB].align = 1;
+    sh[ELF_NOTE_STACK].type = SHT_PROGBITS;
+    sh[ELF_NOTE_STACK].align = 1;
+
+    const StrBuf *contents[ELF_NSECTIONS] = {
+        [ELF_TEXT] = &obj->sections[OBJ_SEC_TEXT].data,
+        [ELF_DATA] = &obj->sections[OBJ_SEC_DATA].data,
+        [ELF_RODATA] = &obj->sections[OBJ_SEC_RODATA].data,
+        [ELF_RELA_TEXT] = &rela[OBJ_SEC_TEXT],
+        [ELF_RELA_DATA] = &rela[OBJ_SEC_DATA],
+        [ELF_RELA_RODATA] = &rela[OBJ_SEC_RODATA],
+        [ELF_SYMTAB] = &symtab,
+        [ELF_STRTAB] = &strtab,
+        [ELF_SHSTRTAB] = &shstrtab,
+    };
+
+    StrBuf file;
+    sb_init(&file);
+
+    /* e_ident: magic, 64-bit, little-endian, version 1, System V ABI */
+    sb_append(&file, "\x7f" "ELF\x02\x01\x01\x00", 8);
+    put_u64(&file, 0);
+    put_u16(&file, 1);          /* ET_REL */
+    put_u16(&file, 62);         /* EM_X86_64 */
+    put_u32(&file, 1);          /* EV_CURRENT */
+    put_u64(&file, 0);          /* e_entry */
+    put_u64(&file, 0);          /* e_phoff */
+    size_t shoff_pos = file.len;
+    put_u64(&file, 0);          /* e_shoff, patched below */
+    put_u32(&file, 0);          /* e_flags */
+    put_u16(&file, 64);         /* e_ehsize */
+    put_u16(&file, 0);          /* e_phentsize */
+    put_u16(&file, 0);          /* e_phnum */
+    put_u16(&file, 64);         /* e_shentsize */
+    put_u16(&file, ELF_NSECTIONS);
+    put_u16(&file, ELF_SHSTRTAB);
+
+    for (int i = 1; i < ELF_NSECTIONS; i++) {
+        if (!contents[i]) continue;
+        pad_to(&file, sh[i].align);
+        sh[i].offset = file.len;
+        sh[i].size = contents[i]->len;
+        sb_append(&file, contents[i]->data, contents[i]->len);
+    }
+    sh[ELF_NOTE_STACK].offset = file.len;
+
+    pad_to(&file, 8);
+    patch_u64(&file, shoff_pos, file.len);
+    for (int i = 0; i < ELF_NSECTIONS; i++) {
+        put_u32(&file, sh[i].name);
+        put_u32(&file, sh[i].type);
+        put_u64(&file, sh[i].flags);
+        put_u64(&file, 0);      /* sh_addr */
+        put_u64(&file, sh[i].offset);
+        put_u64(&file, sh[i].size);
+        put_u32(&file, sh[i].link);
+        put_u32(&file, sh[i].info);
+        put_u64(&file, sh[i].align);
+        put_u64(&file, sh[i].entsize);
+    }
+
+    sb_free(&symtab);
+    sb_free(&strtab);
+    sb_free(&shstrtab);
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) sb_free(&rela[s]);
+    return write_buffer(&file, out);
+}
+
+/* ---------------------------------------------------------
+   COFF (x86_64)
+   Layout: file header, section headers, then per section its raw data
+   followed by its relocations, then the symbol and string tables.
+   --------------------------------------------------------- */
+
+enum {
+    IMAGE_FILE_MACHINE_AMD64 = 0x8664,
+    IMAGE_REL_AMD64_ABSOLUTE = 0,
+    IMAGE_REL_AMD64_REL32 = 4,
+    IMAGE_SYM_CLASS_EXTERNAL = 2,
+    IMAGE_SYM_CLASS_STATIC = 3,
+    IMAGE_SYM_DTYPE_FUNCTION = 0x20
+};
+
+/* Characteristics: contents, alignment and access */
+#define COFF_TEXT_FLAGS 0x60500020u     /* CODE | ALIGN_16BYTES | EXECUTE | READ */
+#define COFF_DATA_FLAGS 0xC0500040u     /* INITIALIZED_DATA | ALIGN_16BYTES | READ | WRITE */
+#define COFF_RDATA_FLAGS 0x40500040u    /* INITIALIZED_DATA | ALIGN_16BYTES | READ */
+
+/*
+ * A section with 0xFFFF or more relocations sets LNK_NRELOC_OVFL, stores
+ * 0xFFFF in its 16-bit counts and puts the real count, including itself,
+ * in the address field of an extra first relocation.
+ */
+#define IMAGE_SCN_LNK_NRELOC_OVFL 0x01000000u
+#define COFF_MAX_RELOCS 0xFFFF
+
+static bool reloc_overflow(const ObjSection *sec) {
+    return sec->nrelocs >= COFF_MAX_RELOCS;
+}
+
+/** Relocation records written for `sec`, with the overflow record. */
+static uint32_t reloc_records(const ObjSection *sec) {
+    return (uint32_t)sec->nrelocs + (reloc_overflow(sec) ? 1u : 0u);
+}
+
+/** Value of the 16-bit relocation count fields. */
+static uint16_t reloc_count16(const ObjSection *sec) {
+    return (uint16_t)(reloc_overflow(sec) ? COFF_MAX_RELOCS : sec->nrelocs);
+}
+
+/** 8-byte short name, or "/0" + string table offset for longer names. */
+static void coff_name(StrBuf *out, StrBuf *strtab, const char *name) {
+    size_t len = strlen(name);
+    if (len <= 8) {
+        char field[8] = { 0 };
+        memcpy(field, name, len);
+        sb_append(out, field, 8);
+        return;
+    }
+    put_u32(out, 0);
+    put_u32(out, (uint32_t)strtab->len + 4);    /* Offsets include the size field */
+    sb_append(strtab, name, len + 1);
+}
+
+static bool write_coff64(const ObjFile *obj, FILE *out) {
+    static const uint32_t flags[OBJ_SEC_COUNT] = { COFF_TEXT_FLAGS, COFF_DATA_FLAGS, COFF_RDATA_FLAGS };
+    const int header_size = 20 + 40 * OBJ_SEC_COUNT;
+
+    /* Section symbols take two records each (symbol + auxiliary) */
+    int *coff_index = xmalloc(sizeof(int) * (size_t)(obj->nsyms ? obj->nsyms : 1));
+    for (int i = 0; i < obj->nsyms; i++)
+        coff_index[i] = 2 * OBJ_SEC_COUNT + i;
+
+    /* Raw data and relocations follow the headers */
+    uint32_t raw_offset[OBJ_SEC_COUNT], reloc_offset[OBJ_SEC_COUNT];
+    uint32_t pos = (uint32_t)header_size;
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) {
+        raw_offset[s] = pos;
+        pos += (uint32_t)obj->sections[s].data.len;
+        reloc_offset[s] = pos;
+        pos += 10u * reloc_records(&obj->sections[s]);
+    }
+    uint32_t symtab_offset = pos;
+
+    StrBuf file, strtab;
+    sb_init(&file);
+    sb_init(&strtab);
+
+    put_u16(&file, IMAGE_FILE_MACHINE_AMD64);
+    put_u16(&file, OBJ_SEC_COUNT);
+    put_u32(&file, 0);                  /* TimeDateStamp: keep output reproducible */
+    put_u32(&file, symtab_offset);
+    put_u32(&file, (uint32_t)(2 * OBJ_SEC_COUNT + obj->nsyms));
+    put_u16(&file, 0);                  /* SizeOfOptionalHeader */
+    put_u16(&file, 0);                  /* Characteristics */
+
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) {
+        const ObjSection *sec = &obj->sections[s];
+        coff_name(&file, &strtab, section_names[s]);
+        put_u32(&file, 0);              /* VirtualSize */
+        put_u32(&file, 0);              /* VirtualAddress */
+        put_u32(&file, (uint32_t)sec->data.len);
+        put_u32(&file, sec->data.len ? raw_offset[s] : 0);
+        put_u32(&file, sec->nrelocs ? reloc_offset[s] : 0);
+        put_u32(&file, 0);              /* PointerToLinenumbers */
+        put_u16(&file, reloc_count16(sec));
+        put_u16(&file, 0);              /* NumberOfLinenumbers */
+        put_u32(&file, flags[s] | (reloc_overflow(sec) ? IMAGE_SCN_LNK_NRELOC_OVFL : 0));
+    }
+
+    /* REL32 adds the value stored in the field, so the fields stay 0 */
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) {
+        const ObjSection *sec = &obj->sections[s];
+        sb_append(&file, sec->data.data, sec->data.len);
+        if (reloc_overflow(sec)) {
+            put_u32(&file, reloc_records(sec));
+            put_u32(&file, 0);
+            put_u16(&file, IMAGE_REL_AMD64_ABSOLUTE);
+        }
+        for (int r = 0; r < sec->nrelocs; r++) {
+            put_u32(&file, (uint32_t)sec->relocs[r].offset);
+            put_u32(&file, (uint32_t)coff_index[sec->relocs[r].symbol]);
+            put_u16(&file, IMAGE_REL_AMD64_REL32);
+        }
+    }
+    free(coff_index);
+
+    for (int s = 0; s < OBJ_SEC_COUNT; s++) {
+        const ObjSection *sec = &obj->sections[s];
+        coff_name(&file, &strtab, section_names[s]);
+        put_u32(&file, 0);
+        put_u16(&file, (uint16_t)(s + 1));
+        put_u16(&file, 0);
+        put_u8(&file, IMAGE_SYM_CLASS_STATIC);
+        put_u8(&file, 1);               /* One auxiliary record */
+
+        /* Section definition: length, relocation count, line numbers, checksum, number */
+        put_u32(&file, (uint32_t)sec->data.len);
+        put_u16(&file, reloc_count16(sec));
+        put_u16(&file, 0);
+        put_u32(&file, 0);
+        put_u16(&file, 0);
+        put_u8(&file, 0);
+        sb_append(&file, "\0\0\0", 3);
+    }
+
+    for (int i = 0; i < obj->nsyms; i++) {
+        const ObjSymbol *sym = &obj->syms[i];
+        bool external = sym->global || sym->section == OBJ_UNDEF;
+        coff_name(&file, &strtab, sym->name);
+        put_u32(&file, (uint32_t)sym->value);
+        put_u16(&file, (uint16_t)(sym->section == OBJ_UNDEF ? 0 : sym->section + 1));
+        put_u16(&file, sym->section == OBJ_SEC_TEXT || sym->section == OBJ_UNDEF
+                       ? IMAGE_SYM_DTYPE_FUNCTION : 0);
+        put_u8(&file, external ? IMAGE_SYM_CLASS_EXTERNAL : IMAGE_SYM_CLASS_STATIC);
+        put_u8(&file, 0);
+    }
+
+    put_u32(&file, (uint32_t)strtab.len + 4);
+    sb_append(&file, strtab.data, strtab.len);
+    sb_free(&strtab);
+    return write_buffer(&file, out);
+}
+
+bool obj_write(const ObjFile *obj, ObjFormat fmt, FILE *out) {
+    return fmt == OBJ_COFF64 ? write_coff64(obj, out) : write_elf64(obj, out);
+}
@@ -0,0 +1,483 @@
+/**
+ * @file opt.c
+ * @brief Scalar optimizations over the linear IR.
+ *
+ * Passes rewrite or move instructions and never add new ones, so
+ * temporaries keep their single definition. Arithmetic is folded with
+ * two's-complement wraparound to match what the emitted code computes.
+ *
+ * A slot whose address is taken still only changes at its own stores when
+ * the borrow checker proved that no reference can write it (its alias
+ * fact), so it is treated like a slot that is never borrowed.
+ */
+
+#include "../include/opt.h"
+#include "../include/ir.h"
+#include "../include/common.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   ANALYSIS HELPERS
+   --------------------------------------------------------- */
+
+/** Per-slot access summary. */
+typedef struct SlotInfo {
+    int nstores;
+    int nloads;
+    bool addr_taken;
+    int stored;         /* Temporary of the (last seen) store */
+} SlotInfo;
+
+static SlotInfo *scan_slots(IrFunc *fn) {
+    SlotInfo *info = xmalloc(sizeof(SlotInfo) * (size_t)(fn->nslots ? fn->nslots : 1));
+    for (int i = 0; i < fn->nslots; i++) {
+        info[i].nstores = info[i].nloads = 0;
+        info[i].addr_taken = false;
+        info[i].stored = -1;
+    }
+
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++) {
+            IrInstr *in = &blk->code[j];
+            switch (in->op) {
+            case IR_STORE: info[in->slot].nstores++; info[in->slot].stored = in->a; break;
+            case IR_LOAD:  info[in->slot].nloads++; break;
+            case IR_LOADX: info[in->slot].nloads++; break;
+            case IR_STOREX:
+            case IR_COPY:
+            case IR_ZERO:  info[in->slot].nstores++; break;
+            case IR_ADDR:  info[in->slot].addr_taken = true; break;
+            default: break;
+            }
+        }
+    }
+    return info;
+}
+
+/** True if only the slot's own stores can change it. */
+static bool only_stored_directly(const IrFunc *fn, const SlotInfo *info, int slot) {
+    return !info[slot].addr_taken || ir_slot_unaliased(&fn->slots[slot]);
+}
+
+/** Counts how many instructions read each temporary. */
+static int *count_uses(IrFunc *fn) {
+    int *uses = xmalloc(sizeof(int) * (size_t)(fn->ntemps ? fn->ntemps : 1));
+    memset(uses, 0, sizeof(int) * (size_t)(fn->ntemps ? fn->ntemps : 1));
+
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++) {
+            if (blk->code[j].a >= 0) uses[blk->code[j].a]++;
+            if (blk->code[j].b >= 0) uses[blk->code[j].b]++;
+        }
+    }
+    return uses;
+}
+
+/**
+ * @brief Evaluates `a op b` at compile time.
+ * Returns false for operations that must trap at run time (division by
+ * zero, or the INT64_MIN / -1 overflow).
+ */
+static bool eval_binop(char op, long a, long b, long *out) {
+    unsigned long ua = (unsigned long)a, ub = (unsigned long)b;
+
+    switch (op) {
+    case '+': *out = (long)(ua + ub); return true;
+    case '-': *out = (long)(ua - ub); return true;
+    case '*': *out = (long)(ua * ub); return true;
+    case '/':
+    case '%':
+        if (b == 0 || (b == -1 && a == LONG_MIN))
+            return false;
+        *out = (op == '/') ? a / b : a % b;
+        return true;
+    case '<': *out = a < b;  return true;
+    case '>': *out = a > b;  return true;
+    case 'l': *out = a <= b; return true;
+    case 'g': *out = a >= b; return true;
+    case 'e': *out = a == b; return true;
+    case 'n': *out = a != b; return true;
+    default:  return false;
+    }
+}
+
+static void make_const(IrInstr *in, long v) {
+    int dst = in->dst;
+    memset(in, 0, sizeof(*in));
+    in->op = IR_CONST;
+    in->dst = dst;
+    in->a = in->b = in->slot = -1;
+    in->target = in->alt = -1;
+    in->imm = v;
+}
+
+/* ---------------------------------------------------------
+   CONSTANT FOLDING & PROPAGATION
+   --------------------------------------------------------- */
+
+void opt_constant_fold(IrFunc *fn) {
+    int nt = fn->ntemps ? fn->ntemps : 1;
+    bool *known = xmalloc(sizeof(bool) * (size_t)nt);
+    long *value = xmalloc(sizeof(long) * (size_t)nt);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        memset(known, 0, sizeof(bool) * (size_t)nt);
+
+        /* Constants are defined before use in layout order except across
+           back edges, which only ever delay a fold to the next round. */
+        SlotInfo *slots = scan_slots(fn);
+
+        for (int i = 0; i < fn->nblocks; i++) {
+            IrBlock *blk = fn->blocks[i];
+            for (int j = 0; j < blk->n; j++) {
+                IrInstr *in = &blk->code[j];
+
+                switch (in->op) {
+                case IR_CONST:
+                    known[in->dst] = true;
+                    value[in->dst] = in->imm;
+                    break;
+
+                case IR_LOAD: {
+                    /* An int written once and not writable through a reference is immutable */
+                    SlotInfo *si = &slots[in->slot];
+                    if (fn->slots[in->slot].type.kind == TY_INT && only_stored_directly(fn, slots, in->slot) &&
+                        si->nstores == 1 && si->stored >= 0 && known[si->stored]) {
+                        make_const(in, value[si->stored]);
+                        known[in->dst] = true;
+                        value[in->dst] = in->imm;
+                        changed = true;
+                    }
+                    break;
+                }
+
+                case IR_BIN: {
+                    long v;
+                    if (known[in->a] && known[in->b] &&
+                        eval_binop(in->binop, value[in->a], value[in->b], &v)) {
+                        make_const(in, v);
+                        known[in->dst] = true;
+                        value[in->dst] = v;
+                        changed = true;
+                    }
+                    break;
+                }
+
+                case IR_BOUNDS:
+                    /* A check that cannot fail passes its index through */
+                    if (known[in->a] && value[in->a] >= 0 && value[in->a] < in->imm) {
+                        long v = value[in->a];
+                        make_const(in, v);
+                        known[in->dst] = true;
+                        value[in->dst] = v;
+                        changed = true;
+                    }
+                    break;
+
+                case IR_BR:
+                    if (known[in->a]) {
+                        int target = value[in->a] ? in->target : in->alt;
+                        in->op = IR_JMP;
+                        in->a = -1;
+                        in->target = target;
+                        in->alt = -1;
+                        changed = true;
+                    }
+                    break;
+
+                default:
+                    break;
+                }
+            }
+        }
+        free(slots);
+    }
+
+    free(known);
+    free(value);
+}
+
+/* ---------------------------------------------------------
+   DEAD CODE ELIMINATION
+   --------------------------------------------------------- */
+
+/** Drops blocks not reachable from the entry and renumbers the rest. */
+static void remove_unreachable(IrFunc *fn) {
+    int n = fn->nblocks;
+    bool *reach = xmalloc(sizeof(bool) * (size_t)n);
+    int *work = xmalloc(sizeof(int) * (size_t)n);
+    int *remap = xmalloc(sizeof(int) * (size_t)n);
+    memset(reach, 0, sizeof(bool) * (size_t)n);
+
+    int top = 0;
+    reach[0] = true;
+    work[top++] = 0;
+    while (top > 0) {
+        IrBlock *blk = fn->blocks[work[--top]];
+        IrInstr *term = &blk->code[blk->n - 1];
+        int succ[2] = { term->target, term->alt };
+        for (int k = 0; k < 2; k++) {
+            if (succ[k] >= 0 && !reach[succ[k]]) {
+                reach[succ[k]] = true;
+                work[top++] = succ[k];
+            }
+        }
+    }
+
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (reach[i]) {
+            remap[i] = kept;
+            fn->blocks[kept++] = fn->blocks[i];
+        } else {
+            free(fn->blocks[i]->code);
+            free(fn->blocks[i]);
+        }
+    }
+    fn->nblocks = kept;
+
+    for (int i = 0; i < kept; i++) {
+        IrBlock *blk = fn->blocks[i];
+        blk->id = i;
+        IrInstr *term = &blk->code[blk->n - 1];
+        if (term->target >= 0) term->target = remap[term->target];
+        if (term->alt >= 0) term->alt = remap[term->alt];
+    }
+
+    free(reach);
+    free(work);
+    free(remap);
+}
+
+/** True if removing the instruction cannot change observable behaviour. */
+static bool is_removable(IrInstr *in, const int *uses, const SlotInfo *slots) {
+    switch (in->op) {
+    case IR_CONST:
+    case IR_STR:
+    case IR_LOAD:
+    case IR_ADDR:
+    case IR_ARRAY:
+    case IR_LOADX:
+        return uses[in->dst] == 0;
+    case IR_BIN:
+        /* Division may trap; keep it unless the divisor was folded away */
+        return uses[in->dst] == 0 && in->binop != '/' && in->binop != '%';
+    case IR_STORE:
+    case IR_STOREX:
+    case IR_COPY:
+    case IR_ZERO:
+        return slots[in->slot].nloads == 0 && !slots[in->slot].addr_taken;
+    default:
+        return false;
+    }
+}
+
+/** Renumbers slots so that only referenced ones occupy frame space. */
+static void compact_slots(IrFunc *fn) {
+    SlotInfo *info = scan_slots(fn);
+    int *remap = xmalloc(sizeof(int) * (size_t)(fn->nslots ? fn->nslots : 1));
+
+    int kept = 0;
+    for (int i = 0; i < fn->nslots; i++) {
+        if (info[i].nloads || info[i].nstores || info[i].addr_taken) {
+            remap[i] = kept;
+            fn->slots[kept++] = fn->slots[i];
+        }
+    }
+    fn->nslots = kept;
+
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++) {
+            if (blk->code[j].slot >= 0)
+                blk->code[j].slot = remap[blk->code[j].slot];
+        }
+    }
+
+    free(info);
+    free(remap);
+}
+
+void opt_dead_code(IrFunc *fn) {
+    remove_unreachable(fn);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        int *uses = count_uses(fn);
+        SlotInfo *slots = scan_slots(fn);
+
+        for (int i = 0; i < fn->nblocks; i++) {
+            IrBlock *blk = fn->blocks[i];
+            int out = 0;
+            for (int j = 0; j < blk->n; j++) {
+                if (is_removable(&blk->code[j], uses, slots)) {
+                    changed = true;
+                    continue;
+                }
+                blk->code[out++] = blk->code[j];
+            }
+            blk->n = out;
+        }
+
+        free(uses);
+        free(slots);
+    }
+
+    compact_slots(fn);
+}
+
+/* ---------------------------------------------------------
+   LOOP-INVARIANT LOADS
+   Loops are contiguous in layout: a back edge from the latch to the
+   head spans exactly the blocks of the loop, as codegen assumes too.
+   --------------------------------------------------------- */
+
+/** Renumbers temporaries in definition order, which codegen relies on. */
+static void renumber_temps(IrFunc *fn) {
+    int nt = fn->ntemps ? fn->ntemps : 1;
+    int *remap = xmalloc(sizeof(int) * (size_t)nt);
+    int next = 0;
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++) {
+            IrInstr *in = &blk->code[j];
+            if (in->a >= 0) in->a = remap[in->a];
+            if (in->b >= 0) in->b = remap[in->b];
+            if (in->dst >= 0) in->dst = remap[in->dst] = next++;
+        }
+    }
+    fn->ntemps = next;
+    free(remap);
+}
+
+/** Appends `in` to `blk` just before its terminator. */
+static void insert_before_terminator(IrBlock *blk, IrInstr in) {
+    if (blk->n == blk->cap) {
+        blk->cap = blk->cap ? blk->cap * 2 : 8;
+        blk->code = xrealloc(blk->code, sizeof(IrInstr) * (size_t)blk->cap);
+    }
+    blk->code[blk->n] = blk->code[blk->n - 1];
+    blk->code[blk->n - 1] = in;
+    blk->n++;
+}
+
+/**
+ * @brief Hoists the loads of loop [head, latch] whose slot it never stores
+ * into the block that jumps to the head from outside; returns true if any
+ * moved. Loops with calls keep their loads, since a value held across a
+ * call costs a save and a restore around it.
+ */
+static bool hoist_loop(IrFunc *fn, int head, int latch, const SlotInfo *info,
+                       bool *stored, int *hoisted, int *replace) {
+    /* The loop must be entered only at its head, from one plain jump */
+    int pre = -1;
+    for (int i = 0; i < fn->nblocks; i++) {
+        if (i >= head && i <= latch) continue;
+        IrInstr *term = &fn->blocks[i]->code[fn->blocks[i]->n - 1];
+        int succ[2] = { term->target, term->alt };
+        for (int k = 0; k < 2; k++) {
+            if (succ[k] < head || succ[k] > latch) continue;
+            if (succ[k] != head || term->op != IR_JMP || pre >= 0) return false;
+            pre = i;
+        }
+    }
+    if (pre < 0 || pre > head || fn->blocks[pre]->par != fn->blocks[head]->par) return false;
+
+    for (int s = 0; s < fn->nslots; s++) {
+        stored[s] = false;
+        hoisted[s] = -1;
+    }
+    for (int i = head; i <= latch; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++) {
+            IrInstr *in = &blk->code[j];
+            if (in->op == IR_CALL || in->op == IR_PAR) return false;
+            if (in->op == IR_STORE || in->op == IR_STOREX || in->op == IR_COPY || in->op == IR_ZERO)
+                stored[in->slot] = true;
+        }
+    }
+
+    /* The first load of each slot moves; later ones reuse its temporary */
+    bool moved = false;
+    for (int i = head; i <= latch; i++) {
+        IrBlock *blk = fn->blocks[i];
+        int out = 0;
+        for (int j = 0; j < blk->n; j++) {
+            IrInstr in = blk->code[j];
+            if (in.op == IR_LOAD && !stored[in.slot] && only_stored_directly(fn, info, in.slot)) {
+                if (hoisted[in.slot] < 0) {
+                    hoisted[in.slot] = in.dst;
+                    insert_before_terminator(fn->blocks[pre], in);
+                } else {
+                    replace[in.dst] = hoisted[in.slot];
+                }
+                moved = true;
+                continue;
+            }
+            blk->code[out++] = in;
+        }
+        blk->n = out;
+    }
+    return moved;
+}
+
+void opt_hoist_loads(IrFunc *fn) {
+    int nb = fn->nblocks, nt = fn->ntemps ? fn->ntemps : 1;
+    int *latch = xmalloc(sizeof(int) * (size_t)(nb ? nb : 1));
+    for (int i = 0; i < nb; i++) latch[i] = -1;
+    for (int i = 0; i < nb; i++) {
+        IrInstr *term = &fn->blocks[i]->code[fn->blocks[i]->n - 1];
+        int succ[2] = { term->target, term->alt };
+        for (int k = 0; k < 2; k++)
+            if (succ[k] >= 0 && succ[k] <= i && latch[succ[k]] < i) latch[succ[k]] = i;
+    }
+
+    SlotInfo *info = scan_slots(fn);
+    bool *stored = xmalloc(sizeof(bool) * (size_t)(fn->nslots ? fn->nslots : 1));
+    int *hoisted = xmalloc(sizeof(int) * (size_t)(fn->nslots ? fn->nslots : 1));
+    int *replace = xmalloc(sizeof(int) * (size_t)nt);
+    for (int t = 0; t < nt; t++) replace[t] = -1;
+
+    /* Inner loops first: what leaves one may then leave the loop around it */
+    bool moved = false;
+    for (int h = nb - 1; h >= 0; h--)
+        if (latch[h] >= 0) moved |= hoist_loop(fn, h, latch[h], info, stored, hoisted, replace);
+
+    /* A load hoisted out of an inner loop may itself be replaced by the outer one */
+    if (moved) {
+        for (int i = 0; i < nb; i++) {
+            IrBlock *blk = fn->blocks[i];
+            for (int j = 0; j < blk->n; j++) {
+                IrInstr *in = &blk->code[j];
+                while (in->a >= 0 && replace[in->a] >= 0) in->a = replace[in->a];
+                while (in->b >= 0 && replace[in->b] >= 0) in->b = replace[in->b];
+            }
+        }
+        renumber_temps(fn);
+    }
+
+    free(latch);
+    free(info);
+    free(stored);
+    free(hoisted);
+    free(replace);
+}
+
+/* ---------------------------------------------------------
+   PASS PIPELINE
+   --------------------------------------------------------- */
+
+void ir_optimize(IrFunc *fn, int opt_level) {
+    if (opt_level < 1) return;
+    opt_constant_fold(fn);
+    opt_dead_code(fn);
+    opt_hoist_loads(fn);
+}
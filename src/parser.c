@@ -10,57 +10,90 @@
 #include "../include/lexer.h"
 #include "../include/ast.h"
 #include "../include/common.h"
+#include "../include/stats.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-/** * @brief Global parser state.
- * L: The lexer instance used for scanning source characters.
+/** * @brief State of one parse, passed to every parsing function so that
+ * several files can be parsed at once on different threads.
+ * lex: The lexer instance used for scanning source characters.
  * cur: The current lookahead token buffer.
+ * arena: Receives every AST node and list; handed to the Function.
+ * ntokens: Tokens consumed, reported with the compiler statistics.
  */
-static Token cur;
-static Lexer L;
+typedef struct Parser {
+    Lexer lex;
+    Token cur;
+    Arena arena;
+    long ntokens;       /* Tokens read so far, for --mem-stats */
+} Parser;
+
+/**
+ * @brief Appends `x` to an array `items` in `arena` of `n` used / `cap`
+ * allocated elements. Capacity doubles, and the newest arena allocation
+ * grows in place, so appends are amortized O(1).
+ */
+#define LIST_PUSH(arena, items, n, cap, x) do {                               \
+    if ((n) == (cap)) {                                                       \
+        int grown_ = (cap) ? (cap) * 2 : 4;                                   \
+        (items) = arena_realloc((arena), (items),                             \
+                                sizeof(*(items)) * (size_t)(cap),             \
+                                sizeof(*(items)) * (size_t)grown_);           \
+        (cap) = grown_;                                                       \
+    }                                                                         \
+    (items)[(n)++] = (x);                                                     \
+} while (0)
 
 /* ---------------------------------------------------------
    PARSER UTILITIES
    --------------------------------------------------------- */
 
+/** Error cleanup: releases what a parse stopped by an error has built. */
+static void parser_free(void *arg) {
+    Parser *p = arg;
+    arena_free(&p->arena);
+    source_close(&p->lex.source);
+}
+
 /**
  * @brief Fetches the next token from the lexer and updates the 'cur' state.
  */
-static void nexttok() {
-    cur = lexer_next(&L);
+static void nexttok(Parser *p) {
+    p->cur = lexer_next(&p->lex);
+    p->ntokens++;
 }
 
 /**
  * @brief Checks if the current token matches a specific kind without consuming it.
  */
-static bool tok_is(TokenKind k) {
-    return cur.kind == k;
+static bool tok_is(Parser *p, TokenKind k) {
+    return p->cur.kind == k;
 }
 
 /**
  * @brief Validates that the current token is of kind 'k'.
- * If it matches, the token is consumed via nexttok(). If not, a fatal 
+ * If it matches, the token is consumed via nexttok(p). If not, a fatal 
  * parse error is reported.
  */
-static void expect(TokenKind k, const char *msg) {
-    if (!tok_is(k)) {
-        errorf("Parse error at %d:%d: expected %s (got '%s')\n",
-                cur.line, cur.col, msg, cur.lexeme);
+static void expect(Parser *p, TokenKind k, const char *msg) {
+    if (!tok_is(p, k)) {
+        errorf_at(p->cur.line, p->cur.col, "syntax error: expected %s (got '%.*s')\n",
+                  msg, p->cur.len, tok_text(&p->lex, &p->cur));
     }
-    nexttok();
+    nexttok(p);
 }
 
 /* Forward declarations to handle mutual recursion in the grammar */
-static Expr *parse_expr();
-static Expr *parse_primary();
-static Stmt *parse_stmt();
-static Stmt *parse_block();
+static Expr *parse_expr(Parser *p);
+static Expr *parse_binary(Parser *p, int min_prec);
+static Expr *parse_primary(Parser *p);
+static Stmt *parse_stmt(Parser *p);
+static Stmt *parse_block(Parser *p);
 
 /* ---------------------------------------------------------
-   EXPRESSION PARSING (Precedence: Primary > Range)
+   EXPRESSION PARSING (Precedence: Primary > Binary > Range)
    --------------------------------------------------------- */
 
 /**
@@ -71,114 +104,170 @@ static Stmt *parse_block();
  * Grammar:
  * Primary -> INTLIT | STRLIT | IDENT ('(' args? ')')? ('[' expr ']')* | '[' items? ']' | '&' Primary
  */
-static Expr *parse_primary() {
-    int l = cur.line, c = cur.col;
+static Expr *parse_primary(Parser *p) {
+    int l = p->cur.line, c = p->cur.col;
 
     // Handle Integer Literals
-    if (tok_is(T_INTLIT)) {
-        long v = cur.int_val;
-        nexttok();
-        return expr_int(v, l, c);
+    if (tok_is(p, T_INTLIT)) {
+        long v = p->cur.int_val;
+        nexttok(p);
+        return expr_int(&p->arena, v, l, c);
     }
 
     // Handle String Literals
-    if (tok_is(T_STRLIT)) {
-        const char *s = cur.lexeme;
-        nexttok();
-        return expr_str(s, l, c);
+    if (tok_is(p, T_STRLIT)) {
+        Expr *e = expr_str(&p->arena, p->cur.str, p->cur.str_len, l, c);
+        nexttok(p);
+        return e;
     }
 
     // Handle Identifiers, Function Calls, and Array Indexing
-    if (tok_is(T_IDENT) || tok_is(T_PRINT)) {
-        char name[MAX_IDENT];
-        snprintf(name, sizeof(name), "%s", cur.lexeme);
-        nexttok();
+    if (tok_is(p, T_IDENT) || tok_is(p, T_PRINT)) {
+        Symbol name = p->cur.sym;
+        nexttok(p);
 
-        Expr *base = expr_ident(name, l, c);
+        Expr *base = expr_ident(&p->arena, name, l, c);
 
         // Branching for Function Calls: ident(...)
-        if (tok_is(T_LPAREN)) {
-            nexttok();
+        if (tok_is(p, T_LPAREN)) {
+            nexttok(p);
             Expr **args = NULL;
-            int nargs = 0;
+            int nargs = 0, cap = 0;
 
-            if (!tok_is(T_RPAREN)) {
+            if (!tok_is(p, T_RPAREN)) {
                 while (1) {
-                    Expr *a = parse_expr();
-                    args = realloc(args, sizeof(Expr *) * (nargs + 1));
-                    args[nargs++] = a;
+                    Expr *a = parse_expr(p);
+                    LIST_PUSH(&p->arena, args, nargs, cap, a);
 
-                    if (tok_is(T_COMMA)) {
-                        nexttok();
+                    if (tok_is(p, T_COMMA)) {
+                        nexttok(p);
                         continue;
                     }
                     break;
                 }
             }
-            expect(T_RPAREN, "')'");
-            base = expr_call(name, args, nargs, l, c);
+            expect(p, T_RPAREN, "')'");
+            base = expr_call(&p->arena, name, args, nargs, l, c);
         }
 
         // Branching for Postfix Array Indexing: ident[idx]
-        while (tok_is(T_LBRACKET)) {
-            nexttok();
-            Expr *idx = parse_expr();
-            expect(T_RBRACKET, "']'");
-            base = expr_index(base, idx, l, c);
+        while (tok_is(p, T_LBRACKET)) {
+            nexttok(p);
+            Expr *idx = parse_expr(p);
+            expect(p, T_RBRACKET, "']'");
+            base = expr_index(&p->arena, base, idx, l, c);
         }
 
         return base;
     }
 
     // Handle Array Literals: [1, 2, 3]
-    if (tok_is(T_LBRACKET)) {
-        nexttok();
+    if (tok_is(p, T_LBRACKET)) {
+        nexttok(p);
         Expr **items = NULL;
-        int count = 0;
+        int count = 0, cap = 0;
 
-        if (!tok_is(T_RBRACKET)) {
+        if (!tok_is(p, T_RBRACKET)) {
             while (1) {
-                Expr *e = parse_expr();
-                items = realloc(items, sizeof(Expr *) * (count + 1));
-                items[count++] = e;
+                Expr *e = parse_expr(p);
+                LIST_PUSH(&p->arena, items, count, cap, e);
 
-                if (tok_is(T_COMMA)) {
-                    nexttok();
+                if (tok_is(p, T_COMMA)) {
+                    nexttok(p);
                     continue;
                 }
                 break;
             }
         }
-        expect(T_RBRACKET, "']'");
-        return expr_array(items, count, l, c);
+        expect(p, T_RBRACKET, "']'");
+        return expr_array(&p->arena, items, count, l, c);
+    }
+
+    // Handle Parenthesized Expressions: (expr)
+    if (tok_is(p, T_LPAREN)) {
+        nexttok(p);
+        Expr *inner = parse_expr(p);
+        expect(p, T_RPAREN, "')'");
+        return inner;
+    }
+
+    // Handle Unary Negation: -x is lowered to (0 - x)
+    if (tok_is(p, T_MINUS)) {
+        nexttok(p);
+        Expr *operand = parse_primary(p);
+        return expr_binop(&p->arena, '-', expr_int(&p->arena, 0, l, c), operand, l, c);
     }
 
     // Handle Borrowing / Referencing: &x or &mut x
-    if (tok_is(T_AND) || tok_is(T_ANDMUT)) {
-        bool mut = tok_is(T_ANDMUT);
-        nexttok();
-        Expr *inner = parse_primary();
-        return expr_addr(inner, mut, l, c);
+    if (tok_is(p, T_AND) || tok_is(p, T_ANDMUT)) {
+        bool mut = tok_is(p, T_ANDMUT);
+        nexttok(p);
+        Expr *inner = parse_primary(p);
+        return expr_addr(&p->arena, inner, mut, l, c);
     }
 
-    errorf("Unexpected token '%s' at %d:%d\n", cur.lexeme, l, c);
+    errorf_at(l, c, "syntax error: unexpected token '%.*s'\n", p->cur.len, tok_text(&p->lex, &p->cur));
     return NULL;
 }
 
+/**
+ * @brief Maps the current token to its binary operator code and precedence.
+ * Returns 0 when the token is not a binary operator.
+ */
+static int binop_prec(Parser *p, char *op) {
+    switch (p->cur.kind) {
+    case T_STAR:    *op = '*'; return 3;
+    case T_SLASH:   *op = '/'; return 3;
+    case T_PERCENT: *op = '%'; return 3;
+    case T_PLUS:    *op = '+'; return 2;
+    case T_MINUS:   *op = '-'; return 2;
+    case T_LT:      *op = '<'; return 1;
+    case T_GT:      *op = '>'; return 1;
+    case T_LE:      *op = 'l'; return 1;
+    case T_GE:      *op = 'g'; return 1;
+    case T_EQEQ:    *op = 'e'; return 1;
+    case T_NE:      *op = 'n'; return 1;
+    default:        return 0;
+    }
+}
+
+/**
+ * @brief Parses left-associative binary operators by precedence climbing.
+ *
+ * Grammar: Binary -> Primary ( binop Primary )*
+ * Precedence: '*' '/' '%'  >  '+' '-'  >  comparisons
+ */
+static Expr *parse_binary(Parser *p, int min_prec) {
+    Expr *lhs = parse_primary(p);
+
+    while (1) {
+        char op;
+        int prec = binop_prec(p, &op);
+        if (prec == 0 || prec < min_prec) break;
+
+        int l = p->cur.line, c = p->cur.col;
+        nexttok(p);
+        Expr *rhs = parse_binary(p, prec + 1);
+        lhs = expr_binop(&p->arena, op, lhs, rhs, l, c);
+    }
+
+    return lhs;
+}
+
 /**
  * @brief Entry point for expression parsing.
- * Currently handles the Range operator (..) with the lowest precedence.
+ * Handles the Range operator (..) with the lowest precedence.
  *
- * Grammar: Expr -> Primary ( '..' Primary )?
+ * Grammar: Expr -> Binary ( '..' Binary )?
  */
-static Expr *parse_expr() {
-    Expr *lhs = parse_primary();
-
-    if (tok_is(T_DOTDOT)) {
-        int l = cur.line, c = cur.col;
-        nexttok();
-        Expr *rhs = parse_primary();
-        return expr_range(lhs, rhs, l, c);
+static Expr *parse_expr(Parser *p) {
+    Expr *lhs = parse_binary(p, 1);
+
+    if (tok_is(p, T_DOTDOT)) {
+        int l = p->cur.line, c = p->cur.col;
+        nexttok(p);
+        Expr *rhs = parse_binary(p, 1);
+        return expr_range(&p->arena, lhs, rhs, l, c);
     }
 
     return lhs;
@@ -188,105 +277,199 @@ static Expr *parse_expr() {
    STATEMENT PARSING
    --------------------------------------------------------- */
 
+/**
+ * @brief Parses a fixed-size array type after the opening bracket is seen.
+ *
+ * Grammar: ArrayType -> '[' 'int' ';' INTLIT ']'
+ */
+static Type parse_array_type(Parser *p) {
+    expect(p, T_LBRACKET, "'['");
+    if (!tok_is(p, T_INT_TYPE))
+        errorf_at(p->cur.line, p->cur.col, "syntax error: array elements must be int\n");
+    nexttok(p);
+    expect(p, T_SEMI, "';'");
+
+    int l = p->cur.line, c = p->cur.col;
+    if (!tok_is(p, T_INTLIT))
+        errorf_at(l, c, "syntax error: expected array length\n");
+    long len = p->cur.int_val;
+    if (len < 1 || len > MAX_ARRAY_LEN)
+        errorf_at(l, c, "syntax error: array length must be between 1 and %d\n", MAX_ARRAY_LEN);
+    nexttok(p);
+    expect(p, T_RBRACKET, "']'");
+
+    Type *elem = arena_alloc(&p->arena, sizeof(Type));
+    *elem = mktype(TY_INT);
+    return mkarray(elem, len);
+}
+
+/**
+ * @brief Parses a reference-counted type; `Rc` is an ordinary identifier.
+ *
+ * Grammar: RcType -> 'Rc' '<' 'string' '>'
+ */
+static Type parse_rc_type(Parser *p) {
+    nexttok(p);
+    expect(p, T_LT, "'<'");
+    if (!tok_is(p, T_STRING_TYPE))
+        errorf_at(p->cur.line, p->cur.col, "syntax error: Rc payload must be string\n");
+    nexttok(p);
+    expect(p, T_GT, "'>'");
+
+    Type *payload = arena_alloc(&p->arena, sizeof(Type));
+    *payload = mktype(TY_STRING);
+    return mkref(TY_RC, payload);
+}
+
 /**
  * @brief Main dispatcher for various statement types.
  * Handles variable declarations (let), loops (for), code blocks, 
  * and expression-based statements.
  */
-static Stmt *parse_stmt() {
-    int l = cur.line, c = cur.col;
+static Stmt *parse_stmt(Parser *p) {
+    int l = p->cur.line, c = p->cur.col;
 
     // 1. Variable Declaration: let name: type = init;
-    if (tok_is(T_LET)) {
-        nexttok();
+    if (tok_is(p, T_LET)) {
+        nexttok(p);
 
-        if (!tok_is(T_IDENT)) {
-            errorf("Expected identifier after 'let' at %d:%d\n", l, c);
+        if (!tok_is(p, T_IDENT)) {
+            errorf_at(l, c, "syntax error: expected identifier after 'let'\n");
         }
 
-        char name[MAX_IDENT];
-        snprintf(name, sizeof(name), "%s", cur.lexeme);
-        nexttok();
+        Symbol name = p->cur.sym;
+        nexttok(p);
 
         Type ty = mktype(TY_UNKNOWN); // Default for Type Inference
         Expr *init = NULL;
 
         // Optional Type Annotation: let x: int
-        if (tok_is(T_COLON)) {
-            nexttok();
-            if (tok_is(T_INT_TYPE)) {
+        if (tok_is(p, T_COLON)) {
+            nexttok(p);
+            if (tok_is(p, T_INT_TYPE)) {
                 ty = mktype(TY_INT);
-                nexttok();
-            } else if (tok_is(T_STRING_TYPE)) {
+                nexttok(p);
+            } else if (tok_is(p, T_STRING_TYPE)) {
                 ty = mktype(TY_STRING);
-                nexttok();
+                nexttok(p);
+            } else if (tok_is(p, T_LBRACKET)) {
+                ty = parse_array_type(p);
+            } else if (tok_is(p, T_IDENT) && p->cur.sym == SYM_RC) {
+                ty = parse_rc_type(p);
             } else {
-                errorf("Unknown type at %d:%d\n", cur.line, cur.col);
+                errorf_at(p->cur.line, p->cur.col, "syntax error: unknown type\n");
             }
         }
 
         // Optional Assignment: let x = expression;
-        if (tok_is(T_EQ)) {
-            nexttok();
-            init = parse_expr();
+        if (tok_is(p, T_EQ)) {
+            nexttok(p);
+            init = parse_expr(p);
         }
 
-        expect(T_SEMI, "';'");
-        return stmt_decl(name, ty, init, l, c);
+        expect(p, T_SEMI, "';'");
+        return stmt_decl(&p->arena, name, ty, init, l, c);
     }
 
-    // 2. For Loop: for var in iter { ... }
-    if (tok_is(T_FOR)) {
-        nexttok();
+    // 2. For Loop: for var in iter { ... }, or par for var in iter { ... }
+    bool par = tok_is(p, T_PAR);
+    if (par) {
+        nexttok(p);
+        if (!tok_is(p, T_FOR)) {
+            errorf_at(l, c, "syntax error: expected 'for' after 'par'\n");
+        }
+    }
+    if (tok_is(p, T_FOR)) {
+        nexttok(p);
 
-        if (!tok_is(T_IDENT)) {
-            errorf("Expected identifier after 'for' at %d:%d\n", l, c);
+        if (!tok_is(p, T_IDENT)) {
+            errorf_at(l, c, "syntax error: expected identifier after 'for'\n");
         }
 
-        char var[MAX_IDENT];
-        snprintf(var, sizeof(var), "%s", cur.lexeme);
-        nexttok();
+        Symbol var = p->cur.sym;
+        nexttok(p);
 
-        expect(T_IN, "'in'");
-        Expr *iter = parse_expr();
-        Stmt *body = parse_block();
+        expect(p, T_IN, "'in'");
+        Expr *iter = parse_expr(p);
+        Stmt *body = parse_block(p);
 
-        return stmt_for(var, iter, body, l, c);
+        Stmt *s = stmt_for(&p->arena, var, iter, body, l, c);
+        s->v.fors.par = par;
+        return s;
     }
 
-    // 3. Block Statement: { ... }
-    if (tok_is(T_LBRACE)) {
-        return parse_block();
+    // 3. Conditional: if cond { ... } else { ... }
+    if (tok_is(p, T_IF)) {
+        nexttok(p);
+        Expr *cond = parse_expr(p);
+        Stmt *then_s = parse_block(p);
+        Stmt *else_s = NULL;
+
+        if (tok_is(p, T_ELSE)) {
+            nexttok(p);
+            /* 'else if' chains nest as a single statement in the else arm */
+            else_s = tok_is(p, T_IF) ? parse_stmt(p) : parse_block(p);
+        }
+        return stmt_if(&p->arena, cond, then_s, else_s, l, c);
     }
 
-    // 4. Expression Statement: call_func();
-    Expr *e = parse_expr();
-    expect(T_SEMI, "';'");
-    return stmt_expr(e, l, c);
+    // 4. While Loop: while cond { ... }
+    if (tok_is(p, T_WHILE)) {
+        nexttok(p);
+        Expr *cond = parse_expr(p);
+        Stmt *body = parse_block(p);
+        return stmt_while(&p->arena, cond, body, l, c);
+    }
+
+    // 5. Block Statement: { ... }
+    if (tok_is(p, T_LBRACE)) {
+        return parse_block(p);
+    }
+
+    // 6. Expression Statement: call_func();
+    Expr *e = parse_expr(p);
+
+    // 7. Assignment: name = expr;
+    if (tok_is(p, T_EQ) && e->kind == E_IDENT) {
+        nexttok(p);
+        Expr *value = parse_expr(p);
+        expect(p, T_SEMI, "';'");
+        return stmt_assign(&p->arena, e->v.ident, value, l, c);
+    }
+
+    // 8. Element Assignment: name[index] = expr;
+    if (tok_is(p, T_EQ) && e->kind == E_INDEX && e->v.index.array->kind == E_IDENT) {
+        nexttok(p);
+        Expr *value = parse_expr(p);
+        expect(p, T_SEMI, "';'");
+        return stmt_assign_index(&p->arena, e->v.index.array->v.ident, e->v.index.index, value, l, c);
+    }
+
+    expect(p, T_SEMI, "';'");
+    return stmt_expr(&p->arena, e, l, c);
 }
 
 /**
  * @brief Processes a sequence of statements within curly braces.
  * This establishes a new lexical scope at the syntax level.
  */
-static Stmt *parse_block() {
-    int l = cur.line, c = cur.col;
-    expect(T_LBRACE, "'{'");
+static Stmt *parse_block(Parser *p) {
+    int l = p->cur.line, c = p->cur.col;
+    expect(p, T_LBRACE, "'{'");
 
     Stmt **list = NULL;
-    int n = 0;
+    int n = 0, cap = 0;
 
-    while (!tok_is(T_RBRACE)) {
-        if (tok_is(T_EOF)) {
-            errorf("Unexpected EOF inside block\n");
+    while (!tok_is(p, T_RBRACE)) {
+        if (tok_is(p, T_EOF)) {
+            errorf_at(p->cur.line, p->cur.col, "syntax error: unexpected EOF inside block\n");
         }
-        Stmt *s = parse_stmt();
-        list = realloc(list, sizeof(Stmt *) * (n + 1));
-        list[n++] = s;
+        Stmt *s = parse_stmt(p);
+        LIST_PUSH(&p->arena, list, n, cap, s);
     }
 
-    expect(T_RBRACE, "'}'");
-    return stmt_block(list, n, l, c);
+    expect(p, T_RBRACE, "'}'");
+    return stmt_block(&p->arena, list, n, l, c);
 }
 
 /* ---------------------------------------------------------
@@ -301,23 +484,31 @@ static Stmt *parse_block() {
  * @return Function* Pointer to the AST root node.
  */
 Function *parse_program(const char *filename) {
-    // Initialize the token stream scanner
-    lexer_init(&L, filename);
-    
+    Parser parser;
+    Parser *p = &parser;
+
+    // Initialize the token stream scanner and the node arena
+    p->ntokens = 0;
+    arena_init(&p->arena);
+    lexer_init(&p->lex, filename, &p->arena);
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, parser_free, p);
+
     // Seed the first lookahead token
-    nexttok();
+    nexttok(p);
 
     Stmt **list = NULL;
-    int n = 0;
+    int n = 0, cap = 0;
 
     // Parse until the End of File is reached
-    while (!tok_is(T_EOF)) {
-        Stmt *s = parse_stmt();
-        list = realloc(list, sizeof(Stmt *) * (n + 1));
-        list[n++] = s;
+    while (!tok_is(p, T_EOF)) {
+        Stmt *s = parse_stmt(p);
+        LIST_PUSH(&p->arena, list, n, cap, s);
     }
 
     // Wrap all global statements into an implicit main function block
-    Stmt *body = stmt_block(list, n, 0, 0);
-    return make_main(body);
+    Stmt *body = stmt_block(&p->arena, list, n, 0, 0);
+    stats_count(STAT_TOKENS, (uint64_t)p->ntokens);
+    error_cleanup_pop(&cleanup);
+    return make_main(&p->arena, &p->lex.source, body);
 }
\ No newline at end of file
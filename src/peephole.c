@@ -0,0 +1,372 @@
+/**
+ * @file peephole.c
+ * @brief Windowed peephole optimizer over buffered NASM instructions.
+ *
+ * Rules only look at a few neighbouring instructions and never across a
+ * label, so they do not need control-flow information. They rely on two
+ * properties of the code emitted by codegen.c: the flags set by a `cmp` are
+ * only consumed by the conditional jump that immediately follows it, and
+ * the stack pointer is only ever changed by push/pop, call and explicit
+ * `add`/`sub rsp` instructions.
+ */
+
+#include "../include/peephole.h"
+#include "../include/common.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Maximum number of instructions allowed between a push and its pop */
+#define PH_WINDOW 4
+
+/* ---------------------------------------------------------
+   OPERAND CLASSIFICATION
+   --------------------------------------------------------- */
+
+/* Register names by family; index 0 is the 64-bit name */
+static const char *const reg_names[][5] = {
+    { "rax", "eax", "ax", "al", "ah" },
+    { "rbx", "ebx", "bx", "bl", "bh" },
+    { "rcx", "ecx", "cx", "cl", "ch" },
+    { "rdx", "edx", "dx", "dl", "dh" },
+    { "rsi", "esi", "si", "sil", NULL },
+    { "rdi", "edi", "di", "dil", NULL },
+    { "rbp", "ebp", "bp", "bpl", NULL },
+    { "rsp", "esp", "sp", "spl", NULL },
+    { "r8",  "r8d",  "r8w",  "r8b",  NULL },
+    { "r9",  "r9d",  "r9w",  "r9b",  NULL },
+    { "r10", "r10d", "r10w", "r10b", NULL },
+    { "r11", "r11d", "r11w", "r11b", NULL },
+    { "r12", "r12d", "r12w", "r12b", NULL },
+    { "r13", "r13d", "r13w", "r13b", NULL },
+    { "r14", "r14d", "r14w", "r14b", NULL },
+    { "r15", "r15d", "r15w", "r15b", NULL },
+};
+
+#define NUM_REG_FAMILIES ((int)(sizeof(reg_names) / sizeof(reg_names[0])))
+#define FAM_RAX 0
+#define FAM_RSP 7
+
+/** Register family of the name `s[0..len)`, or -1. */
+static int reg_family(const char *s, size_t len) {
+    for (int f = 0; f < NUM_REG_FAMILIES; f++) {
+        for (int k = 0; k < 5 && reg_names[f][k]; k++) {
+            if (strlen(reg_names[f][k]) == len && strncmp(reg_names[f][k], s, len) == 0)
+                return f;
+        }
+    }
+    return -1;
+}
+
+/** Family of an operand that is exactly one register, or -1. */
+static int operand_reg(const char *op) {
+    return reg_family(op, strlen(op));
+}
+
+/** True if the operand is a full 64-bit register. */
+static bool is_reg64(const char *op) {
+    int f = operand_reg(op);
+    return f >= 0 && strcmp(reg_names[f][0], op) == 0;
+}
+
+static bool is_mem(const char *op) {
+    return strchr(op, '[') != NULL;
+}
+
+/** Parses an integer immediate operand. */
+static bool parse_imm(const char *op, long *out) {
+    if (!(isdigit((unsigned char)op[0]) || (op[0] == '-' && isdigit((unsigned char)op[1]))))
+        return false;
+    char *end;
+    errno = 0;
+    long v = strtol(op, &end, 0);
+    if (*end != '\0' || errno) return false;
+    *out = v;
+    return true;
+}
+
+/** The bracketed part of a memory operand, ignoring any size keyword. */
+static const char *mem_core(const char *op) {
+    return strchr(op, '[');
+}
+
+/** True if any register of family `fam` appears anywhere in the operand. */
+static bool mentions(const char *op, int fam) {
+    const char *p = op;
+    while (*p) {
+        if (!isalnum((unsigned char)*p)) { p++; continue; }
+        const char *start = p;
+        while (isalnum((unsigned char)*p)) p++;
+        if (reg_family(start, (size_t)(p - start)) == fam) return true;
+    }
+    return false;
+}
+
+/* ---------------------------------------------------------
+   LINE HELPERS
+   --------------------------------------------------------- */
+
+static bool is_dead(const AsmLine *l) {
+    return l->kind == ASM_INSN && l->mnemonic[0] == '\0';
+}
+
+static void kill(AsmLine *l) {
+    l->mnemonic[0] = '\0';
+    l->nops = 0;
+}
+
+static bool is_insn(const AsmLine *l, const char *mnemonic) {
+    return l->kind == ASM_INSN && strcmp(l->mnemonic, mnemonic) == 0;
+}
+
+/** Index of the next live line after `i`, or buf->n. */
+static int next_live(const AsmBuf *buf, int i) {
+    for (i++; i < buf->n; i++)
+        if (!is_dead(&buf->lines[i])) return i;
+    return buf->n;
+}
+
+static void set_mov(AsmLine *l, const char *dst, const char *src) {
+    char d[ASM_OP_LEN], s[ASM_OP_LEN];
+    strcpy(d, dst);
+    strcpy(s, src);
+    const char *ops[2] = { d, s };
+    asm_set_insn(l, "mov", 2, ops);
+}
+
+/**
+ * @brief True if `l` may sit between a push of `src` and the matching pop
+ * into family `dst_fam` without changing what is popped.
+ * Only simple two-operand ALU/move instructions that leave the stack alone
+ * qualify; they must not touch the destination register and must not
+ * overwrite the pushed value.
+ */
+static bool transparent(const AsmLine *l, const char *src, int dst_fam) {
+    static const char *const ok[] = {
+        "mov", "movzx", "lea", "add", "sub", "imul", "and", "or", "xor", "cmp", "test"
+    };
+    if (l->kind != ASM_INSN) return false;
+
+    bool known = strncmp(l->mnemonic, "set", 3) == 0;
+    for (size_t k = 0; !known && k < sizeof(ok) / sizeof(ok[0]); k++)
+        known = strcmp(l->mnemonic, ok[k]) == 0;
+    if (!known) return false;
+
+    for (int k = 0; k < l->nops; k++) {
+        if (mentions(l->ops[k], FAM_RSP) || mentions(l->ops[k], dst_fam))
+            return false;
+    }
+
+    bool writes = strcmp(l->mnemonic, "cmp") != 0 && strcmp(l->mnemonic, "test") != 0;
+    if (!writes || l->nops == 0) return true;
+
+    const char *dst = l->ops[0];
+    if (is_mem(dst)) return !is_mem(src);
+    int fam = operand_reg(dst);
+    return fam < 0 || !mentions(src, fam);
+}
+
+/* ---------------------------------------------------------
+   RULES
+   --------------------------------------------------------- */
+
+/** push x ... pop y  ->  mov y, x   (and push x / add rsp, 8 -> nothing) */
+static bool rule_push(AsmBuf *buf, int i, PeepholeStats *st) {
+    AsmLine *push = &buf->lines[i];
+    if (!is_insn(push, "push") || push->nops != 1) return false;
+
+    int j = next_live(buf, i);
+    if (j < buf->n && is_insn(&buf->lines[j], "add") && buf->lines[j].nops == 2 &&
+        strcmp(buf->lines[j].ops[0], "rsp") == 0 && strcmp(buf->lines[j].ops[1], "8") == 0) {
+        kill(push);
+        kill(&buf->lines[j]);
+        st->hits[PH_PUSH_DISCARD]++;
+        return true;
+    }
+
+    /* Find the pop first: the window check depends on its register */
+    int between[PH_WINDOW];
+    int nbetween = 0;
+    for (; j < buf->n; j = next_live(buf, j)) {
+        AsmLine *l = &buf->lines[j];
+        if (is_insn(l, "pop")) break;
+        if (l->kind != ASM_INSN || nbetween == PH_WINDOW) return false;
+        between[nbetween++] = j;
+    }
+    if (j >= buf->n) return false;
+
+    AsmLine *pop = &buf->lines[j];
+    int dst_fam = operand_reg(pop->ops[0]);
+    if (pop->nops != 1 || !is_reg64(pop->ops[0])) return false;
+    for (int k = 0; k < nbetween; k++) {
+        if (!transparent(&buf->lines[between[k]], push->ops[0], dst_fam))
+            return false;
+    }
+
+    if (strcmp(push->ops[0], pop->ops[0]) == 0)
+        kill(pop);
+    else
+        set_mov(pop, pop->ops[0], push->ops[0]);
+    kill(push);
+    st->hits[PH_PUSH_POP]++;
+    return true;
+}
+
+/** mov [m], r / mov s, [m]  ->  mov [m], r / mov s, r */
+static bool rule_store_load(AsmBuf *buf, int i, PeepholeStats *st) {
+    AsmLine *store = &buf->lines[i];
+    long imm;
+    if (!is_insn(store, "mov") || store->nops != 2 || !is_mem(store->ops[0]))
+        return false;
+    if (!is_reg64(store->ops[1]) && !parse_imm(store->ops[1], &imm))
+        return false;
+
+    int j = next_live(buf, i);
+    if (j >= buf->n) return false;
+    AsmLine *load = &buf->lines[j];
+    if (!is_insn(load, "mov") || load->nops != 2 || !is_reg64(load->ops[0]) ||
+        !is_mem(load->ops[1]) || strcmp(mem_core(load->ops[1]), mem_core(store->ops[0])) != 0)
+        return false;
+
+    if (strcmp(load->ops[0], store->ops[1]) == 0)
+        kill(load);
+    else
+        set_mov(load, load->ops[0], store->ops[1]);
+    st->hits[PH_STORE_LOAD]++;
+    return true;
+}
+
+/** mov r, r  ->  nothing */
+static bool rule_self_move(AsmBuf *buf, int i, PeepholeStats *st) {
+    AsmLine *l = &buf->lines[i];
+    if (!is_insn(l, "mov") || l->nops != 2 || operand_reg(l->ops[0]) < 0 ||
+        strcmp(l->ops[0], l->ops[1]) != 0)
+        return false;
+    kill(l);
+    st->hits[PH_SELF_MOVE]++;
+    return true;
+}
+
+/** mov r, k / cmp r, 0 / je|jne L  ->  mov r, k / (jmp L) */
+static bool rule_const_branch(AsmBuf *buf, int i, PeepholeStats *st) {
+    AsmLine *mov = &buf->lines[i];
+    long k;
+    if (!is_insn(mov, "mov") || mov->nops != 2 || !is_reg64(mov->ops[0]) ||
+        !parse_imm(mov->ops[1], &k))
+        return false;
+
+    int j = next_live(buf, i);
+    if (j >= buf->n) return false;
+    AsmLine *cmp = &buf->lines[j];
+    if (!is_insn(cmp, "cmp") || cmp->nops != 2 || strcmp(cmp->ops[0], mov->ops[0]) != 0 ||
+        strcmp(cmp->ops[1], "0") != 0)
+        return false;
+
+    int c = next_live(buf, j);
+    if (c >= buf->n) return false;
+    AsmLine *jcc = &buf->lines[c];
+    bool je = is_insn(jcc, "je");
+    if (!je && !is_insn(jcc, "jne")) return false;
+
+    kill(cmp);
+    if ((k == 0) == je) {
+        char target[ASM_OP_LEN];
+        strcpy(target, jcc->ops[0]);
+        const char *ops[1] = { target };
+        asm_set_insn(jcc, "jmp", 1, ops);
+    } else {
+        kill(jcc);
+    }
+    st->hits[PH_CONST_BRANCH]++;
+    return true;
+}
+
+/** jmp L / L:  ->  L: */
+static bool rule_jump_next(AsmBuf *buf, int i, PeepholeStats *st) {
+    AsmLine *jmp = &buf->lines[i];
+    if (!is_insn(jmp, "jmp") || jmp->nops != 1) return false;
+
+    int j = next_live(buf, i);
+    if (j >= buf->n || buf->lines[j].kind != ASM_LABEL) return false;
+    const char *label = buf->lines[j].text;
+    size_t len = strlen(label) - 1;     /* Without the colon */
+    if (strlen(jmp->ops[0]) != len || strncmp(jmp->ops[0], label, len) != 0)
+        return false;
+
+    kill(jmp);
+    st->hits[PH_JUMP_NEXT]++;
+    return true;
+}
+
+/** Instructions after an unconditional jmp or ret up to the next label */
+static bool rule_unreachable(AsmBuf *buf, int i, PeepholeStats *st) {
+    AsmLine *l = &buf->lines[i];
+    if (!is_insn(l, "jmp") && !is_insn(l, "ret")) return false;
+
+    bool changed = false;
+    for (int j = next_live(buf, i); j < buf->n && buf->lines[j].kind == ASM_INSN;
+         j = next_live(buf, j)) {
+        kill(&buf->lines[j]);
+        st->hits[PH_UNREACHABLE]++;
+        changed = true;
+    }
+    return changed;
+}
+
+/* ---------------------------------------------------------
+   DRIVER
+   --------------------------------------------------------- */
+
+static void compact(AsmBuf *buf) {
+    int out = 0;
+    for (int i = 0; i < buf->n; i++) {
+        if (!is_dead(&buf->lines[i]))
+            buf->lines[out++] = buf->lines[i];
+    }
+    buf->n = out;
+}
+
+void peephole_run(AsmBuf *buf, PeepholeStats *stats) {
+    PeepholeStats local;
+    PeepholeStats *st = stats ? stats : &local;
+    memset(st, 0, sizeof(*st));
+    st->insns_before = asm_count_insns(buf);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < buf->n; i = next_live(buf, i)) {
+            if (is_dead(&buf->lines[i])) continue;
+            changed |= rule_self_move(buf, i, st) ||
+                       rule_push(buf, i, st) ||
+                       rule_store_load(buf, i, st) ||
+                       rule_const_branch(buf, i, st) ||
+                       rule_jump_next(buf, i, st) ||
+                       rule_unreachable(buf, i, st);
+        }
+        compact(buf);
+    }
+
+    st->insns_after = asm_count_insns(buf);
+}
+
+void peephole_print_stats(const PeepholeStats *st, StrBuf *out) {
+    static const char *const rule_names[PH_RULE_COUNT] = {
+        "push/pop pairs",
+        "discarded pushes",
+        "store/load forwarding",
+        "self moves",
+        "constant branches",
+        "jumps to next label",
+        "unreachable instructions"
+    };
+
+    double saved = st->insns_before
+        ? 100.0 * (st->insns_before - st->insns_after) / st->insns_before : 0.0;
+    sb_printf(out, "peephole: %d -> %d instructions (-%.1f%%)\n",
+            st->insns_before, st->insns_after, saved);
+    for (int r = 0; r < PH_RULE_COUNT; r++)
+        sb_printf(out, "  %-26s %d\n", rule_names[r], st->hits[r]);
+}
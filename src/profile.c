@@ -0,0 +1,300 @@
+/**
+ * @file profile.c
+ * @brief Profile lookup and profile-guided block layout.
+ *
+ * The layout pass only ever exchanges the two arms of an if/else. Arms are
+ * recognized in the CFG rather than from the AST, as a run of blocks that
+ * is entered only at its first block and only left to the join, so the
+ * pass works on whatever the optimizer left. Afterwards blocks and
+ * temporaries are renumbered into layout and definition order again,
+ * which the backend relies on.
+ */
+
+#include "../include/profile.h"
+#include "../include/runtime.h"
+#include "../include/common.h"
+
+#include <limits.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   PROFILE FILES
+   --------------------------------------------------------- */
+
+/** A record of the file: the checksum, n and the n encoded counts. */
+typedef struct Record {
+    uint64_t checksum, n;
+    const unsigned char *counts;
+} Record;
+
+/** Reads a ULEB128 value at `*p`; false if it runs past `end` or 64 bits. */
+static bool get_uleb(const unsigned char **p, const unsigned char *end, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char b = *(*p)++;
+        *v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+/** Decodes the record at `*p` and steps past it; false if it is cut short. */
+static bool next_record(const unsigned char **p, const unsigned char *end, Record *r) {
+    if (end - *p < 8) return false;
+    r->checksum = 0;
+    for (int i = 0; i < 8; i++) r->checksum |= (uint64_t)(*p)[i] << (8 * i);
+    *p += 8;
+    if (!get_uleb(p, end, &r->n)) return false;
+    r->counts = *p;
+    uint64_t c;
+    for (uint64_t k = 0; k < r->n; k++)
+        if (!get_uleb(p, end, &c)) return false;
+    return true;
+}
+
+static const unsigned char *records_begin(const Profile *p) {
+    return (const unsigned char *)p->file.data + sizeof RT_PROFILE_MAGIC;
+}
+
+static const unsigned char *records_end(const Profile *p) {
+    return (const unsigned char *)p->file.data + p->file.size;
+}
+
+/** Error cleanup: unmaps a profile that failed to load. */
+static void close_profile(void *p) {
+    profile_free(p);
+}
+
+void profile_load(Profile *p, const char *path) {
+    p->path = path;
+    source_open(&p->file, path);
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, close_profile, p);
+
+    /* The magic, then the version byte where its NUL would be */
+    size_t head = sizeof RT_PROFILE_MAGIC - 1;
+    const unsigned char *d = (const unsigned char *)p->file.data;
+    if (p->file.size <= head || memcmp(d, RT_PROFILE_MAGIC, head) != 0)
+        errorf("mycc: '%s' is not a profile\n", path);
+    if (d[head] != RT_PROFILE_VERSION)
+        errorf("mycc: profile '%s' has unsupported version %d\n", path, d[head]);
+
+    const unsigned char *q = records_begin(p), *end = records_end(p);
+    Record r;
+    while (q < end) {
+        if (!next_record(&q, end, &r)) errorf("mycc: profile '%s' is truncated\n", path);
+    }
+    error_cleanup_pop(&cleanup);
+}
+
+void profile_free(Profile *p) {
+    source_close(&p->file);
+}
+
+/* ---------------------------------------------------------
+   COUNTER NUMBERING
+   --------------------------------------------------------- */
+
+/** FNV-1a step over the 8 bytes of `v`. */
+static uint64_t mix(uint64_t h, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        h ^= (v >> (8 * i)) & 0xFF;
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+uint64_t profile_checksum(const IrFunc *fn) {
+    /* Every field of every instruction: any change to the IR is a mismatch */
+    uint64_t h = mix(0xCBF29CE484222325ull, (uint64_t)fn->nblocks);
+    for (int i = 0; i < fn->nblocks; i++) {
+        const IrBlock *blk = fn->blocks[i];
+        h = mix(h, (uint64_t)blk->n);
+        for (int j = 0; j < blk->n; j++) {
+            const IrInstr *in = &blk->code[j];
+            h = mix(h, (uint64_t)in->op);
+            h = mix(h, (uint64_t)(int64_t)in->dst);
+            h = mix(h, (uint64_t)(int64_t)in->a);
+            h = mix(h, (uint64_t)(int64_t)in->b);
+            h = mix(h, (uint64_t)(int64_t)in->slot);
+            h = mix(h, (uint64_t)in->imm);
+            h = mix(h, (uint64_t)(unsigned char)in->binop);
+            h = mix(h, (uint64_t)(int64_t)in->target);
+            h = mix(h, (uint64_t)(int64_t)in->alt);
+        }
+    }
+    return h;
+}
+
+int profile_counters(const IrFunc *fn) {
+    int n = fn->nblocks;
+    for (int i = 0; i < fn->nblocks; i++) {
+        const IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++)
+            n += blk->code[j].op == IR_CALL || blk->code[j].op == IR_PAR;
+    }
+    return n;
+}
+
+/* ---------------------------------------------------------
+   BLOCK LAYOUT
+   --------------------------------------------------------- */
+
+typedef struct Layout {
+    IrFunc *fn;
+    int *pred_lo, *pred_hi;     /* Smallest and largest predecessor of each block, or -1 */
+    IrBlock **order;            /* New layout, built by place */
+    int n;
+} Layout;
+
+/** Successor ids of `blk` in `succ`; returns how many there are. */
+static int successors(const IrBlock *blk, int succ[2]) {
+    const IrInstr *term = &blk->code[blk->n - 1];
+    int n = 0;
+    if (term->target >= 0) succ[n++] = term->target;
+    if (term->alt >= 0) succ[n++] = term->alt;
+    return n;
+}
+
+/**
+ * @brief True if blocks [lo, hi) are only entered at `lo` (from `from` or
+ * from inside) and only left to `exit`, so they can move as a unit.
+ * Edges into `lo` from the blocks between `from` and it are not seen by
+ * the predecessor bounds; for an else arm those are the then arm, whose
+ * own check allows it no such edge.
+ */
+static bool is_region(const Layout *l, int from, int lo, int hi, int exit) {
+    for (int k = lo; k < hi; k++) {
+        int plo = l->pred_lo[k], phi = l->pred_hi[k];
+        int first = k == lo ? from : lo;
+        if (plo >= 0 && (plo < first || phi >= hi)) return false;
+        if (k == lo && plo > from && plo < lo) return false;
+
+        int succ[2];
+        int n = successors(l->fn->blocks[k], succ);
+        for (int s = 0; s < n; s++)
+            if ((succ[s] < lo || succ[s] >= hi) && succ[s] != exit) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Recognizes block `i` as the branch of an if/else laid out as
+ * i, then arm [i + 1, *e), else arm [*e, *j), join *j <= hi.
+ */
+static bool is_diamond(const Layout *l, int i, int hi, int *e, int *j) {
+    IrBlock **blocks = l->fn->blocks;
+    const IrInstr *br = &blocks[i]->code[blocks[i]->n - 1];
+    if (br->op != IR_BR || br->target != i + 1 || br->alt <= i + 1 || br->alt >= hi) return false;
+
+    const IrInstr *then_end = &blocks[br->alt - 1]->code[blocks[br->alt - 1]->n - 1];
+    if (then_end->op != IR_JMP || then_end->target <= br->alt || then_end->target > hi) return false;
+
+    *e = br->alt;
+    *j = then_end->target;
+    return is_region(l, i, i + 1, *e, *j) && is_region(l, i, *e, *j, *j);
+}
+
+/** Appends blocks [lo, hi) to the new layout, hotter arm of each if/else first. */
+static void place(Layout *l, int lo, int hi) {
+    IrBlock **blocks = l->fn->blocks;
+    int i = lo;
+    while (i < hi) {
+        l->order[l->n++] = blocks[i];
+        int e, j;
+        if (!is_diamond(l, i, hi, &e, &j)) {
+            i++;
+            continue;
+        }
+        if (blocks[e]->count > blocks[i + 1]->count) {
+            place(l, e, j);
+            place(l, i + 1, e);
+        } else {
+            place(l, i + 1, e);
+            place(l, e, j);
+        }
+        i = j;
+    }
+}
+
+/** Makes block ids layout positions again and temporaries numbered in definition order. */
+static void renumber(IrFunc *fn) {
+    int *block_id = xmalloc(sizeof(int) * (size_t)fn->nblocks);
+    for (int i = 0; i < fn->nblocks; i++)
+        block_id[fn->blocks[i]->id] = i;
+
+    int *temp_id = xmalloc(sizeof(int) * (size_t)(fn->ntemps ? fn->ntemps : 1));
+    int ntemps = 0;
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        for (int j = 0; j < blk->n; j++)
+            if (blk->code[j].dst >= 0) temp_id[blk->code[j].dst] = ntemps++;
+    }
+
+    for (int i = 0; i < fn->nblocks; i++) {
+        IrBlock *blk = fn->blocks[i];
+        blk->id = i;
+        for (int j = 0; j < blk->n; j++) {
+            IrInstr *in = &blk->code[j];
+            if (in->dst >= 0) in->dst = temp_id[in->dst];
+            if (in->a >= 0) in->a = temp_id[in->a];
+            if (in->b >= 0) in->b = temp_id[in->b];
+            if (in->target >= 0) in->target = block_id[in->target];
+            if (in->alt >= 0) in->alt = block_id[in->alt];
+        }
+    }
+    fn->ntemps = ntemps;
+    free(block_id);
+    free(temp_id);
+}
+
+static void layout_blocks(IrFunc *fn) {
+    int n = fn->nblocks;
+    Layout l = { .fn = fn, .n = 0 };
+    l.pred_lo = xmalloc(sizeof(int) * (size_t)n);
+    l.pred_hi = xmalloc(sizeof(int) * (size_t)n);
+    l.order = xmalloc(sizeof(IrBlock *) * (size_t)n);
+    for (int i = 0; i < n; i++) l.pred_lo[i] = l.pred_hi[i] = -1;
+    for (int i = 0; i < n; i++) {
+        int succ[2];
+        int ns = successors(fn->blocks[i], succ);
+        for (int s = 0; s < ns; s++) {
+            int b = succ[s];
+            if (l.pred_lo[b] < 0 || i < l.pred_lo[b]) l.pred_lo[b] = i;
+            if (i > l.pred_hi[b]) l.pred_hi[b] = i;
+        }
+    }
+
+    place(&l, 0, n);
+    bool moved = false;
+    for (int i = 0; i < n; i++) moved |= l.order[i] != fn->blocks[i];
+    if (moved) {
+        memcpy(fn->blocks, l.order, sizeof(IrBlock *) * (size_t)n);
+        renumber(fn);
+    }
+    free(l.pred_lo);
+    free(l.pred_hi);
+    free(l.order);
+}
+
+void profile_apply(IrFunc *fn, const Profile *p) {
+    uint64_t checksum = profile_checksum(fn);
+    uint64_t ncounters = (uint64_t)profile_counters(fn);
+
+    const unsigned char *q = records_begin(p), *end = records_end(p);
+    Record r;
+    bool found = false;
+    while (!found && q < end && next_record(&q, end, &r))
+        found = r.checksum == checksum && r.n == ncounters;
+    if (!found)
+        errorf("Profile error: '%s' has no record for this program (instrument it with the same flags)\n",
+               p->path);
+
+    const unsigned char *c = r.counts;
+    for (int i = 0; i < fn->nblocks; i++) {
+        uint64_t v;
+        get_uleb(&c, end, &v);
+        fn->blocks[i]->count = v > LONG_MAX ? LONG_MAX : (long)v;
+    }
+    layout_blocks(fn);
+}
@@ -2,35 +2,124 @@
  * @file runtime.c
  * @brief Runtime support library for MyLang generated binaries.
  * * This library is linked with the assembly output of the compiler.
- * It provides the concrete implementation for functions called by 
- * the x86_64 backend.
+ * It provides the concrete implementation for functions called by
+ * the x86_64 backend. The string layout is described in runtime.h.
  */
+/* write() is POSIX, hidden by -std=c99 without this */
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/runtime.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 /* ---------------------------------------------------------
-   STRING MANAGEMENT
+   OUTPUT BUFFER
    --------------------------------------------------------- */
 
+/* Only the main thread prints (par loops cannot), so the buffer takes no
+   lock. The buffer is exported for the --intrinsics print path (runtime.h). */
+char runtime_out_buf[RT_OUT_BUF_SIZE];
+uint64_t runtime_out_len;
+
+/** Writes `p[0..n)` straight to the stdout handle, retrying short writes. */
+static void out_write(const char *p, size_t n) {
+#ifdef _WIN32
+    HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
+    while (n > 0) {
+        DWORD chunk = n > 0x40000000u ? 0x40000000u : (DWORD)n;
+        DWORD done = 0;
+        if (!WriteFile(h, p, chunk, &done, NULL) || done == 0) return;
+        p += done;
+        n -= done;
+    }
+#else
+    while (n > 0) {
+        ssize_t done = write(1, p, n);
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        p += done;
+        n -= (size_t)done;
+    }
+#endif
+}
+
 /**
- * @brief Allocates a new heap-backed string from a static literal.
- * Called by the backend when a "string literal" is encountered.
+ * @brief Writes out everything buffered so far.
+ * Called by the generated main before it returns, and by the runtime
+ * itself before any error message so output stays in order.
  */
-char *runtime_new_string(const char *lit) {
-    if (!lit) return NULL;
-
-    /* Safe length check using snprintf per project style */
-    size_t n = snprintf(NULL, 0, "%s", lit);
+void runtime_flush(void) {
+    out_write(runtime_out_buf, runtime_out_len);
+    runtime_out_len = 0;
+}
 
-    char *p = malloc(n + 1);
-    if (!p) {
-        fprintf(stderr, "runtime error: out of memory in runtime_new_string\n");
-        exit(1);
+/** Appends `p[0..n)` to the buffer, flushing first when it would overflow. */
+static void out_append(const char *p, size_t n) {
+    if (n > RT_OUT_BUF_SIZE - runtime_out_len) {
+        runtime_flush();
+        /* Too large to be worth copying: write it through */
+        if (n >= RT_OUT_BUF_SIZE) {
+            out_write(p, n);
+            return;
+        }
     }
+    memcpy(runtime_out_buf + runtime_out_len, p, n);
+    runtime_out_len += n;
+}
+
+/** Reports a fatal runtime error after flushing pending output. */
+static void runtime_fail(const char *what, const char *who) {
+    runtime_flush();
+    runtime_profile_end();
+    fprintf(stderr, "runtime error: %s in %s\n", what, who);
+    exit(1);
+}
+
+/**
+ * @brief Reports an array index outside 0..len-1 and exits.
+ * Generated code jumps to a call of this from every bounds check that
+ * could not be proven at compile time; the stack is realigned first.
+ */
+void runtime_bounds_fail(long index, long len) {
+    runtime_flush();
+    runtime_profile_end();
+    fprintf(stderr, "runtime error: index %ld out of bounds for array of length %ld\n", index, len);
+    exit(1);
+}
+
+/* ---------------------------------------------------------
+   STRING MANAGEMENT
+   --------------------------------------------------------- */
 
-    snprintf(p, n + 1, "%s", lit);
+/** Allocates a heap string with room for `len` bytes; the header is filled in. */
+static RtString *alloc_string(uint64_t len, const char *who) {
+    RtString *p = malloc(sizeof(RtString) + len + 1);
+    if (!p) runtime_fail("out of memory", who);
+    p->len = len;
+    p->cap = len + 1;
+    return p;
+}
+
+/**
+ * @brief Allocates a new heap-backed string holding `bytes[0..len)`.
+ * Literals do not go through here: they are static RtStrings in .data.
+ */
+RtString *runtime_string_from(const char *bytes, uint64_t len) {
+    RtString *p = alloc_string(len, "runtime_string_from");
+    memcpy(p->data, bytes, len);
+    p->data[len] = '\0';
     return p;
 }
 
@@ -38,50 +127,505 @@ char *runtime_new_string(const char *lit) {
  * @brief Deep-copies a string object.
  * Supporting 'move' semantics: if a user wants to keep the original
  * and pass a copy, the 'clone()' function in MyLang maps here.
+ * Static literals are copied too, so the clone can be mutated and dropped.
  */
-char *runtime_clone_string(char *s) {
+RtString *runtime_clone_string(const RtString *s) {
     if (!s) return NULL;
 
-    size_t n = snprintf(NULL, 0, "%s", s);
-    char *p = malloc(n + 1);
-    if (!p) {
-        fprintf(stderr, "runtime error: out of memory in runtime_clone_string\n");
-        exit(1);
-    }
-
-    snprintf(p, n + 1, "%s", s);
+    RtString *p = alloc_string(s->len, "runtime_clone_string");
+    memcpy(p->data, s->data, s->len + 1);
     return p;
 }
 
 /**
  * @brief Destroys a string object and releases heap memory.
- * This is the target for the "drop" logic (RAII) when a variable 
- * goes out of scope.
+ * This is the target for the "drop" logic (RAII) when a variable
+ * goes out of scope. Literals and arena strings (cap == 0) are left
+ * alone, and NULL is what a moved-from variable holds.
  */
-void runtime_drop_string(char *s) {
-    if (s) {
+void runtime_drop_string(RtString *s) {
+    if (s && s->cap != 0) {
         free(s);
     }
 }
 
+/* ---------------------------------------------------------
+   FRAME ARENAS
+   --------------------------------------------------------- */
+
+/* Default chunk size; larger strings get a chunk of their own */
+#define RT_ARENA_CHUNK 65536
+
+typedef struct RtArenaChunk {
+    struct RtArenaChunk *prev;
+    size_t used, size;
+    char data[];
+} RtArenaChunk;
+
+/* Arena position at each open frame */
+typedef struct RtArenaMark {
+    RtArenaChunk *chunk;
+    size_t used;
+} RtArenaMark;
+
+static RtArenaChunk *arena_chunk;
+static RtArenaMark *arena_marks;
+static size_t arena_depth, arena_marks_cap;
+
+/** Opens a frame: allocations up to the matching leave are released together. */
+void runtime_arena_enter(void) {
+    if (arena_depth == arena_marks_cap) {
+        size_t cap = arena_marks_cap ? arena_marks_cap * 2 : 16;
+        RtArenaMark *p = realloc(arena_marks, sizeof(RtArenaMark) * cap);
+        if (!p) runtime_fail("out of memory", "runtime_arena_enter");
+        arena_marks = p;
+        arena_marks_cap = cap;
+    }
+    arena_marks[arena_depth].chunk = arena_chunk;
+    arena_marks[arena_depth].used = arena_chunk ? arena_chunk->used : 0;
+    arena_depth++;
+}
+
+/** Closes the innermost frame, freeing every chunk it started. */
+void runtime_arena_leave(void) {
+    if (arena_depth == 0) return;
+    RtArenaMark m = arena_marks[--arena_depth];
+
+    while (arena_chunk != m.chunk) {
+        RtArenaChunk *prev = arena_chunk->prev;
+        free(arena_chunk);
+        arena_chunk = prev;
+    }
+    if (arena_chunk) arena_chunk->used = m.used;
+}
+
+/** Bump-allocates `size` bytes (8-byte aligned) in the current frame. */
+static void *arena_alloc(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (!arena_chunk || arena_chunk->size - arena_chunk->used < size) {
+        size_t cap = size > RT_ARENA_CHUNK ? size : RT_ARENA_CHUNK;
+        RtArenaChunk *c = malloc(sizeof(RtArenaChunk) + cap);
+        if (!c) runtime_fail("out of memory", "runtime_arena_clone_string");
+        c->prev = arena_chunk;
+        c->used = 0;
+        c->size = cap;
+        arena_chunk = c;
+    }
+    void *p = arena_chunk->data + arena_chunk->used;
+    arena_chunk->used += size;
+    return p;
+}
+
+/**
+ * @brief clone() for strings that never leave the current frame.
+ * The copy is marked cap = 0, so runtime_drop_string ignores it.
+ */
+RtString *runtime_arena_clone_string(const RtString *s) {
+    if (!s) return NULL;
+
+    RtString *p = arena_alloc(sizeof(RtString) + s->len + 1);
+    p->len = s->len;
+    p->cap = 0;
+    memcpy(p->data, s->data, s->len + 1);
+    return p;
+}
+
+/* ---------------------------------------------------------
+   SHARED STRINGS
+   --------------------------------------------------------- */
+
+/** The count word just before the string of an Rc block. */
+static uint64_t *rc_count(RtString *s) {
+    return (uint64_t *)((char *)s - RT_RC_HEADER);
+}
+
+/**
+ * @brief Rc(s): copies `s` into a new counted block, with a count of 1.
+ * The count and the string share one allocation, and the string is
+ * marked cap = 0 so nothing but the count ever frees it.
+ */
+RtString *runtime_rc_new(const RtString *s) {
+    uint64_t len = s ? s->len : 0;
+    char *block = malloc(RT_RC_HEADER + sizeof(RtString) + len + 1);
+    if (!block) runtime_fail("out of memory", "runtime_rc_new");
+
+    RtString *p = (RtString *)(block + RT_RC_HEADER);
+    *rc_count(p) = 1;
+    p->len = len;
+    p->cap = 0;
+    if (s) memcpy(p->data, s->data, len + 1);
+    else p->data[0] = '\0';
+    return p;
+}
+
+/** clone() of an Rc: one more owner of the same block. */
+RtString *runtime_rc_retain(RtString *s) {
+    if (s) ++*rc_count(s);
+    return s;
+}
+
+/** Drops one count, freeing the block with the last; NULL (moved out) is ignored. */
+void runtime_rc_release(RtString *s) {
+    if (s && --*rc_count(s) == 0) free(rc_count(s));
+}
+
 /* ---------------------------------------------------------
    I/O OPERATIONS
    --------------------------------------------------------- */
 
 /**
  * @brief Prints a 64-bit signed integer to stdout.
+ * Digits are produced back to front into a local buffer; the magnitude is
+ * taken as unsigned so LONG_MIN needs no special case.
  */
 int runtime_print_int(long v) {
-    return printf("%ld\n", v);
+    char tmp[24];
+    char *end = tmp + sizeof tmp;
+    char *p = end;
+    unsigned long u = v < 0 ? 0UL - (unsigned long)v : (unsigned long)v;
+
+    *--p = '\n';
+    do {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (v < 0) *--p = '-';
+
+    out_append(p, (size_t)(end - p));
+    return (int)(end - p);
 }
 
 /**
  * @brief Prints a MyLang string object to stdout.
+ * The length is known, so the bytes are copied into the output buffer
+ * as-is without scanning for a terminator.
+ */
+int runtime_print_string(const RtString *s) {
+    if (!s) {
+        out_append("(null)\n", 7);
+        return 7;
+    }
+    out_append(s->data, s->len);
+    out_append("\n", 1);
+    return (int)s->len + 1;
+}
+
+/* ---------------------------------------------------------
+   PARALLEL LOOPS
+   The range of a par loop is cut into chunks of `grain` iterations, and
+   the chunk numbers are dealt out in contiguous runs to one deque per
+   thread. Each thread takes chunks from the back of its own deque and,
+   once that is empty, steals from the front of the others', so uneven
+   iterations even out. The caller takes part as thread 0; the other
+   threads sleep between loops.
+   --------------------------------------------------------- */
+
+/* Enough chunks per thread to balance the load, few enough to stay cheap */
+#define PAR_CHUNKS_PER_THREAD 8
+
+/* Chunks get a frame as large as main's, so workers get a generous stack */
+#define PAR_STACK_SIZE ((size_t)16 << 20)
+
+#ifdef _WIN32
+typedef SRWLOCK ParLock;
+typedef CONDITION_VARIABLE ParCond;
+
+static void par_lock_init(ParLock *l)        { InitializeSRWLock(l); }
+static void par_cond_init(ParCond *c)        { InitializeConditionVariable(c); }
+static void par_lock(ParLock *l)             { AcquireSRWLockExclusive(l); }
+static void par_unlock(ParLock *l)           { ReleaseSRWLockExclusive(l); }
+static void par_wait(ParCond *c, ParLock *l) { SleepConditionVariableSRW(c, l, INFINITE, 0); }
+static void par_wake_all(ParCond *c)         { WakeAllConditionVariable(c); }
+#else
+typedef pthread_mutex_t ParLock;
+typedef pthread_cond_t ParCond;
+
+static void par_lock_init(ParLock *l)        { pthread_mutex_init(l, NULL); }
+static void par_cond_init(ParCond *c)        { pthread_cond_init(c, NULL); }
+static void par_lock(ParLock *l)             { pthread_mutex_lock(l); }
+static void par_unlock(ParLock *l)           { pthread_mutex_unlock(l); }
+static void par_wait(ParCond *c, ParLock *l) { pthread_cond_wait(c, l); }
+static void par_wake_all(ParCond *c)         { pthread_cond_broadcast(c); }
+#endif
+
+/** Chunk numbers [top, bottom) of one thread not taken yet. */
+typedef struct ParDeque {
+    ParLock lock;
+    long top, bottom;
+} ParDeque;
+
+static struct {
+    int nthreads;           /* Including the caller; 0 until the first loop */
+
+    ParLock lock;           /* Guards loop and busy */
+    ParCond start, finish;
+    unsigned long loop;     /* Number of the loop being run */
+    int busy;               /* Workers not done with it yet */
+
+    /* The loop being run, set up before it is announced */
+    RtParChunk chunk;
+    void *frame;
+    long lo;
+    unsigned long total, grain;
+    ParDeque deques[RT_PAR_MAX_THREADS];
+} pool;
+
+/** Takes a chunk from the back of deque `w`, or from its front to steal; -1 if empty. */
+static long par_take(int w, int steal) {
+    ParDeque *d = &pool.deques[w];
+    long c = -1;
+    par_lock(&d->lock);
+    if (d->top < d->bottom) c = steal ? d->top++ : --d->bottom;
+    par_unlock(&d->lock);
+    return c;
+}
+
+/** Thread `w`'s part of the current loop: its own chunks, then whatever it can steal. */
+static void par_work(int w) {
+    int n = pool.nthreads;
+    for (;;) {
+        long c = par_take(w, 0);
+        for (int k = 1; c < 0 && k < n; k++)
+            c = par_take((w + k) % n, 1);
+        if (c < 0) return;
+
+        /* Offsets from lo are unsigned: the range may span the whole of long */
+        unsigned long first = (unsigned long)c * pool.grain;
+        unsigned long end = pool.total - first > pool.grain ? first + pool.grain : pool.total;
+        pool.chunk((long)((unsigned long)pool.lo + first), (long)((unsigned long)pool.lo + end), pool.frame);
+    }
+}
+
+/** Worker `w`: runs its part of every loop announced from now on. */
+static void par_serve(int w) {
+    unsigned long seen = 0;
+    par_lock(&pool.lock);
+    for (;;) {
+        while (pool.loop == seen) par_wait(&pool.start, &pool.lock);
+        seen = pool.loop;
+        par_unlock(&pool.lock);
+
+        par_work(w);
+
+        par_lock(&pool.lock);
+        if (--pool.busy == 0) par_wake_all(&pool.finish);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI par_thread(LPVOID arg) {
+    par_serve((int)(intptr_t)arg);
+    return 0;
+}
+
+static int par_spawn(int w) {
+    HANDLE h = CreateThread(NULL, PAR_STACK_SIZE, par_thread, (LPVOID)(intptr_t)w,
+                            STACK_SIZE_PARAM_IS_A_RESERVATION, NULL);
+    if (!h) return 0;
+    CloseHandle(h);
+    return 1;
+}
+#else
+static void *par_thread(void *arg) {
+    par_serve((int)(intptr_t)arg);
+    return NULL;
+}
+
+static int par_spawn(int w) {
+    pthread_attr_t attr;
+    pthread_t t;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PAR_STACK_SIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ok = pthread_create(&t, &attr, par_thread, (void *)(intptr_t)w) == 0;
+    pthread_attr_destroy(&attr);
+    return ok;
+}
+#endif
+
+/** MYLANG_THREADS if it is a positive number, else the number of CPUs. */
+static int par_thread_count(void) {
+    const char *env = getenv("MYLANG_THREADS");
+    long n = 0;
+    if (env) {
+        char *end;
+        n = strtol(env, &end, 10);
+        if (end == env || *end != '\0') n = 0;
+    }
+    if (n < 1) {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        n = (long)info.dwNumberOfProcessors;
+#else
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    if (n < 1) n = 1;
+    return n > RT_PAR_MAX_THREADS ? RT_PAR_MAX_THREADS : (int)n;
+}
+
+/**
+ * @brief Starts the workers. Only the main thread runs par loops (they do
+ * not nest), so this needs no synchronization; if a thread cannot be
+ * created, the loops run on the ones that could.
  */
-int runtime_print_string(char *s) {
-    if (s) {
-        return printf("%s\n", s);
-    } else {
-        return printf("(null)\n");
+static void par_start(void) {
+    par_lock_init(&pool.lock);
+    par_cond_init(&pool.start);
+    par_cond_init(&pool.finish);
+    for (int w = 0; w < RT_PAR_MAX_THREADS; w++)
+        par_lock_init(&pool.deques[w].lock);
+
+    int n = par_thread_count();
+    pool.nthreads = 1;
+    while (pool.nthreads < n && par_spawn(pool.nthreads))
+        pool.nthreads++;
+}
+
+void runtime_par_for(RtParChunk chunk, long lo, long hi, void *frame) {
+    if (hi <= lo) return;
+    if (pool.nthreads == 0) par_start();
+
+    int n = pool.nthreads;
+    unsigned long total = (unsigned long)hi - (unsigned long)lo;
+    if (n == 1 || total == 1) {
+        chunk(lo, hi, frame);
+        return;
+    }
+
+    /* Rounded up, so there are at most max chunks (and none empty) */
+    unsigned long max = (unsigned long)n * PAR_CHUNKS_PER_THREAD;
+    unsigned long grain = total / max + (total % max != 0);
+    long nchunks = (long)(total / grain + (total % grain != 0));
+
+    /* Every worker finished the previous loop, so nothing reads these now */
+    pool.chunk = chunk;
+    pool.frame = frame;
+    pool.lo = lo;
+    pool.total = total;
+    pool.grain = grain;
+    for (int w = 0; w < n; w++) {
+        pool.deques[w].top = nchunks * w / n;
+        pool.deques[w].bottom = nchunks * (w + 1) / n;
+    }
+
+    par_lock(&pool.lock);
+    pool.busy = n - 1;
+    pool.loop++;
+    par_wake_all(&pool.start);
+    par_unlock(&pool.lock);
+
+    par_work(0);
+
+    par_lock(&pool.lock);
+    while (pool.busy > 0) par_wait(&pool.finish, &pool.lock);
+    par_unlock(&pool.lock);
+}
+
+/* ---------------------------------------------------------
+   PROFILING
+   The file is read whole, the records of other programs are copied
+   as they are, and this program's record is written last with the
+   counts of an earlier record for it added in. Counters that par
+   chunks increment from several threads may have lost updates.
+   --------------------------------------------------------- */
+
+static uint64_t *profile_table;    /* Between begin and end, else NULL */
+
+void runtime_profile_begin(uint64_t *table) {
+    profile_table = table;
+}
+
+/** Writes `v` as ULEB128: 7 bits per byte, low first, high bit = more follow. */
+static void put_uleb(FILE *f, uint64_t v) {
+    do {
+        unsigned char b = v & 0x7F;
+        v >>= 7;
+        fputc(v ? b | 0x80 : b, f);
+    } while (v);
+}
+
+/** Reads a ULEB128 value at `*p`; false if it runs past `end` or 64 bits. */
+static int get_uleb(const unsigned char **p, const unsigned char *end, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char b = *(*p)++;
+        *v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return 1;
+    }
+    return 0;
+}
+
+/** The whole file at `path` in a malloc'd buffer, or NULL (with *len = 0). */
+static unsigned char *read_all(const char *path, size_t *len) {
+    *len = 0;
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096;
+    unsigned char *buf = malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + *len, 1, cap - *len, f)) > 0) {
+        *len += n;
+        if (*len == cap) {
+            unsigned char *grown = realloc(buf, cap *= 2);
+            if (!grown) free(buf);
+            buf = grown;
+        }
+    }
+    fclose(f);
+    if (!buf) *len = 0;
+    return buf;
+}
+
+void runtime_profile_end(void) {
+    uint64_t *table = profile_table;
+    if (!table) return;
+    profile_table = NULL;
+
+    const char *path = getenv("MYLANG_PROFILE");
+    if (!path || !*path) path = RT_PROFILE_FILE;
+
+    size_t len;
+    unsigned char *old = read_all(path, &len);
+    size_t head = sizeof RT_PROFILE_MAGIC - 1;
+    if (len <= head || memcmp(old, RT_PROFILE_MAGIC, head) != 0 || old[head] != RT_PROFILE_VERSION)
+        len = 0;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "runtime error: cannot write profile '%s'\n", path);
+        free(old);
+        return;
     }
-}
\ No newline at end of file
+    fwrite(RT_PROFILE_MAGIC, 1, head, f);
+    fputc(RT_PROFILE_VERSION, f);
+
+    /* Records of other programs go through unchanged; a damaged tail is dropped */
+    const unsigned char *p = len ? old + head + 1 : NULL, *end = p ? old + len : NULL;
+    while (p && end - p >= 8) {
+        const unsigned char *rec = p, *counts;
+        uint64_t checksum = 0, n, k, c;
+        for (int i = 0; i < 8; i++) checksum |= (uint64_t)p[i] << (8 * i);
+        p += 8;
+        if (!get_uleb(&p, end, &n)) break;
+        counts = p;
+        for (k = 0; k < n && get_uleb(&p, end, &c); k++) {}
+        if (k < n) break;
+
+        if (checksum != table[0] || n != table[1]) {
+            fwrite(rec, 1, (size_t)(p - rec), f);
+            continue;
+        }
+        for (k = 0; k < n; k++) {
+            get_uleb(&counts, end, &c);
+            table[2 + k] += c;
+        }
+    }
+
+    for (int i = 0; i < 8; i++) fputc((int)((table[0] >> (8 * i)) & 0xFF), f);
+    put_uleb(f, table[1]);
+    for (uint64_t k = 0; k < table[1]; k++) put_uleb(f, table[2 + k]);
+    if (fclose(f) != 0) fprintf(stderr, "runtime error: cannot write profile '%s'\n", path);
+    free(old);
+}
@@ -5,61 +5,122 @@
  * It 'decorates' the AST by filling in Expr->type fields, which allows the 
  * backend to generate type-specific machine instructions (e.g., distinguishing 
  * between an integer print and a string print).
+ *
+ * The same traversal applies the ownership and borrowing rules through the
+ * hooks of borrowchecker.h, so the front end walks the tree only once.
  */
 
 #include "../include/semantic.h"
+#include "../include/borrowchecker.h"
 #include "../include/ast.h"
+#include "../include/symtab.h"
 #include "../include/common.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 
-/** Entry in the symbol table representing a variable. */
+/** Symbol table payload describing a variable. */
 typedef struct Sym {
-    char name[MAX_IDENT];
     Type type;
     int defined_line;
-    struct Sym *next;
+    bool in_par;        /* Declared inside the body of a par loop */
+    VarInfo borrow;     /* Maintained by the borrow-check hooks */
 } Sym;
 
-/** A simple linked-list based symbol table for lexical scoping. */
-typedef struct {
-    Sym *head;
-} SymTable;
+/** Traversal context shared by type checking and borrow checking. */
+typedef struct SemCtx {
+    SymTab sym;
+    BorrowCheck bc;
+    Arena *arena;       /* The function's AST arena, for element types */
+    bool in_par;        /* Inside the body of a par loop */
+} SemCtx;
 
 /* ---------------------------------------------------------
    SYMBOL TABLE HELPERS
    --------------------------------------------------------- */
 
 /** Adds a symbol to the current scope. */
-static void sym_add(SymTable *t, const char *name, Type ty, int line) {
-    Sym *s = xmalloc(sizeof(Sym));
-    snprintf(s->name, sizeof(s->name), "%s", name);
+static Sym *sym_add(SemCtx *cx, Symbol name, Type ty, int line) {
+    Sym *s = symtab_declare(&cx->sym, name);
     s->type = ty;
     s->defined_line = line;
-    s->next = t->head;
-    t->head = s;
+    s->in_par = cx->in_par;
+    return s;
 }
 
 /** Looks up a symbol by name in the current and parent scopes. */
-static Sym *sym_find(SymTable *t, const char *name) {
-    for (Sym *s = t->head; s; s = s->next) {
-        if (strcmp(s->name, name) == 0)
-            return s;
-    }
-    return NULL;
+static Sym *sym_find(SymTab *t, Symbol name) {
+    return symtab_lookup(t, name);
 }
 
 /* ---------------------------------------------------------
    TYPE INFERENCE & ANNOTATION
    --------------------------------------------------------- */
 
+/** The declaration of the variable named by `e`, which must exist. */
+static Sym *used_sym(Expr *e, SemCtx *cx) {
+    Sym *s = sym_find(&cx->sym, e->v.ident);
+    if (!s) {
+        errorf_at(e->line, e->col, "semantic error: use of undeclared variable '%s'\n",
+                  sym_name(e->v.ident));
+        exit(1);
+    }
+    e->type = s->type;
+    return s;
+}
+
+/** Types a use of a variable; `what` names the access in borrow errors. */
+static Type use_var(Expr *e, SemCtx *cx, const char *what) {
+    Sym *s = used_sym(e, cx);
+    bc_use(&cx->bc, &s->borrow, e, what);
+    return s->type;
+}
+
+/** use_var for the operand of `&` or `&mut`, also counting the borrow. */
+static Type borrow_var(Expr *e, SemCtx *cx, bool mut) {
+    Type t = use_var(e, cx, mut ? "mut borrow of" : "borrow of");
+    bc_borrow(&cx->bc, &sym_find(&cx->sym, e->v.ident)->borrow, mut);
+    return t;
+}
+
+static Type infer_expr(Expr *e, SemCtx *cx);
+
+/** True if `a` and `b` match for a declaration or assignment (arrays by length). */
+static bool same_type(Type a, Type b) {
+    if (a.kind == TY_ARRAY || b.kind == TY_ARRAY)
+        return a.kind == b.kind && a.len == b.len;
+    return a.kind == b.kind || (a.kind == TY_REF && b.kind == TY_REF);
+}
+
+/**
+ * @brief Checks an index into the variable `name` of type `t`.
+ * Constant indices are checked against the length here; the rest are
+ * checked at run time unless lowering proves them in range.
+ */
+static void check_index(Type t, Symbol name, Expr *index, SemCtx *cx, int line, int col) {
+    if (t.kind != TY_ARRAY) {
+        errorf_at(line, col, "semantic error: cannot index '%s', which is not an array\n",
+                  sym_name(name));
+        exit(1);
+    }
+    if (infer_expr(index, cx).kind != TY_INT) {
+        errorf_at(index->line, index->col, "semantic error: array index must be int\n");
+        exit(1);
+    }
+    if (index->kind == E_INT_LIT && (index->v.int_val < 0 || index->v.int_val >= t.len)) {
+        errorf_at(index->line, index->col, "semantic error: index %ld is out of bounds for '%s' of length %ld\n",
+                  index->v.int_val, sym_name(name), t.len);
+        exit(1);
+    }
+}
+
 /**
  * @brief Recursively determines the type of an expression.
  * @return The inferred Type of the expression.
  */
-static Type infer_expr(Expr *e, SymTable *sym) {
+static Type infer_expr(Expr *e, SemCtx *cx) {
     if (!e) return mktype(TY_UNKNOWN);
 
     Type result = mktype(TY_UNKNOWN);
@@ -73,67 +134,142 @@ static Type infer_expr(Expr *e, SymTable *sym) {
         result = mktype(TY_STRING);
         break;
 
-    case E_IDENT: {
-        Sym *s = sym_find(sym, e->v.ident);
-        if (!s) {
-            errorf("Semantic error: use of undeclared variable '%s' at %d:%d\n",
-                   e->v.ident, e->line, e->col);
+    case E_IDENT:
+        result = use_var(e, cx, "use of");
+        break;
+
+    case E_BINOP: {
+        Type l = infer_expr(e->v.bin.l, cx);
+        Type r = infer_expr(e->v.bin.r, cx);
+        if (l.kind != TY_INT || r.kind != TY_INT) {
+            errorf_at(e->line, e->col, "semantic error: operator '%c' requires int operands\n",
+                      e->v.bin.op);
             exit(1);
         }
-        result = s->type;
+        result = mktype(TY_INT);
         break;
     }
 
     case E_ADDR: {
-        Type inner = infer_expr(e->v.inner, sym);
-        Type *p = xmalloc(sizeof(Type));
+        Expr *in = e->v.inner;
+        Type inner = in->kind == E_IDENT ? borrow_var(in, cx, false) : infer_expr(in, cx);
+        Type *p = arena_alloc(cx->arena, sizeof(Type));
         *p = inner;
         result = mkref(TY_REF, p);
         break;
     }
 
     case E_MUTADDR: {
-        Type inner = infer_expr(e->v.inner, sym);
-        Type *p = xmalloc(sizeof(Type));
+        Expr *in = e->v.inner;
+        Type inner = in->kind == E_IDENT ? borrow_var(in, cx, true) : infer_expr(in, cx);
+        Type *p = arena_alloc(cx->arena, sizeof(Type));
         *p = inner;
         result = mkref(TY_MUTREF, p);
         break;
     }
 
     case E_CALL: {
-        const char *fn = e->v.call.name;
+        Symbol fn = e->v.call.name;
 
-        /* Built-in: clone(string) -> string */
-        if (strcmp(fn, "clone") == 0) {
+        /* Built-in: clone(string) -> string, clone(Rc<string>) -> Rc<string> */
+        if (fn == SYM_CLONE) {
             if (e->v.call.nargs != 1) {
-                errorf("clone() expects 1 argument at %d:%d\n", e->line, e->col);
+                errorf_at(e->line, e->col, "semantic error: clone() expects 1 argument\n");
                 exit(1);
             }
-            Type arg = infer_expr(e->v.call.args[0], sym);
-            if (arg.kind != TY_STRING) {
-                errorf("clone() requires string type at %d:%d\n", e->line, e->col);
+            Expr *src = e->v.call.args[0];
+            Type arg = infer_expr(src, cx);
+            if (arg.kind != TY_STRING && arg.kind != TY_RC) {
+                errorf_at(e->line, e->col, "semantic error: clone() requires string or Rc type\n");
                 exit(1);
             }
-            result = mktype(TY_STRING);
-        } 
+            /* Rc counts are not atomic: only the loop's own Rcs may gain owners */
+            if (arg.kind == TY_RC && cx->in_par &&
+                (src->kind != E_IDENT || !sym_find(&cx->sym, src->v.ident)->in_par)) {
+                errorf_at(e->line, e->col, "semantic error: cannot clone an Rc from outside a par loop\n");
+                exit(1);
+            }
+            result = arg;
+        }
+        /* Built-in: Rc(string) -> Rc<string>, a shared copy of the string */
+        else if (fn == SYM_RC) {
+            if (e->v.call.nargs != 1) {
+                errorf_at(e->line, e->col, "semantic error: Rc() expects 1 argument\n");
+                exit(1);
+            }
+            if (infer_expr(e->v.call.args[0], cx).kind != TY_STRING) {
+                errorf_at(e->line, e->col, "semantic error: Rc() requires string type\n");
+                exit(1);
+            }
+            Type *payload = arena_alloc(cx->arena, sizeof(Type));
+            *payload = mktype(TY_STRING);
+            result = mkref(TY_RC, payload);
+        }
         /* Built-in: print(any) -> int */
-        else if (strcmp(fn, "print") == 0) {
+        else if (fn == SYM_PRINT) {
             if (e->v.call.nargs != 1) {
-                errorf("print() expects 1 argument at %d:%d\n", e->line, e->col);
+                errorf_at(e->line, e->col, "semantic error: print() expects 1 argument\n");
+                exit(1);
+            }
+            /* The output buffer is not shared between threads */
+            if (cx->in_par) {
+                errorf_at(e->line, e->col, "semantic error: print() is not allowed inside a par loop\n");
+                exit(1);
+            }
+            if (infer_expr(e->v.call.args[0], cx).kind == TY_ARRAY) {
+                errorf_at(e->line, e->col, "semantic error: print() cannot print an array\n");
                 exit(1);
             }
-            infer_expr(e->v.call.args[0], sym);
             result = mktype(TY_INT);
         } 
         else {
-            errorf("Unknown function '%s' at %d:%d\n", fn, e->line, e->col);
+            errorf_at(e->line, e->col, "semantic error: unknown function '%s'\n", sym_name(fn));
+            exit(1);
+        }
+        break;
+    }
+
+    case E_ARRAY_LIT: {
+        /* [a, b, c]: int elements, the length is the item count */
+        int n = e->v.array.count;
+        if (n < 1 || n > MAX_ARRAY_LEN) {
+            errorf_at(e->line, e->col, "semantic error: array literal must have between 1 and %d elements\n",
+                      MAX_ARRAY_LEN);
             exit(1);
         }
+        for (int i = 0; i < n; i++) {
+            Expr *item = e->v.array.items[i];
+            if (infer_expr(item, cx).kind != TY_INT) {
+                errorf_at(item->line, item->col, "semantic error: array elements must be int\n");
+                exit(1);
+            }
+        }
+        Type *elem = arena_alloc(cx->arena, sizeof(Type));
+        *elem = mktype(TY_INT);
+        result = mkarray(elem, n);
         break;
     }
 
+    case E_INDEX: {
+        Expr *array = e->v.index.array;
+        if (array->kind != E_IDENT) {
+            errorf_at(e->line, e->col, "semantic error: only array variables can be indexed\n");
+            exit(1);
+        }
+        Sym *s = used_sym(array, cx);
+        bc_use_element(&cx->bc, &s->borrow, array, e->v.index.index);
+        Type t = s->type;
+        check_index(t, array->v.ident, e->v.index.index, cx, e->line, e->col);
+        result = *t.inner;
+        break;
+    }
+
+    case E_RANGE:
+        errorf_at(e->line, e->col, "semantic error: a range is only allowed as the iterator of a for loop\n");
+        exit(1);
+
     default:
-        errorf("Semantic: unsupported expr kind %d at %d:%d\n", e->kind, e->line, e->col);
+        errorf_at(e->line, e->col, "semantic error: unsupported expr kind %d\n", e->kind);
         exit(1);
     }
 
@@ -149,7 +285,7 @@ static Type infer_expr(Expr *e, SymTable *sym) {
 /**
  * @brief Validates statement logic and manages symbol visibility.
  */
-static void sem_stmt(Stmt *s, SymTable *sym) {
+static void sem_stmt(Stmt *s, SemCtx *cx) {
     if (!s) return;
 
     switch (s->kind) {
@@ -157,46 +293,140 @@ static void sem_stmt(Stmt *s, SymTable *sym) {
         Type t = s->v.decl.type;
 
         if (s->v.decl.init) {
-            Type init_t = infer_expr(s->v.decl.init, sym);
+            Type init_t = infer_expr(s->v.decl.init, cx);
 
             /* Type Inference: let x = 5; (t starts as UNKNOWN) */
             if (t.kind == TY_UNKNOWN) {
                 t = init_t;
             } else {
                 /* Type Checking: let x: int = "string"; (Mismatch) */
-                if (!(t.kind == init_t.kind || (t.kind == TY_REF && init_t.kind == TY_REF))) {
-                    errorf("Type mismatch in declaration of '%s' at %d:%d\n",
-                           s->v.decl.name, s->line, s->col);
+                if (!same_type(t, init_t)) {
+                    errorf_at(s->line, s->col, "semantic error: type mismatch in declaration of '%s'\n",
+                              sym_name(s->v.decl.name));
                     exit(1);
                 }
             }
         }
-        sym_add(sym, s->v.decl.name, t, s->line);
+        /* Record the inferred type so later passes see the declared slot type */
+        s->v.decl.type = t;
+
+        /* The source is moved or borrowed before the new name can shadow it */
+        bc_bind_source(&cx->bc, s);
+        Sym *v = sym_add(cx, s->v.decl.name, t, s->line);
+        bc_declare(&cx->bc, &v->borrow, s);
+        break;
+    }
+
+    case S_ASSIGN: {
+        Sym *target = sym_find(&cx->sym, s->v.assign.name);
+        if (!target) {
+            errorf_at(s->line, s->col, "semantic error: assignment to undeclared variable '%s'\n",
+                      sym_name(s->v.assign.name));
+            exit(1);
+        }
+        if (s->v.assign.index) {
+            /* a[i] = v: the index is evaluated before the value */
+            check_index(target->type, s->v.assign.name, s->v.assign.index, cx, s->line, s->col);
+            if (infer_expr(s->v.assign.value, cx).kind != TY_INT) {
+                errorf_at(s->line, s->col, "semantic error: type mismatch in assignment to element of '%s'\n",
+                          sym_name(s->v.assign.name));
+                exit(1);
+            }
+            bc_assign_index(&cx->bc, &target->borrow, s);
+            break;
+        }
+        Type value_t = infer_expr(s->v.assign.value, cx);
+        if (!same_type(target->type, value_t)) {
+            errorf_at(s->line, s->col, "semantic error: type mismatch in assignment to '%s'\n",
+                      sym_name(s->v.assign.name));
+            exit(1);
+        }
+        bc_assign(&cx->bc, &target->borrow, s);
         break;
     }
 
     case S_EXPR:
-        infer_expr(s->v.expr, sym);
+        infer_expr(s->v.expr, cx);
         break;
 
     case S_BLOCK: {
-        /* Create a local scope by passing the current head */
-        SymTable local = { .head = sym->head };
+        /* Declarations inside the block are dropped when it ends */
+        symtab_push(&cx->sym);
+        int mark = symtab_count(&cx->sym);
         for (int i = 0; i < s->v.block.n; i++)
-            sem_stmt(s->v.block.stmts[i], &local);
+            sem_stmt(s->v.block.stmts[i], cx);
+        bc_close_scope(&cx->bc, mark);
+        symtab_pop(&cx->sym);
         break;
     }
 
-    case S_IF:
-        infer_expr(s->v.ifs.cond, sym);
-        sem_stmt(s->v.ifs.then_s, sym);
-        if (s->v.ifs.else_s) sem_stmt(s->v.ifs.else_s, sym);
+    case S_IF: {
+        BorrowFlow fl;
+        infer_expr(s->v.ifs.cond, cx);
+        bc_if_begin(&cx->bc, &fl);
+        sem_stmt(s->v.ifs.then_s, cx);
+        if (s->v.ifs.else_s) {
+            bc_if_else(&cx->bc, &fl);
+            sem_stmt(s->v.ifs.else_s, cx);
+        }
+        bc_if_end(&cx->bc, &fl);
         break;
+    }
 
-    case S_WHILE:
-        infer_expr(s->v.wh.cond, sym);
-        sem_stmt(s->v.wh.body, sym);
+    case S_WHILE: {
+        BorrowFlow fl;
+        bc_loop_begin(&cx->bc, &fl);
+        infer_expr(s->v.wh.cond, cx);
+        bc_loop_body(&cx->bc, &fl);
+        sem_stmt(s->v.wh.body, cx);
+        bc_loop_end(&cx->bc, &fl);
         break;
+    }
+
+    case S_FOR: {
+        /* for i in start..end: both bounds are ints, evaluated once */
+        Expr *range = s->v.fors.iter;
+        if (range->kind != E_RANGE) {
+            errorf_at(range->line, range->col, "semantic error: for loop expects a range 'start..end'\n");
+            exit(1);
+        }
+        Type lo = infer_expr(range->v.range.start, cx);
+        Type hi = infer_expr(range->v.range.end, cx);
+        if (lo.kind != TY_INT || hi.kind != TY_INT) {
+            errorf_at(range->line, range->col, "semantic error: range bounds must be int\n");
+            exit(1);
+        }
+        range->type = mktype(TY_INT);
+
+        BorrowFlow fl;
+        bc_loop_begin(&cx->bc, &fl);
+        bc_loop_body(&cx->bc, &fl);
+
+        /* The induction variable is scoped to the body */
+        Stmt *var = s->v.fors.var;
+        symtab_push(&cx->sym);
+        int mark = symtab_count(&cx->sym);
+        if (s->v.fors.par) {
+            if (cx->in_par) {
+                errorf_at(s->line, s->col, "semantic error: par loops cannot be nested\n");
+                exit(1);
+            }
+            cx->in_par = true;
+        }
+        Sym *v = sym_add(cx, var->v.decl.name, var->v.decl.type, s->line);
+        bc_loop_var(&cx->bc, &v->borrow, var);
+        if (s->v.fors.par) bc_par_body(&cx->bc, &v->borrow);
+        sem_stmt(s->v.fors.body, cx);
+        if (s->v.fors.par) {
+            bc_par_end(&cx->bc);
+            cx->in_par = false;
+        }
+        bc_close_scope(&cx->bc, mark);
+        symtab_pop(&cx->sym);
+
+        bc_loop_end(&cx->bc, &fl);
+        break;
+    }
 
     default:
         break;
@@ -207,8 +437,23 @@ static void sem_stmt(Stmt *s, SymTable *sym) {
    ENTRY POINT
    --------------------------------------------------------- */
 
-void semantic_check(Function *f, const char *filename) {
-    (void)filename;
-    SymTable st = { .head = NULL };
-    sem_stmt(f->body, &st);
+/** Error cleanup: the scopes and borrow events of an abandoned check. */
+static void sem_free(void *arg) {
+    SemCtx *cx = arg;
+    bc_free(&cx->bc);
+    symtab_free(&cx->sym);
+}
+
+void semantic_check(Function *f, const char *filename, bool borrowck) {
+    SemCtx cx;
+    cx.arena = &f->arena;
+    cx.in_par = false;
+    symtab_init(&cx.sym, sizeof(Sym));
+    bc_init(&cx.bc, filename, &cx.sym, offsetof(Sym, borrow), borrowck);
+    ErrorCleanup cleanup;
+    error_cleanup_push(&cleanup, sem_free, &cx);
+    sem_stmt(f->body, &cx);
+    bc_finish(&cx.bc);
+    error_cleanup_pop(&cleanup);
+    symtab_free(&cx.sym);
 }
\ No newline at end of file
@@ -0,0 +1,431 @@
+/**
+ * @file server.c
+ * @brief Request loop of mycc --server and the client that forwards to it.
+ *
+ * Both directions use one framing over a byte stream:
+ *   request: REQUEST_MAGIC, a count, then that many strings: the working
+ *            directory, then argv[0], argv[1], ...
+ *   reply:   REPLY_MAGIC, the exit status, then the stdout and the
+ *            stderr output as two strings
+ * Integers are 32-bit little-endian; a string is its length and its bytes.
+ */
+/* sockaddr_un, sigaction and umask are hidden by -std=c99 without this */
+#define _DEFAULT_SOURCE
+
+#include "../include/server.h"
+#include "../include/cache.h"
+#include "../include/common.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define REQUEST_MAGIC "MYCQ"
+#define REPLY_MAGIC   "MYCR"
+
+/* Bounds on what a request may ask the server to allocate */
+#define MAX_REQUEST_STRINGS 65536
+#define MAX_REQUEST_STRING  ((uint32_t)1 << 20)
+
+/* ---------------------------------------------------------
+   CONNECTIONS
+   --------------------------------------------------------- */
+
+#ifdef _WIN32
+
+typedef HANDLE Conn;
+
+/** `path` as a pipe name: \\.\pipe\<path> unless it already is one. */
+static void pipe_name(StrBuf *out, const char *path) {
+    if (strncmp(path, "\\\\", 2) != 0) sb_puts(out, "\\\\.\\pipe\\");
+    sb_puts(out, path);
+    sb_putc(out, '\0');
+}
+
+static bool conn_read(Conn c, void *buf, size_t n) {
+    char *p = buf;
+    while (n > 0) {
+        DWORD got;
+        DWORD want = n > 65536 ? 65536 : (DWORD)n;
+        if (!ReadFile(c, p, want, &got, NULL) || got == 0) return false;
+        p += got;
+        n -= got;
+    }
+    return true;
+}
+
+static bool conn_write(Conn c, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        DWORD put;
+        DWORD want = n > 65536 ? 65536 : (DWORD)n;
+        if (!WriteFile(c, p, want, &put, NULL) || put == 0) return false;
+        p += put;
+        n -= put;
+    }
+    return true;
+}
+
+/** Connects to the server, waiting while it is busy with another client. */
+static bool conn_open(const char *path, Conn *c) {
+    StrBuf name;
+    sb_init(&name);
+    pipe_name(&name, path);
+    bool ok = false;
+    for (;;) {
+        HANDLE h = CreateFileA(name.data, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (h != INVALID_HANDLE_VALUE) {
+            *c = h;
+            ok = true;
+            break;
+        }
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(name.data, NMPWAIT_WAIT_FOREVER)) break;
+    }
+    sb_free(&name);
+    return ok;
+}
+
+static void conn_close(Conn c) {
+    CloseHandle(c);
+}
+
+static bool change_dir(const char *dir) {
+    return SetCurrentDirectoryA(dir) != 0;
+}
+
+static void current_dir(StrBuf *out) {
+    DWORD n = GetCurrentDirectoryA(0, NULL);
+    char *dst = sb_reserve(out, n + 1);
+    DWORD got = n ? GetCurrentDirectoryA(n, dst) : 0;
+    out->len += got < n ? got : 0;
+}
+
+#else
+
+typedef int Conn;
+
+static bool conn_read(Conn c, void *buf, size_t n) {
+    char *p = buf;
+    while (n > 0) {
+        ssize_t got = read(c, p, n);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        n -= (size_t)got;
+    }
+    return true;
+}
+
+static bool conn_write(Conn c, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t put = write(c, p, n);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        p += put;
+        n -= (size_t)put;
+    }
+    return true;
+}
+
+/** `path` as a socket address; false if it does not fit. */
+static bool socket_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr->sun_path) return false;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+/** Connects to the server; a busy one queues us until it accepts. */
+static bool conn_open(const char *path, Conn *c) {
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, path)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0) {
+        close(fd);
+        return false;
+    }
+    *c = fd;
+    return true;
+}
+
+static void conn_close(Conn c) {
+    close(c);
+}
+
+static bool change_dir(const char *dir) {
+    return chdir(dir) == 0;
+}
+
+static void current_dir(StrBuf *out) {
+    for (size_t cap = 256; cap <= ((size_t)1 << 20); cap *= 2) {
+        char *dst = sb_reserve(out, cap);
+        if (getcwd(dst, cap)) {
+            out->len += strlen(dst);
+            return;
+        }
+        if (errno != ERANGE) return;
+    }
+}
+
+#endif
+
+/* ---------------------------------------------------------
+   FRAMING
+   --------------------------------------------------------- */
+
+static void put_u32(StrBuf *sb, uint32_t v) {
+    char b[4] = { (char)v, (char)(v >> 8), (char)(v >> 16), (char)(v >> 24) };
+    sb_append(sb, b, 4);
+}
+
+static void put_str(StrBuf *sb, const char *s, size_t len) {
+    put_u32(sb, (uint32_t)len);
+    sb_append(sb, s, len);
+}
+
+static bool get_u32(Conn c, uint32_t *v) {
+    unsigned char b[4];
+    if (!conn_read(c, b, 4)) return false;
+    *v = (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+    return true;
+}
+
+/** Reads a string of at most `max` bytes into a new NUL-terminated buffer, or NULL. */
+static char *get_str(Conn c, uint32_t max, uint32_t *len) {
+    if (!get_u32(c, len) || *len > max) return NULL;
+    char *s = xmalloc((size_t)*len + 1);
+    if (!conn_read(c, s, *len)) {
+        free(s);
+        return NULL;
+    }
+    s[*len] = '\0';
+    return s;
+}
+
+static bool get_magic(Conn c, const char *magic) {
+    char b[4];
+    return conn_read(c, b, 4) && memcmp(b, magic, 4) == 0;
+}
+
+/** Appends everything written to the temporary file `f`. */
+static void read_back(StrBuf *out, FILE *f) {
+    fflush(f);
+    rewind(f);
+    size_t n;
+    do {
+        char *dst = sb_reserve(out, 65536);
+        n = fread(dst, 1, 65536, f);
+        out->len += n;
+    } while (n > 0);
+}
+
+/* ---------------------------------------------------------
+   SERVER
+   --------------------------------------------------------- */
+
+typedef struct Request {
+    ServerBuild build;
+    int argc;
+    char **argv;
+    FILE *out, *err;
+    int status;
+} Request;
+
+/** catch_errors body: an error that would end mycc ends only the request. */
+static void request_build(void *arg) {
+    Request *r = arg;
+    r->status = r->build(r->argc, r->argv, r->out, r->err);
+}
+
+/** Reads one request from `c`, compiles it and sends the reply. */
+static void serve(Conn c, ServerBuild build) {
+    uint32_t count;
+    if (!get_magic(c, REQUEST_MAGIC) || !get_u32(c, &count) || count < 2 || count > MAX_REQUEST_STRINGS)
+        return;
+
+    /* strings[0] is the directory; the rest is argv, NULL-terminated like main's */
+    char **strings = xmalloc(sizeof(char *) * ((size_t)count + 1));
+    uint32_t nread = 0;
+    for (; nread < count; nread++) {
+        uint32_t len;
+        strings[nread] = get_str(c, MAX_REQUEST_STRING, &len);
+        if (!strings[nread]) break;
+    }
+    strings[count] = NULL;
+
+    if (nread == count) {
+        Request r = { build, (int)count - 1, strings + 1, tmpfile(), tmpfile(), 1 };
+        StrBuf diag;
+        sb_init(&diag);
+        if (!r.out || !r.err)
+            sb_puts(&diag, "mycc: server cannot create its output files\n");
+        else if (!change_dir(strings[0]))
+            sb_printf(&diag, "mycc: server cannot enter '%s'\n", strings[0]);
+        else if (!catch_errors(request_build, &r, &diag))
+            r.status = 1;
+
+        StrBuf out, err;
+        sb_init(&out);
+        sb_init(&err);
+        if (r.out) read_back(&out, r.out);
+        if (r.err) read_back(&err, r.err);
+        sb_append(&err, diag.data, diag.len);
+
+        StrBuf reply;
+        sb_init(&reply);
+        sb_append(&reply, REPLY_MAGIC, 4);
+        put_u32(&reply, (uint32_t)r.status);
+        put_str(&reply, out.data, out.len);
+        put_str(&reply, err.data, err.len);
+        conn_write(c, reply.data, reply.len);
+
+        sb_free(&reply);
+        sb_free(&out);
+        sb_free(&err);
+        sb_free(&diag);
+        if (r.out) fclose(r.out);
+        if (r.err) fclose(r.err);
+    }
+    for (uint32_t i = 0; i < nread; i++) free(strings[i]);
+    free(strings);
+}
+
+#ifdef _WIN32
+
+static HANDLE pipe_instance(const char *name, bool first) {
+    return CreateNamedPipeA(name, PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                            PIPE_UNLIMITED_INSTANCES, 65536, 65536, 0, NULL);
+}
+
+int server_run(const char *path, ServerBuild build) {
+    StrBuf name;
+    sb_init(&name);
+    pipe_name(&name, path);
+    HANDLE h = pipe_instance(name.data, true);
+    if (h == INVALID_HANDLE_VALUE)
+        errorf("mycc: cannot listen on '%s' (error %lu)\n", name.data, GetLastError());
+    cache_keep_in_memory(SERVER_CACHE_BUDGET);
+
+    /* The next instance exists before a request is served, so clients
+       arriving meanwhile wait for it instead of finding no pipe */
+    for (;;) {
+        if (ConnectNamedPipe(h, NULL) || GetLastError() == ERROR_PIPE_CONNECTED) {
+            HANDLE next = pipe_instance(name.data, false);
+            if (next == INVALID_HANDLE_VALUE)
+                errorf("mycc: cannot listen on '%s' (error %lu)\n", name.data, GetLastError());
+            serve(h, build);
+            FlushFileBuffers(h);
+            DisconnectNamedPipe(h);
+            CloseHandle(h);
+            h = next;
+        }
+    }
+}
+
+#else
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+int server_run(const char *path, ServerBuild build) {
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, path)) errorf("mycc: socket path '%s' is too long\n", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) errorf("mycc: cannot create a socket\n");
+
+    /* The socket is created with mode 0600: requests read and write files as us */
+    mode_t mask = umask(0077);
+    int rc = bind(fd, (struct sockaddr *)&addr, sizeof addr);
+    if (rc != 0 && errno == EADDRINUSE) {
+        Conn probe;
+        if (conn_open(path, &probe)) {
+            conn_close(probe);
+            errorf("mycc: a server is already listening on '%s'\n", path);
+        }
+        /* Left behind by a server that did not shut down cleanly */
+        unlink(path);
+        rc = bind(fd, (struct sockaddr *)&addr, sizeof addr);
+    }
+    umask(mask);
+    if (rc != 0 || listen(fd, SOMAXCONN) != 0) errorf("mycc: cannot listen on '%s'\n", path);
+    cache_keep_in_memory(SERVER_CACHE_BUDGET);
+
+    /* No SA_RESTART: a stop signal has to interrupt the blocked accept */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    /* A client that goes away must not take the server with it */
+    signal(SIGPIPE, SIG_IGN);
+
+    while (!stop_requested) {
+        int c = accept(fd, NULL, NULL);
+        if (c < 0) continue;
+        serve(c, build);
+        close(c);
+    }
+    close(fd);
+    unlink(path);
+    return 0;
+}
+
+#endif
+
+/* ---------------------------------------------------------
+   CLIENT
+   --------------------------------------------------------- */
+
+int server_forward(const char *path, int argc, char **argv) {
+    Conn c;
+    if (!conn_open(path, &c)) return -1;
+
+    StrBuf req, dir;
+    sb_init(&req);
+    sb_init(&dir);
+    current_dir(&dir);
+    sb_append(&req, REQUEST_MAGIC, 4);
+    put_u32(&req, (uint32_t)argc + 1);
+    put_str(&req, dir.data, dir.len);
+    for (int i = 0; i < argc; i++) put_str(&req, argv[i], strlen(argv[i]));
+
+    /* The reply is trusted as far as its sizes go: it is our own server */
+    uint32_t status = 0, out_len = 0, err_len = 0;
+    char *out = NULL, *err = NULL;
+    bool ok = dir.len > 0 && conn_write(c, req.data, req.len) && get_magic(c, REPLY_MAGIC)
+              && get_u32(c, &status) && (out = get_str(c, UINT32_MAX, &out_len))
+              && (err = get_str(c, UINT32_MAX, &err_len));
+    conn_close(c);
+    sb_free(&req);
+    sb_free(&dir);
+
+    if (ok) {
+        fwrite(out, 1, out_len, stdout);
+        fflush(stdout);
+        fwrite(err, 1, err_len, stderr);
+        fflush(stderr);
+    }
+    free(out);
+    free(err);
+    return ok ? (int)status : -1;
+}
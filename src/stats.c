@@ -0,0 +1,163 @@
+/**
+ * @file stats.c
+ * @brief Phase timers, allocation counters and their reports.
+ */
+/* clock_gettime is POSIX, hidden by -std=c99 without this */
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/stats.h"
+#include "../include/common.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static const char *const phase_names[PHASE_COUNT] = {
+    [PHASE_CACHE]    = "cache",
+    [PHASE_PARSE]    = "parse",
+    [PHASE_SEMANTIC] = "semantic",
+    [PHASE_LOWER]    = "lower",
+    [PHASE_OPT]      = "optimize",
+    [PHASE_CODEGEN]  = "codegen",
+    [PHASE_PEEPHOLE] = "peephole",
+    [PHASE_OUTPUT]   = "output",
+};
+
+static const char *const counter_names[STAT_COUNT] = {
+    [STAT_TOKENS]        = "tokens",
+    [STAT_AST_NODES]     = "ast_nodes",
+    [STAT_IR_INSTRS]     = "ir_instrs",
+    [STAT_IR_INSTRS_OPT] = "ir_instrs_optimized",
+    [STAT_ASM_INSNS]     = "asm_instructions",
+    [STAT_OUTPUT_BYTES]  = "output_bytes",
+};
+
+/* Record of the unit this thread is compiling, or NULL */
+static THREAD_LOCAL Stats *current;
+
+uint64_t stats_now_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000u
+         + (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000u / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void stats_begin(Stats *s) {
+    memset(s, 0, sizeof *s);
+    s->running = -1;
+    current = s;
+}
+
+/** Charges the time since the last switch to the running phase. */
+static void charge(Stats *s, uint64_t now) {
+    if (s->running >= 0) s->phase[s->running].ns += now - s->since;
+    s->since = now;
+}
+
+void stats_end(void) {
+    if (!current) return;
+    charge(current, stats_now_ns());
+    current->running = -1;
+    current = NULL;
+}
+
+void stats_phase(Phase p) {
+    Stats *s = current;
+    if (!s) return;
+    charge(s, stats_now_ns());
+    s->running = (int)p;
+}
+
+void stats_count(StatCounter c, uint64_t n) {
+    if (current) current->counters[c] += n;
+}
+
+void stats_note_alloc(size_t bytes) {
+    Stats *s = current;
+    if (!s || s->running < 0) return;
+    s->phase[s->running].allocs++;
+    s->phase[s->running].bytes += bytes;
+}
+
+void stats_merge(Stats *into, const Stats *from) {
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        into->phase[p].ns += from->phase[p].ns;
+        into->phase[p].allocs += from->phase[p].allocs;
+        into->phase[p].bytes += from->phase[p].bytes;
+    }
+    for (int c = 0; c < STAT_COUNT; c++)
+        into->counters[c] += from->counters[c];
+}
+
+/* ---------------------------------------------------------
+   REPORTS
+   --------------------------------------------------------- */
+
+static void report_json(const Stats *s, int units, int jobs, uint64_t wall_ns, FILE *out) {
+    fprintf(out, "{\"version\": 1, \"units\": %d, \"jobs\": %d, \"wall_ns\": %llu,\n",
+            units, jobs, (unsigned long long)wall_ns);
+    fprintf(out, " \"phases\": {");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(out, "%s\n  \"%s\": {\"ns\": %llu, \"allocs\": %llu, \"bytes\": %llu}",
+                p ? "," : "", phase_names[p], (unsigned long long)s->phase[p].ns,
+                (unsigned long long)s->phase[p].allocs, (unsigned long long)s->phase[p].bytes);
+    }
+    fprintf(out, "},\n \"counters\": {");
+    for (int c = 0; c < STAT_COUNT; c++) {
+        fprintf(out, "%s\"%s\": %llu", c ? ", " : "", counter_names[c],
+                (unsigned long long)s->counters[c]);
+    }
+    fprintf(out, "}}\n");
+}
+
+void stats_report(const Stats *s, int units, int jobs, uint64_t wall_ns,
+                  const StatsFormat *fmt, FILE *out) {
+    if (fmt->json) {
+        report_json(s, units, jobs, wall_ns, out);
+        return;
+    }
+
+    PhaseStats total = { 0, 0, 0 };
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        total.ns += s->phase[p].ns;
+        total.allocs += s->phase[p].allocs;
+        total.bytes += s->phase[p].bytes;
+    }
+
+    fprintf(out, "%-10s", "phase");
+    if (fmt->time) fprintf(out, " %12s %7s", "time (ms)", "share");
+    if (fmt->mem) fprintf(out, " %12s %14s", "allocs", "bytes");
+    fprintf(out, "\n");
+
+    for (int p = 0; p <= PHASE_COUNT; p++) {
+        const PhaseStats *ph = p < PHASE_COUNT ? &s->phase[p] : &total;
+        fprintf(out, "%-10s", p < PHASE_COUNT ? phase_names[p] : "total");
+        if (fmt->time) {
+            double share = total.ns ? 100.0 * (double)ph->ns / (double)total.ns : 0.0;
+            fprintf(out, " %12.3f %6.1f%%", (double)ph->ns / 1e6, share);
+        }
+        if (fmt->mem) {
+            fprintf(out, " %12llu %14llu", (unsigned long long)ph->allocs,
+                    (unsigned long long)ph->bytes);
+        }
+        fprintf(out, "\n");
+    }
+
+    if (fmt->time) {
+        fprintf(out, "wall clock %12.3f ms for %d unit%s on %d thread%s%s\n",
+                (double)wall_ns / 1e6, units, units == 1 ? "" : "s", jobs, jobs == 1 ? "" : "s",
+                units > 1 ? " (phase times are summed over units)" : "");
+    }
+    for (int c = 0; c < STAT_COUNT; c++)
+        fprintf(out, "%-20s %llu\n", counter_names[c], (unsigned long long)s->counters[c]);
+}
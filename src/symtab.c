@@ -0,0 +1,129 @@
+/**
+ * @file symtab.c
+ * @brief Hash table + undo stack implementation of scoped bindings.
+ */
+
+#include "../include/symtab.h"
+#include "../include/common.h"
+
+#include <string.h>
+
+/** Header stored in front of every binding's payload. */
+typedef struct Binding {
+    Symbol name;
+    int shadowed;       /* Previous binding of the same name, or -1 */
+} Binding;
+
+#define BINDING_HEADER ((sizeof(Binding) + 15) & ~(size_t)15)
+
+static Binding *binding_at(const SymTab *t, int i) {
+    return (Binding *)(t->bindings + (size_t)i * t->entry_size);
+}
+
+/* Symbols are small dense integers: Fibonacci hashing spreads them out */
+static uint32_t slot_index(const SymTab *t, Symbol name) {
+    return (uint32_t)(name * 2654435769u) & (t->nslots - 1);
+}
+
+/** Finds the slot holding `name`, or the empty slot where it belongs. */
+static SymTabSlot *find_slot(const SymTab *t, Symbol name) {
+    uint32_t mask = t->nslots - 1;
+    uint32_t i = slot_index(t, name);
+    while (t->slots[i].name != SYM_NONE && t->slots[i].name != name)
+        i = (i + 1) & mask;
+    return &t->slots[i];
+}
+
+static void resize_slots(SymTab *t, uint32_t size) {
+    SymTabSlot *old = t->slots;
+    uint32_t old_n = t->nslots;
+
+    t->slots = xmalloc(sizeof(SymTabSlot) * size);
+    memset(t->slots, 0, sizeof(SymTabSlot) * size);
+    t->nslots = size;
+
+    for (uint32_t i = 0; i < old_n; i++) {
+        if (old[i].name != SYM_NONE)
+            *find_slot(t, old[i].name) = old[i];
+    }
+    free(old);
+}
+
+void symtab_init(SymTab *t, size_t value_size) {
+    memset(t, 0, sizeof(*t));
+    t->value_size = value_size;
+    t->entry_size = BINDING_HEADER + ((value_size + 15) & ~(size_t)15);
+    resize_slots(t, 64);
+}
+
+void symtab_free(SymTab *t) {
+    free(t->bindings);
+    free(t->slots);
+    free(t->marks);
+    memset(t, 0, sizeof(*t));
+}
+
+void symtab_push(SymTab *t) {
+    if (t->nmarks == t->marks_cap) {
+        t->marks_cap = t->marks_cap ? t->marks_cap * 2 : 16;
+        t->marks = xrealloc(t->marks, sizeof(int) * (size_t)t->marks_cap);
+    }
+    t->marks[t->nmarks++] = t->n;
+}
+
+void symtab_pop(SymTab *t) {
+    if (t->nmarks == 0) errorf("symtab: scope stack underflow\n");
+    int mark = t->marks[--t->nmarks];
+
+    /* Names stay in the hash table; they simply revert to what they shadowed */
+    while (t->n > mark) {
+        Binding *b = binding_at(t, --t->n);
+        find_slot(t, b->name)->top = b->shadowed;
+    }
+}
+
+int symtab_depth(const SymTab *t) {
+    return t->nmarks;
+}
+
+void *symtab_declare(SymTab *t, Symbol name) {
+    if (t->n == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 64;
+        t->bindings = xrealloc(t->bindings, t->entry_size * (size_t)t->cap);
+    }
+
+    SymTabSlot *slot = find_slot(t, name);
+    if (slot->name == SYM_NONE) {
+        if ((t->used + 1) * 2 > t->nslots) {
+            resize_slots(t, t->nslots * 2);
+            slot = find_slot(t, name);
+        }
+        slot->name = name;
+        slot->top = -1;
+        t->used++;
+    }
+
+    int index = t->n++;
+    Binding *b = binding_at(t, index);
+    b->name = name;
+    b->shadowed = slot->top;
+    slot->top = index;
+
+    void *value = (unsigned char *)b + BINDING_HEADER;
+    memset(value, 0, t->value_size);
+    return value;
+}
+
+int symtab_count(const SymTab *t) {
+    return t->n;
+}
+
+void *symtab_at(const SymTab *t, int i) {
+    return (unsigned char *)binding_at(t, i) + BINDING_HEADER;
+}
+
+void *symtab_lookup(const SymTab *t, Symbol name) {
+    const SymTabSlot *slot = find_slot(t, name);
+    if (slot->name == SYM_NONE || slot->top < 0) return NULL;
+    return (unsigned char *)binding_at(t, slot->top) + BINDING_HEADER;
+}
@@ -0,0 +1,845 @@
+/**
+ * @file x86enc.c
+ * @brief Encoder from AsmBuf lines to x86_64 machine code.
+ *
+ * Instructions are encoded one by one into fixed-size Code records. Jumps
+ * and conditional branches only get their displacement once every label
+ * position is known: they start in the 2-byte rel8 form and are widened to
+ * rel32 until no displacement is out of range; calls to local .L labels
+ * are resolved the same way but always use rel32. Encodings follow the forms
+ * GAS picks for the same Intel-syntax input, so the output can be compared
+ * byte for byte against an external assembler.
+ */
+
+#include "../include/x86enc.h"
+#include "../include/intern.h"
+#include "../include/symtab.h"
+#include "../include/common.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   OPERANDS
+   --------------------------------------------------------- */
+
+#define REG_RIP 16          /* Operand.reg of a [rel symbol] operand */
+#define REG_RAX 0
+#define REG_RSP 4
+#define REG_RBP 5
+
+static const char *const reg64[16] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+};
+static const char *const reg32[16] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"
+};
+static const char *const reg8[16] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+};
+
+typedef enum {
+    OPND_NONE,
+    OPND_REG,
+    OPND_IMM,
+    OPND_MEM,
+    OPND_SYM            /* Bare label or external symbol (jump/call target) */
+} OperandKind;
+
+typedef struct Operand {
+    OperandKind kind;
+    int bits;                   /* Register or access width (128 = xmm); 0 = unspecified */
+    int reg;                    /* OPND_REG: register; OPND_MEM: base or REG_RIP */
+    int index, scale;           /* OPND_MEM: scaled index register, or -1 */
+    int64_t value;              /* OPND_IMM: value; OPND_MEM: displacement */
+    char sym[ASM_OP_LEN];       /* OPND_SYM, or OPND_MEM based on REG_RIP */
+} Operand;
+
+/** Register number and width of `s[0..len)`, or -1. */
+static int parse_reg(const char *s, size_t len, int *bits) {
+    static const char *const *const tables[3] = { reg64, reg32, reg8 };
+    static const int widths[3] = { 64, 32, 8 };
+    if (len > 3 && len <= 5 && strncmp(s, "xmm", 3) == 0 && isdigit((unsigned char)s[3])) {
+        int r = s[3] - '0';
+        if (len == 5) r = isdigit((unsigned char)s[4]) ? r * 10 + (s[4] - '0') : 16;
+        *bits = 128;
+        return r < 16 ? r : -1;
+    }
+    for (int t = 0; t < 3; t++) {
+        for (int r = 0; r < 16; r++) {
+            if (strlen(tables[t][r]) == len && strncmp(tables[t][r], s, len) == 0) {
+                *bits = widths[t];
+                return r;
+            }
+        }
+    }
+    return -1;
+}
+
+/** Parses a decimal or 0x-prefixed integer covering all of `s[0..len)`. */
+static bool parse_int(const char *s, size_t len, int64_t *out) {
+    char tmp[32];
+    if (len == 0 || len >= sizeof(tmp)) return false;
+    memcpy(tmp, s, len);
+    tmp[len] = '\0';
+    if (!isdigit((unsigned char)tmp[tmp[0] == '-' || tmp[0] == '+']))
+        return false;
+
+    char *end;
+    errno = 0;
+    long long v = strtoll(tmp, &end, 0);
+    if (*end != '\0' || errno != 0) return false;
+    *out = (int64_t)v;
+    return true;
+}
+
+static void skip_space(const char **p) {
+    while (isspace((unsigned char)**p)) (*p)++;
+}
+
+static void bad_operand(const char *op) {
+    errorf("assembler: unsupported operand '%s'\n", op);
+}
+
+/** Parses a 64-bit register name at `*p` and advances past it, or returns -1. */
+static int parse_reg64(const char **p, const char *end) {
+    const char *q = *p;
+    while (q < end && isalnum((unsigned char)*q)) q++;
+    int bits;
+    int reg = parse_reg(*p, (size_t)(q - *p), &bits);
+    *p = q;
+    return reg >= 0 && bits == 64 ? reg : -1;
+}
+
+/**
+ * @brief Parses the inside of a memory operand: "base", "base+index*scale"
+ * (scale 1, 2, 4 or 8, "*1" optional), either followed by "+disp"/"-disp",
+ * or "rel sym".
+ */
+static void parse_mem(const char *op, const char *p, const char *end, Operand *o) {
+    o->kind = OPND_MEM;
+    o->index = -1;
+    o->scale = 1;
+    skip_space(&p);
+    while (end > p && isspace((unsigned char)end[-1])) end--;
+
+    if (end - p > 4 && strncmp(p, "rel", 3) == 0 && isspace((unsigned char)p[3])) {
+        p += 4;
+        skip_space(&p);
+        if ((size_t)(end - p) >= ASM_OP_LEN) bad_operand(op);
+        o->reg = REG_RIP;
+        memcpy(o->sym, p, (size_t)(end - p));
+        o->sym[end - p] = '\0';
+        return;
+    }
+
+    const char *q = p;
+    o->reg = parse_reg64(&q, end);
+    if (o->reg < 0) bad_operand(op);
+
+    skip_space(&q);
+    o->value = 0;
+    if (q == end) return;
+    if (*q != '+' && *q != '-') bad_operand(op);
+
+    /* "+index" or "+index*scale" */
+    const char *r = q + 1;
+    skip_space(&r);
+    if (*q == '+' && r < end && isalpha((unsigned char)*r)) {
+        o->index = parse_reg64(&r, end);
+        if (o->index < 0 || o->index == REG_RSP) bad_operand(op);
+        skip_space(&r);
+        if (r < end && *r == '*') {
+            r++;
+            skip_space(&r);
+            if (r >= end || (*r != '1' && *r != '2' && *r != '4' && *r != '8')) bad_operand(op);
+            o->scale = *r++ - '0';
+            skip_space(&r);
+        }
+        q = r;
+        if (q == end) return;
+        if (*q != '+' && *q != '-') bad_operand(op);
+    }
+
+    /* Allow "rbp - 8" as well as "rbp-8" */
+    char sign = *q++;
+    skip_space(&q);
+    if (!parse_int(q, (size_t)(end - q), &o->value) || o->value < 0) bad_operand(op);
+    if (sign == '-') o->value = -o->value;
+    if (o->value < INT32_MIN || o->value > INT32_MAX) bad_operand(op);
+}
+
+static void parse_operand(const char *op, Operand *o) {
+    memset(o, 0, sizeof(*o));
+    o->index = -1;
+    const char *p = op;
+    skip_space(&p);
+
+    static const struct { const char *name; int bits; } sizes[] = {
+        { "qword", 64 }, { "dword", 32 }, { "byte", 8 }
+    };
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        size_t n = strlen(sizes[k].name);
+        if (strncmp(p, sizes[k].name, n) == 0 && isspace((unsigned char)p[n])) {
+            o->bits = sizes[k].bits;
+            p += n;
+            skip_space(&p);
+            break;
+        }
+    }
+
+    size_t len = strlen(p);
+    while (len > 0 && isspace((unsigned char)p[len - 1])) len--;
+
+    if (len > 0 && p[0] == '[') {
+        if (p[len - 1] != ']') bad_operand(op);
+        parse_mem(op, p + 1, p + len - 1, o);
+        return;
+    }
+    if (o->bits) bad_operand(op);  /* Size prefixes only apply to memory */
+
+    int bits;
+    int reg = parse_reg(p, len, &bits);
+    if (reg >= 0) {
+        o->kind = OPND_REG;
+        o->reg = reg;
+        o->bits = bits;
+        return;
+    }
+    if (parse_int(p, len, &o->value)) {
+        o->kind = OPND_IMM;
+        return;
+    }
+    if (len == 0 || len >= ASM_OP_LEN) bad_operand(op);
+    o->kind = OPND_SYM;
+    memcpy(o->sym, p, len);
+    o->sym[len] = '\0';
+}
+
+static bool fits8(int64_t v)  { return v >= -128 && v <= 127; }
+static bool fits32(int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; }
+
+/* ---------------------------------------------------------
+   INSTRUCTION ENCODING
+   --------------------------------------------------------- */
+
+#define CC_JMP (-1)         /* Code.cc of an unconditional jmp */
+#define CC_CALL (-2)        /* Code.cc of a call to a local label (always rel32) */
+
+/** One encoded instruction. */
+typedef struct Code {
+    uint8_t bytes[16];
+    int len;
+
+    int reloc_at;           /* Offset of a relocated rel32 field, or -1 */
+    int reloc_sym;          /* ObjFile symbol index */
+    ObjRelocKind reloc_kind;
+
+    Symbol target;          /* Jumps: destination label, SYM_NONE otherwise */
+    int cc;                 /* Jumps: condition code, CC_JMP or CC_CALL */
+    bool is_near;           /* Jumps: rel32 form */
+} Code;
+
+typedef struct Encoder {
+    ObjFile *obj;
+    const AsmLine *line;    /* For diagnostics */
+    Code *c;                /* Instruction being encoded */
+} Encoder;
+
+static const struct { const char *name; int cc; } cond_codes[] = {
+    { "o", 0x0 }, { "no", 0x1 }, { "b", 0x2 }, { "c", 0x2 }, { "ae", 0x3 }, { "nc", 0x3 },
+    { "e", 0x4 }, { "z", 0x4 }, { "ne", 0x5 }, { "nz", 0x5 }, { "be", 0x6 }, { "a", 0x7 },
+    { "s", 0x8 }, { "ns", 0x9 }, { "p", 0xA }, { "np", 0xB }, { "l", 0xC }, { "ge", 0xD },
+    { "le", 0xE }, { "g", 0xF }
+};
+
+/** Condition code for the suffix of jcc/setcc, or -1. */
+static int parse_cc(const char *suffix) {
+    for (size_t k = 0; k < sizeof(cond_codes) / sizeof(cond_codes[0]); k++)
+        if (strcmp(cond_codes[k].name, suffix) == 0) return cond_codes[k].cc;
+    return -1;
+}
+
+static void unsupported(const Encoder *e) {
+    const AsmLine *l = e->line;
+    errorf("assembler: unsupported instruction: %s%s%s%s%s\n", l->mnemonic,
+           l->nops > 0 ? " " : "", l->nops > 0 ? l->ops[0] : "",
+           l->nops > 1 ? ", " : "", l->nops > 1 ? l->ops[1] : "");
+}
+
+static void byte(Encoder *e, int b) {
+    e->c->bytes[e->c->len++] = (uint8_t)b;
+}
+
+static void imm(Encoder *e, int64_t v, int size) {
+    for (int i = 0; i < size; i++)
+        byte(e, (int)((uint64_t)v >> (8 * i)) & 0xFF);
+}
+
+/**
+ * @brief Emits [REX] opcode ModRM [SIB] [disp] for `reg` (register or /digit)
+ * and the r/m operand `rm`.
+ * `w` selects 64-bit operand size; a REX prefix is also forced for the
+ * spl/bpl/sil/dil byte registers.
+ */
+static void emit_modrm(Encoder *e, bool w, const int *opcode, int nopcode,
+                       int reg, const Operand *rm) {
+    int base = rm->reg == REG_RIP ? 0 : rm->reg;
+    int index = rm->kind == OPND_MEM && rm->index >= 0 ? rm->index : 0;
+    int rex = 0x40 | (w ? 8 : 0) | ((reg >> 3) & 1) << 2 | ((index >> 3) & 1) << 1 | ((base >> 3) & 1);
+    bool byte_reg = rm->kind == OPND_REG && rm->bits == 8 && rm->reg >= 4 && rm->reg < 8;
+    if (rex != 0x40 || byte_reg) byte(e, rex);
+    for (int i = 0; i < nopcode; i++) byte(e, opcode[i]);
+
+    int r = (reg & 7) << 3;
+    if (rm->kind == OPND_REG) {
+        byte(e, 0xC0 | r | (rm->reg & 7));
+        return;
+    }
+    if (rm->kind != OPND_MEM) unsupported(e);
+
+    if (rm->reg == REG_RIP) {
+        byte(e, 0x00 | r | 5);
+        e->c->reloc_at = e->c->len;
+        e->c->reloc_sym = obj_symbol(e->obj, rm->sym);
+        e->c->reloc_kind = OBJ_REL_PC32;
+        imm(e, 0, 4);
+        return;
+    }
+
+    /* rbp/r13 have no disp-less form; rsp/r12 and indexed operands need a SIB byte */
+    int mod = (rm->value == 0 && (base & 7) != REG_RBP) ? 0x00 : fits8(rm->value) ? 0x40 : 0x80;
+    if (rm->index >= 0) {
+        static const int scale_bits[9] = { 0, 0, 1, 0, 2, 0, 0, 0, 3 };
+        byte(e, mod | r | REG_RSP);
+        byte(e, scale_bits[rm->scale] << 6 | (rm->index & 7) << 3 | (base & 7));
+    } else {
+        byte(e, mod | r | (base & 7));
+        if ((base & 7) == REG_RSP) byte(e, 0x24);
+    }
+    if (mod == 0x40) imm(e, rm->value, 1);
+    if (mod == 0x80) imm(e, rm->value, 4);
+}
+
+static void modrm1(Encoder *e, bool w, int opcode, int reg, const Operand *rm) {
+    emit_modrm(e, w, &opcode, 1, reg, rm);
+}
+
+static void modrm2(Encoder *e, bool w, int op1, int op2, int reg, const Operand *rm) {
+    int opcode[2] = { op1, op2 };
+    emit_modrm(e, w, opcode, 2, reg, rm);
+}
+
+/** REX prefix for an instruction that encodes `reg` in the opcode byte. */
+static void rex_opcode_reg(Encoder *e, bool w, int reg) {
+    if (w || reg >= 8) byte(e, 0x40 | (w ? 8 : 0) | ((reg >> 3) & 1));
+}
+
+/** An immediate after a rip-relative field would shift the relocation */
+static void check_imm_operand(Encoder *e, const Operand *rm) {
+    if (rm->kind == OPND_MEM && rm->reg == REG_RIP) unsupported(e);
+}
+
+/** Operand width of a reg or memory operand (memory defaults to the other operand). */
+static int width(Encoder *e, const Operand *a, const Operand *b) {
+    int bits = a->kind == OPND_REG || a->bits ? a->bits : b ? b->bits : 0;
+    if (b && b->kind == OPND_REG && a->kind == OPND_REG && a->bits != b->bits) unsupported(e);
+    if (bits == 0) bits = 64;
+    if (bits != 64 && bits != 32) unsupported(e);
+    return bits;
+}
+
+/** add/or/and/sub/xor/cmp: ALU operation number `ext` (the /digit). */
+static void enc_alu(Encoder *e, int ext, const Operand *dst, const Operand *src) {
+    if (dst->kind != OPND_REG && dst->kind != OPND_MEM) unsupported(e);
+    if (src->kind == OPND_IMM) {
+        bool w = width(e, dst, NULL) == 64;
+        check_imm_operand(e, dst);
+        if (fits8(src->value)) {
+            modrm1(e, w, 0x83, ext, dst);
+            imm(e, src->value, 1);
+        } else if (fits32(src->value)) {
+            if (dst->kind == OPND_REG && dst->reg == REG_RAX) {
+                /* Short accumulator form */
+                rex_opcode_reg(e, w, 0);
+                byte(e, ext * 8 + 5);
+            } else {
+                modrm1(e, w, 0x81, ext, dst);
+            }
+            imm(e, src->value, 4);
+        } else {
+            unsupported(e);
+        }
+        return;
+    }
+    bool w = width(e, dst, src) == 64;
+    if (src->kind == OPND_REG)
+        modrm1(e, w, ext * 8 + 1, src->reg, dst);
+    else if (dst->kind == OPND_REG && src->kind == OPND_MEM)
+        modrm1(e, w, ext * 8 + 3, dst->reg, src);
+    else
+        unsupported(e);
+}
+
+/** Byte stores: mov m8, imm8 and mov m8, r8. */
+static void enc_mov_byte(Encoder *e, const Operand *dst, const Operand *src) {
+    if (dst->kind != OPND_MEM) unsupported(e);
+    if (src->kind == OPND_IMM && src->value >= -128 && src->value <= 255) {
+        check_imm_operand(e, dst);
+        modrm1(e, false, 0xC6, 0, dst);
+        imm(e, src->value, 1);
+    } else if (src->kind == OPND_REG && src->bits == 8 && !(src->reg >= 4 && src->reg < 8)) {
+        /* spl/bpl/sil/dil would need a REX prefix emit_modrm cannot infer here */
+        modrm1(e, false, 0x88, src->reg, dst);
+    } else {
+        unsupported(e);
+    }
+}
+
+static void enc_mov(Encoder *e, const Operand *dst, const Operand *src) {
+    if (dst->bits == 8 || (src->kind == OPND_REG && src->bits == 8)) {
+        enc_mov_byte(e, dst, src);
+        return;
+    }
+    if (src->kind == OPND_IMM) {
+        int bits = width(e, dst, NULL);
+        if (dst->kind == OPND_REG && bits == 32) {
+            if (src->value < INT32_MIN || src->value > (int64_t)UINT32_MAX) unsupported(e);
+            rex_opcode_reg(e, false, dst->reg);
+            byte(e, 0xB8 + (dst->reg & 7));
+            imm(e, src->value, 4);
+        } else if (fits32(src->value)) {
+            check_imm_operand(e, dst);
+            modrm1(e, bits == 64, 0xC7, 0, dst);
+            imm(e, src->value, 4);
+        } else if (dst->kind == OPND_REG) {
+            /* movabs */
+            rex_opcode_reg(e, true, dst->reg);
+            byte(e, 0xB8 + (dst->reg & 7));
+            imm(e, src->value, 8);
+        } else {
+            unsupported(e);
+        }
+        return;
+    }
+    bool w = width(e, dst, src) == 64;
+    if (src->kind == OPND_REG && (dst->kind == OPND_REG || dst->kind == OPND_MEM))
+        modrm1(e, w, 0x89, src->reg, dst);
+    else if (dst->kind == OPND_REG && src->kind == OPND_MEM)
+        modrm1(e, w, 0x8B, dst->reg, src);
+    else
+        unsupported(e);
+}
+
+static void enc_imul(Encoder *e, int nops, const Operand *dst, const Operand *src) {
+    if (nops != 2 || dst->kind != OPND_REG) unsupported(e);
+    bool w = width(e, dst, src->kind == OPND_IMM ? NULL : src) == 64;
+    if (src->kind == OPND_IMM) {
+        /* imul r, r/m, imm with r/m = r */
+        check_imm_operand(e, dst);
+        if (fits8(src->value)) {
+            modrm1(e, w, 0x6B, dst->reg, dst);
+            imm(e, src->value, 1);
+        } else if (fits32(src->value)) {
+            modrm1(e, w, 0x69, dst->reg, dst);
+            imm(e, src->value, 4);
+        } else {
+            unsupported(e);
+        }
+        return;
+    }
+    if (src->kind != OPND_REG && src->kind != OPND_MEM) unsupported(e);
+    modrm2(e, w, 0x0F, 0xAF, dst->reg, src);
+}
+
+static bool is_xmm(const Operand *o) {
+    return o->kind == OPND_REG && o->bits == 128;
+}
+
+/** movdqu xmm, m / movdqu m, xmm: unaligned 16-byte moves (block copies). */
+static void enc_movdqu(Encoder *e, const Operand *dst, const Operand *src) {
+    byte(e, 0xF3);
+    if (is_xmm(dst) && src->kind == OPND_MEM)
+        modrm2(e, false, 0x0F, 0x6F, dst->reg, src);
+    else if (dst->kind == OPND_MEM && is_xmm(src))
+        modrm2(e, false, 0x0F, 0x7F, src->reg, dst);
+    else
+        unsupported(e);
+}
+
+/** Mnemonic of a ModRM /digit opcode group and its digit. */
+typedef struct GroupOp {
+    const char *name;
+    int ext;
+} GroupOp;
+
+/** The /digit of `m` in the NULL-terminated `group`, or -1. */
+static int group_ext(const char *m, const GroupOp *group) {
+    for (; group->name; group++)
+        if (strcmp(m, group->name) == 0) return group->ext;
+    return -1;
+}
+
+/** Encodes everything but the displacement of jumps (see finish_jumps). */
+static void encode_insn(Encoder *e) {
+    const AsmLine *l = e->line;
+    const char *m = l->mnemonic;
+    Operand ops[ASM_MAX_OPS];
+    for (int i = 0; i < ASM_MAX_OPS; i++) {
+        if (i < l->nops) parse_operand(l->ops[i], &ops[i]);
+        else memset(&ops[i], 0, sizeof(ops[i]));
+    }
+    const Operand *a = &ops[0], *b = &ops[1];
+    int n = l->nops;
+
+    static const GroupOp alu[] = {
+        { "add", 0 }, { "or", 1 }, { "and", 4 }, { "sub", 5 }, { "xor", 6 }, { "cmp", 7 }, { NULL, 0 }
+    };
+    static const GroupOp unary[] = {
+        { "not", 2 }, { "neg", 3 }, { "mul", 4 }, { "idiv", 7 }, { NULL, 0 }
+    };
+    static const GroupOp shifts[] = {
+        { "shl", 4 }, { "shr", 5 }, { "sar", 7 }, { NULL, 0 }
+    };
+    int ext = group_ext(m, alu);
+    if (ext >= 0) {
+        if (n != 2) unsupported(e);
+        enc_alu(e, ext, a, b);
+        return;
+    }
+
+    if (strcmp(m, "mov") == 0 && n == 2) {
+        enc_mov(e, a, b);
+    } else if (strcmp(m, "lea") == 0 && n == 2 && a->kind == OPND_REG && b->kind == OPND_MEM) {
+        modrm1(e, width(e, a, NULL) == 64, 0x8D, a->reg, b);
+    } else if (strcmp(m, "test") == 0 && n == 2 && b->kind == OPND_REG) {
+        modrm1(e, width(e, a, b) == 64, 0x85, b->reg, a);
+    } else if (strcmp(m, "imul") == 0) {
+        enc_imul(e, n, a, b);
+    } else if ((ext = group_ext(m, unary)) >= 0 && n == 1) {
+        if (a->kind != OPND_REG && a->kind != OPND_MEM) unsupported(e);
+        modrm1(e, width(e, a, NULL) == 64, 0xF7, ext, a);
+    } else if ((ext = group_ext(m, shifts)) >= 0 && n == 2 && b->kind == OPND_IMM) {
+        /* Shifts by 1 have their own opcode, which GAS picks as well */
+        if (a->kind != OPND_REG && a->kind != OPND_MEM) unsupported(e);
+        if (b->value < 0 || b->value > 63) unsupported(e);
+        check_imm_operand(e, a);
+        modrm1(e, width(e, a, NULL) == 64, b->value == 1 ? 0xD1 : 0xC1, ext, a);
+        if (b->value != 1) imm(e, b->value, 1);
+    } else if (strcmp(m, "movzx") == 0 && n == 2 && a->kind == OPND_REG &&
+               (b->kind == OPND_REG ? b->bits == 8 : b->bits == 8 && b->kind == OPND_MEM)) {
+        modrm2(e, width(e, a, NULL) == 64, 0x0F, 0xB6, a->reg, b);
+    } else if (strncmp(m, "set", 3) == 0 && parse_cc(m + 3) >= 0 && n == 1 &&
+               (a->kind == OPND_REG ? a->bits == 8 : a->kind == OPND_MEM)) {
+        modrm2(e, false, 0x0F, 0x90 + parse_cc(m + 3), 0, a);
+    } else if ((strcmp(m, "push") == 0 || strcmp(m, "pop") == 0) && n == 1) {
+        bool push = m[1] == 'u';
+        if (a->kind == OPND_REG && a->bits == 64) {
+            rex_opcode_reg(e, false, a->reg);
+            byte(e, (push ? 0x50 : 0x58) + (a->reg & 7));
+        } else if (push && a->kind == OPND_IMM && fits8(a->value)) {
+            byte(e, 0x6A);
+            imm(e, a->value, 1);
+        } else if (push && a->kind == OPND_IMM && fits32(a->value)) {
+            byte(e, 0x68);
+            imm(e, a->value, 4);
+        } else {
+            unsupported(e);
+        }
+    } else if (strcmp(m, "movdqu") == 0 && n == 2) {
+        enc_movdqu(e, a, b);
+    } else if (strcmp(m, "pxor") == 0 && n == 2 && is_xmm(a) && is_xmm(b)) {
+        byte(e, 0x66);
+        modrm2(e, false, 0x0F, 0xEF, a->reg, b);
+    } else if (strcmp(m, "cqo") == 0 && n == 0) {
+        byte(e, 0x48);
+        byte(e, 0x99);
+    } else if (strcmp(m, "ret") == 0 && n == 0) {
+        byte(e, 0xC3);
+    } else if (strcmp(m, "nop") == 0 && n == 0) {
+        byte(e, 0x90);
+    } else if (strcmp(m, "call") == 0 && n == 1 && a->kind == OPND_SYM &&
+               strncmp(a->sym, ".L", 2) == 0) {
+        /* Local routines are resolved with the jumps, never relocated */
+        e->c->target = intern_cstr(a->sym);
+        e->c->cc = CC_CALL;
+        e->c->is_near = true;
+        e->c->len = 5;
+    } else if (strcmp(m, "call") == 0 && n == 1 && a->kind == OPND_SYM) {
+        byte(e, 0xE8);
+        e->c->reloc_at = e->c->len;
+        e->c->reloc_sym = obj_symbol(e->obj, a->sym);
+        e->c->reloc_kind = OBJ_REL_CALL32;
+        imm(e, 0, 4);
+    } else if (m[0] == 'j' && n == 1 && a->kind == OPND_SYM &&
+               (strcmp(m, "jmp") == 0 || parse_cc(m + 1) >= 0)) {
+        e->c->target = intern_cstr(a->sym);
+        e->c->cc = strcmp(m, "jmp") == 0 ? CC_JMP : parse_cc(m + 1);
+        e->c->len = 2;
+    } else {
+        unsupported(e);
+    }
+}
+
+/* ---------------------------------------------------------
+   DIRECTIVES & DATA
+   --------------------------------------------------------- */
+
+/** Splits "word rest" into the leading word and the remaining text. */
+static const char *split_word(const char *s, char *word, size_t cap) {
+    skip_space(&s);
+    size_t n = 0;
+    while (s[n] && !isspace((unsigned char)s[n])) n++;
+    if (n >= cap) errorf("assembler: unsupported line: %s\n", s);
+    memcpy(word, s, n);
+    word[n] = '\0';
+    s += n;
+    skip_space(&s);
+    return s;
+}
+
+/**
+ * @brief Appends a `db` (size 1) or `dq` (size 8) operand list.
+ * Quoted strings are only accepted by db.
+ */
+static void emit_data(StrBuf *out, int size, const char *p, const char *line) {
+    while (1) {
+        skip_space(&p);
+        if (size == 1 && (*p == '"' || *p == '\'')) {
+            char quote = *p++;
+            const char *end = strchr(p, quote);
+            if (!end) errorf("assembler: unterminated string: %s\n", line);
+            sb_append(out, p, (size_t)(end - p));
+            p = end + 1;
+        } else {
+            const char *start = p;
+            while (*p && *p != ',' && !isspace((unsigned char)*p)) p++;
+            int64_t v;
+            if (!parse_int(start, (size_t)(p - start), &v) || (size == 1 && (v < -128 || v > 255)))
+                errorf("assembler: bad data operand: %s\n", line);
+            char *dst = sb_reserve(out, (size_t)size);
+            for (int i = 0; i < size; i++)
+                dst[i] = (char)(((uint64_t)v >> (8 * i)) & 0xFF);
+            out->len += (size_t)size;
+        }
+        skip_space(&p);
+        if (*p == '\0') return;
+        if (*p++ != ',') errorf("assembler: bad data operand: %s\n", line);
+    }
+}
+
+/* ---------------------------------------------------------
+   DRIVER
+   --------------------------------------------------------- */
+
+/** Symbol of a .text label and the instruction it precedes. */
+typedef struct TextLabel {
+    int symbol;             /* ObjFile symbol, or -1 for local .L labels */
+    int insn;
+} TextLabel;
+
+typedef struct Assembler {
+    ObjFile *obj;
+    int section;
+
+    Code *code;             /* .text instructions in order */
+    int ncode, cap;
+
+    SymTab labels;          /* Interned label name -> TextLabel */
+} Assembler;
+
+static void define_label(Assembler *as, const char *name, size_t len) {
+    char tmp[ASM_OP_LEN];
+    if (len == 0 || len >= sizeof(tmp)) errorf("assembler: bad label '%.*s'\n", (int)len, name);
+    memcpy(tmp, name, len);
+    tmp[len] = '\0';
+
+    Symbol key = intern(tmp, len);
+    if (symtab_lookup(&as->labels, key))
+        errorf("assembler: label '%s' defined twice\n", tmp);
+    TextLabel *l = symtab_declare(&as->labels, key);
+    l->symbol = -1;
+    l->insn = as->ncode;
+
+    if (as->section != OBJ_SEC_TEXT) {
+        l->symbol = obj_symbol(as->obj, tmp);
+        as->obj->syms[l->symbol].section = as->section;
+        as->obj->syms[l->symbol].value = as->obj->sections[as->section].data.len;
+    } else if (strncmp(tmp, ".L", 2) != 0) {
+        /* Offsets of .text symbols are known once jumps are sized */
+        l->symbol = obj_symbol(as->obj, tmp);
+        as->obj->syms[l->symbol].section = OBJ_SEC_TEXT;
+    }
+}
+
+static void assemble_directive(Assembler *as, const char *text) {
+    char word[ASM_OP_LEN];
+    const char *p = text;
+    skip_space(&p);
+    if (*p == '\0' || *p == ';') return;
+
+    const char *rest = split_word(p, word, sizeof(word));
+    size_t wlen = strlen(word);
+
+    /* "label: db ..." */
+    if (wlen > 1 && word[wlen - 1] == ':') {
+        define_label(as, word, wlen - 1);
+        if (*rest == '\0') return;
+        p = rest;
+        rest = split_word(p, word, sizeof(word));
+    }
+
+    if (strcmp(word, "section") == 0) {
+        char name[ASM_OP_LEN];
+        const char *attr = split_word(rest, name, sizeof(name));
+        if (strcmp(name, ".text") == 0) as->section = OBJ_SEC_TEXT;
+        else if (strcmp(name, ".data") == 0) as->section = OBJ_SEC_DATA;
+        else if (strcmp(name, ".rodata") == 0 || strcmp(name, ".rdata") == 0) as->section = OBJ_SEC_RODATA;
+        else errorf("assembler: unsupported section '%s'\n", rest);
+
+        /* Sections are always at least OBJ_SECTION_ALIGN aligned */
+        int64_t align;
+        if (*attr && !(strncmp(attr, "align=", 6) == 0 &&
+                       parse_int(attr + 6, strlen(attr + 6), &align) &&
+                       align > 0 && OBJ_SECTION_ALIGN % align == 0))
+            errorf("assembler: unsupported section attribute '%s'\n", attr);
+    } else if (strcmp(word, "global") == 0) {
+        int sym = obj_symbol(as->obj, rest);
+        as->obj->syms[sym].global = true;
+    } else if (strcmp(word, "extern") == 0) {
+        obj_symbol(as->obj, rest);
+    } else if (strcmp(word, "db") == 0 && as->section != OBJ_SEC_TEXT) {
+        emit_data(&as->obj->sections[as->section].data, 1, rest, text);
+    } else if (strcmp(word, "dq") == 0 && as->section != OBJ_SEC_TEXT) {
+        emit_data(&as->obj->sections[as->section].data, 8, rest, text);
+    } else {
+        errorf("assembler: unsupported directive: %s\n", text);
+    }
+}
+
+static Code *push_code(Assembler *as) {
+    if (as->ncode == as->cap) {
+        as->cap = as->cap ? as->cap * 2 : 256;
+        as->code = xrealloc(as->code, sizeof(Code) * (size_t)as->cap);
+    }
+    Code *c = &as->code[as->ncode++];
+    memset(c, 0, sizeof(*c));
+    c->reloc_at = -1;
+    c->target = SYM_NONE;
+    return c;
+}
+
+static int jump_size(const Code *c) {
+    if (!c->is_near) return 2;
+    return c->cc == CC_JMP || c->cc == CC_CALL ? 5 : 6;
+}
+
+/** Widens jumps until every displacement fits; fills `offset` (ncode + 1 entries). */
+static void size_jumps(Assembler *as, int *offset) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        int pos = 0;
+        for (int i = 0; i < as->ncode; i++) {
+            offset[i] = pos;
+            pos += as->code[i].target != SYM_NONE ? jump_size(&as->code[i]) : as->code[i].len;
+        }
+        offset[as->ncode] = pos;
+
+        for (int i = 0; i < as->ncode; i++) {
+            Code *c = &as->code[i];
+            if (c->target == SYM_NONE) continue;
+            TextLabel *l = symtab_lookup(&as->labels, c->target);
+            if (!l) errorf("assembler: undefined label '%s'\n", sym_name(c->target));
+            if (c->is_near) continue;
+            long disp = (long)offset[l->insn] - (offset[i] + 2);
+            if (!fits8(disp)) {
+                c->is_near = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+/** Writes the final bytes of a jump whose form and target offset are known. */
+static void finish_jump(Code *c, long disp) {
+    c->len = 0;
+    if (c->is_near) {
+        if (c->cc == CC_JMP || c->cc == CC_CALL) {
+            c->bytes[c->len++] = c->cc == CC_JMP ? 0xE9 : 0xE8;
+        } else {
+            c->bytes[c->len++] = 0x0F;
+            c->bytes[c->len++] = (uint8_t)(0x80 + c->cc);
+        }
+        disp -= jump_size(c);
+        for (int k = 0; k < 4; k++)
+            c->bytes[c->len++] = (uint8_t)(((unsigned long)disp >> (8 * k)) & 0xFF);
+    } else {
+        c->bytes[c->len++] = (uint8_t)(c->cc == CC_JMP ? 0xEB : 0x70 + c->cc);
+        c->bytes[c->len++] = (uint8_t)((disp - 2) & 0xFF);
+    }
+}
+
+void x86_assemble(const AsmBuf *buf, ObjFile *obj) {
+    Assembler as;
+    memset(&as, 0, sizeof(as));
+    as.obj = obj;
+    as.section = OBJ_SEC_TEXT;
+    symtab_init(&as.labels, sizeof(TextLabel));
+
+    for (int i = 0; i < buf->n; i++) {
+        const AsmLine *line = &buf->lines[i];
+        switch (line->kind) {
+        case ASM_INSN: {
+            if (line->mnemonic[0] == '\0') break;     /* Removed by the peephole pass */
+            if (as.section != OBJ_SEC_TEXT)
+                errorf("assembler: instruction outside .text: %s\n", line->mnemonic);
+            Encoder e = { obj, line, push_code(&as) };
+            encode_insn(&e);
+            break;
+        }
+        case ASM_LABEL:
+            define_label(&as, line->text, strlen(line->text) - 1);
+            break;
+        case ASM_DIRECTIVE:
+            assemble_directive(&as, line->text);
+            break;
+        }
+    }
+    if (buf->pending.len > 0)
+        errorf("assembler: unterminated last line\n");
+
+    int *offset = xmalloc(sizeof(int) * (size_t)(as.ncode + 1));
+    size_jumps(&as, offset);
+
+    StrBuf *text = &obj->sections[OBJ_SEC_TEXT].data;
+    for (int i = 0; i < as.ncode; i++) {
+        Code *c = &as.code[i];
+        if (c->target != SYM_NONE) {
+            TextLabel *l = symtab_lookup(&as.labels, c->target);
+            finish_jump(c, (long)offset[l->insn] - offset[i]);
+        }
+        if (c->reloc_at >= 0)
+            obj_add_reloc(obj, OBJ_SEC_TEXT, (uint64_t)(offset[i] + c->reloc_at),
+                          c->reloc_sym, c->reloc_kind);
+        sb_append(text, (const char *)c->bytes, (size_t)c->len);
+    }
+
+    /* Now that instruction offsets are final, place the .text symbols */
+    for (int i = 0; i < obj->nsyms; i++) {
+        ObjSymbol *sym = &obj->syms[i];
+        if (sym->section != OBJ_SEC_TEXT) continue;
+        TextLabel *l = symtab_lookup(&as.labels, intern_cstr(sym->name));
+        sym->value = (uint64_t)offset[l->insn];
+    }
+
+    free(offset);
+    free(as.code);
+    symtab_free(&as.labels);
+}